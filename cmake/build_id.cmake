@@ -0,0 +1,16 @@
+# Writes OUTPUT, the identity of the compiler being built: the LLVM it links and a hash of its own sources.
+# Run at every build, the header is only rewritten when the identity changes, so nothing is recompiled otherwise.
+
+file(GLOB_RECURSE BUILD_ID_SOURCES "${SOURCE_DIR}/src/*" "${SOURCE_DIR}/include/*" "${SOURCE_DIR}/lang/*.cpp" "${SOURCE_DIR}/CMakeLists.txt")
+list(SORT BUILD_ID_SOURCES)
+
+set(BUILD_ID_HASHES "${COMPILER_CONFIGURATION}")
+foreach(source ${BUILD_ID_SOURCES})
+    file(SHA256 "${source}" source_hash)
+    string(APPEND BUILD_ID_HASHES " ${source_hash}")
+endforeach()
+
+string(SHA256 BUILD_ID_HASH "${BUILD_ID_HASHES}")
+set(BUILD_ID "llvm-${LLVM_VERSION} ${BUILD_ID_HASH}")
+
+configure_file("${SOURCE_DIR}/cmake/build_id.hpp.in" "${OUTPUT}" @ONLY)
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lang
+{
+    namespace ast
+    {
+        /* Fixed size array living in an Arena, used for the children of an AST node */
+        template<typename T>
+        struct List
+        {
+            T* m_data{nullptr};
+            std::uint32_t m_size{0};
+
+            T* begin() const { return m_data; }
+            T* end() const { return m_data + m_size; }
+
+            std::size_t size() const { return m_size; }
+            bool empty() const { return m_size == 0; }
+
+            T& operator[](std::size_t index) const { return m_data[index]; }
+        };
+
+        /*
+            Bump allocator owning every node of an AST.
+
+            Nodes are carved out of large blocks and are never destroyed one by one, so they must be
+            trivially destructible (children are plain pointers and Lists). Releasing the arena frees the
+            whole tree at once, without walking it.
+        */
+        class Arena
+        {
+            public:
+                Arena() = default;
+                ~Arena() = default;
+
+                Arena(const Arena&) = delete;
+                Arena& operator=(const Arena&) = delete;
+
+                Arena(Arena&&) = default;
+                Arena& operator=(Arena&&) = default;
+
+                void* allocate(std::size_t size, std::size_t alignment)
+                {
+                    std::size_t aligned_offset = (m_offset + alignment - 1) & ~(alignment - 1);
+
+                    if(m_blocks.empty() || aligned_offset + size > m_block_size)
+                    {
+                        this->add_block(size + alignment);
+                        aligned_offset = (m_offset + alignment - 1) & ~(alignment - 1);
+                    }
+
+                    m_offset = aligned_offset + size;
+                    m_bytes_allocated += size;
+
+                    return m_blocks.back().get() + aligned_offset;
+                }
+
+                template<typename T, typename... Args>
+                T* make(Args&&... args)
+                {
+                    static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+
+                    return new (this->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+                }
+
+                template<typename T>
+                List<T> make_list(const T* first, std::size_t count)
+                {
+                    static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+
+                    if(count == 0)
+                    {
+                        return List<T>{};
+                    }
+
+                    T* data = static_cast<T*>(this->allocate(sizeof(T) * count, alignof(T)));
+                    for(std::size_t i = 0; i < count; i++)
+                    {
+                        new (data + i) T(first[i]);
+                    }
+
+                    return List<T>{data, static_cast<std::uint32_t>(count)};
+                }
+
+                /* Frees every node. The most recent block is kept to serve the next allocations */
+                void reset()
+                {
+                    if(m_blocks.size() > 1)
+                    {
+                        std::unique_ptr<char[]> last_block = std::move(m_blocks.back());
+                        m_blocks.clear();
+                        m_blocks.emplace_back(std::move(last_block));
+                    }
+
+                    m_offset = 0;
+                    m_bytes_allocated = 0;
+                }
+
+                /* 
+                    Takes over the blocks of 'other', its nodes do not move and stay valid. 'other' is left empty
+                    The blocks go in front of the current one, which keeps serving the next allocations
+                */
+                void adopt(Arena&& other)
+                {
+                    auto insert_position = m_blocks.empty() ? m_blocks.end() : m_blocks.end() - 1;
+                    m_blocks.insert(insert_position, std::make_move_iterator(other.m_blocks.begin()), std::make_move_iterator(other.m_blocks.end()));
+                    m_bytes_allocated += other.m_bytes_allocated;
+
+                    other.m_blocks.clear();
+                    other.m_block_size = 0;
+                    other.m_offset = 0;
+                    other.m_bytes_allocated = 0;
+                }
+
+                std::size_t bytes_allocated() const
+                {
+                    return m_bytes_allocated;
+                }
+
+                std::size_t block_count() const
+                {
+                    return m_blocks.size();
+                }
+
+            private:
+                void add_block(std::size_t minimum_size)
+                {
+                    /* Blocks double in size up to MAX_BLOCK_SIZE, a huge request gets a block of its own size */
+                    std::size_t block_size = m_blocks.empty() ? MIN_BLOCK_SIZE : std::min(m_block_size * 2, MAX_BLOCK_SIZE);
+                    block_size = std::max(block_size, minimum_size);
+
+                    m_blocks.emplace_back(new char[block_size]);
+                    m_block_size = block_size;
+                    m_offset = 0;
+                }
+
+            private:
+                static constexpr std::size_t MIN_BLOCK_SIZE = 64 * 1024;
+                static constexpr std::size_t MAX_BLOCK_SIZE = 4 * 1024 * 1024;
+
+                std::vector<std::unique_ptr<char[]>> m_blocks;
+                std::size_t m_block_size{0};
+                std::size_t m_offset{0};
+                std::size_t m_bytes_allocated{0};
+        };
+    }
+}
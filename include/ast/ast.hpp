@@ -2,318 +2,379 @@
 
 #include <types/types.hpp>
 #include <token/token.hpp>
-#include "llvm/IR/Value.h"
+#include <ast/arena.hpp>
 
 namespace lang
 {
     namespace ast
     {   
 
+        /*
+            Storage of the variable a name refers to, filled in by the Resolver
+            'depth' counts the functions between the reference and the declaration: 0 is the frame of the function the
+            reference is in (or of the top-level code), 1 the frame of the function around it and so on. 'slot' indexes that frame
+            Top-level 'var' and 'fun' declarations are globals instead, with their own slots
+        */
+        struct Binding
+        {
+            static constexpr std::uint32_t GLOBAL = UINT32_MAX;
+            static constexpr std::uint32_t UNRESOLVED = UINT32_MAX;
+
+            std::uint32_t depth{GLOBAL};
+            std::uint32_t slot{UNRESOLVED};
+
+            bool is_global() const { return depth == GLOBAL; }
+            bool is_resolved() const { return slot != UNRESOLVED; }
+        };
+
         /**********************************************************************************************************************8*/
-        struct ExpressionStatement;
-        struct PrintStatement;
-        struct VarStatement;
-        struct BlockStatement;
-        struct IfStatement;
-        struct WhileStatement;
-        struct FunctionStatement;
-        struct ReturnStatement;
-        
-        struct BaseVisitorForStatement
+        enum class StatementKind: std::uint8_t
         {
-            virtual void visit(ExpressionStatement* statement) = 0;
-            virtual void visit(PrintStatement* statement) = 0;
-            virtual void visit(VarStatement* statement) = 0;
-            virtual void visit(BlockStatement* statement) = 0;
-            virtual void visit(IfStatement* statement) = 0;
-            virtual void visit(WhileStatement* statement) = 0;
-            virtual void visit(FunctionStatement* statement) = 0;
-            virtual void visit(ReturnStatement* statement) = 0;
+            EXPRESSION, PRINT, VAR, BLOCK, IF, WHILE, FUNCTION, RETURN
         };
 
+        /* 
+            Nodes live in an ast::Arena and are never deleted one by one, so every node must stay trivially destructible:
+            children are plain pointers into the same arena and lists of children are ast::List spans
+            There are no virtual functions, 'kind' tells which node it is, see StatementVisitor and ast::as()
+        */
         struct Statement
         {
-            virtual void accept(BaseVisitorForStatement* visitor) = 0;
-            virtual ~Statement() = default;
+            const StatementKind kind;
+
+            protected:
+                Statement(StatementKind kind)
+                    : kind(kind)
+                {}
+
+                ~Statement() = default;
         };
         /**********************************************************************************************************************8*/
 
 
-        struct BinaryExpression;
-        struct GroupingExpression;
-        struct LiteralExpression;
-        struct UnaryExpression;
-        struct VariableExpression;
-        struct AssignmentExpression;
-        struct LogicalExpression;
-        struct CallExpression;
-        struct ParenthesizeExpression;
-
-        struct BaseVisitorForExpression
+        enum class ExpressionKind: std::uint8_t
         {
-            virtual llvm::Value* visit(BinaryExpression* expression) = 0;
-            virtual llvm::Value* visit(GroupingExpression* expression) = 0;
-            virtual llvm::Value* visit(LiteralExpression* expression) = 0;
-            virtual llvm::Value* visit(UnaryExpression* expression) = 0;
-            virtual llvm::Value* visit(VariableExpression* expression) = 0;
-            virtual llvm::Value* visit(AssignmentExpression* expression) = 0;
-            virtual llvm::Value* visit(LogicalExpression* expression) = 0;
-            virtual llvm::Value* visit(CallExpression* expression) = 0;
-            virtual llvm::Value* visit(ParenthesizeExpression* expression) = 0;
+            BINARY, GROUPING, LITERAL, UNARY, VARIABLE, ASSIGNMENT, LOGICAL, CALL
         };
 
         struct Expression
         {
-            virtual llvm::Value* accept(BaseVisitorForExpression* visitor) = 0;
-            virtual ~Expression() = default;
+            const ExpressionKind kind;
+
+            protected:
+                Expression(ExpressionKind kind)
+                    : kind(kind)
+                {}
+
+                ~Expression() = default;
         };
 
         /**********************************************************************************************************************8*/
         struct ExpressionStatement: public Statement
         {
-            std::unique_ptr<Expression> expr;
+            static constexpr StatementKind KIND = StatementKind::EXPRESSION;
 
-            ExpressionStatement(std::unique_ptr<Expression> expr)
-                : expr(std::move(expr))
-            {}
+            Expression* expr;
 
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            ExpressionStatement(Expression* expr)
+                : Statement(KIND), expr(expr)
+            {}
         };
 
         struct PrintStatement: public Statement
         {
-            std::unique_ptr<Expression> expr;
+            static constexpr StatementKind KIND = StatementKind::PRINT;
 
-            PrintStatement(std::unique_ptr<Expression> expr)
-                : expr(std::move(expr))
-            {}
+            Expression* expr;
 
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            PrintStatement(Expression* expr)
+                : Statement(KIND), expr(expr)
+            {}
         };
 
         struct VarStatement: public Statement
         {
-            lang::Token name; /* Stores the TokenType::IDENTIFIER */
-            std::unique_ptr<Expression> initializer;
+            static constexpr StatementKind KIND = StatementKind::VAR;
 
-            VarStatement(const lang::Token& name, std::unique_ptr<Expression> initializer)
-                : name(name), initializer(std::move(initializer))
-            {}
+            lang::Token name; /* Stores the TokenType::IDENTIFIER, name.m_symbol is its interned id */
+            Expression* initializer;
 
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            Binding binding; /* Its depth is 0 or Binding::GLOBAL */
+            bool captured; /* A function declared inside its scope refers to it, so it has to outlive the frame */
+
+            VarStatement(const lang::Token& name, Expression* initializer)
+                : Statement(KIND), name(name), initializer(initializer), binding(), captured(false)
+            {}
         };
 
         struct BlockStatement: public Statement
         {
-            std::vector<std::unique_ptr<Statement>> statements;
+            static constexpr StatementKind KIND = StatementKind::BLOCK;
 
-            BlockStatement(std::vector<std::unique_ptr<Statement>>&& statements)
-                : statements(std::move(statements))
-            {}
+            List<Statement*> statements;
 
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            BlockStatement(List<Statement*> statements)
+                : Statement(KIND), statements(statements)
+            {}
         };
 
         struct IfStatement: public Statement
         {
-            std::unique_ptr<Expression> condition;
-            std::unique_ptr<Statement> thenBranch;
-            std::unique_ptr<Statement> elseBranch;
+            static constexpr StatementKind KIND = StatementKind::IF;
 
-            IfStatement(std::unique_ptr<Expression> condition, std::unique_ptr<Statement> thenBranch, std::unique_ptr<Statement> elseBranch)
-                : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch))
-            {}
+            Expression* condition;
+            Statement* thenBranch;
+            Statement* elseBranch;
 
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            IfStatement(Expression* condition, Statement* thenBranch, Statement* elseBranch)
+                : Statement(KIND), condition(condition), thenBranch(thenBranch), elseBranch(elseBranch)
+            {}
         };
 
         struct WhileStatement: public Statement
         {
-            std::unique_ptr<Expression> condition_expr;
-            std::unique_ptr<Statement> body_stmt;
+            static constexpr StatementKind KIND = StatementKind::WHILE;
 
-            WhileStatement(std::unique_ptr<Expression> condition_expr, std::unique_ptr<Statement> body_stmt)
-                : condition_expr(std::move(condition_expr)), body_stmt(std::move(body_stmt))
-            {}
+            Expression* condition_expr;
+            Statement* body_stmt;
 
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            WhileStatement(Expression* condition_expr, Statement* body_stmt)
+                : Statement(KIND), condition_expr(condition_expr), body_stmt(body_stmt)
+            {}
         };
 
         struct FunctionStatement: public Statement
         {
-            lang::Token name;   /* Stores the function name */
-            std::vector<lang::Token> params; /* Stores the parametes*/
-            std::vector<std::unique_ptr<Statement>> body_stmts;
-
-            FunctionStatement(const lang::Token& name, std::vector<lang::Token>&& params, std::vector<std::unique_ptr<Statement>>&& body_stmts)
-                : name(name), params(std::move(params)), body_stmts(std::move(body_stmts))
+            static constexpr StatementKind KIND = StatementKind::FUNCTION;
+
+            lang::Token name;   /* Stores the function name, name.m_symbol is its interned id */
+            List<lang::Token> params; /* Stores the parametes, each with its interned m_symbol */
+            List<Statement*> body_stmts;
+
+            /* 
+                With lazy function bodies the body is only brace matched, body_stmts stays empty and 'body_begin' is the
+                index of the first token after '{' in the parser's token stream, see Parser::parse_function_body()
+            */
+            bool is_body_parsed;
+            int body_begin;
+
+            /* 
+                Filled in by the Resolver: where the function itself is stored, like VarStatement::binding and captured, 
+                the slots its frame needs, the parameters taking the first ones, and which parameters are captured
+            */
+            Binding binding;
+            bool captured;
+            std::uint32_t frame_size;
+            List<bool> captured_params;
+
+            FunctionStatement(const lang::Token& name, List<lang::Token> params, List<Statement*> body_stmts)
+                : Statement(KIND), name(name), params(params), body_stmts(body_stmts), is_body_parsed(true), body_begin(-1), binding(), captured(false), frame_size(0), captured_params()
             {}
 
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            FunctionStatement(const lang::Token& name, List<lang::Token> params, int body_begin)
+                : Statement(KIND), name(name), params(params), body_stmts(), is_body_parsed(false), body_begin(body_begin), binding(), captured(false), frame_size(0), captured_params()
+            {}
         };
 
         struct ReturnStatement: public Statement
         {
+            static constexpr StatementKind KIND = StatementKind::RETURN;
+
             lang::Token keyword; /* stores the keyword 'return' */
-            std::unique_ptr<Expression> expr;
+            Expression* expr;
 
-            ReturnStatement(const lang::Token& keyword, std::unique_ptr<Expression> expr)
-                : keyword(keyword), expr(std::move(expr))
+            ReturnStatement(const lang::Token& keyword, Expression* expr)
+                : Statement(KIND), keyword(keyword), expr(expr)
             {}
-
-            void accept(BaseVisitorForStatement* visitor) override
-            {
-                return visitor->visit(this);
-            }
         };
         /**********************************************************************************************************************8*/
 
 
         struct BinaryExpression: public Expression
         {
-            std::unique_ptr<Expression> left;
+            static constexpr ExpressionKind KIND = ExpressionKind::BINARY;
+
+            Expression* left;
             lang::Token op;
-            std::unique_ptr<Expression> right;
+            Expression* right;
 
-            BinaryExpression(std::unique_ptr<Expression> left, const lang::Token& op, std::unique_ptr<Expression> right)
-                : left(std::move(left)), right(std::move(right)), op(op)
+            BinaryExpression(Expression* left, const lang::Token& op, Expression* right)
+                : Expression(KIND), left(left), right(right), op(op)
             {}
-
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
-            {
-                return visitor->visit(this);
-            }
         };
 
         struct GroupingExpression: public Expression
         {
+            static constexpr ExpressionKind KIND = ExpressionKind::GROUPING;
+
             /* '(' expression ')' */
-            std::unique_ptr<Expression> expr;
+            Expression* expr;
 
-            GroupingExpression(std::unique_ptr<Expression> expr)
-                : expr(std::move(expr))
+            GroupingExpression(Expression* expr)
+                : Expression(KIND), expr(expr)
             {}
-
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
-            {
-                return visitor->visit(this);
-            }
         };
 
         struct LiteralExpression: public Expression
         {
-            /* We can only store double */
-            double value;
+            static constexpr ExpressionKind KIND = ExpressionKind::LITERAL;
+
+            enum class Type: std::uint8_t { NIL, BOOLEAN, NUMBER, STRING };
+
+            Type type;
+            bool boolean; /* BOOLEAN */
+            double number; /* NUMBER */
+            std::string_view string; /* STRING: the characters between the quotes, a view into the mapped source */
 
-            LiteralExpression(double value)
-                : value(value)
+            LiteralExpression()
+                : Expression(KIND), type(Type::NIL), boolean(false), number(0), string()
             {}
 
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
-            {
-                return visitor->visit(this);
-            }
+            explicit LiteralExpression(bool boolean)
+                : Expression(KIND), type(Type::BOOLEAN), boolean(boolean), number(0), string()
+            {}
+
+            explicit LiteralExpression(double number)
+                : Expression(KIND), type(Type::NUMBER), boolean(false), number(number), string()
+            {}
+
+            explicit LiteralExpression(std::string_view string)
+                : Expression(KIND), type(Type::STRING), boolean(false), number(0), string(string)
+            {}
         };
 
         struct UnaryExpression: public Expression
         {
+            static constexpr ExpressionKind KIND = ExpressionKind::UNARY;
+
             lang::Token op;
-            std::unique_ptr<Expression> expr;
+            Expression* expr;
 
-            UnaryExpression(const lang::Token& op, std::unique_ptr<Expression> expr)
-                : op(op), expr(std::move(expr))
+            UnaryExpression(const lang::Token& op, Expression* expr)
+                : Expression(KIND), op(op), expr(expr)
             {}
-
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
-            {
-                return visitor->visit(this);
-            }
         };
 
         /* Expression class for referencing a variable, like "a". */
         struct VariableExpression: public Expression
         {
-            lang::Token name; /** Stores the TokenType::IDENTIFIER */
+            static constexpr ExpressionKind KIND = ExpressionKind::VARIABLE;
+
+            lang::Token name; /** Stores the TokenType::IDENTIFIER, name.m_symbol is its interned id */
+            Binding binding;
 
             VariableExpression(const lang::Token& name)
-                : name(name)
+                : Expression(KIND), name(name), binding()
             {}
-
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
-            {
-                return visitor->visit(this);
-            }
         };
 
         struct AssignmentExpression: public Expression
         {
-            std::unique_ptr<Expression> expr;
-            lang::Token name; /* Stores assignment operator*/
+            static constexpr ExpressionKind KIND = ExpressionKind::ASSIGNMENT;
 
+            Expression* expr;
+            lang::Token name; /* Stores the assigned TokenType::IDENTIFIER, name.m_symbol is its interned id */
+            Binding binding;
 
-            AssignmentExpression(const lang::Token& name, std::unique_ptr<Expression> expr)
-                : name(name), expr(std::move(expr))
+            AssignmentExpression(const lang::Token& name, Expression* expr)
+                : Expression(KIND), expr(expr), name(name), binding()
             {}
-
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
-            {
-                return visitor->visit(this);
-            }
         };
 
         struct LogicalExpression: public Expression
         {
-            std::unique_ptr<Expression> left;
+            static constexpr ExpressionKind KIND = ExpressionKind::LOGICAL;
+
+            Expression* left;
             lang::Token op; /* Stores logical operator*/
-            std::unique_ptr<Expression> right;
+            Expression* right;
 
 
-            LogicalExpression(std::unique_ptr<Expression> left, const lang::Token& op, std::unique_ptr<Expression> right)
-                : left(std::move(left)), op(op), right(std::move(right))
+            LogicalExpression(Expression* left, const lang::Token& op, Expression* right)
+                : Expression(KIND), left(left), op(op), right(right)
             {}
-
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
-            {
-                return visitor->visit(this);
-            }
         };
 
         struct CallExpression: public Expression
         {
-            std::unique_ptr<Expression> callee;
+            static constexpr ExpressionKind KIND = ExpressionKind::CALL;
+
+            Expression* callee;
             lang::Token closing_paren;
-            std::vector<std::unique_ptr<Expression>> arguments;
+            List<Expression*> arguments;
 
 
-            CallExpression(std::unique_ptr<Expression> callee, const lang::Token& closing_paren, std::vector<std::unique_ptr<Expression>>&& arguments)
-                : callee(std::move(callee)), closing_paren(closing_paren), arguments(std::move(arguments))
+            CallExpression(Expression* callee, const lang::Token& closing_paren, List<Expression*> arguments)
+                : Expression(KIND), callee(callee), closing_paren(closing_paren), arguments(arguments)
             {}
+        };
+        /**********************************************************************************************************************8*/
+
+
+        /* Checked downcast, it returns nullptr for a node of another kind or for nullptr */
+        template<typename Node>
+        Node* as(Statement* statement)
+        {
+            return statement != nullptr && statement->kind == Node::KIND ? static_cast<Node*>(statement) : nullptr;
+        }
 
-            llvm::Value* accept(BaseVisitorForExpression* visitor) override
+        template<typename Node>
+        Node* as(Expression* expression)
+        {
+            return expression != nullptr && expression->kind == Node::KIND ? static_cast<Node*>(expression) : nullptr;
+        }
+
+        /*
+            Switch based dispatch on the kind tag. A pass derives from the visitors of the node families it walks,
+            with itself as 'Derived', and implements one visit() overload per node, returning 'Result'
+            The call to the overload is direct, so it can be inlined, and a pass does not need to know about code generation
+
+                class NodeCounter: public StatementVisitor<NodeCounter>, public ExpressionVisitor<NodeCounter, int> { ... };
+        */
+        template<typename Derived, typename Result = void>
+        struct StatementVisitor
+        {
+            Result visit_statement(Statement* statement)
+            {
+                Derived* derived = static_cast<Derived*>(this);
+
+                switch(statement->kind)
+                {
+                    case StatementKind::EXPRESSION: return derived->visit(static_cast<ExpressionStatement*>(statement));
+                    case StatementKind::PRINT: return derived->visit(static_cast<PrintStatement*>(statement));
+                    case StatementKind::VAR: return derived->visit(static_cast<VarStatement*>(statement));
+                    case StatementKind::BLOCK: return derived->visit(static_cast<BlockStatement*>(statement));
+                    case StatementKind::IF: return derived->visit(static_cast<IfStatement*>(statement));
+                    case StatementKind::WHILE: return derived->visit(static_cast<WhileStatement*>(statement));
+                    case StatementKind::FUNCTION: return derived->visit(static_cast<FunctionStatement*>(statement));
+                    case StatementKind::RETURN: return derived->visit(static_cast<ReturnStatement*>(statement));
+                }
+
+                __builtin_unreachable();
+            }
+        };
+
+        template<typename Derived, typename Result = void>
+        struct ExpressionVisitor
+        {
+            Result visit_expression(Expression* expression)
             {
-                return visitor->visit(this);
+                Derived* derived = static_cast<Derived*>(this);
+
+                switch(expression->kind)
+                {
+                    case ExpressionKind::BINARY: return derived->visit(static_cast<BinaryExpression*>(expression));
+                    case ExpressionKind::GROUPING: return derived->visit(static_cast<GroupingExpression*>(expression));
+                    case ExpressionKind::LITERAL: return derived->visit(static_cast<LiteralExpression*>(expression));
+                    case ExpressionKind::UNARY: return derived->visit(static_cast<UnaryExpression*>(expression));
+                    case ExpressionKind::VARIABLE: return derived->visit(static_cast<VariableExpression*>(expression));
+                    case ExpressionKind::ASSIGNMENT: return derived->visit(static_cast<AssignmentExpression*>(expression));
+                    case ExpressionKind::LOGICAL: return derived->visit(static_cast<LogicalExpression*>(expression));
+                    case ExpressionKind::CALL: return derived->visit(static_cast<CallExpression*>(expression));
+                }
+
+                __builtin_unreachable();
             }
         };
     }
-}
\ No newline at end of file
+}
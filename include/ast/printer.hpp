@@ -0,0 +1,66 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+#include <ast/ast.hpp>
+
+namespace lang
+{
+    namespace ast
+    {
+        /*
+            Writes a tree as nested parenthesized forms, one line per top-level statement, e.g. (print (+ 1 (group x))).
+
+            Used to compare the trees two parsers or parsing paths build from the same source, so every node and token
+            the parser keeps is written, numbers with all their digits. The tree is walked with an explicit stack like
+            the other passes, any nesting the parser accepts can be printed.
+        */
+        class Printer: public StatementVisitor<Printer>, public ExpressionVisitor<Printer>
+        {
+            public:
+                explicit Printer(std::ostream& out);
+
+                void print(const std::vector<Statement*>& statements);
+
+                /* Each writes the head of its node and schedules its children and closing parenthesis */
+                void visit(ExpressionStatement* statement);
+                void visit(PrintStatement* statement);
+                void visit(VarStatement* statement);
+                void visit(BlockStatement* statement);
+                void visit(IfStatement* statement);
+                void visit(WhileStatement* statement);
+                void visit(FunctionStatement* statement);
+                void visit(ReturnStatement* statement);
+
+                void visit(BinaryExpression* expression);
+                void visit(GroupingExpression* expression);
+                void visit(LiteralExpression* expression);
+                void visit(UnaryExpression* expression);
+                void visit(VariableExpression* expression);
+                void visit(AssignmentExpression* expression);
+                void visit(LogicalExpression* expression);
+                void visit(CallExpression* expression);
+
+            private:
+                /* A node to print or, when both are nullptr, a piece of text written once the nodes above it are done */
+                struct Work
+                {
+                    Statement* statement;
+                    Expression* expression;
+                    const char* text;
+                };
+
+                void push(Statement* statement);
+                void push(Expression* expression);
+                void push(const char* text);
+
+                /* The children of a list separated by spaces, pushed last to first so they are printed in order */
+                void push_list(List<Statement*> statements);
+                void push_list(List<Expression*> expressions);
+
+            private:
+                std::ostream& m_out;
+                std::vector<Work> m_work;
+        };
+    }
+}
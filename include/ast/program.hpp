@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <ast/arena.hpp>
+
+namespace lang
+{
+    namespace ast
+    {
+        struct Statement;
+
+        /* The parsed top-level declarations together with the arena owning all of their nodes */
+        struct Program
+        {
+            lang::ast::Arena arena;
+            std::vector<lang::ast::Statement*> statements;
+        };
+    }
+}
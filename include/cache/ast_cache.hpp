@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <ast/program.hpp>
+
+namespace lang
+{
+    /*
+        On-disk cache of parsed programs, one file per source in a cache directory, named after a hash of the source contents
+        and of the build of the compiler (lang::BUILD_ID), so a rebuilt parser never reuses the trees of the previous one.
+
+        An entry is a flat, pointer free encoding of the tree: nodes are written children first, so decoding is a single
+        pass over the mapped file with one stack per node type, nested as deeply as the parser allows without recursion.
+        Tokens are stored like in a TokenStream, as the offset and length of their lexeme in the source, which has to be
+        mapped anyway to hash it, and identifiers refer to a table of names interned once per entry. A hit also needs the
+        SHA-256 of the source to match the one of the entry, the key alone could collide.
+
+        Only programs parsed without errors are stored, so a hit stands for a successful tokenize and parse.
+    */
+    class AstCache
+    {
+        public:
+            struct Statistics
+            {
+                std::size_t hits{0};
+                std::size_t misses{0};
+                std::size_t stores{0};
+                std::size_t bytes_read{0};
+                std::size_t bytes_written{0};
+            };
+
+            /* Entries written with another nesting limit are not used, a deeper program may not be accepted any more */
+            AstCache(std::string directory, std::size_t max_nesting_depth);
+
+            /* Key of the entry of 'source', computed once by the caller and passed to the load() and the store() following a miss */
+            static std::uint64_t hash_source(std::string_view source);
+
+            /* On a hit the decoded statements are appended to 'program' and their nodes allocated in its arena */
+            bool load(std::string_view source, std::uint64_t source_hash, lang::ast::Program& program);
+
+            /* Every function body must be parsed. It returns false if the entry could not be written */
+            bool store(std::string_view source, std::uint64_t source_hash, const lang::ast::Program& program);
+
+            const Statistics& statistics() const;
+
+        private:
+            std::string entry_path(std::uint64_t source_hash) const;
+
+        private:
+            std::string m_directory;
+            std::size_t m_max_nesting_depth;
+
+            Statistics m_statistics;
+    };
+}
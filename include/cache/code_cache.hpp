@@ -0,0 +1,80 @@
+#pragma once
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace lang
+{
+    /*
+        On-disk cache of compiled code, optimized bitcode or object files, one file per entry in a cache directory, named after
+        a key which hashes the source together with everything else the code depends on: optimization level and pipeline,
+        output, host target and the build of the compiler itself (lang::BUILD_ID, generated at build time), so a rebuilt
+        compiler starts from an empty cache. A hit stands for lexing, parsing, generating and optimizing the source, none of
+        which runs again, but only once the SHA-256 of the source matches the one of the entry as well.
+
+        It is also the llvm::ObjectCache of the JIT, an object the JIT compiles is stored under the entry selected with
+        select_object_entry()
+    */
+    class CodeCache: public llvm::ObjectCache
+    {
+        public:
+            enum class Kind: std::uint8_t { BITCODE, OBJECT };
+
+            struct Statistics
+            {
+                std::size_t hits{0};
+                std::size_t misses{0};
+                std::size_t stores{0};
+                std::size_t bytes_read{0};
+                std::size_t bytes_written{0};
+            };
+
+            using SourceDigest = std::array<std::uint8_t, 32>;
+
+            explicit CodeCache(std::string directory);
+
+            static std::uint64_t hash_key(std::string_view source, std::string_view configuration);
+
+            /* Triple and CPU of the host, part of the configuration of every object file the JIT compiles */
+            static std::string host_configuration();
+
+            static SourceDigest digest_source(std::string_view source);
+
+            /* nullptr on a miss, a damaged or mismatching entry is a miss */
+            std::unique_ptr<llvm::MemoryBuffer> load(std::uint64_t key, std::string_view source, Kind kind);
+
+            /* It returns false if the entry could not be written */
+            bool store(std::uint64_t key, std::string_view source, Kind kind, llvm::StringRef code);
+
+            /* Entry the object of the next module the JIT compiles is stored under */
+            void select_object_entry(std::uint64_t key, std::string_view source);
+
+            void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+
+            /* Entries are looked up before the source is even tokenized, a module reaching the JIT has missed already */
+            std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+            const Statistics& statistics() const;
+
+        private:
+            bool store(std::uint64_t key, std::size_t source_size, const SourceDigest& source_digest, Kind kind, llvm::StringRef code);
+
+            std::string entry_path(std::uint64_t key, Kind kind) const;
+
+        private:
+            std::string m_directory;
+
+            std::uint64_t m_object_key{0};
+            std::size_t m_object_source_size{0};
+            SourceDigest m_object_source_digest{};
+
+            Statistics m_statistics;
+    };
+}
@@ -5,39 +5,268 @@
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBufferRef.h"
+#include "llvm/Target/TargetMachine.h"
 
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <memory>
 #include <string>
 #include <ast/ast.hpp>
+#include <runtime/values.hpp>
 
 namespace lang
 {
+    /*
+        Generates an LLVM module from a resolved tree, the top-level code becomes 'main'.
+
+        Every value is a 64 bit double, NaN boxed as runtime/values.hpp describes, so arithmetic is plain floating point code.
+        Truthiness is the one defined in runtime/values.hpp.
+
+        Locals are entry block allocas, promoted to registers by mem2reg. A local a nested function refers to (flagged by the
+        Resolver) lives in a heap box instead and every closure holds the boxes it uses, copied from the enclosing function
+        when the closure is created, so each execution of a declaration gets a variable of its own. Globals are module globals.
+
+        The runtime (printing, string concatenation and equality, call and operand checks) is generated into the module as
+        well, it only needs the C library, so the module runs under lli as it is. Nothing is freed.
+    */
     class Generator
     {
         public:
             Generator();
             ~Generator();
-            
-            std::vector<std::string> generate(std::vector<std::unique_ptr<lang::ast::Statement>>&& statements);
+
+            std::vector<std::string> generate(const std::vector<lang::ast::Statement*>& statements);
+
+            /*
+                generate() with the top-level functions split across up to 'thread_count' workers, each a Generator with a context
+                and module of its own, while this one generates the top-level code. Modules of different contexts cannot be linked
+                directly, so each worker hands its module over as bitcode, which is linked into this one with llvm::Linker.
+                Lazily parsed bodies are all loaded up front, the loader is not thread safe
+            */
+            std::vector<std::string> generate_parallel(const std::vector<lang::ast::Statement*>& statements, unsigned thread_count);
+
+            /*
+                Streaming interface, generate() is begin_generation(), one generate_declaration() per statement and end_generation()
+                The statement is only borrowed, its arena may be reset as soon as generate_declaration() returns
+            */
+            void begin_generation();
+
+            void generate_declaration(lang::ast::Statement* statement);
+
+            std::vector<std::string> end_generation();
+
+            /*
+                Code for the tiered execution of the Interpreter, each in a module of its own: the runtime alone, with external linkage,
+                and a top-level function defined under 'symbol', which refers to the runtime and to globals named lang.global.<name>
+            */
+            std::vector<std::string> generate_runtime();
+
+            std::vector<std::string> generate_function(lang::ast::FunctionStatement* function, const std::string& symbol);
+
+            /*
+                A loop of a running frame as the function 'double symbol(i8* closure, double* locals, double** boxes)', entered in
+                place of its next condition check. A slot flagged in 'boxed_slots' is the heap box in 'boxes', any other one is
+                read from 'locals' and written back when the loop ends, then it returns LOOP_EXIT_VALUE, a 'return' returns its value.
+                The loop must not use variables of enclosing functions
+            */
+            std::vector<std::string> generate_loop(lang::ast::WhileStatement* loop, const std::vector<bool>& boxed_slots, const std::string& symbol);
+
+            /* It parses the body of a function the parser skipped in lazy mode and returns the errors found in it */
+            using FunctionBodyLoader = std::function<std::vector<std::string>(lang::ast::FunctionStatement*)>;
+
+            void set_function_body_loader(FunctionBodyLoader loader);
+
+            /*
+                It runs the default pipeline of the new pass manager for 'level' (0 to 3) over the generated module, level 0 leaves it as it is.
+                'favor_compile_latency' runs only the per-function simplification pipeline of that level: no inlining or other
+                interprocedural passes, for scripts which run for less time than the full pipeline takes.
+                With a 'target_machine' the module is set up for that target first and the passes see its costs
+            */
+            void optimize(unsigned level, bool favor_compile_latency, llvm::TargetMachine* target_machine = nullptr);
+
+            /* The generated module and its context, the generator starts from new ones at the next begin_generation() */
+            std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>> take_module();
+
+            /* It replaces the generated module with one read from bitcode and returns the errors found reading it */
+            std::vector<std::string> load_bitcode(llvm::MemoryBufferRef bitcode);
+
+            void write_bitcode(llvm::SmallVectorImpl<char>& bitcode);
 
             void save_module_to_file(const std::string& file_name);
             void print_module();
-        
+
         private:
+            static constexpr std::uint64_t QUIET_NAN = lang::runtime::QUIET_NAN;
+            static constexpr std::uint64_t TRUE_VALUE = lang::runtime::TRUE_VALUE;
+            static constexpr std::uint64_t FALSE_VALUE = lang::runtime::FALSE_VALUE;
+            static constexpr std::uint64_t NIL_VALUE = lang::runtime::NIL_VALUE;
+            static constexpr std::uint64_t OBJECT_TAG = lang::runtime::OBJECT_TAG;
+            static constexpr std::uint64_t ADDRESS_MASK = lang::runtime::ADDRESS_MASK;
+            static constexpr std::uint64_t LOOP_EXIT_VALUE = lang::runtime::LOOP_EXIT_VALUE;
+
+            static constexpr std::uint8_t STRING_OBJECT = lang::runtime::STRING_OBJECT;
+            static constexpr std::uint8_t CLOSURE_OBJECT = lang::runtime::CLOSURE_OBJECT;
+
+            static constexpr int RUNTIME_ERROR_STATUS = lang::runtime::RUNTIME_ERROR_STATUS;
+
+            /* Index of the upvalues in lang.closure */
+            static constexpr unsigned UPVALUES_FIELD = 6;
+
+            /*
+                A node whose code is generated, or the rest of one once the nodes it waits for are done
+                Expressions leave their value on m_values, the continuations take their operands from there
+            */
+            struct Work
+            {
+                enum class Kind: std::uint8_t
+                {
+                    STATEMENT, EXPRESSION,
+                    DISCARD, PRINT, DEFINE_VAR, IF_BRANCH, IF_ELSE, IF_END, WHILE_BODY, WHILE_END, FUNCTION_END, RETURN,
+                    UNARY, BINARY, ASSIGN, LOGICAL_RIGHT, LOGICAL_END, CALL
+                };
+
+                Kind kind;
+                lang::ast::Statement* statement;
+                lang::ast::Expression* expression;
+
+                /* State kept between the steps of a statement or expression spanning several blocks */
+                llvm::BasicBlock* first_block;
+                llvm::BasicBlock* second_block;
+                llvm::Value* value;
+            };
+
+            /* Where a local lives: a 'double' alloca, or with 'boxed' an alloca holding the address of its heap box */
+            struct Storage
+            {
+                llvm::Value* address;
+                bool boxed;
+            };
+
+            /* A box a closure copies on creation, from a local of the enclosing function or from the enclosing closure */
+            struct Upvalue
+            {
+                llvm::Value* parent_local; /* Storage::address of the local, nullptr if it is the enclosing closure's upvalue 'parent_index' */
+                std::uint32_t parent_index;
+            };
+
+            /* A function being generated, the first one is 'main' */
+            struct FunctionContext
+            {
+                lang::ast::FunctionStatement* statement;
+                llvm::Function* function;
+                llvm::Value* closure; /* The i8* to its own closure, every function receives it as its first argument */
+                llvm::BasicBlock* caller_block; /* Where generation of the enclosing function continues */
+
+                std::vector<Storage> slots; /* Indexed by the slots of the Resolver, the declaration in scope holds each */
+                std::vector<Upvalue> upvalues;
+            };
 
             void module_initialization();
 
-            llvm::Value* gen(std::vector<std::unique_ptr<lang::ast::Statement>>&& statements);
-            
+            /* An invalid module is reported as an error */
+            void verify_module();
+
+            /*
+                A worker of generate_parallel() only defines top-level functions, under the symbol the primary module refers to
+                them by. The runtime and the globals are declared, the primary module defines them with external linkage
+            */
+            void begin_worker_generation();
+            void generate_function_definition(lang::ast::FunctionStatement* function, const std::string& symbol);
+            std::vector<std::string> end_worker_generation(llvm::SmallVectorImpl<char>& bitcode);
+
+            /* The closure of a top-level function a worker defines, stored to its global where the declaration runs */
+            void declare_top_level_function(lang::ast::FunctionStatement* function, const std::string& symbol);
+
+            void link_bitcode(const llvm::SmallVectorImpl<char>& bitcode);
+
+            /* Once every worker module is linked, what was only external to link them becomes internal again */
+            void internalize_shared_symbols();
+
+            /* It emits the code of everything on m_work, nodes are visited with an explicit stack */
+            void run();
+
+            void generate_statement(lang::ast::Statement* statement);
+            void generate_expression(lang::ast::Expression* expression);
+
+            void push(lang::ast::Statement* statement);
+            void push(lang::ast::Expression* expression);
+            void push(Work::Kind kind, lang::ast::Statement* statement, lang::ast::Expression* expression, llvm::BasicBlock* first_block = nullptr, llvm::BasicBlock* second_block = nullptr, llvm::Value* value = nullptr);
+
+            llvm::Value* pop_value();
+
+            /* It opens the function and schedules its body, FUNCTION_END closes it and stores its closure */
+            void begin_function(lang::ast::FunctionStatement* function);
+            void end_function(lang::ast::FunctionStatement* function);
+
+            void generate_binary(lang::ast::BinaryExpression* expression, llvm::Value* left, llvm::Value* right);
+            void generate_call(lang::ast::CallExpression* expression);
+
+            /* Address of the double holding the variable, to load it or store to it */
+            llvm::Value* variable_address(const lang::ast::Binding& binding, const lang::Token& name);
+            llvm::Value* global_address(std::uint32_t slot, std::string_view name);
+            llvm::Value* upvalue_address(llvm::Value* closure, std::uint32_t index);
+
+            /* Index of the upvalue of the function at 'level' reaching the local 'slot' of the one at 'target_level' */
+            std::uint32_t upvalue_index(std::size_t level, std::size_t target_level, std::uint32_t slot);
+
+            /* A local of the current function, 'captured' ones get a new heap box each time the declaration runs */
+            llvm::Value* declare_local(std::uint32_t slot, bool captured, std::string_view name);
+
+            llvm::Value* make_closure(const FunctionContext& context);
+            llvm::Value* make_string(std::string_view string);
+
+            /*************************************************************************************************************/
+            /* Values, see generator_runtime.cpp */
+
+            void declare_runtime();
+
+            /* It starts the body of a runtime function, in a worker it only declares it */
+            llvm::Function* runtime_function(const std::string& name, llvm::FunctionType* type);
+
+            llvm::Constant* constant_value(std::uint64_t bits);
+            llvm::Constant* nil_value();
+            llvm::Value* number_value(double number);
+            llvm::Value* boolean_value(llvm::Value* condition);
+
+            llvm::Value* value_bits(llvm::Value* value);
+            llvm::Value* is_number(llvm::Value* value);
+            llvm::Value* is_object(llvm::Value* value);
+            llvm::Value* is_truthy(llvm::Value* value);
+
+            llvm::Value* box_object(llvm::Value* pointer);
+            llvm::Value* unbox_object(llvm::Value* value);
+
+            /* A branch to a runtime error unless 'condition' holds, code generation continues where it holds */
+            void check(llvm::Value* condition, const char* message, int line);
+
+            /* 'message' is a printf format for the two i32 arguments, it ends the block with 'unreachable' */
+            void call_runtime_error(llvm::Value* message, llvm::Value* line, llvm::Value* first_argument = nullptr, llvm::Value* second_argument = nullptr);
+
+            llvm::FunctionType* function_type(std::size_t parameter_count);
+            llvm::Value* c_string(std::string_view string, const char* name);
+
+            /*************************************************************************************************************/
             llvm::Function* create_function(const std::string& fnName, llvm::FunctionType* fnType);
             llvm::Function* create_function_proto(const std::string& fnName, llvm::FunctionType* fnType);
             void create_function_block(llvm::Function* fn);
             llvm::BasicBlock* create_BB(const std::string& name, llvm::Function* fn = nullptr);
 
+            /* It appends the block to the current function if it is not in it yet and continues there */
+            void start_block(llvm::BasicBlock* block);
+
+            bool is_block_terminated();
+
+            /* Every function must go through it before its body_stmts are read, it returns false if the body has errors */
+            bool load_function_body(lang::ast::FunctionStatement* function);
+
             llvm::Value* error(const Token& token, const std::string& message);
             void generate_error(int line, const std::string& message);
-            
+
 
         private:
             std::unique_ptr<llvm::LLVMContext> m_ctx;
@@ -46,7 +275,33 @@ namespace lang
 
             std::vector<std::string> m_errors;
 
-            llvm::Function* fn;
+            FunctionBodyLoader m_function_body_loader;
+
+            std::vector<Work> m_work;
+            std::vector<llvm::Value*> m_values;
+
+            std::vector<FunctionContext> m_functions;
+
+            /* Indexed by the global slots of the Resolver */
+            std::vector<llvm::GlobalVariable*> m_globals;
+
+            /* String literals, one object per distinct contents, and the C strings of the runtime */
+            std::unordered_map<std::string_view, llvm::Constant*> m_strings;
+            std::unordered_map<std::string_view, llvm::Value*> m_c_strings;
+
+            /* Layout of the heap objects and the runtime functions generated into the module */
+            llvm::StructType* m_string_type{nullptr};   /* { i8 kind, i64 length, i8* characters } */
+            llvm::StructType* m_closure_type{nullptr};  /* { i8 kind, i8* function, i8* name, i32 arity, i32 upvalue_count, i8* interpreted, [0 x double*] upvalues } */
+
+            llvm::Function* m_print{nullptr};
+            llvm::Function* m_add{nullptr};
+            llvm::Function* m_equal{nullptr};
+            llvm::Function* m_callee{nullptr};
+            llvm::Function* m_runtime_error{nullptr};
+            llvm::Function* m_malloc{nullptr};
 
+            /* Set in the primary Generator and in the workers of generate_parallel(), the workers only declare what they share */
+            bool m_shares_symbols{false};
+            bool m_is_worker{false};
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <ast/ast.hpp>
+#include <runtime/values.hpp>
+
+namespace lang
+{
+    class TierCompiler;
+
+    /*
+        Tier 0 of tiered execution: it runs a resolved tree as it is, so a program starts without waiting for LLVM.
+
+        Values, strings and closures have the layout of the generated code (runtime/values.hpp) and it behaves the same,
+        including the runtime errors. Every function counts its calls and the back edges of its loops, once a top-level
+        function (or one nested in it) reaches the threshold the TierCompiler compiles it in the background, and the next
+        call runs the compiled code. A call running already finishes in the interpreter, but a hot loop which uses no variable
+        of an enclosing function is compiled on its own too and entered at its next condition check, with the frame's slots.
+
+        Compiled code and interpreted code call each other: the closures created here point to an entry which comes back
+        into the interpreter, and the compiled code reads and writes the globals of the interpreter directly.
+        The tree is walked with explicit stacks, like the Generator does.
+    */
+    class Interpreter
+    {
+        public:
+            /* Compiled code passes the arguments in registers, functions taking more stay in the interpreter */
+            static constexpr std::size_t MAX_NATIVE_ARITY = 8;
+
+            /* 'tier_up_threshold' calls and back edges make a function hot, 0 never compiles anything */
+            Interpreter(std::uint32_t tier_up_threshold, unsigned optimization_level);
+            ~Interpreter();
+
+            /* It parses the body of a function the parser skipped in lazy mode and returns the errors found in it */
+            using FunctionBodyLoader = std::function<std::vector<std::string>(lang::ast::FunctionStatement*)>;
+
+            void set_function_body_loader(FunctionBodyLoader loader);
+
+            /* It runs the top-level code and returns the errors which stopped it, a runtime error exits the process like the generated code */
+            std::vector<std::string> interpret(const std::vector<lang::ast::Statement*>& statements, std::uint32_t global_count);
+
+            /* Entry of the closures created by the interpreter, when compiled code calls them */
+            double call_from_native(lang::runtime::Closure* closure, const double* arguments);
+
+            struct Statistics
+            {
+                std::size_t hot_functions{0};
+                std::size_t hot_loops{0};
+                std::size_t compiled{0};
+                std::size_t native_calls{0};
+                std::size_t native_loops{0};
+            };
+
+            Statistics statistics() const;
+
+        private:
+            /* A variable of an enclosing function a closure holds the box of, 'depth' counted from the function itself */
+            struct UpvalueReference
+            {
+                std::uint32_t depth;
+                std::uint32_t slot;
+            };
+
+            struct FunctionInfo
+            {
+                lang::ast::FunctionStatement* statement;
+
+                /* The top-level function compiled once this one is hot, nullptr if it cannot be */
+                FunctionInfo* tier_root;
+
+                std::string name; /* NUL terminated for the closures */
+                std::vector<UpvalueReference> upvalues;
+
+                bool is_loaded;
+                bool is_requested;
+                std::uint32_t hotness;
+
+                /* Set by the TierCompiler's thread */
+                std::atomic<void*> native_code;
+            };
+
+            struct LoopInfo
+            {
+                lang::ast::WhileStatement* statement;
+
+                bool is_requested;
+                std::uint32_t hotness;
+
+                /* Slots of the frame when it got hot, the compiled loop is passed as many */
+                std::size_t frame_size;
+
+                /* Set by the TierCompiler's thread */
+                std::atomic<void*> native_code;
+            };
+
+            struct Work
+            {
+                enum class Kind: std::uint8_t
+                {
+                    STATEMENT, EXPRESSION,
+                    DISCARD, PRINT, DEFINE_VAR, IF_BRANCH, WHILE_CONDITION, WHILE_BODY, FUNCTION_END, RETURN,
+                    UNARY, BINARY, ASSIGN, LOGICAL_RIGHT, CALL
+                };
+
+                Kind kind;
+                lang::ast::Statement* statement;
+                lang::ast::Expression* expression;
+                LoopInfo* loop; /* Of WHILE_CONDITION and WHILE_BODY, nullptr if loops are not counted */
+            };
+
+            /* A call being interpreted, the first one is the top-level code. What it pushed on the stacks starts at the 'begin' indices */
+            struct Frame
+            {
+                FunctionInfo* function;
+                lang::runtime::Closure* closure;
+                std::size_t slots_begin;
+                std::size_t work_begin;
+                std::size_t values_begin;
+            };
+
+            void run(std::size_t work_floor);
+
+            void execute_statement(lang::ast::Statement* statement);
+            void evaluate_expression(lang::ast::Expression* expression);
+
+            void push(Work::Kind kind, lang::ast::Statement* statement, lang::ast::Expression* expression, LoopInfo* loop = nullptr);
+            void push(lang::ast::Statement* statement);
+            void push(lang::ast::Expression* expression);
+
+            double pop_value();
+
+            /* The callee and the arguments are on the value stack */
+            void call(lang::ast::CallExpression* expression);
+
+            /* The frame's values start at 'values_begin' */
+            void enter_function(lang::runtime::Closure* closure, FunctionInfo* function, const double* arguments, std::size_t values_begin);
+            void leave_function(double result);
+
+            /* It parses a lazy body and decides if the function can be compiled, false after errors, which stop the program */
+            bool load_function(FunctionInfo* function);
+
+            void count_hotness(FunctionInfo* function);
+            void count_hotness(LoopInfo* loop);
+
+            /* It runs the compiled loop in the current frame, in place of the interpreted one */
+            void run_compiled_loop(LoopInfo* loop, void* code);
+
+            FunctionInfo* function_info(lang::ast::FunctionStatement* function);
+            double make_closure(lang::ast::FunctionStatement* function);
+
+            double* variable_address(const lang::ast::Binding& binding);
+            double* declare_local(std::uint32_t slot, bool captured);
+            std::uint32_t upvalue_index(const FunctionInfo& function, std::uint32_t depth, std::uint32_t slot) const;
+
+            double binary(lang::ast::BinaryExpression* expression, double left, double right);
+            double make_string(std::string_view string);
+            double concatenate(double left, double right, int line);
+
+            /* Absolute symbols of the compiled code: the globals, by the names the Generator gives them */
+            std::vector<std::pair<std::string, void*>> native_symbols(const std::vector<lang::ast::Statement*>& statements);
+
+        private:
+            std::uint32_t m_tier_up_threshold;
+            unsigned m_optimization_level;
+
+            FunctionBodyLoader m_function_body_loader;
+
+            std::vector<Work> m_work;
+            std::vector<double> m_values;
+            std::vector<Frame> m_frames;
+
+            /* Slots of the frames, a captured variable lives in the heap box of m_boxes instead of m_locals */
+            std::vector<double> m_locals;
+            std::vector<double*> m_boxes;
+
+            /* Compiled code holds their addresses, the vector is never resized while the program runs */
+            std::vector<double> m_globals;
+
+            std::unordered_map<lang::ast::FunctionStatement*, std::unique_ptr<FunctionInfo>> m_functions;
+            std::unordered_map<lang::ast::WhileStatement*, std::unique_ptr<LoopInfo>> m_loops;
+
+            std::deque<lang::runtime::String> m_strings;
+            std::unordered_map<std::string_view, double> m_string_values;
+
+            /* A lazy body had errors, every run() returns as soon as it sees it */
+            bool m_stopped{false};
+            std::vector<std::string> m_errors;
+
+            std::size_t m_hot_functions{0};
+            std::size_t m_hot_loops{0};
+            std::size_t m_native_calls{0};
+            std::size_t m_native_loops{0};
+
+            /* nullptr until the first function or loop gets hot */
+            std::unique_ptr<lang::TierCompiler> m_tier_compiler;
+            std::vector<std::pair<std::string, void*>> m_native_symbols;
+    };
+}
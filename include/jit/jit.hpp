@@ -0,0 +1,40 @@
+#pragma once
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lang
+{
+    /*
+        Runs a generated module in this process with an ORC LLJIT instance instead of writing it out for lli.
+        Symbols the module does not define (the C library of the runtime, 'stderr') are looked up in the process itself
+    */
+    class Jit
+    {
+        public:
+            /* The object_cache, if any, is told about every object file the JIT compiles */
+            explicit Jit(llvm::ObjectCache* object_cache = nullptr);
+            ~Jit();
+
+            /* It compiles the module, calls its 'main' and returns the errors found before 'main' could be called */
+            std::vector<std::string> run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module);
+
+            /* The same for an object file the JIT compiled before, nothing is compiled */
+            std::vector<std::string> run_object(std::unique_ptr<llvm::MemoryBuffer> object);
+
+        private:
+            llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> create_jit();
+
+            std::vector<std::string> call_main(llvm::orc::LLJIT& jit);
+
+        private:
+            llvm::ObjectCache* m_object_cache;
+    };
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <ast/ast.hpp>
+
+namespace llvm
+{
+    namespace orc
+    {
+        class LLJIT;
+    }
+}
+
+namespace lang
+{
+    /*
+        Tier 1 of tiered execution: it compiles the functions the Interpreter found hot on a thread of its own, while the
+        interpreter keeps running the program.
+
+        Its LLJIT holds the runtime of the generated code once, every function is a module of its own linked against it,
+        and the symbols given on construction (the globals of the interpreter) are defined at their absolute addresses.
+        Hot loops are compiled the same way, as functions of their own.
+        The address of the compiled code is published through the atomic of the request, nothing is waited for.
+    */
+    class TierCompiler
+    {
+        public:
+            TierCompiler(unsigned optimization_level, std::vector<std::pair<std::string, void*>> symbols);
+
+            /* Requests not started yet are dropped, the one being compiled is finished */
+            ~TierCompiler();
+
+            /* The function body must be parsed and must not change anymore, 'symbol' is unique among the requests */
+            void request_function(lang::ast::FunctionStatement* function, std::string symbol, std::atomic<void*>* code);
+
+            /* A loop of a running frame, see Generator::generate_loop() */
+            void request_loop(lang::ast::WhileStatement* loop, std::vector<bool> boxed_slots, std::string symbol, std::atomic<void*>* code);
+
+            std::size_t compiled_count() const;
+
+        private:
+            /* Either 'function' or 'loop' */
+            struct Request
+            {
+                lang::ast::FunctionStatement* function;
+                lang::ast::WhileStatement* loop;
+                std::vector<bool> boxed_slots;
+                std::string symbol;
+                std::atomic<void*>* code;
+            };
+
+            void request(Request request);
+
+            void compile_requests();
+
+            /* The JIT and the runtime, false if they could not be set up, then nothing gets compiled */
+            bool create_jit();
+
+            void* compile(const Request& request);
+
+        private:
+            unsigned m_optimization_level;
+            std::vector<std::pair<std::string, void*>> m_symbols;
+
+            std::unique_ptr<llvm::orc::LLJIT> m_jit;
+
+            mutable std::mutex m_mutex;
+            std::condition_variable m_requested;
+            std::deque<Request> m_requests;
+            bool m_stopping{false};
+            std::size_t m_compiled_count{0};
+
+            /* Started by the first request */
+            std::thread m_thread;
+    };
+}
@@ -1,33 +1,206 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace lang
 {
     class Lexer;
     class Parser;
     class Generator;
+    class SourceFile;
+    class AstCache;
+    class Resolver;
+    class ConstantFolder;
+    class Jit;
+    class NativeEmitter;
+    class CodeCache;
+    class Interpreter;
+    class BytecodeCompiler;
+    class VirtualMachine;
+
+    namespace ast
+    {
+        struct Program;
+        struct Statement;
+    }
+
+    /* What is made of the generated module when it is not run in process */
+    enum class Emit
+    {
+        LLVM_IR,    /* out.ll, for lli */
+        BITCODE,    /* out.bc, for lli as well */
+        OBJECT,     /* out.o for the host */
+        EXECUTABLE  /* out, the object file linked with the C library */
+    };
+
+    /* What runs the resolved program */
+    enum class Backend
+    {
+        LLVM,   /* The Generator, then the JIT, the tiered interpreter or the files of Options::emit */
+        VM      /* The BytecodeCompiler and the VirtualMachine, nothing of LLVM is used */
+    };
+
+    struct Options
+    {
+        /* Lex, parse and generate one top-level declaration at a time instead of materializing each stage in full */
+        bool streaming{false};
+
+        /* Threads used to tokenize large sources, 0 picks std::thread::hardware_concurrency() */
+        unsigned lexer_threads{0};
+
+        /* Split sources and token streams between the lexer and parser threads whatever their size, to compare the parallel and sequential paths */
+        bool force_parallel{false};
+
+        /* Threads used to parse large token streams, 0 picks std::thread::hardware_concurrency() */
+        unsigned parser_threads{0};
+
+        /* Threads generating the code of the top-level functions of large programs, 0 picks std::thread::hardware_concurrency() */
+        unsigned generator_threads{0};
+
+        /* Only brace match function bodies while parsing, a body is parsed the first time the generator needs it */
+        bool lazy_function_bodies{false};
+
+        /* Deepest nesting of statements and expressions the parser accepts before reporting an error, 0 keeps the parser's default */
+        std::size_t max_nesting_depth{0};
+
+        /* Fold constant expressions, drop branches that never run and code after a return before generating code */
+        bool fold_constants{true};
+
+        /* Directory of the binary AST cache, a source parsed before without errors is then neither tokenized nor parsed. Empty disables it, it is not used while streaming */
+        std::string ast_cache_directory;
+
+        /* Optimization level of the generated module, 0 to 3, 0 writes it as generated */
+        unsigned optimization_level{0};
+
+        /* Optimize with the cheaper per-function pipeline of the level instead of the full module pipeline */
+        bool favor_compile_latency{false};
+
+        /* Compile the module with an in-process JIT and run its main instead of writing out.ll for lli */
+        bool run_in_process{false};
+
+        /* Output written when the program is not run in process */
+        lang::Emit emit{lang::Emit::LLVM_IR};
+
+        /* CPU the object file and executable are compiled for, "generic" runs on any CPU of the triple, "native" is the host's. The JIT always compiles for the host */
+        std::string target_cpu{"generic"};
+
+        /* Directory of the compiled code cache, a source compiled before with the same options is then neither parsed nor compiled again. Empty disables it */
+        std::string code_cache_directory;
+
+        /* Start running the tree in an interpreter and compile the hot functions in the background, instead of compiling the whole module first */
+        bool tiered{false};
+
+        /* Calls and loop iterations making a function hot in tiered execution, 0 keeps everything in the interpreter */
+        std::uint32_t tier_up_threshold{1000};
+
+        /* With Backend::VM the program is compiled to bytecode and run in process, every option about LLVM code is ignored */
+        lang::Backend backend{lang::Backend::LLVM};
+
+        /* Print the line, type and lexeme of every token and stop, to compare the lexers of two runs */
+        bool dump_tokens{false};
+
+        /* Print the tree as parsed and stop, to compare the parsers of two runs */
+        bool dump_ast{false};
+    };
 
     class Lang
     {
         public:
-            Lang();
+            Lang(const lang::Options& options = lang::Options{});
             ~Lang();
             
             int run_source_code(const char* absolute_path_of_source_code);
 
         private:
 
-            void run(std::string&& source);
+            void run(std::string_view source);
+
+            void run_streaming(std::string_view source);
+
+            /* Options::dump_tokens, the source is tokenized like in load_program() */
+            void dump_tokens(std::string_view source);
+
+            /* Options::dump_ast, the tree is the one of load_program(), before resolving and folding */
+            void dump_ast(std::string_view source);
+
+            /* It interprets the resolved program, compiling its hot functions as it goes */
+            void run_tiered(const std::vector<lang::ast::Statement*>& statements);
+
+            /* It compiles the resolved program to bytecode and runs it in the virtual machine */
+            void run_bytecode(const std::vector<lang::ast::Statement*>& statements);
+
+            /* It fills 'program' from the cache or by tokenizing and parsing 'source', it returns false after reporting errors */
+            bool load_program(std::string_view source, lang::ast::Program& program);
+
+            /* It runs the optimized module in process or writes out.ll, out.bc, out.o or the executable out, as the options ask */
+            void emit_module();
+
+            /* The three ways of emit_module(): run by the JIT, written as IR or bitcode, compiled to an object file */
+            void run_module();
+            void write_module();
+            void compile_module();
+
+            /* It writes out.o and links it if an executable is asked for */
+            void emit_object(std::string_view object);
+
+            /* It runs or writes the code cached for the source, it returns false on a miss */
+            bool emit_cached_code();
+
+            /* Everything besides the source the compiled code depends on */
+            std::string code_cache_configuration() const;
+
+            void report_cache_statistics();
+
+            void report_code_cache_statistics();
+
+            void report_tiering_statistics();
+
+            void report_errors(const char* stage, const std::vector<std::string>& errors);
 
         private:
+            lang::Options m_options;
+
+            /** The mapped source outlives every Token, since the tokens only hold views into it */
+            std::unique_ptr<lang::SourceFile> m_source_file;
+
             /** First lexer will be created then parser and then interpreter */
             std::unique_ptr<lang::Lexer> m_lexer;
 
             std::unique_ptr<lang::Parser> m_parser;
 
+            std::unique_ptr<lang::Resolver> m_resolver;
+
+            /** nullptr if Options::fold_constants is off */
+            std::unique_ptr<lang::ConstantFolder> m_constant_folder;
+
+            /** nullptr with Backend::VM */
             std::unique_ptr<lang::Generator> m_generator;
+
+            /** nullptr unless Options::run_in_process is set */
+            std::unique_ptr<lang::Jit> m_jit;
+
+            /** nullptr unless Options::emit asks for machine code */
+            std::unique_ptr<lang::NativeEmitter> m_native_emitter;
+
+            /** nullptr unless Options::tiered is set, then there is no generator, JIT, emitter or code cache */
+            std::unique_ptr<lang::Interpreter> m_interpreter;
+
+            /** Both nullptr unless Options::backend is Backend::VM, then there is nothing else of LLVM either */
+            std::unique_ptr<lang::BytecodeCompiler> m_bytecode_compiler;
+            std::unique_ptr<lang::VirtualMachine> m_virtual_machine;
+
+            /** nullptr unless Options::code_cache_directory is set */
+            std::unique_ptr<lang::CodeCache> m_code_cache;
+
+            /** Key of the source being run in m_code_cache */
+            std::uint64_t m_code_cache_key{0};
+
+            /** nullptr unless Options::ast_cache_directory is set */
+            std::unique_ptr<lang::AstCache> m_ast_cache;
             
     };
 }
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <types/token_type.hpp>
+#include <string_view>
+
+namespace lang
+{
+    namespace keywords
+    {
+        /*
+            Keyword recognition without allocation or hashing.
+
+            The 16 reserved words are told apart by their length and first character, so a
+            single switch leaves at most one candidate, which is then compared in full.
+            Everything here is constexpr, the table is checked at compile time below.
+        */
+        constexpr lang::TokenType classify(std::string_view text)
+        {
+            /* Returns 'type' if text is exactly 'keyword', otherwise it is an identifier */
+            auto is = [text](std::string_view keyword, lang::TokenType type) constexpr
+            {
+                return text == keyword ? type : lang::TokenType::IDENTIFIER;
+            };
+
+            switch(text.size())
+            {
+                case 2:
+                    switch(text[0])
+                    {
+                        case 'i': return is("if", lang::TokenType::IF);
+                        case 'o': return is("or", lang::TokenType::OR);
+                    }
+                    break;
+                case 3:
+                    switch(text[0])
+                    {
+                        case 'a': return is("and", lang::TokenType::AND);
+                        case 'f':
+                            /* 'for' and 'fun' share the first character */
+                            return text[1] == 'o' ? is("for", lang::TokenType::FOR) : is("fun", lang::TokenType::FUN);
+                        case 'n': return is("nil", lang::TokenType::NIL);
+                        case 'v': return is("var", lang::TokenType::VAR);
+                    }
+                    break;
+                case 4:
+                    switch(text[0])
+                    {
+                        case 'e': return is("else", lang::TokenType::ELSE);
+                        case 't':
+                            /* 'this' and 'true' share the first character */
+                            return text[1] == 'h' ? is("this", lang::TokenType::THIS) : is("true", lang::TokenType::TRUE);
+                    }
+                    break;
+                case 5:
+                    switch(text[0])
+                    {
+                        case 'c': return is("class", lang::TokenType::CLASS);
+                        case 'f': return is("false", lang::TokenType::FALSE);
+                        case 'p': return is("print", lang::TokenType::PRINT);
+                        case 's': return is("super", lang::TokenType::SUPER);
+                        case 'w': return is("while", lang::TokenType::WHILE);
+                    }
+                    break;
+                case 6:
+                    if(text[0] == 'r')
+                    {
+                        return is("return", lang::TokenType::RETURN);
+                    }
+                    break;
+            }
+
+            return lang::TokenType::IDENTIFIER;
+        }
+
+        static_assert(classify("and") == lang::TokenType::AND);
+        static_assert(classify("class") == lang::TokenType::CLASS);
+        static_assert(classify("else") == lang::TokenType::ELSE);
+        static_assert(classify("false") == lang::TokenType::FALSE);
+        static_assert(classify("for") == lang::TokenType::FOR);
+        static_assert(classify("fun") == lang::TokenType::FUN);
+        static_assert(classify("if") == lang::TokenType::IF);
+        static_assert(classify("nil") == lang::TokenType::NIL);
+        static_assert(classify("or") == lang::TokenType::OR);
+        static_assert(classify("print") == lang::TokenType::PRINT);
+        static_assert(classify("return") == lang::TokenType::RETURN);
+        static_assert(classify("super") == lang::TokenType::SUPER);
+        static_assert(classify("this") == lang::TokenType::THIS);
+        static_assert(classify("true") == lang::TokenType::TRUE);
+        static_assert(classify("var") == lang::TokenType::VAR);
+        static_assert(classify("while") == lang::TokenType::WHILE);
+
+        static_assert(classify("") == lang::TokenType::IDENTIFIER);
+        static_assert(classify("fo") == lang::TokenType::IDENTIFIER);
+        static_assert(classify("fox") == lang::TokenType::IDENTIFIER);
+        static_assert(classify("thus") == lang::TokenType::IDENTIFIER);
+        static_assert(classify("returns") == lang::TokenType::IDENTIFIER);
+        static_assert(classify("While") == lang::TokenType::IDENTIFIER);
+    }
+}
@@ -2,23 +2,65 @@
 
 #include <types/types.hpp>
 #include <types/token_type.hpp>
+#include <token/token_stream.hpp>
 #include <vector>
 #include <utility>
 #include <string>
+#include <string_view>
 
 namespace lang
 {
-    class Token;
-    
     class Lexer
     {
         public:
             Lexer();
             ~Lexer();
             
-            std::pair<std::vector<lang::Token>, std::vector<std::string>> tokenize(std::string&& source);
+            std::pair<lang::TokenStream, std::vector<std::string>> tokenize(std::string_view source);
+
+            /*
+                Same result as tokenize(), but the source is split at newline boundaries and every chunk
+                is tokenized on its own thread. A string literal crossing a boundary is re-lexed from its
+                opening quote, so tokens, line numbers and errors come out exactly as in tokenize()
+            */
+            std::pair<lang::TokenStream, std::vector<std::string>> tokenize_parallel(std::string_view source, unsigned thread_count);
+
+            /* 
+                Streaming interface, used instead of tokenize() when the Parser pulls tokens on demand
+                begin() resets the lexer and next_token() returns one token at a time, MYEOF at the end
+            */
+            void begin(std::string_view source);
+
+            /* It appends the next token to 'out', whose literal ids then refer to literals() */
+            void next_token(lang::TokenStream& out);
+
+            std::string_view source() const;
+
+            /* Values of the literals handed out by next_token() */
+            const lang::LiteralPool& literals() const;
+
+            bool has_errors() const;
+
+            std::vector<std::string> take_errors();
 
         private:
+            struct Chunk
+            {
+                std::size_t begin;
+                std::size_t end; /* One past the '\n' which ends the chunk */
+                int first_line;
+                int newline_count;
+
+                lang::TokenStream tokens;
+                std::vector<std::string> errors;
+
+                /* Opening quote of a string literal which runs past 'end', std::string_view::npos if none */
+                std::size_t spill_offset;
+                int spill_line;
+            };
+
+            void tokenize_chunk(std::string_view source, Chunk& chunk, bool is_last_chunk);
+
             void scan_token();
 
             void read_identifier();
@@ -32,7 +74,10 @@ namespace lang
 
             void read_string_literal();
 
-            /* It consumes the next character in the source file and returns it */
+            /* 
+                It consumes the next character in the source file and returns it
+                There is no bounds check here, callers test is_at_end() first
+            */
             char advance();
 
             /* It is like conditional advance(). It only consumes the current character if it's what we're looking for. */
@@ -49,7 +94,9 @@ namespace lang
 
             void add_token(lang::TokenType type);
 
-            void add_token(lang::TokenType type, lang::util::object_t literal);
+            void add_token(lang::TokenType type, lang::LiteralId literal);
+
+            void add_identifier_token(lang::Symbol symbol);
 
             /* It returns true if current reaches end of file */
             bool is_at_end();
@@ -64,33 +111,19 @@ namespace lang
             bool is_aplha_numeric(char c);
 
         private:
-            std::string m_source;
+            std::string_view m_source; /* View into the source owned by the caller, it must outlive the tokens */
             std::size_t m_source_size;
-            int m_start{0}; /* points to the first character in the lexeme being scanned */
-            int m_current{0}; /* points to the character currently being considered */
+            std::size_t m_start{0}; /* points to the first character in the lexeme being scanned */
+            std::size_t m_current{0}; /* points to the character currently being considered */
             int m_line{1};
 
-            std::vector<lang::Token> m_tokens;
+            /* Only set while tokenizing a chunk which is not the last one, see read_string_literal() */
+            bool m_spill_allowed{false};
+            std::size_t m_spill_offset{std::string_view::npos};
+            int m_spill_line{0};
 
-            std::vector<std::string> m_errors;
+            lang::TokenStream m_tokens;
 
-            std::unordered_map<std::string, lang::TokenType> m_keywords = {
-                {"and", lang::TokenType::AND},
-                {"class", lang::TokenType::CLASS},
-                {"else", lang::TokenType::ELSE},
-                {"false", lang::TokenType::FALSE},
-                {"for", lang::TokenType::FOR},
-                {"fun", lang::TokenType::FUN},
-                {"if", lang::TokenType::IF},
-                {"nil", lang::TokenType::NIL},
-                {"or", lang::TokenType::OR},
-                {"print", lang::TokenType::PRINT},
-                {"return", lang::TokenType::RETURN},
-                {"super", lang::TokenType::SUPER},
-                {"this", lang::TokenType::THIS},
-                {"true", lang::TokenType::TRUE},
-                {"var", lang::TokenType::VAR},
-                {"while", lang::TokenType::WHILE}
-            };
+            std::vector<std::string> m_errors;
     };
 }
\ No newline at end of file
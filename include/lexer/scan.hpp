@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace lang
+{
+    namespace scan
+    {
+        /*
+            Run skipping helpers used by the Lexer for the hot inner loops.
+
+            Each helper starts at index 'from' of 'data' and returns the index of the first
+            character which does not belong to the run (or 'size' when the run reaches the end).
+            On x86 the runs are classified 32 (AVX2) or 16 (SSE2) bytes at a time, the
+            implementation is picked once at runtime and a scalar loop handles the tail and
+            every other architecture.
+        */
+
+        /* Skips ' ', '\r', '\t' and '\n'. Every '\n' that is skipped is added to 'line' */
+        std::size_t skip_whitespace(const char* data, std::size_t from, std::size_t size, int& line);
+
+        /* Skips to the '\n' which ends a '//' comment. The '\n' itself is not consumed */
+        std::size_t skip_comment(const char* data, std::size_t from, std::size_t size);
+
+        /* Skips [a-zA-Z0-9_] */
+        std::size_t skip_identifier_body(const char* data, std::size_t from, std::size_t size);
+
+        /* Skips [0-9] */
+        std::size_t skip_digits(const char* data, std::size_t from, std::size_t size);
+
+        /* Skips to the closing '"' of a string literal. Every '\n' that is skipped is added to 'line' */
+        std::size_t skip_string_body(const char* data, std::size_t from, std::size_t size, int& line);
+
+        /*
+            Replaces the implementation picked at runtime by "avx2", "sse2" or "scalar", to compare them on the same input.
+            It returns false if this CPU or build lacks it. Only call it before anything is lexed
+        */
+        bool force_implementation(std::string_view name);
+    }
+}
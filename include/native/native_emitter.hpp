@@ -0,0 +1,48 @@
+#pragma once
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lang
+{
+    /*
+        Compiles a generated module to machine code for the host triple and links it into an executable with the C compiler driver.
+        The runtime is generated into the module, so the C library is all the executable links against
+    */
+    class NativeEmitter
+    {
+        public:
+            /* The code runs on the CPU named, "generic" is the baseline of the triple and "native" the host with all its features */
+            explicit NativeEmitter(const std::string& cpu);
+            ~NativeEmitter();
+
+            /* It registers the host target with LLVM, only the first call does anything */
+            static void initialize_native_target();
+
+            /* The host target machine, nullptr if it could not be created, the errors then say why */
+            llvm::TargetMachine* target_machine();
+
+            /* Triple and CPU the code is compiled for, part of the configuration of a cached object file */
+            std::string configuration() const;
+
+            const std::vector<std::string>& errors() const;
+
+            /* It compiles the module into an object file, which needs the module's triple and data layout set to the target machine's */
+            std::vector<std::string> compile_object(llvm::Module& module, llvm::SmallVectorImpl<char>& object);
+
+            std::vector<std::string> link_executable(const std::string& object_file, const std::string& executable_file);
+
+        private:
+            void generate_error(const std::string& message);
+
+        private:
+            std::unique_ptr<llvm::TargetMachine> m_target_machine;
+
+            std::vector<std::string> m_errors;
+    };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <ast/arena.hpp>
+#include <ast/ast.hpp>
+
+namespace lang
+{
+    /*
+        AST to AST pass between parsing and code generation.
+
+        An operator whose operands are literals is replaced by a literal holding its result, an if or while whose
+        condition is a literal by the branch that runs (or by nothing), and the statements following a return in
+        the same block are dropped. Truthiness is the one defined in runtime/values.hpp.
+        Operands of different types, strings and non-literal operands are left alone.
+
+        The tree is rewritten children first with an explicit stack, so it handles any nesting the parser accepts.
+    */
+    class ConstantFolder: public lang::ast::StatementVisitor<ConstantFolder, lang::ast::Statement*>, public lang::ast::ExpressionVisitor<ConstantFolder, lang::ast::Expression*>
+    {
+        public:
+            struct Statistics
+            {
+                std::size_t folded_expressions{0};
+                std::size_t pruned_branches{0};
+                std::size_t removed_statements{0};
+            };
+
+            /* Folds every statement, statements folding away are erased from 'statements'. New nodes go to 'arena' */
+            void fold(std::vector<lang::ast::Statement*>& statements, lang::ast::Arena& arena);
+
+            /* Streaming interface, it returns nullptr if the whole declaration folds away */
+            lang::ast::Statement* fold_declaration(lang::ast::Statement* statement, lang::ast::Arena& arena);
+
+            /* Bodies skipped in lazy mode are left alone by fold(), this folds one once Parser::parse_function_body() parsed it */
+            void fold_function_body(lang::ast::FunctionStatement* function, lang::ast::Arena& arena);
+
+            const Statistics& statistics() const;
+
+            /*
+                Called once all children of the node are folded, each returns the node replacing it
+                A statement returns nullptr when it does nothing at all
+            */
+            lang::ast::Statement* visit(lang::ast::ExpressionStatement* statement);
+            lang::ast::Statement* visit(lang::ast::PrintStatement* statement);
+            lang::ast::Statement* visit(lang::ast::VarStatement* statement);
+            lang::ast::Statement* visit(lang::ast::BlockStatement* statement);
+            lang::ast::Statement* visit(lang::ast::IfStatement* statement);
+            lang::ast::Statement* visit(lang::ast::WhileStatement* statement);
+            lang::ast::Statement* visit(lang::ast::FunctionStatement* statement);
+            lang::ast::Statement* visit(lang::ast::ReturnStatement* statement);
+
+            lang::ast::Expression* visit(lang::ast::BinaryExpression* expression);
+            lang::ast::Expression* visit(lang::ast::GroupingExpression* expression);
+            lang::ast::Expression* visit(lang::ast::LiteralExpression* expression);
+            lang::ast::Expression* visit(lang::ast::UnaryExpression* expression);
+            lang::ast::Expression* visit(lang::ast::VariableExpression* expression);
+            lang::ast::Expression* visit(lang::ast::AssignmentExpression* expression);
+            lang::ast::Expression* visit(lang::ast::LogicalExpression* expression);
+            lang::ast::Expression* visit(lang::ast::CallExpression* expression);
+
+        private:
+            /* A pointer to the field or list entry holding a node, so the node can be replaced once it is folded */
+            struct Work
+            {
+                lang::ast::Statement** statement;
+                lang::ast::Expression** expression;
+                bool in_list; /* A statement removed from a list is erased from it, elsewhere it becomes an empty block */
+                bool children_folded;
+            };
+
+            void schedule(lang::ast::Statement** statement, bool in_list);
+            void schedule(lang::ast::Expression** expression);
+            void schedule_children(lang::ast::Statement* statement);
+            void schedule_children(lang::ast::Expression* expression);
+
+            /* It folds the scheduled nodes and everything below them */
+            void run();
+
+            /* It erases removed entries and, in a body or block, everything after the first return. It returns the new size */
+            std::size_t compact(lang::ast::Statement** statements, std::size_t count, bool stop_at_return);
+
+            lang::ast::Expression* make_number(double value);
+            lang::ast::Expression* make_boolean(bool value);
+
+            static bool is_truthy(const lang::ast::LiteralExpression* literal);
+
+        private:
+            lang::ast::Arena* m_arena{nullptr};
+
+            std::vector<Work> m_work;
+
+            Statistics m_statistics;
+    };
+}
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 #include <vector>
 #include <utility>
 #include <string>
 #include <token/token.hpp>
+#include <token/token_stream.hpp>
 #include <types/token_type.hpp>
+#include <ast/arena.hpp>
+#include <ast/program.hpp>
 
 namespace lang
 {
@@ -13,8 +17,11 @@ namespace lang
     {
         struct Statement;
         struct Expression;
+        struct FunctionStatement;
     }
 
+    class Lexer;
+
     // class Token; /* Here in this header file we are not using a pointer to Token. */
 
     class Parser
@@ -23,46 +30,128 @@ namespace lang
             Parser();
             ~Parser();
 
-            std::pair<std::vector<std::unique_ptr<lang::ast::Statement>>, std::vector<std::string>> parse(std::vector<lang::Token>&& tokens);
+            std::pair<lang::ast::Program, std::vector<std::string>> parse(lang::TokenStream&& tokens);
 
-        private:
-            std::unique_ptr<lang::ast::Statement> parse_declaration();
+            /*
+                Same result as parse(), but the token stream is split before top-level 'fun' and 'var' declarations
+                (found by matching braces and parentheses) and every range is parsed on its own thread into its own arena
+                A range whose last declaration runs past its end, e.g. during error recovery, makes it fall back to parse()
+            */
+            std::pair<lang::ast::Program, std::vector<std::string>> parse_parallel(lang::TokenStream&& tokens, unsigned thread_count);
 
-            std::unique_ptr<lang::ast::Statement> parse_var_declaration();
+            /* 
+                In lazy mode the body of a top-level function is only brace matched and its token range recorded, errors inside it are
+                reported by parse_function_body() once somebody needs the body. It has no effect while streaming, as tokens are released
+            */
+            void set_lazy_function_bodies(bool lazy);
 
-            std::unique_ptr<lang::ast::Statement> parse_statement();
-            std::unique_ptr<lang::ast::Statement> parse_print_statement();
-            std::unique_ptr<lang::ast::Statement> parse_expression_statement();
-            std::vector<std::unique_ptr<lang::ast::Statement>> parse_block();
-            std::unique_ptr<lang::ast::Statement> parse_while_statement();
-            std::unique_ptr<lang::ast::Statement> parse_function_statement();
+            /* 
+                Parsing uses explicit stacks instead of recursion, so nesting is only bounded by this limit, which
+                counts every open block, if, while, grouping, unary, binary operand and call. Going past it is an error
+            */
+            void set_max_nesting_depth(std::size_t max_nesting_depth);
 
-            std::unique_ptr<lang::ast::Statement> parse_if_statement();
-            std::unique_ptr<lang::ast::Statement> parse_return_statement();
-            
-            std::unique_ptr<lang::ast::Expression> parse_expression();
-            std::unique_ptr<lang::ast::Expression> parse_call_expression();
-            std::unique_ptr<lang::ast::Expression> parse_assignment();
+            static constexpr std::size_t DEFAULT_MAX_NESTING_DEPTH = 1 << 20;
+
+            /* 
+                It parses the body of a function skipped in lazy mode and returns the errors found in it
+                The nodes go to 'arena', normally the arena of the Program returned by the last parse() or parse_parallel()
+            */
+            std::vector<std::string> parse_function_body(lang::ast::FunctionStatement* function, lang::ast::Arena& arena);
+
+            /* 
+                Streaming interface, used instead of parse() to hand out one top-level declaration at a time
+                Tokens are pulled from the lexer on demand and released once their declaration is parsed
+                Nodes are allocated in 'arena', the caller may reset it once a declaration has been consumed
+            */
+            void begin(lang::Lexer& token_source, lang::ast::Arena& arena);
 
-            std::unique_ptr<lang::ast::Expression> parse_equality();
-            std::unique_ptr<lang::ast::Expression> parse_logical_or_expression();
-            std::unique_ptr<lang::ast::Expression> parse_logical_and_expression();
+            bool has_more_declarations();
 
-            std::unique_ptr<lang::ast::Expression> parse_comparison();
+            lang::ast::Statement* parse_next_declaration();
 
-            std::unique_ptr<lang::ast::Expression> parse_term();
+            bool has_errors() const;
+
+            std::vector<std::string> take_errors();
+
+        private:
+            struct Range
+            {
+                int begin;
+                int end; /* Token starting the next range, MYEOF for the last one */
+                int stopped_at; /* Where parsing of the range stopped, equal to 'end' unless a declaration ran past it */
+
+                lang::ast::Arena arena;
+                std::vector<lang::ast::Statement*> statements;
+                std::vector<std::string> errors;
+            };
+
+            /* Brace matching pre-pass, it returns at most 'range_count' ranges of about the same number of tokens */
+            static std::vector<Range> split_into_ranges(const lang::TokenStream& tokens, unsigned range_count);
+
+            /* It parses every declaration starting in [range.begin, range.end) of 'tokens' */
+            void parse_range(const lang::TokenStream& tokens, Range& range);
+
+            /* A statement or expression whose parsing was suspended to parse a nested one */
+            struct StatementFrame
+            {
+                enum class Kind: std::uint8_t { BLOCK, FUNCTION_BODY, IF_THEN, IF_ELSE, WHILE_BODY };
+
+                Kind kind;
+                int statement_begin; /* BLOCK, FUNCTION_BODY: first token of the statement being parsed in it */
+                std::size_t statements_begin; /* BLOCK, FUNCTION_BODY: first entry of m_statement_scratch belonging to it */
+                lang::ast::Expression* condition; /* IF_THEN, IF_ELSE, WHILE_BODY */
+                lang::ast::Statement* then_branch; /* IF_ELSE */
+                lang::ast::FunctionStatement* function; /* FUNCTION_BODY: receives the body */
+            };
+
+            struct ExpressionFrame
+            {
+                enum class Kind: std::uint8_t { UNARY, GROUPING, BINARY, LOGICAL, ASSIGNMENT, CALL_ARGUMENTS };
+
+                Kind kind;
+                std::uint8_t min_precedence; /* Of the level the frame returns to */
+                lang::Token op; /* UNARY, BINARY, LOGICAL: the operator, ASSIGNMENT: the assigned variable */
+                lang::ast::Expression* left; /* BINARY, LOGICAL: the left operand, CALL_ARGUMENTS: the callee */
+                std::size_t arguments_begin; /* CALL_ARGUMENTS: first entry of m_expression_scratch belonging to it */
+            };
+
+            lang::ast::Statement* parse_declaration();
+
+            /* 
+                Parses one declaration with its nested statements, pushing a StatementFrame instead of recursing
+                With 'function_body' it instead parses the rest of that function's body, whose '{' is already consumed
+            */
+            lang::ast::Statement* parse_statement_tree(lang::ast::FunctionStatement* function_body);
+
+            /* Everything up to and including the '{' of the body, which is skipped in lazy mode */
+            lang::ast::FunctionStatement* parse_function_header();
+
+            /* It skips to the '}' matching an already consumed '{', the lazy counterpart of parsing a function body */
+            void skip_function_body();
+
+            lang::ast::Statement* parse_var_declaration();
+            lang::ast::Statement* parse_print_statement();
+            lang::ast::Statement* parse_expression_statement();
+            lang::ast::Statement* parse_return_statement();
             
+            lang::ast::Expression* parse_expression();
 
-            std::unique_ptr<lang::ast::Expression> parse_factor();
+            /* 
+                Pratt parser, it parses a prefix expression and then folds in every infix operator that binds at least as tightly as 'min_precedence'
+                The binding power of each TokenType is looked up in a table instead of descending one function per precedence level
+                Operands still to be combined wait on an ExpressionFrame stack, so the native stack does not grow with nesting
+            */
+            lang::ast::Expression* parse_precedence(std::uint8_t min_precedence);
 
-            std::unique_ptr<lang::ast::Expression> parse_unary();
+            lang::ast::Expression* finish_call_expression(lang::ast::Expression* callee, std::size_t arguments_begin);
 
-            std::unique_ptr<lang::ast::Expression> parse_primary();
+            lang::ast::Expression* parse_primary();
 
             lang::Token consume(lang::TokenType type, std::string message);
 
             /* It returns nullptr */
-            std::unique_ptr<lang::ast::Statement> error(const Token& token, const std::string& message);
+            lang::ast::Statement* error(const Token& token, const std::string& message);
 
             void generate_error(int line, const std::string& message);
             
@@ -70,25 +159,66 @@ namespace lang
 
             bool check(lang::TokenType type);
 
-            lang::Token advance();
+            /* 
+                The token stream is read by index, only peek(), previous() and consume() materialize a Token
+                and a Token is a small value holding a view into the source, so nothing is copied
+            */
+            void advance();
 
             bool is_at_end();
 
+            lang::TokenType peek_type();
+
             Token peek();
 
             Token previous();
 
             void synchronize_after_an_error();
 
-            std::unique_ptr<lang::ast::Expression> parse_single_call_expression_helper_function(std::unique_ptr<lang::ast::Expression> callee);
+            /* Before every push of a frame, past the limit it reports the error once and skips to the end of the source */
+            bool exceeds_nesting_limit();
+
+            /* In streaming mode it pulls tokens from m_token_source until m_tokens has an entry at 'index' */
+            void fill_tokens_up_to(std::size_t index);
+
+            /* In streaming mode it drops every token before previous(), they are never looked at again */
+            void release_consumed_tokens();
 
         private:
-            std::vector<lang::Token> m_tokens;
+            lang::TokenStream m_tokens;
+
+            /* Tokens being parsed, &m_tokens unless this parser works on a Range of a shared stream */
+            const lang::TokenStream* m_stream{&m_tokens};
             int m_current{0};
 
+            /* Values of the literals in m_tokens, owned by m_tokens or by the lexer when streaming */
+            const lang::LiteralPool* m_literals{nullptr};
+
+            /* nullptr unless parsing in streaming mode */
+            lang::Lexer* m_token_source{nullptr};
+
+            bool m_lazy_function_bodies{false};
+
+            std::size_t m_max_nesting_depth{DEFAULT_MAX_NESTING_DEPTH};
+
+            /* Set once the limit was hit, every suspended statement and expression is then dropped */
+            bool m_nesting_too_deep{false};
+
+            std::vector<StatementFrame> m_statement_frames;
+            std::vector<ExpressionFrame> m_expression_frames;
+
             std::vector<std::string> m_errors;
 
-            std::vector<std::unique_ptr<lang::ast::Statement>> m_statements;
+            /* Arena receiving the nodes being parsed, the Program's own arena unless streaming */
+            lang::ast::Arena* m_arena{nullptr};
+
+            /* 
+                Children are collected on these stacks while a list is being parsed and then copied into the arena in one piece
+                Nested lists push above the entries of the enclosing list, so a single stack per element type is enough
+            */
+            std::vector<lang::ast::Statement*> m_statement_scratch;
+            std::vector<lang::ast::Expression*> m_expression_scratch;
+            std::vector<lang::Token> m_parameter_scratch;
 
     };
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <symbol/interner.hpp>
+#include <ast/arena.hpp>
+#include <ast/ast.hpp>
+
+namespace lang
+{
+    /*
+        Pass between parsing and code generation binding every name to the variable it refers to.
+
+        Each VariableExpression and AssignmentExpression gets a Binding, a (depth, slot) pair counting frames of functions, so
+        generated code addresses variables by index instead of looking names up. Each function gets the size of its frame,
+        slots of sibling blocks are shared, and every local a nested function refers to is flagged as captured.
+
+        Names are looked up by their interned lang::Symbol in arrays indexed by it, nothing is hashed. It reports a local read
+        in its own initializer, a local declared twice in a scope, a global used by top-level code before its declaration,
+        a name declared nowhere and a return outside of a function. The tree is walked with an explicit stack.
+    */
+    class Resolver
+    {
+        public:
+            /* It resolves a whole program, begin_resolution(), one resolve_declaration() per statement and end_resolution() */
+            std::vector<std::string> resolve(const std::vector<lang::ast::Statement*>& statements, lang::ast::Arena& arena);
+
+            /*
+                Streaming interface, globals are kept from one declaration to the next, so a function may refer to one declared after it
+                Names still undeclared at the end are reported by end_resolution()
+            */
+            void begin_resolution();
+
+            void resolve_declaration(lang::ast::Statement* statement, lang::ast::Arena& arena);
+
+            bool has_errors() const;
+
+            std::vector<std::string> end_resolution();
+
+            /* A top-level body skipped in lazy mode is resolved once Parser::parse_function_body() parsed it, against the globals of the program */
+            std::vector<std::string> resolve_function_body(lang::ast::FunctionStatement* function, lang::ast::Arena& arena);
+
+            /* Slots needed by the globals and by the blocks of the top-level code */
+            std::uint32_t global_count() const;
+            std::uint32_t top_level_frame_size() const;
+
+        private:
+            struct Work
+            {
+                enum class Kind: std::uint8_t
+                {
+                    STATEMENT, EXPRESSION,
+                    DEFINE, /* The initializer of 'var' was resolved, the variable may be used from now on */
+                    END_SCOPE, END_FUNCTION
+                };
+
+                Kind kind;
+                lang::ast::Statement* statement;
+                lang::ast::Expression* expression;
+            };
+
+            /* A local variable in scope, shadowing the declaration of the same name at 'shadowed' */
+            struct Local
+            {
+                lang::Symbol symbol;
+                std::uint32_t function; /* Index in m_frames of the frame holding it */
+                std::uint32_t slot;
+                std::uint32_t shadowed;
+                bool defined;
+                bool* captured;
+            };
+
+            struct Scope
+            {
+                std::size_t locals_begin;
+                std::uint32_t next_slot; /* Of its function when the scope was opened, the slots after it are free again once it closes */
+            };
+
+            /* The frame of a function being resolved, the first entry is the one of the top-level code */
+            struct Frame
+            {
+                lang::ast::FunctionStatement* function;
+                std::uint32_t next_slot;
+                std::uint32_t size;
+            };
+
+            struct Global
+            {
+                lang::Symbol symbol;
+                bool declared;
+                int first_use_line; /* Of the first use before its declaration, 0 if none */
+                int first_top_level_use_line; /* Same, only counting top-level code, which runs before the declaration */
+            };
+
+            void run();
+
+            void resolve_statement(lang::ast::Statement* statement);
+            void resolve_expression(lang::ast::Expression* expression);
+
+            void push(lang::ast::Statement* statement);
+            void push(lang::ast::Expression* expression);
+
+            void begin_scope();
+            void end_scope();
+
+            /* It opens the frame and the scope of the function and declares its parameters */
+            void begin_function(lang::ast::FunctionStatement* function);
+            void end_function();
+
+            /* In a scope the name becomes a local in the current frame, else it is a global */
+            lang::ast::Binding declare(const lang::Token& name, bool* captured, bool defined);
+            lang::ast::Binding declare_global(const lang::Token& name);
+
+            /* Only reads are checked against the initializer of the variable, an assignment may run there */
+            lang::ast::Binding resolve_name(const lang::Token& name, bool is_read);
+
+            std::uint32_t global_slot(lang::Symbol symbol);
+
+            /* Globals used before being declared and still undeclared are reported as undefined */
+            void report_undefined_globals();
+
+            void error(const lang::Token& token, const std::string& message);
+            void generate_error(int line, const std::string& message);
+
+        private:
+            lang::ast::Arena* m_arena{nullptr};
+
+            std::vector<Work> m_work;
+
+            std::vector<Local> m_locals;
+            std::vector<Scope> m_scopes;
+            std::vector<Frame> m_frames;
+
+            /* Indexed by lang::Symbol: the innermost Local of that name in m_locals and the slot of the global of that name */
+            std::vector<std::uint32_t> m_innermost_local;
+            std::vector<std::uint32_t> m_global_slots;
+
+            std::vector<Global> m_globals;
+
+            /* Slots of globals used before their declaration, checked again by report_undefined_globals() */
+            std::vector<std::uint32_t> m_pending_globals;
+
+            std::vector<std::string> m_errors;
+    };
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <runtime/values.hpp>
+
+namespace lang
+{
+    /*
+        Operations on the values of runtime/values.hpp for the backends running a program inside the compiler (the
+        Interpreter and the VirtualMachine). They behave like the runtime of the generated code, down to the text printed
+        and the runtime errors.
+    */
+    namespace runtime
+    {
+        inline double value_of(std::uint64_t bits)
+        {
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+
+            return value;
+        }
+
+        inline std::uint64_t bits_of(double value)
+        {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            return bits;
+        }
+
+        inline const double NIL_DOUBLE = value_of(NIL_VALUE);
+        inline const double TRUE_DOUBLE = value_of(TRUE_VALUE);
+        inline const double FALSE_DOUBLE = value_of(FALSE_VALUE);
+
+        inline double boolean_value(bool condition)
+        {
+            return condition ? TRUE_DOUBLE : FALSE_DOUBLE;
+        }
+
+        inline bool is_number(double value)
+        {
+            return (bits_of(value) & QUIET_NAN) != QUIET_NAN;
+        }
+
+        inline bool is_object(double value)
+        {
+            return (bits_of(value) & OBJECT_TAG) == OBJECT_TAG;
+        }
+
+        /* See runtime/values.hpp: only nil and false are false */
+        inline bool is_truthy(double value)
+        {
+            std::uint64_t bits = bits_of(value);
+            return bits != FALSE_VALUE && bits != NIL_VALUE;
+        }
+
+        inline double box_object(const void* object)
+        {
+            return value_of(reinterpret_cast<std::uint64_t>(object) | OBJECT_TAG);
+        }
+
+        inline std::uint8_t* unbox_object(double value)
+        {
+            return reinterpret_cast<std::uint8_t*>(bits_of(value) & ADDRESS_MASK);
+        }
+
+        inline bool is_string(double value)
+        {
+            return is_object(value) && *unbox_object(value) == STRING_OBJECT;
+        }
+
+        inline bool is_closure(double value)
+        {
+            return is_object(value) && *unbox_object(value) == CLOSURE_OBJECT;
+        }
+
+        /* == of the language: numbers by value, strings by their characters, everything else by identity */
+        bool values_equal(double left, double right);
+
+        /* Both are strings, the result is never freed, like in the generated code */
+        double concatenate(double left, double right);
+
+        void print(double value);
+
+        /* The process ends without running destructors, a thread of the TierCompiler may still be compiling */
+        [[noreturn]] void exit_program(int status);
+
+        /* 'message' is a printf format taking up to two ints, the program exits with RUNTIME_ERROR_STATUS */
+        [[noreturn]] void runtime_error(int line, const char* message, int first_argument = 0, int second_argument = 0);
+    }
+}
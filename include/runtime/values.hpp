@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lang
+{
+    /*
+        Representation of values shared by the generated code and the Interpreter, so each can call functions of the other.
+
+        Every value is a 64 bit double. Numbers are themselves and the other values are hidden in the payload of quiet NaNs
+        (NaN boxing): nil, true, false and pointers to heap objects, which are strings and closures.
+
+        Truthiness, for every backend and the ConstantFolder: nil and false are false, every other value is true, 0 and ""
+        included, like in Lox
+    */
+    namespace runtime
+    {
+        /* Bit patterns of the values which are not numbers, an object is OBJECT_TAG | its 48 bit address */
+        constexpr std::uint64_t QUIET_NAN = 0x7ffc000000000000;
+        constexpr std::uint64_t TRUE_VALUE = QUIET_NAN | 1;
+        constexpr std::uint64_t FALSE_VALUE = QUIET_NAN | 2;
+        constexpr std::uint64_t NIL_VALUE = QUIET_NAN | 3;
+        constexpr std::uint64_t OBJECT_TAG = 0xfffc000000000000;
+        constexpr std::uint64_t ADDRESS_MASK = 0x0000ffffffffffff;
+
+        /* Returned by a loop compiled on its own (Generator::generate_loop()) which ran to its end, no value has these bits */
+        constexpr std::uint64_t LOOP_EXIT_VALUE = QUIET_NAN | 4;
+
+        /* First field of every heap object */
+        enum ObjectKind: std::uint8_t { STRING_OBJECT = 0, CLOSURE_OBJECT = 1 };
+
+        /* Exit status of a program stopped by a runtime error */
+        constexpr int RUNTIME_ERROR_STATUS = 70;
+
+        /* lang.string */
+        struct String
+        {
+            std::uint8_t kind;
+            std::int64_t length;
+            const char* characters;
+        };
+
+        /*
+            lang.closure, followed by 'upvalue_count' pointers to the boxes of the variables of enclosing functions it uses.
+            'function' is the code, taking the closure and the arguments as doubles and returning a double. 'interpreted' is
+            nullptr in closures created by generated code, the Interpreter keeps the function it interprets there and the
+            VirtualMachine its vm::Prototype
+        */
+        struct Closure
+        {
+            std::uint8_t kind;
+            void* function;
+            const char* name;
+            std::int32_t arity;
+            std::int32_t upvalue_count;
+            void* interpreted;
+
+            double** upvalues()
+            {
+                return reinterpret_cast<double**>(this + 1);
+            }
+        };
+
+        static_assert(sizeof(Closure) == 40, "The upvalues of lang.closure start at offset 40");
+    }
+}
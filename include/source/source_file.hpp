@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+
+namespace lang
+{
+    /*
+        Read-only memory mapping of a source code file.
+
+        The mapping is kept alive for the whole compilation, so the lexer can hand out
+        std::string_view spans into it instead of copying every lexeme on the heap.
+    */
+    class SourceFile
+    {
+        public:
+            SourceFile();
+            ~SourceFile();
+
+            SourceFile(const SourceFile&) = delete;
+            SourceFile& operator=(const SourceFile&) = delete;
+
+            /* It returns false if the file can not be opened or mapped */
+            bool open(const char* absolute_path_of_source_code);
+
+            void close();
+
+            std::string_view view() const;
+
+        private:
+            const char* m_data{nullptr};
+            std::size_t m_size{0};
+    };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lang
+{
+    /* Dense id of an interned identifier, ids are handed out as 0, 1, 2 ... */
+    using Symbol = std::uint32_t;
+
+    constexpr lang::Symbol NO_SYMBOL = UINT32_MAX;
+
+    /*
+        Process wide identifier interner.
+
+        The lexer interns every IDENTIFIER once, later stages compare and look up the
+        resulting lang::Symbol instead of hashing and comparing strings. Every distinct
+        name is stored exactly once, here. It is safe to use from several lexer threads.
+    */
+    class Interner
+    {
+        public:
+            static lang::Interner& global();
+
+            lang::Symbol intern(std::string_view name);
+
+            std::string_view name(lang::Symbol symbol) const;
+
+            std::size_t size() const;
+
+        private:
+            Interner() = default;
+
+        private:
+            mutable std::shared_mutex m_mutex;
+
+            /* A std::deque never moves its elements, so the views below stay valid */
+            std::deque<std::string> m_storage;
+            std::vector<std::string_view> m_names;
+            std::unordered_map<std::string_view, lang::Symbol> m_symbols;
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lang
+{
+    /* 
+        Index of a literal value in a LiteralPool
+        The top bit tells strings apart from numbers, tokens without a value carry NO_LITERAL
+    */
+    using LiteralId = std::uint32_t;
+
+    constexpr lang::LiteralId NO_LITERAL = UINT32_MAX;
+
+    /*
+        Side table holding the values of the NUMBER and STRING tokens of one token stream.
+
+        Numbers are parsed once by the lexer. Strings are views into the mapped source (the
+        quotes are trimmed) and identical strings share one entry, so a token only carries a
+        32 bit index instead of its own copy of the value.
+    */
+    class LiteralPool
+    {
+        public:
+            lang::LiteralId add_number(double value)
+            {
+                m_numbers.push_back(value);
+                return static_cast<lang::LiteralId>(m_numbers.size() - 1);
+            }
+
+            lang::LiteralId add_string(std::string_view value)
+            {
+                auto [it, inserted] = m_string_ids.try_emplace(value, static_cast<lang::LiteralId>(m_strings.size()) | STRING_BIT);
+                if(inserted)
+                {
+                    m_strings.push_back(value);
+                }
+
+                return it->second;
+            }
+
+            bool is_string(lang::LiteralId id) const
+            {
+                return (id & STRING_BIT) != 0;
+            }
+
+            double number(lang::LiteralId id) const
+            {
+                return m_numbers[id];
+            }
+
+            std::string_view string(lang::LiteralId id) const
+            {
+                return m_strings[id & ~STRING_BIT];
+            }
+
+            /* It adds the literal 'id' of 'other' to this pool and returns its id in this pool */
+            lang::LiteralId adopt(const lang::LiteralPool& other, lang::LiteralId id)
+            {
+                return other.is_string(id) ? this->add_string(other.string(id)) : this->add_number(other.number(id));
+            }
+
+        private:
+            static constexpr lang::LiteralId STRING_BIT = 1u << 31;
+
+            std::vector<double> m_numbers;
+            std::vector<std::string_view> m_strings;
+            std::unordered_map<std::string_view, lang::LiteralId> m_string_ids;
+    };
+}
@@ -2,18 +2,22 @@
 
 #include <types/token_type.hpp>
 #include <types/types.hpp>
+#include <token/literal_pool.hpp>
+#include <symbol/interner.hpp>
+#include <string_view>
 
 namespace lang
 {
     struct Token
     {
         lang::TokenType m_type;
-        std::string m_lexeme;               /* It stores the value represented by the Token. It is in std::string */
-        lang::util::object_t m_literal;     /* It corresponds to the type casted value of m_lexeme. e.g "5" -> 5, "wiz" -> "wiz", "var" -> lang::util::null */
+        std::string_view m_lexeme;          /* It stores the value represented by the Token. It is a view into the mapped source */
+        lang::LiteralId m_literal;          /* Index of the type casted value of m_lexeme in the LiteralPool of the token stream. e.g "5" -> 5, "wiz" -> "wiz", "var" -> lang::NO_LITERAL */
         int m_line;
+        lang::Symbol m_symbol;              /* Interned name of an IDENTIFIER, every other token carries lang::NO_SYMBOL */
 
-        Token(TokenType type, const std::string& lexeme, lang::util::object_t literal, int line)
-            : m_type(type), m_lexeme(lexeme), m_literal(literal), m_line(line)
+        Token(TokenType type, std::string_view lexeme, lang::LiteralId literal, int line, lang::Symbol symbol = lang::NO_SYMBOL)
+            : m_type(type), m_lexeme(lexeme), m_literal(literal), m_line(line), m_symbol(symbol)
         {}
     };
 
@@ -22,9 +26,8 @@ namespace lang
     {
         std::ostream& operator<<(std::ostream& o,const lang::Token& token)
         {
-            std::cout << lang::tokenType_map_to_string[token.m_type] << " '" << token.m_lexeme << "' ";
-            std::visit(lang::util::PrintVisitor{}, token.m_literal);
+            o << lang::tokenType_map_to_string[token.m_type] << " '" << token.m_lexeme << "'\n";
             return o;
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <token/token.hpp>
+#include <token/literal_pool.hpp>
+#include <symbol/interner.hpp>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lang
+{
+    /*
+        Output of the Lexer, stored as a struct of arrays.
+
+        Per token there is a TokenType byte, the offset and length of its lexeme in the source
+        and a 32 bit payload (the LiteralId of a NUMBER or STRING, the Symbol of an IDENTIFIER).
+        Line numbers are kept in a run-length table, a new entry is only added when the line changes.
+        That is 13 bytes per token plus one line run per source line with tokens on it.
+
+        A lang::Token is only materialized on demand by at(), it is a small trivially copyable value.
+    */
+    class TokenStream
+    {
+        public:
+            TokenStream() = default;
+
+            explicit TokenStream(std::string_view source)
+                : m_source(source)
+            {}
+
+            void push_back(lang::TokenType type, std::size_t offset, std::size_t length, std::uint32_t payload, int line);
+
+            /* Copies token 'index' of 'other', which must share the literal pool of this stream (see append()) */
+            void push_back(const lang::TokenStream& other, std::size_t index);
+
+            /* Appends every token of 'other', its literals are moved into the pool of this stream */
+            void append(const lang::TokenStream& other);
+
+            /* Drops the first 'count' tokens, the remaining ones are renumbered from 0 */
+            void erase_front(std::size_t count);
+
+            /* Drops every token but keeps the literal pool */
+            void clear_tokens();
+
+            void reserve(std::size_t token_count);
+
+            std::size_t size() const
+            {
+                return m_types.size();
+            }
+
+            lang::TokenType type(std::size_t index) const
+            {
+                return m_types[index];
+            }
+
+            std::string_view lexeme(std::size_t index) const
+            {
+                return m_source.substr(m_offsets[index], m_lengths[index]);
+            }
+
+            lang::LiteralId literal(std::size_t index) const
+            {
+                return has_literal(m_types[index]) ? m_payloads[index] : lang::NO_LITERAL;
+            }
+
+            lang::Symbol symbol(std::size_t index) const
+            {
+                return m_types[index] == lang::TokenType::IDENTIFIER ? m_payloads[index] : lang::NO_SYMBOL;
+            }
+
+            int line(std::size_t index) const;
+
+            lang::Token at(std::size_t index) const
+            {
+                return lang::Token{this->type(index), this->lexeme(index), this->literal(index), this->line(index), this->symbol(index)};
+            }
+
+            std::string_view source() const
+            {
+                return m_source;
+            }
+
+            lang::LiteralPool& literals()
+            {
+                return m_literals;
+            }
+
+            const lang::LiteralPool& literals() const
+            {
+                return m_literals;
+            }
+
+            /* Bytes used by the token arrays and the line table, the literal pool is not included */
+            std::size_t memory_usage() const;
+
+        private:
+            static bool has_literal(lang::TokenType type)
+            {
+                return type == lang::TokenType::NUMBER || type == lang::TokenType::STRING;
+            }
+
+            struct LineRun
+            {
+                std::uint32_t first_token;
+                int line;
+            };
+
+            std::string_view m_source;
+
+            std::vector<lang::TokenType> m_types;
+            std::vector<std::uint32_t> m_offsets;
+            std::vector<std::uint32_t> m_lengths;
+            std::vector<std::uint32_t> m_payloads;
+
+            std::vector<LineRun> m_lines;
+
+            lang::LiteralPool m_literals;
+    };
+}
@@ -2,10 +2,11 @@
 
 #include <unordered_map>
 #include <string>
+#include <cstdint>
 
 namespace lang
 {
-    enum class TokenType
+    enum class TokenType: std::uint8_t
     {
         // Single-character tokens.
         LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <runtime/values.hpp>
+
+namespace lang
+{
+    /*
+        Register based bytecode, what the BytecodeCompiler lowers a resolved tree to and the VirtualMachine runs.
+
+        Every function is a Prototype, its frame is a window of registers holding runtime/values.hpp doubles: the slots of
+        the Resolver come first (parameters in the first ones), temporaries follow. A captured local holds the address of
+        its heap box instead of its value, like in the generated code. Operands are register numbers unless noted,
+        'a' is the destination of the instructions producing a value, jump offsets count from the next instruction.
+    */
+    namespace vm
+    {
+        enum class OpCode: std::uint8_t
+        {
+            MOVE,               /* a = b */
+            LOAD_CONSTANT,      /* a = constants[b] */
+            GET_GLOBAL,         /* a = globals[b] */
+            SET_GLOBAL,         /* globals[b] = a */
+            NEW_BOX,            /* a = address of a new box holding b */
+            GET_BOX,            /* a = *box b */
+            SET_BOX,            /* *box a = b */
+            GET_UPVALUE,        /* a = *upvalues[b] of the running closure */
+            SET_UPVALUE,        /* *upvalues[b] = a */
+            CLOSURE,            /* a = new closure of the prototype b of the module */
+
+            ADD, SUBTRACT, MULTIPLY, DIVIDE,                    /* a = b op c */
+            EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL,
+            NEGATE, NOT,        /* a = op b */
+
+            JUMP,               /* by c */
+            JUMP_IF_FALSE,      /* by c unless a is truthy */
+            JUMP_IF_TRUE,       /* by c if a is truthy */
+
+            /* Superinstructions of a comparison and the conditional jump of an if or while on it: by c unless a op b */
+            JUMP_UNLESS_EQUAL, JUMP_UNLESS_NOT_EQUAL, JUMP_UNLESS_LESS, JUMP_UNLESS_LESS_EQUAL, JUMP_UNLESS_GREATER, JUMP_UNLESS_GREATER_EQUAL,
+
+            /*
+                The callee is a, the arguments follow it and the result replaces it. CALL takes b arguments, the others are
+                superinstructions for the common argument counts
+            */
+            CALL, CALL_0, CALL_1, CALL_2, CALL_3,
+
+            RETURN,             /* a */
+            RETURN_NIL,
+
+            PRINT,              /* a */
+
+            OPCODE_COUNT
+        };
+
+        /* Direct threading: once the module is linked 'handler' is the address of the VM's code for 'op' */
+        struct Instruction
+        {
+            const void* handler;
+            OpCode op;
+            std::uint32_t a;
+            std::uint32_t b;
+            std::int32_t c;
+        };
+
+        /* A box a closure copies on creation, a local of the function creating it or one of that function's upvalues */
+        struct UpvalueSource
+        {
+            bool is_local;
+            std::uint32_t index; /* Register or upvalue */
+        };
+
+        struct Prototype
+        {
+            std::string name; /* NUL terminated for the closures */
+            std::uint32_t arity;
+            std::uint32_t register_count;
+
+            std::vector<Instruction> code;
+            std::vector<int> lines; /* Source line of each instruction, for the runtime errors */
+
+            /* Constant pool: numbers, nil, true, false and strings, already boxed */
+            std::vector<double> constants;
+
+            std::vector<UpvalueSource> upvalues;
+        };
+
+        /* A compiled program, its first prototype is the top-level code */
+        struct Module
+        {
+            std::vector<std::unique_ptr<Prototype>> prototypes;
+            std::uint32_t global_count{0};
+
+            /* The string constants own their characters, the tree they come from may be gone */
+            std::deque<std::string> characters;
+            std::deque<lang::runtime::String> strings;
+
+            bool is_linked{false};
+        };
+    }
+}
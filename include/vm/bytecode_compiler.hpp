@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <ast/ast.hpp>
+#include <vm/bytecode.hpp>
+
+namespace lang
+{
+    /*
+        Lowers a resolved tree to the register bytecode of vm/bytecode.hpp, in a single pass without LLVM.
+
+        Expressions leave the register holding their value: a local is read where it is, everything else goes to the next
+        free temporary, and temporaries are released as soon as the instruction using them is emitted, so they behave like
+        a stack. An instruction computing a temporary which is only stored to a local is retargeted to the local instead.
+        Comparisons deciding an if or a while become a single compare-and-branch instruction, calls with few arguments
+        a call instruction of their own count. The tree is walked with explicit stacks, like the Generator does.
+    */
+    class BytecodeCompiler
+    {
+        public:
+            /* It parses the body of a function the parser skipped in lazy mode and returns the errors found in it */
+            using FunctionBodyLoader = std::function<std::vector<std::string>(lang::ast::FunctionStatement*)>;
+
+            void set_function_body_loader(FunctionBodyLoader loader);
+
+            /* 'top_level_frame_size' is the number of slots of the top-level code, see Resolver::top_level_frame_size() */
+            std::vector<std::string> compile(const std::vector<lang::ast::Statement*>& statements, std::uint32_t global_count, std::uint32_t top_level_frame_size);
+
+            lang::vm::Module take_module();
+
+        private:
+            static constexpr std::size_t NO_INSTRUCTION = SIZE_MAX;
+
+            /* Where an expression left its value, a temporary is released once it is used */
+            struct Operand
+            {
+                std::uint32_t reg;
+                bool temporary;
+            };
+
+            /*
+                A node whose code is emitted, or the rest of one once the nodes it waits for are done
+                Expressions leave their Operand on m_values, the continuations take their operands from there
+            */
+            struct Work
+            {
+                enum class Kind: std::uint8_t
+                {
+                    STATEMENT, EXPRESSION,
+                    DISCARD, PRINT, DEFINE_VAR, IF_BRANCH, IF_ELSE, IF_END, WHILE_BODY, WHILE_END, FUNCTION_END, RETURN,
+                    UNARY, BINARY, ASSIGN, LOGICAL_RIGHT, LOGICAL_END, CALL_ARGUMENT, CALL
+                };
+
+                Kind kind;
+                lang::ast::Statement* statement;
+                lang::ast::Expression* expression;
+
+                /* State kept between the steps of a statement or expression: instruction indices or a register */
+                std::size_t first;
+                std::size_t second;
+            };
+
+            /* A function being compiled, the first one is the top-level code */
+            struct FunctionContext
+            {
+                lang::vm::Prototype* prototype;
+                std::uint32_t prototype_index;
+
+                std::vector<bool> boxed_slots; /* Indexed by the slots of the Resolver, for the declaration in scope */
+                std::uint32_t next_register;
+
+                std::unordered_map<std::uint64_t, std::uint32_t> constant_indices; /* By the bits of the constant */
+            };
+
+            void run();
+
+            void compile_statement(lang::ast::Statement* statement);
+            void compile_expression(lang::ast::Expression* expression);
+
+            void push(lang::ast::Statement* statement);
+            void push(lang::ast::Expression* expression);
+            void push(Work::Kind kind, lang::ast::Statement* statement, lang::ast::Expression* expression, std::size_t first = 0, std::size_t second = 0);
+
+            /*
+                The expression of a statement. A local read where it is could be assigned before the operator using it runs,
+                as in 'a + (a = 1)', so in an expression assigning inside itself every read is copied to a temporary
+            */
+            void push_root(lang::ast::Expression* expression);
+
+            /* An if or while condition, the comparison it is when a compare-and-branch instruction decides it */
+            lang::ast::BinaryExpression* push_condition(lang::ast::Expression* condition);
+            std::size_t emit_condition_jump(lang::ast::BinaryExpression* comparison);
+
+            Operand pop_value();
+
+            /* It opens the function and schedules its body, FUNCTION_END closes it and stores its closure */
+            void begin_function(lang::ast::FunctionStatement* function);
+            void end_function(lang::ast::FunctionStatement* function, std::uint32_t prototype_index);
+            bool load_function_body(lang::ast::FunctionStatement* function);
+
+            void compile_binary(lang::ast::BinaryExpression* expression);
+            void compile_call(lang::ast::CallExpression* expression);
+            void compile_assignment(lang::ast::AssignmentExpression* expression);
+
+            Operand read_variable(const lang::ast::Binding& binding);
+            Operand local_result(std::uint32_t slot);
+
+            /* Index of the upvalue of the function at 'level' reaching the local 'slot' of the one at 'target_level' */
+            std::uint32_t upvalue_index(std::size_t level, std::size_t target_level, std::uint32_t slot);
+
+            void declare_local(std::uint32_t slot, bool captured);
+
+            std::uint32_t allocate_register();
+            void release(Operand operand);
+
+            /* 'value' ends up in the register 'target', see the description of the class */
+            void store_to(std::uint32_t target, Operand value);
+
+            std::uint32_t constant_index(double value);
+            double make_string(std::string_view string);
+
+            /* It returns the index of the instruction, emit_result() marks it as computing a fresh temporary in 'a' */
+            std::size_t emit(lang::vm::OpCode op, std::uint32_t a = 0, std::uint32_t b = 0, std::int32_t c = 0, int line = 0);
+            std::size_t emit_result(lang::vm::OpCode op, std::uint32_t a, std::uint32_t b = 0, std::int32_t c = 0, int line = 0);
+
+            /* The jump at 'index' lands on the next instruction emitted */
+            void patch_jump(std::size_t index);
+            void emit_jump_back(std::size_t target);
+
+        private:
+            lang::vm::Module m_module;
+
+            std::vector<Work> m_work;
+            std::vector<Operand> m_values;
+            std::vector<FunctionContext> m_functions;
+
+            std::unordered_map<std::string_view, double> m_string_values;
+
+            bool m_copy_locals{false};
+            std::size_t m_last_result{NO_INSTRUCTION};
+
+            std::vector<std::string> m_errors;
+            FunctionBodyLoader m_function_body_loader;
+    };
+}
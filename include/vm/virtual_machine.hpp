@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <runtime/values.hpp>
+#include <vm/bytecode.hpp>
+
+namespace lang
+{
+    /*
+        Runs the bytecode of the BytecodeCompiler, the backend of hosts which do without LLVM.
+
+        The dispatch loop is direct threaded with computed gotos (a GNU extension, GCC and Clang have it): linking a module
+        stores in every instruction the address of the code handling it, and each handler jumps straight to the handler of
+        the next instruction, there is no central switch. Frames are windows of one register stack, a call passes the
+        arguments where the caller left them, right after the callee.
+
+        Values, strings and closures have the layout of the generated code (runtime/values.hpp) and the program behaves
+        the same, including the runtime errors, which exit the process. Nothing is freed.
+    */
+    class VirtualMachine
+    {
+        public:
+            /* Registers of all the frames together and the number of nested calls, beyond them a call is a stack overflow */
+            static constexpr std::size_t REGISTER_STACK_SIZE = std::size_t{1} << 23;
+            static constexpr std::size_t MAX_FRAMES = std::size_t{1} << 20;
+
+            VirtualMachine();
+
+            /* It runs the top-level code of the module, linking it first */
+            void run(lang::vm::Module& module);
+
+        private:
+            /* The caller of a running function, restored by its return */
+            struct CallFrame
+            {
+                const lang::vm::Prototype* prototype;
+                lang::runtime::Closure* closure;
+                const lang::vm::Instruction* resume;
+                double* base;
+            };
+
+            /* The dispatch loop, also the only place the addresses of the handlers are known, so it links the module */
+            void execute(lang::vm::Module& module);
+
+        private:
+            std::unique_ptr<double[]> m_registers;
+            std::unique_ptr<CallFrame[]> m_frames;
+            std::vector<double> m_globals;
+    };
+}
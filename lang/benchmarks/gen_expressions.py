@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""
+Writes an expression heavy source file, used to benchmark the expression parser
+
+$ python3 lang/benchmarks/gen_expressions.py [statement_count] > expressions.cpl
+"""
+
+import random
+import sys
+
+BINARY_OPERATORS = ["+", "-", "*", "/", "==", "!=", "<", "<=", ">", ">=", "and", "or"]
+
+
+def operand(rng, depth):
+    choice = rng.randrange(6 if depth < 3 else 3)
+
+    if choice == 0:
+        return str(rng.randrange(1000))
+    if choice == 1:
+        return "v{}".format(rng.randrange(16))
+    if choice == 2:
+        return "-v{}".format(rng.randrange(16))
+    if choice == 3:
+        return "({})".format(expression(rng, depth + 1))
+    if choice == 4:
+        return "!({})".format(expression(rng, depth + 1))
+
+    return "f({}, {})".format(expression(rng, depth + 1), expression(rng, depth + 1))
+
+
+def expression(rng, depth=0):
+    parts = [operand(rng, depth)]
+
+    for _ in range(rng.randrange(1, 8)):
+        parts.append(rng.choice(BINARY_OPERATORS))
+        parts.append(operand(rng, depth))
+
+    return " ".join(parts)
+
+
+def main():
+    statement_count = int(sys.argv[1]) if len(sys.argv) > 1 else 20000
+    rng = random.Random(42)
+
+    out = sys.stdout
+    out.write("fun f(a, b)\n{\n    return a + b;\n}\n\n")
+
+    for i in range(16):
+        out.write("var v{} = {};\n".format(i, i))
+
+    for i in range(statement_count):
+        out.write("v{} = {};\n".format(i % 16, expression(rng)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""
+Writes a source file with many top-level functions, used to benchmark parallel code generation
+
+$ python3 lang/benchmarks/gen_functions.py [function_count] > functions.cpl
+"""
+
+import random
+import sys
+
+
+def function(rng, index):
+    callee = "g{}".format(rng.randrange(index)) if index > 0 else None
+    lines = ["fun g{}(a, b)".format(index), "{"]
+
+    lines.append("    var total = a * {} - b;".format(rng.randrange(1, 100)))
+    lines.append("    var i = 0;")
+    lines.append("    while (i < b)")
+    lines.append("    {")
+    lines.append("        if (total > {}) total = total - i; else total = total + i * 2;".format(rng.randrange(1000)))
+    lines.append("        i = i + 1;")
+    lines.append("    }")
+
+    # A closure over a local now and then, and a global read
+    if rng.randrange(4) == 0:
+        lines.append("    fun add(x) { return x + total; }")
+        lines.append("    total = add(counter);")
+
+    if callee is not None:
+        lines.append("    if (a > 0) return {}(a - 1, b) + total;".format(callee))
+
+    lines.append("    return total;")
+    lines.append("}")
+
+    return "\n".join(lines)
+
+
+def main():
+    function_count = int(sys.argv[1]) if len(sys.argv) > 1 else 10000
+    rng = random.Random(42)
+
+    out = sys.stdout
+    out.write("var counter = 1;\n\n")
+
+    for i in range(function_count):
+        out.write(function(rng, i))
+        out.write("\n\n")
+
+    out.write("print g{}(3, 10);\n".format(function_count - 1))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+Writes an identifier heavy source file, used to benchmark the lexer's keyword classification
+
+Most tokens are identifiers or keywords, many identifiers share the length and first character of a keyword
+(andy, form, nill, thistle...) so they reach the final comparison of lang::keywords::classify
+
+$ python3 lang/benchmarks/gen_identifiers.py [statement_count] > identifiers.cpl
+"""
+
+import random
+import sys
+
+NEAR_KEYWORDS = ["andy", "clasp", "elsa", "falsy", "form", "fund", "iffy", "nill", "ore", "prints", "rerun",
+                 "sup", "thistle", "tree", "vary", "whiles", "an", "classy", "fa", "thus", "x"]
+
+KEYWORD_OPERANDS = ["nil", "true", "false"]
+
+
+def name(rng):
+    return "{}{}".format(rng.choice(NEAR_KEYWORDS), rng.randrange(8))
+
+
+def operand(rng):
+    if rng.randrange(4) == 0:
+        return rng.choice(KEYWORD_OPERANDS)
+
+    return name(rng)
+
+
+def condition(rng):
+    parts = [operand(rng)]
+
+    for _ in range(rng.randrange(1, 4)):
+        parts.append(rng.choice(["and", "or"]))
+        parts.append(operand(rng))
+
+    return " ".join(parts)
+
+
+def statement(rng):
+    choice = rng.randrange(4)
+
+    if choice == 0:
+        return "{} = {};".format(name(rng), condition(rng))
+    if choice == 1:
+        return "if ({}) {} = {}; else {} = {};".format(condition(rng), name(rng), operand(rng), name(rng), operand(rng))
+    if choice == 2:
+        return "{} = !{} or {};".format(name(rng), operand(rng), operand(rng))
+
+    return "{} = {} and {};".format(name(rng), operand(rng), operand(rng))
+
+
+def main():
+    statement_count = int(sys.argv[1]) if len(sys.argv) > 1 else 200000
+    rng = random.Random(42)
+
+    out = sys.stdout
+
+    for identifier in NEAR_KEYWORDS:
+        for i in range(8):
+            out.write("var {}{} = nil;\n".format(identifier, i))
+
+    for _ in range(statement_count):
+        out.write(statement(rng) + "\n")
+
+
+if __name__ == "__main__":
+    main()
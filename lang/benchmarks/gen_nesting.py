@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""
+Writes one deeply nested construct, to check that the parser and the tree teardown do not run out of native stack
+
+Kinds: groups (((1))), unary - - 1, calls f(f(1)), assignments a = a = 1, blocks { { } }, ifs if (x) if (x) ...,
+elses if (x) ... else if (x) ..., whiles while (x) while (x) ... and functions fun f() { fun f() { } }
+
+The nesting is printed with --dump-ast, which walks the tree with an explicit stack too, so the source parsed with
+--max-nesting above the depth finishes and prints it, below the depth it reports the nesting error
+
+$ python3 lang/benchmarks/gen_nesting.py KIND [depth] > nesting.cpl
+"""
+
+import sys
+
+DEFAULT_DEPTH = 1000000
+
+
+def write(out, kind, depth):
+    if kind == "groups":
+        out.write("print " + "(" * depth + "1" + ")" * depth + ";\n")
+    elif kind == "unary":
+        out.write("print " + "-" * depth + "1;\n")
+    elif kind == "calls":
+        out.write("fun f(a) { return a; }\nprint " + "f(" * depth + "1" + ")" * depth + ";\n")
+    elif kind == "assignments":
+        out.write("var a = 0;\n" + "a = " * depth + "1;\nprint a;\n")
+    elif kind == "blocks":
+        out.write("{" * depth + "print 1;" + "}" * depth + "\n")
+    elif kind == "ifs":
+        out.write("var x = true;\n" + "if (x) " * depth + "print 1;\n")
+    elif kind == "elses":
+        out.write("var x = 0;\n" + "".join("if (x == {}) print {}; else ".format(i, i) for i in range(depth)) + "print -1;\n")
+    elif kind == "whiles":
+        out.write("var x = false;\n" + "while (x) " * depth + "print 1;\n")
+    elif kind == "functions":
+        out.write("fun f() { " * depth + "print 1;" + " }" * depth + "\n")
+    else:
+        print(__doc__, file=sys.stderr)
+        sys.exit(2)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__, file=sys.stderr)
+        return 2
+
+    depth = int(sys.argv[2]) if len(sys.argv) > 2 else DEFAULT_DEPTH
+    write(sys.stdout, sys.argv[1], depth)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
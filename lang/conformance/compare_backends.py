@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Runs every .cpl program of this directory with each execution engine and compares what they do: the LLVM JIT
+(--run), the interpreter tiering up to the JIT as early as it can (--tiered --tier-threshold=1) and the bytecode
+VM (--backend=vm). Printed output, runtime error messages and exit status must all be those of --run.
+
+$ python3 lang/conformance/compare_backends.py [path_to_executable]
+"""
+
+import difflib
+import os
+import subprocess
+import sys
+import tempfile
+
+REFERENCE = ["--run"]
+
+ENGINES = [
+    ["--tiered", "--tier-threshold=1"],
+    ["--backend=vm"],
+]
+
+# Printed by --tiered only, after the program
+STATISTICS_PREFIX = "Tiered execution:"
+
+
+def run(executable, options, program, directory):
+    result = subprocess.run([executable] + options + [program], cwd=directory, capture_output=True, text=True, timeout=300)
+    stdout = [line for line in result.stdout.splitlines(keepends=True) if not line.startswith(STATISTICS_PREFIX)]
+
+    return "".join(stdout), result.stderr, result.returncode
+
+
+def describe(outcome):
+    stdout, stderr, status = outcome
+    return "{}--- stderr\n{}--- exit status {}\n".format(stdout, stderr, status).splitlines(keepends=True)
+
+
+def main():
+    executable = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "build/executable")
+    here = os.path.dirname(os.path.abspath(__file__))
+    programs = sorted(name for name in os.listdir(here) if name.endswith(".cpl"))
+
+    failures = 0
+
+    # Engines which write files (out.ll...) do it in a scratch directory
+    with tempfile.TemporaryDirectory() as directory:
+        for name in programs:
+            program = os.path.join(here, name)
+            expected = run(executable, REFERENCE, program, directory)
+
+            if "ERROR FOUND DURING" in expected[0]:
+                print("{}: does not compile, it checks nothing".format(name))
+                failures += 1
+                continue
+
+            for options in ENGINES:
+                actual = run(executable, options, program, directory)
+
+                if actual != expected:
+                    failures += 1
+                    print("{}: {} differs from {}".format(name, " ".join(options), " ".join(REFERENCE)))
+                    sys.stdout.writelines(difflib.unified_diff(describe(expected), describe(actual), " ".join(REFERENCE), " ".join(options)))
+
+    print("{} programs, {} engines compared to {}, {} differences".format(len(programs), len(ENGINES), " ".join(REFERENCE), failures))
+
+    return 1 if failures > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
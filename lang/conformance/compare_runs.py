@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Runs every .cpl program of a directory with several command lines and compares what they do with what the first one
+does: printed output, exit status and the out.ll or out.bc written, if any. A run lasting longer than the timeout
+counts as a hang, which has to happen for every command line alike. Each command line is split like a shell would
+and gets the program appended, so two builds or two options of one build can be compared:
+
+$ python3 lang/conformance/compare_runs.py DIR "./build/executable --scan=scalar" "./build/executable --scan=sse2"
+$ python3 lang/conformance/compare_runs.py --timeout=2 DIR "../reference/build/executable" "./build/executable"
+
+With --reference-may-hang a program hanging with the first command line is not compared, the others only have to
+finish it, to check a fix of a hang
+
+The exit status is 1 if any run differs
+"""
+
+import difflib
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+
+TIMEOUT_SECONDS = 10
+
+OUTPUT_FILES = ["out.ll", "out.bc"]
+
+# Differences printed before only counting them
+MAX_REPORTED = 10
+
+
+def run(command, program, directory, timeout):
+    for name in OUTPUT_FILES:
+        path = os.path.join(directory, name)
+        if os.path.exists(path):
+            os.remove(path)
+
+    try:
+        result = subprocess.run(command + [program], cwd=directory, capture_output=True, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        return ["(timed out)\n"]
+
+    outcome = result.stdout.decode("latin-1").splitlines(keepends=True)
+    outcome.append("--- exit status {}\n".format(result.returncode))
+
+    for name in OUTPUT_FILES:
+        path = os.path.join(directory, name)
+        if os.path.exists(path):
+            with open(path, "rb") as written:
+                outcome.append("--- {}\n".format(name))
+                outcome.extend(written.read().decode("latin-1").splitlines(keepends=True))
+
+    return outcome
+
+
+def main():
+    arguments = sys.argv[1:]
+    timeout = TIMEOUT_SECONDS
+
+    reference_may_hang = False
+
+    while arguments and arguments[0].startswith("--"):
+        if arguments[0].startswith("--timeout="):
+            timeout = float(arguments[0][len("--timeout="):])
+        elif arguments[0] == "--reference-may-hang":
+            reference_may_hang = True
+        else:
+            print(__doc__)
+            return 2
+
+        arguments = arguments[1:]
+
+    if len(arguments) < 3:
+        print(__doc__)
+        return 2
+
+    directory = arguments[0]
+    commands = [[os.path.abspath(part) if index == 0 else part for index, part in enumerate(shlex.split(line))] for line in arguments[1:]]
+    programs = sorted(name for name in os.listdir(directory) if name.endswith(".cpl"))
+
+    differences = 0
+    hangs = 0
+
+    # Each command line writes its files in a scratch directory of its own
+    with tempfile.TemporaryDirectory() as scratch:
+        scratch_directories = []
+        for index in range(len(commands)):
+            scratch_directories.append(os.path.join(scratch, str(index)))
+            os.makedirs(scratch_directories[-1])
+
+        for name in programs:
+            program = os.path.abspath(os.path.join(directory, name))
+            expected = run(commands[0], program, scratch_directories[0], timeout)
+
+            reference_hangs = expected == ["(timed out)\n"]
+            if reference_hangs:
+                hangs += 1
+
+            for command, command_directory in zip(commands[1:], scratch_directories[1:]):
+                actual = run(command, program, command_directory, timeout)
+
+                if reference_hangs and reference_may_hang:
+                    expected = ["(finishes)\n"]
+                    if actual != ["(timed out)\n"]:
+                        continue
+
+                if actual == expected:
+                    continue
+
+                differences += 1
+                if differences <= MAX_REPORTED:
+                    reference, other = " ".join(commands[0]), " ".join(command)
+                    print("{}: '{}' differs from '{}'".format(name, other, reference))
+                    sys.stdout.writelines(list(difflib.unified_diff(expected, actual, reference, other))[:40])
+
+    print("{} programs, {} command lines compared to the first one, {} differences ({} programs hang with the first one)".format(
+        len(programs), len(commands) - 1, differences, hangs))
+
+    return 1 if differences > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""
+Writes random programs, to compare the diagnostics and the code of two parsers or parsing paths on them
+
+About half of the programs are valid. The others are valid programs with a few tokens deleted, duplicated or replaced
+and some are cut short, so the parser reports errors and recovers from them
+
+$ python3 lang/conformance/gen_random_programs.py DIR [count] [seed]
+"""
+
+import os
+import random
+import sys
+
+OPERATORS = ["+", "-", "*", "/", "==", "!=", "<", "<=", ">", ">=", "and", "or"]
+
+STRAY_TOKENS = [";", "(", ")", "{", "}", ",", ".", "=", "+", "!", "var", "fun", "if", "else", "while", "return",
+                "print", "x", "1", '"s"']
+
+
+class Generator:
+    def __init__(self, rng):
+        self.rng = rng
+        self.declarations = 0
+
+    def name(self):
+        return "v{}".format(self.rng.randrange(6))
+
+    def primary(self, depth):
+        choice = self.rng.randrange(9 if depth < 4 else 5)
+
+        if choice == 0:
+            return str(self.rng.randrange(100))
+        if choice == 1:
+            return self.rng.choice(["nil", "true", "false"])
+        if choice == 2:
+            return '"{}"'.format(self.rng.choice(["", "a", "text", "x y"]))
+        if choice in (3, 4):
+            return self.name()
+        if choice == 5:
+            return "({})".format(self.expression(depth + 1))
+        if choice == 6:
+            return "{}{}".format(self.rng.choice(["-", "!"]), self.primary(depth + 1))
+        if choice == 7:
+            return "({} = {})".format(self.name(), self.expression(depth + 1))
+
+        arguments = ", ".join(self.expression(depth + 1) for _ in range(self.rng.randrange(3)))
+        return "f{}({})".format(self.rng.randrange(3), arguments)
+
+    def expression(self, depth=0):
+        parts = [self.primary(depth)]
+
+        for _ in range(self.rng.randrange(3)):
+            parts.append(self.rng.choice(OPERATORS))
+            parts.append(self.primary(depth))
+
+        return " ".join(parts)
+
+    def statement(self, depth, in_function):
+        choice = self.rng.randrange(9 if depth < 4 else 4)
+
+        if choice == 0:
+            return "print {};".format(self.expression())
+        if choice == 1:
+            return "var {} = {};".format(self.name() if depth == 0 else self.local_name(), self.expression())
+        if choice == 2:
+            return "{};".format(self.expression())
+        if choice == 3:
+            return "return {};".format(self.expression()) if in_function else "{} = 1;".format(self.name())
+        if choice == 4:
+            return "{{ {} }}".format(self.block(depth + 1, in_function))
+        if choice == 5:
+            text = "if ({}) {}".format(self.expression(), self.branch(depth + 1, in_function))
+            if self.rng.randrange(2) == 0:
+                text += " else " + self.branch(depth + 1, in_function)
+            return text
+        if choice == 6:
+            return "while ({} < 3) {{ {} = {} + 1; {} }}".format(self.name(), self.name(), self.name(), self.block(depth + 1, in_function))
+
+        return self.function(depth + 1)
+
+    def branch(self, depth, in_function):
+        # A declaration is not a statement an if can run, it needs a block of its own
+        text = self.statement(depth, in_function)
+        return "{{ {} }}".format(text) if text.startswith("var ") or text.startswith("fun ") else text
+
+    def local_name(self):
+        # Declaring a name twice in one scope is an error, locals are never redeclared
+        self.declarations += 1
+        return "l{}".format(self.declarations)
+
+    def block(self, depth, in_function):
+        return " ".join(self.statement(depth, in_function) for _ in range(self.rng.randrange(4)))
+
+    def function(self, depth):
+        parameters = ", ".join("p{}".format(i) for i in range(self.rng.randrange(4)))
+        name = "f{}".format(self.rng.randrange(3)) if depth == 1 else self.local_name()
+        return "fun {}({}) {{ {} }}".format(name, parameters, self.block(depth, True))
+
+    def program(self):
+        lines = ["var v{} = {};".format(i, i) for i in range(6)]
+        lines += ["fun f{}(a, b) {{ return a; }}".format(i) for i in range(3)]
+
+        for _ in range(self.rng.randrange(1, 30)):
+            lines.append(self.statement(0, False))
+
+        return "\n".join(lines) + "\n"
+
+
+def corrupt(rng, text):
+    tokens = text.split(" ")
+
+    for _ in range(rng.randrange(1, 4)):
+        index = rng.randrange(len(tokens))
+        choice = rng.randrange(3)
+
+        if choice == 0:
+            del tokens[index]
+        elif choice == 1:
+            tokens.insert(index, tokens[index])
+        else:
+            tokens[index] = rng.choice(STRAY_TOKENS)
+
+    if rng.randrange(6) == 0:
+        tokens = tokens[:rng.randrange(len(tokens))]
+
+    return " ".join(tokens)
+
+
+def main():
+    directory = sys.argv[1]
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 400
+    rng = random.Random(int(sys.argv[3]) if len(sys.argv) > 3 else 42)
+
+    os.makedirs(directory, exist_ok=True)
+
+    for i in range(count):
+        text = Generator(rng).program()
+        if i % 2 == 1:
+            text = corrupt(rng, text)
+
+        with open(os.path.join(directory, "program_{:04}.cpl".format(i)), "w") as out:
+            out.write(text)
+
+
+if __name__ == "__main__":
+    main()
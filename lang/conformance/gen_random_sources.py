@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Writes random sources, lexically valid or not, to compare the tokens of two lexers or lexing paths on them
+
+Runs of every kind the lexer skips in bulk (whitespace, comments, identifiers, digits, string bodies) get lengths
+around the 16 and 32 byte SIMD blocks, strings span lines and contain '//', comments contain quotes, some bytes are
+not part of the language (including bytes >= 0x80) and some sources end inside a string.
+
+Some strings run over dozens of lines, longer than a chunk of a source split between several lexer threads
+(--force-parallel), so the re-lex of a string spilling out of its chunk reaches into the following chunks
+
+$ python3 lang/conformance/gen_random_sources.py DIR [count] [seed]
+"""
+
+import os
+import random
+import sys
+
+KEYWORDS = ["and", "class", "else", "false", "fun", "for", "if", "nil", "or", "print", "return", "super", "this",
+            "true", "var", "while"]
+
+OPERATORS = ["(", ")", "{", "}", ",", ".", "-", "+", ";", "/", "*", "!", "!=", "=", "==", ">", ">=", "<", "<="]
+
+INVALID = ["@", "#", "$", "%", "^", "&", "|", "~", "`", "?", ":", "\\", "'", "\x00", "\x7f"]
+
+IDENTIFIER_CHARACTERS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789"
+
+
+def run_length(rng):
+    # Mostly short, often just around one or two SIMD blocks
+    if rng.randrange(3) == 0:
+        return rng.choice([15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65])
+
+    return rng.randrange(0, 80)
+
+
+def identifier(rng):
+    if rng.randrange(4) == 0:
+        return rng.choice(KEYWORDS)
+
+    first = rng.choice(IDENTIFIER_CHARACTERS[:53])
+    return first + "".join(rng.choice(IDENTIFIER_CHARACTERS) for _ in range(run_length(rng)))
+
+
+def number(rng):
+    text = "".join(rng.choice("0123456789") for _ in range(max(1, run_length(rng))))
+
+    choice = rng.randrange(4)
+    if choice == 0:
+        text += "." + "".join(rng.choice("0123456789") for _ in range(max(1, run_length(rng))))
+    elif choice == 1:
+        text += "."
+
+    return text
+
+
+def string_body(rng):
+    characters = "abc xyz 0123 \t/+-;(){}" + "\n" * 3
+    body = "".join(rng.choice(characters) for _ in range(run_length(rng)))
+
+    if rng.randrange(4) == 0:
+        body += "// not a comment"
+
+    return body
+
+
+def long_string_body(rng):
+    lines = ["".join(rng.choice("abc xyz 0123 //\t;") for _ in range(rng.randrange(0, 60))) for _ in range(rng.randrange(2, 60))]
+    return "\n".join(lines)
+
+
+def comment(rng):
+    characters = "abc xyz \"quoted\" 0123 \t/+-;(){}"
+    return "//" + "".join(rng.choice(characters) for _ in range(run_length(rng)))
+
+
+def whitespace(rng):
+    return "".join(rng.choice(" \t\r\n  ") for _ in range(run_length(rng)))
+
+
+def piece(rng):
+    choice = rng.randrange(21)
+
+    if choice == 20:
+        return '"' + long_string_body(rng) + '"'
+
+    if choice < 5:
+        return identifier(rng)
+    if choice < 8:
+        return number(rng)
+    if choice < 10:
+        return '"' + string_body(rng) + '"'
+    if choice < 11:
+        return comment(rng) + "\n"
+    if choice < 17:
+        return rng.choice(OPERATORS)
+    if choice < 18:
+        return bytes([rng.randrange(0x80, 0x100)]).decode("latin-1")
+
+    return rng.choice(INVALID)
+
+
+def source(rng):
+    parts = []
+
+    for _ in range(rng.randrange(1, 400)):
+        parts.append(piece(rng))
+        parts.append(whitespace(rng) if rng.randrange(3) == 0 else " ")
+
+    if rng.randrange(8) == 0:
+        parts.append('"' + (long_string_body(rng) if rng.randrange(2) == 0 else string_body(rng)))
+
+    return "".join(parts).encode("latin-1")
+
+
+def main():
+    directory = sys.argv[1]
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 200
+    rng = random.Random(int(sys.argv[3]) if len(sys.argv) > 3 else 42)
+
+    os.makedirs(directory, exist_ok=True)
+
+    for i in range(count):
+        with open(os.path.join(directory, "source_{:04}.cpl".format(i)), "wb") as out:
+            out.write(source(rng))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,33 +1,187 @@
 #include <iostream>
 #include <filesystem>
+#include <string_view>
+#include <cstdlib>
 
 #include <lang/lang.hpp>
+#include <lexer/scan.hpp>
 
-/* $ ./main.out file  :- For this "argc" is 2 */
-int main(int argc, const char* argv[])
+namespace
 {
-    
-    lang::Lang application;
-
-    if(argc > 2 || argc <= 1)
+    void print_usage()
     {
-        std::cout << "Usage: last [absolute_path_to_the_source_code_file]\n";
-        return EXIT_FAILURE;
+        std::cout << "Usage: last [options] [absolute_path_to_the_source_code_file]\n"
+                  << "Options:\n"
+                  << "  --stream           lex, parse and generate one top-level declaration at a time\n"
+                  << "  --lex-threads=N    threads used to tokenize large sources (default: one per core)\n"
+                  << "  --force-parallel   lex and parse even small sources on the --lex-threads and --parse-threads threads,\n"
+                  << "                     to compare with one thread\n"
+                  << "  --parse-threads=N  threads used to parse large sources (default: one per core)\n"
+                  << "  --codegen-threads=N threads generating the code of the functions of large sources (default: one per core)\n"
+                  << "  --lazy-bodies      parse a function body only when it is needed\n"
+                  << "  --max-nesting=N    deepest nesting of statements and expressions accepted (default: 1048576)\n"
+                  << "  --no-fold          generate code for constant expressions and dead branches as written\n"
+                  << "  --ast-cache=DIR    reuse the AST of a source parsed before, cached in DIR\n"
+                  << "  -O0, -O1, -O2, -O3 optimization level of the generated module (default: -O0)\n"
+                  << "  --pipeline=P       'throughput' runs the full pipeline of the level, 'latency' only its per-function\n"
+                  << "                     simplification passes, which compile faster (default: throughput)\n"
+                  << "  --run              run the program in this process with a JIT instead of writing out.ll\n"
+                  << "  --emit=K           'll' writes out.ll for lli, 'bc' the bitcode out.bc, 'obj' the host object file out.o,\n"
+                  << "                     'exe' the executable out linked from it (default: ll)\n"
+                  << "  --cpu=C            CPU the object file and executable are compiled for, 'native' tunes them for this\n"
+                  << "                     machine, which they may then need to run (default: generic)\n"
+                  << "  --code-cache=DIR   reuse the optimized code of a source compiled before with the same options, cached in DIR\n"
+                  << "  --tiered           interpret the program right away and compile its hot functions in the background\n"
+                  << "  --tier-threshold=N calls and loop iterations making a function hot, 0 never compiles (default: 1000)\n"
+                  << "  --backend=B        'llvm' generates LLVM code, 'vm' compiles to bytecode and runs it in a virtual machine,\n"
+                  << "                     without LLVM (default: llvm)\n"
+                  << "  --dump-tokens      print the line, type and lexeme of every token instead of compiling\n"
+                  << "  --dump-ast         print the tree as parsed instead of compiling\n"
+                  << "  --scan=S           'avx2', 'sse2' or 'scalar' code skipping runs of characters in the lexer, to compare\n"
+                  << "                     them (default: the fastest the CPU has)\n";
     }
-    else if(argc == 2)
+}
+
+/* $ ./main.out [options] file  :- The single non option argument is the source code file */
+int main(int argc, const char* argv[])
+{
+    lang::Options options;
+    const char* source_code_file = nullptr;
+
+    for(int i = 1; i < argc; i++)
     {
-        if(!std::filesystem::exists(argv[1]))
+        std::string_view argument = argv[i];
+
+        if(argument == "--stream")
         {
-            std::cout << "Provided file does not exists\n";
-            return EXIT_FAILURE;
+            options.streaming = true;
         }
-
-        int ret = application.run_source_code(argv[1]);
-        if(ret == -1)
+        else if(argument == "--run")
+        {
+            options.run_in_process = true;
+        }
+        else if(argument.substr(0, 6) == "--cpu=")
+        {
+            options.target_cpu = std::string{argument.substr(6)};
+        }
+        else if(argument == "--emit=ll")
+        {
+            options.emit = lang::Emit::LLVM_IR;
+        }
+        else if(argument == "--emit=bc")
+        {
+            options.emit = lang::Emit::BITCODE;
+        }
+        else if(argument == "--emit=obj")
+        {
+            options.emit = lang::Emit::OBJECT;
+        }
+        else if(argument == "--emit=exe")
+        {
+            options.emit = lang::Emit::EXECUTABLE;
+        }
+        else if(argument == "--tiered")
+        {
+            options.tiered = true;
+        }
+        else if(argument.substr(0, 17) == "--tier-threshold=")
+        {
+            options.tier_up_threshold = static_cast<std::uint32_t>(std::strtoul(argv[i] + 17, nullptr, 10));
+        }
+        else if(argument == "--backend=llvm" || argument == "--backend=vm")
+        {
+            options.backend = argument == "--backend=vm" ? lang::Backend::VM : lang::Backend::LLVM;
+        }
+        else if(argument.substr(0, 13) == "--code-cache=")
+        {
+            options.code_cache_directory = std::string{argument.substr(13)};
+        }
+        else if(argument == "--lazy-bodies")
+        {
+            options.lazy_function_bodies = true;
+        }
+        else if(argument.substr(0, 14) == "--max-nesting=")
+        {
+            options.max_nesting_depth = static_cast<std::size_t>(std::strtoull(argv[i] + 14, nullptr, 10));
+        }
+        else if(argument == "--no-fold")
+        {
+            options.fold_constants = false;
+        }
+        else if(argument.substr(0, 12) == "--ast-cache=")
         {
+            options.ast_cache_directory = std::string{argument.substr(12)};
+        }
+        else if(argument.size() == 3 && argument.substr(0, 2) == "-O" && argument[2] >= '0' && argument[2] <= '3')
+        {
+            options.optimization_level = static_cast<unsigned>(argument[2] - '0');
+        }
+        else if(argument == "--pipeline=throughput" || argument == "--pipeline=latency")
+        {
+            options.favor_compile_latency = argument == "--pipeline=latency";
+        }
+        else if(argument.substr(0, 14) == "--lex-threads=")
+        {
+            options.lexer_threads = static_cast<unsigned>(std::strtoul(argv[i] + 14, nullptr, 10));
+        }
+        else if(argument == "--force-parallel")
+        {
+            options.force_parallel = true;
+        }
+        else if(argument.substr(0, 18) == "--codegen-threads=")
+        {
+            options.generator_threads = static_cast<unsigned>(std::strtoul(argv[i] + 18, nullptr, 10));
+        }
+        else if(argument.substr(0, 16) == "--parse-threads=")
+        {
+            options.parser_threads = static_cast<unsigned>(std::strtoul(argv[i] + 16, nullptr, 10));
+        }
+        else if(argument == "--dump-tokens")
+        {
+            options.dump_tokens = true;
+        }
+        else if(argument == "--dump-ast")
+        {
+            options.dump_ast = true;
+        }
+        else if(argument.substr(0, 7) == "--scan=")
+        {
+            if(!lang::scan::force_implementation(argument.substr(7)))
+            {
+                std::cout << "The scan implementation is not available on this CPU\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if(argument.substr(0, 1) != "-" && source_code_file == nullptr)
+        {
+            source_code_file = argv[i];
+        }
+        else
+        {
+            print_usage();
             return EXIT_FAILURE;
         }
     }
 
+    if(source_code_file == nullptr)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    if(!std::filesystem::exists(source_code_file))
+    {
+        std::cout << "Provided file does not exists\n";
+        return EXIT_FAILURE;
+    }
+
+    lang::Lang application(options);
+
+    int ret = application.run_source_code(source_code_file);
+    if(ret == -1)
+    {
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
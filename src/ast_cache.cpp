@@ -0,0 +1,1006 @@
+#include <cache/ast_cache.hpp>
+#include <ast/ast.hpp>
+#include <lang/build_id.hpp>
+#include <source/source_file.hpp>
+#include <symbol/interner.hpp>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/SHA256.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+namespace lang
+{
+    namespace
+    {
+        constexpr char MAGIC[4] = {'L', 'A', 'S', 'T'};
+
+        /*
+            Lexemes are decoded as offsets into the source being loaded, so an entry is only used for the very source it
+            was written for: besides the key the SHA-256 of the source has to match
+        */
+        struct Header
+        {
+            char magic[4];
+            std::uint32_t reserved;
+            std::uint64_t source_hash;
+            std::uint64_t source_size;
+            std::array<std::uint8_t, 32> source_digest;
+            std::uint64_t max_nesting_depth;
+            std::uint64_t payload_hash; /* Of the name table and the records, a damaged entry is a miss */
+            std::uint64_t symbol_table_size;
+            std::uint32_t symbol_count;
+            std::uint32_t statement_count;
+        };
+
+        /*
+            One per node, followed by its tokens and counts. Children come before their parent, a parent pops
+            them from the stack of its kind, missing optional children are written as NULL_STATEMENT or NULL_EXPRESSION
+        */
+        enum class Record: std::uint8_t
+        {
+            NULL_STATEMENT, EXPRESSION_STATEMENT, PRINT, VAR, BLOCK, IF, WHILE, FUNCTION, RETURN,
+            NULL_EXPRESSION, BINARY, GROUPING, LITERAL, UNARY, VARIABLE, ASSIGNMENT, LOGICAL, CALL
+        };
+
+        /* Multiply-xorshift over 8 byte words, the source size is compared separately */
+        std::uint64_t hash_bytes(std::string_view bytes, std::uint64_t seed = 0xCBF29CE484222325ull)
+        {
+            constexpr std::uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+            std::uint64_t hash = seed ^ bytes.size();
+            std::size_t i = 0;
+
+            for(; i + 8 <= bytes.size(); i += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, bytes.data() + i, sizeof(word));
+
+                hash = (hash ^ word) * MULTIPLIER;
+                hash ^= hash >> 32;
+            }
+
+            std::uint64_t tail = 0;
+            std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+
+            hash = (hash ^ tail) * MULTIPLIER;
+            hash ^= hash >> 32;
+
+            return hash;
+        }
+
+        std::array<std::uint8_t, 32> digest_source(std::string_view source)
+        {
+            return llvm::SHA256::hash(llvm::ArrayRef<std::uint8_t>(reinterpret_cast<const std::uint8_t*>(source.data()), source.size()));
+        }
+
+        /*
+            Writes the records of a tree in post-order without recursing: a node is visited twice, the first visit
+            pushes its children above it on m_work and the second one, once they are written, writes the node itself
+        */
+        class Encoder: public lang::ast::StatementVisitor<Encoder>, public lang::ast::ExpressionVisitor<Encoder>
+        {
+            public:
+                explicit Encoder(std::string_view source)
+                    : m_source(source)
+                {
+                    /* An entry usually comes out at one to three times the size of its source */
+                    m_records.reserve(source.size());
+                }
+
+                /* It returns false for a tree that can not be encoded, e.g. with a function body that was never parsed */
+                bool encode(const std::vector<lang::ast::Statement*>& statements)
+                {
+                    for(auto it = statements.rbegin(); it != statements.rend(); ++it)
+                    {
+                        this->schedule(*it);
+                    }
+
+                    while(!m_work.empty() && !m_failed)
+                    {
+                        Work work = m_work.back();
+                        m_work.pop_back();
+
+                        if(work.statement == nullptr && work.expression == nullptr)
+                        {
+                            this->put(work.is_expression ? Record::NULL_EXPRESSION : Record::NULL_STATEMENT);
+                            continue;
+                        }
+
+                        m_writing = work.children_written;
+                        if(!work.children_written)
+                        {
+                            work.children_written = true;
+                            m_work.push_back(work);
+                        }
+
+                        if(work.is_expression)
+                        {
+                            this->visit_expression(work.expression);
+                        }
+                        else
+                        {
+                            this->visit_statement(work.statement);
+                        }
+                    }
+
+                    return !m_failed;
+                }
+
+                const std::vector<char>& records() const
+                {
+                    return m_records;
+                }
+
+                const std::vector<lang::Symbol>& symbols() const
+                {
+                    return m_symbols;
+                }
+
+                void visit(lang::ast::ExpressionStatement* statement)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(statement->expr);
+                        return;
+                    }
+
+                    this->put(Record::EXPRESSION_STATEMENT);
+                }
+
+                void visit(lang::ast::PrintStatement* statement)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(statement->expr);
+                        return;
+                    }
+
+                    this->put(Record::PRINT);
+                }
+
+                void visit(lang::ast::VarStatement* statement)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(statement->initializer);
+                        return;
+                    }
+
+                    this->put(Record::VAR);
+                    this->put_token(statement->name);
+                }
+
+                void visit(lang::ast::BlockStatement* statement)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule_list(statement->statements);
+                        return;
+                    }
+
+                    this->put(Record::BLOCK);
+                    this->put_varint(statement->statements.size());
+                }
+
+                void visit(lang::ast::IfStatement* statement)
+                {
+                    if(!m_writing)
+                    {
+                        /* Pushed in reverse, so they are written condition, then, else */
+                        this->schedule(statement->elseBranch);
+                        this->schedule(statement->thenBranch);
+                        this->schedule(statement->condition);
+                        return;
+                    }
+
+                    this->put(Record::IF);
+                }
+
+                void visit(lang::ast::WhileStatement* statement)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(statement->body_stmt);
+                        this->schedule(statement->condition_expr);
+                        return;
+                    }
+
+                    this->put(Record::WHILE);
+                }
+
+                void visit(lang::ast::FunctionStatement* statement)
+                {
+                    /* A skipped body only exists as a token range of the parser that skipped it */
+                    if(!statement->is_body_parsed)
+                    {
+                        m_failed = true;
+                        return;
+                    }
+
+                    if(!m_writing)
+                    {
+                        this->schedule_list(statement->body_stmts);
+                        return;
+                    }
+
+                    this->put(Record::FUNCTION);
+                    this->put_token(statement->name);
+
+                    this->put_varint(statement->params.size());
+                    for(const lang::Token& param: statement->params)
+                    {
+                        this->put_token(param);
+                    }
+
+                    this->put_varint(statement->body_stmts.size());
+                }
+
+                void visit(lang::ast::ReturnStatement* statement)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(statement->expr);
+                        return;
+                    }
+
+                    this->put(Record::RETURN);
+                    this->put_token(statement->keyword);
+                }
+
+                void visit(lang::ast::BinaryExpression* expression)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(expression->right);
+                        this->schedule(expression->left);
+                        return;
+                    }
+
+                    this->put(Record::BINARY);
+                    this->put_token(expression->op);
+                }
+
+                void visit(lang::ast::GroupingExpression* expression)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(expression->expr);
+                        return;
+                    }
+
+                    this->put(Record::GROUPING);
+                }
+
+                void visit(lang::ast::LiteralExpression* expression)
+                {
+                    if(m_writing)
+                    {
+                        this->put(Record::LITERAL);
+                        this->put_literal(expression);
+                    }
+                }
+
+                void visit(lang::ast::UnaryExpression* expression)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(expression->expr);
+                        return;
+                    }
+
+                    this->put(Record::UNARY);
+                    this->put_token(expression->op);
+                }
+
+                void visit(lang::ast::VariableExpression* expression)
+                {
+                    if(m_writing)
+                    {
+                        this->put(Record::VARIABLE);
+                        this->put_token(expression->name);
+                    }
+                }
+
+                void visit(lang::ast::AssignmentExpression* expression)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(expression->expr);
+                        return;
+                    }
+
+                    this->put(Record::ASSIGNMENT);
+                    this->put_token(expression->name);
+                }
+
+                void visit(lang::ast::LogicalExpression* expression)
+                {
+                    if(!m_writing)
+                    {
+                        this->schedule(expression->right);
+                        this->schedule(expression->left);
+                        return;
+                    }
+
+                    this->put(Record::LOGICAL);
+                    this->put_token(expression->op);
+                }
+
+                void visit(lang::ast::CallExpression* expression)
+                {
+                    if(!m_writing)
+                    {
+                        /* The callee ends up on top, it is written before the arguments */
+                        this->schedule_list(expression->arguments);
+                        this->schedule(expression->callee);
+                        return;
+                    }
+
+                    this->put(Record::CALL);
+                    this->put_token(expression->closing_paren);
+                    this->put_varint(expression->arguments.size());
+                }
+
+            private:
+                struct Work
+                {
+                    lang::ast::Statement* statement;
+                    lang::ast::Expression* expression;
+                    bool is_expression;
+                    bool children_written;
+                };
+
+                void schedule(lang::ast::Statement* statement)
+                {
+                    m_work.push_back(Work{statement, nullptr, false, false});
+                }
+
+                void schedule(lang::ast::Expression* expression)
+                {
+                    m_work.push_back(Work{nullptr, expression, true, false});
+                }
+
+                template<typename T>
+                void schedule_list(lang::ast::List<T> list)
+                {
+                    for(std::size_t i = list.size(); i > 0; i--)
+                    {
+                        this->schedule(list[i - 1]);
+                    }
+                }
+
+                template<typename T>
+                void put(T value)
+                {
+                    static_assert(std::is_trivially_copyable_v<T>);
+
+                    std::size_t size = m_records.size();
+                    m_records.resize(size + sizeof(T));
+                    std::memcpy(m_records.data() + size, &value, sizeof(T));
+                }
+
+                /* LEB128, 7 bits per byte, the high bit tells another byte follows */
+                void put_varint(std::uint64_t value)
+                {
+                    while(value >= 0x80)
+                    {
+                        m_records.push_back(static_cast<char>(value | 0x80));
+                        value >>= 7;
+                    }
+
+                    m_records.push_back(static_cast<char>(value));
+                }
+
+                /* Zigzag, so small negative deltas stay small too */
+                void put_delta(std::int64_t delta)
+                {
+                    this->put_varint((static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63));
+                }
+
+                /* Its type and then its value, a string like a lexeme as its offset and length in the source */
+                void put_literal(const lang::ast::LiteralExpression* literal)
+                {
+                    this->put(literal->type);
+
+                    switch(literal->type)
+                    {
+                        case lang::ast::LiteralExpression::Type::NIL:
+                            break;
+
+                        case lang::ast::LiteralExpression::Type::BOOLEAN:
+                            this->put(static_cast<std::uint8_t>(literal->boolean));
+                            break;
+
+                        case lang::ast::LiteralExpression::Type::NUMBER:
+                            this->put(literal->number);
+                            break;
+
+                        case lang::ast::LiteralExpression::Type::STRING:
+                            if(literal->string.data() < m_source.data() || literal->string.data() + literal->string.size() > m_source.data() + m_source.size())
+                            {
+                                m_failed = true;
+                                return;
+                            }
+
+                            this->put_varint(static_cast<std::uint64_t>(literal->string.data() - m_source.data()));
+                            this->put_varint(literal->string.size());
+                            break;
+                    }
+                }
+
+                /*
+                    Same fields as a TokenStream entry, with the symbol replaced by its index in the entry's name table
+                    Offset and line are deltas to the previous token, which is usually close by in the source
+                */
+                void put_token(const lang::Token& token)
+                {
+                    const char* lexeme = token.m_lexeme.data();
+
+                    /* Tokens of the tree never carry literals, their values are stored in the LiteralExpression */
+                    if(lexeme < m_source.data() || lexeme + token.m_lexeme.size() > m_source.data() + m_source.size() || token.m_literal != lang::NO_LITERAL)
+                    {
+                        m_failed = true;
+                        return;
+                    }
+
+                    /* 0 stands for NO_SYMBOL, every other value is one more than the index */
+                    std::uint32_t symbol_index = 0;
+                    if(token.m_symbol != lang::NO_SYMBOL)
+                    {
+                        /* Symbols are dense, so the index of each one is kept in a flat table instead of a hash map */
+                        if(token.m_symbol >= m_symbol_indices.size())
+                        {
+                            m_symbol_indices.resize(token.m_symbol + 1, 0);
+                        }
+
+                        if(m_symbol_indices[token.m_symbol] == 0)
+                        {
+                            m_symbols.push_back(token.m_symbol);
+                            m_symbol_indices[token.m_symbol] = static_cast<std::uint32_t>(m_symbols.size());
+                        }
+
+                        symbol_index = m_symbol_indices[token.m_symbol];
+                    }
+
+                    std::int64_t offset = lexeme - m_source.data();
+
+                    this->put(token.m_type);
+                    this->put_delta(offset - m_previous_offset);
+                    this->put_varint(token.m_lexeme.size());
+                    this->put_delta(static_cast<std::int64_t>(token.m_line) - m_previous_line);
+                    this->put_varint(symbol_index);
+
+                    m_previous_offset = offset;
+                    m_previous_line = token.m_line;
+                }
+
+            private:
+                std::string_view m_source;
+
+                std::vector<Work> m_work;
+                bool m_writing{false};
+                bool m_failed{false};
+
+                std::vector<char> m_records;
+                std::int64_t m_previous_offset{0};
+                std::int64_t m_previous_line{0};
+
+                std::vector<lang::Symbol> m_symbols;
+                std::vector<std::uint32_t> m_symbol_indices; /* By Symbol, 0 until the symbol gets an index */
+        };
+
+        /* Rebuilds the tree from the records, each of them bounds checked, so a damaged entry is a miss and not a crash */
+        class Decoder
+        {
+            public:
+                Decoder(std::string_view source, std::string_view entry, lang::ast::Arena& arena)
+                    : m_source(source), m_cursor(entry.data()), m_end(entry.data() + entry.size()), m_arena(arena)
+                {}
+
+                bool decode_symbols(std::uint32_t symbol_count)
+                {
+                    lang::Interner& interner = lang::Interner::global();
+                    m_symbols.reserve(symbol_count);
+
+                    for(std::uint32_t i = 0; i < symbol_count && !m_failed; i++)
+                    {
+                        std::uint32_t length = this->get<std::uint32_t>();
+                        if(m_failed || static_cast<std::size_t>(m_end - m_cursor) < length)
+                        {
+                            m_failed = true;
+                            break;
+                        }
+
+                        m_symbols.push_back(interner.intern(std::string_view{m_cursor, length}));
+                        m_cursor += length;
+                    }
+
+                    return !m_failed;
+                }
+
+                /* It appends the top-level statements to 'statements' */
+                bool decode_records(std::uint32_t statement_count, std::vector<lang::ast::Statement*>& statements)
+                {
+                    while(m_cursor != m_end && !m_failed)
+                    {
+                        this->decode_record(this->get<Record>());
+                    }
+
+                    if(m_failed || !m_expressions.empty() || m_statements.size() != statement_count)
+                    {
+                        return false;
+                    }
+
+                    statements.insert(statements.end(), m_statements.begin(), m_statements.end());
+                    return true;
+                }
+
+            private:
+                void decode_record(Record record)
+                {
+                    switch(record)
+                    {
+                        case Record::NULL_STATEMENT:
+                            m_statements.push_back(nullptr);
+                            break;
+
+                        case Record::EXPRESSION_STATEMENT:
+                            this->push(m_arena.make<lang::ast::ExpressionStatement>(this->pop_expression()));
+                            break;
+
+                        case Record::PRINT:
+                            this->push(m_arena.make<lang::ast::PrintStatement>(this->pop_expression()));
+                            break;
+
+                        case Record::VAR:
+                        {
+                            lang::Token name = this->get_token();
+                            this->push(m_arena.make<lang::ast::VarStatement>(name, this->pop_expression()));
+                            break;
+                        }
+
+                        case Record::BLOCK:
+                            this->push(m_arena.make<lang::ast::BlockStatement>(this->pop_list(m_statements, this->get_varint())));
+                            break;
+
+                        case Record::IF:
+                        {
+                            lang::ast::Statement* else_branch = this->pop_statement();
+                            lang::ast::Statement* then_branch = this->pop_statement();
+                            this->push(m_arena.make<lang::ast::IfStatement>(this->pop_expression(), then_branch, else_branch));
+                            break;
+                        }
+
+                        case Record::WHILE:
+                        {
+                            lang::ast::Statement* body = this->pop_statement();
+                            this->push(m_arena.make<lang::ast::WhileStatement>(this->pop_expression(), body));
+                            break;
+                        }
+
+                        case Record::FUNCTION:
+                        {
+                            lang::Token name = this->get_token();
+
+                            m_parameters.clear();
+                            std::uint64_t param_count = this->get_varint();
+                            for(std::uint64_t i = 0; i < param_count && !m_failed; i++)
+                            {
+                                m_parameters.push_back(this->get_token());
+                            }
+
+                            lang::ast::List<lang::Token> params = m_arena.make_list(m_parameters.data(), m_parameters.size());
+                            this->push(m_arena.make<lang::ast::FunctionStatement>(name, params, this->pop_list(m_statements, this->get_varint())));
+                            break;
+                        }
+
+                        case Record::RETURN:
+                        {
+                            lang::Token keyword = this->get_token();
+                            this->push(m_arena.make<lang::ast::ReturnStatement>(keyword, this->pop_expression()));
+                            break;
+                        }
+
+                        case Record::NULL_EXPRESSION:
+                            m_expressions.push_back(nullptr);
+                            break;
+
+                        case Record::BINARY:
+                        case Record::LOGICAL:
+                        {
+                            lang::Token op = this->get_token();
+                            lang::ast::Expression* right = this->pop_expression();
+                            lang::ast::Expression* left = this->pop_expression();
+
+                            if(record == Record::BINARY)
+                            {
+                                this->push(m_arena.make<lang::ast::BinaryExpression>(left, op, right));
+                            }
+                            else
+                            {
+                                this->push(m_arena.make<lang::ast::LogicalExpression>(left, op, right));
+                            }
+                            break;
+                        }
+
+                        case Record::GROUPING:
+                            this->push(m_arena.make<lang::ast::GroupingExpression>(this->pop_expression()));
+                            break;
+
+                        case Record::LITERAL:
+                            this->push(this->get_literal());
+                            break;
+
+                        case Record::UNARY:
+                        {
+                            lang::Token op = this->get_token();
+                            this->push(m_arena.make<lang::ast::UnaryExpression>(op, this->pop_expression()));
+                            break;
+                        }
+
+                        case Record::VARIABLE:
+                            this->push(m_arena.make<lang::ast::VariableExpression>(this->get_token()));
+                            break;
+
+                        case Record::ASSIGNMENT:
+                        {
+                            lang::Token name = this->get_token();
+                            this->push(m_arena.make<lang::ast::AssignmentExpression>(name, this->pop_expression()));
+                            break;
+                        }
+
+                        case Record::CALL:
+                        {
+                            lang::Token paren = this->get_token();
+                            lang::ast::List<lang::ast::Expression*> arguments = this->pop_list(m_expressions, this->get_varint());
+                            this->push(m_arena.make<lang::ast::CallExpression>(this->pop_expression(), paren, arguments));
+                            break;
+                        }
+
+                        default:
+                            m_failed = true;
+                            break;
+                    }
+                }
+
+                template<typename T>
+                T get()
+                {
+                    T value{};
+
+                    if(static_cast<std::size_t>(m_end - m_cursor) < sizeof(T))
+                    {
+                        m_failed = true;
+                        return value;
+                    }
+
+                    std::memcpy(&value, m_cursor, sizeof(T));
+                    m_cursor += sizeof(T);
+
+                    return value;
+                }
+
+                std::uint64_t get_varint()
+                {
+                    /* Nearly every count, delta and index fits in the first byte */
+                    if(m_cursor != m_end && static_cast<std::uint8_t>(*m_cursor) < 0x80)
+                    {
+                        return static_cast<std::uint8_t>(*m_cursor++);
+                    }
+
+                    std::uint64_t value = 0;
+
+                    for(unsigned shift = 0; shift < 64; shift += 7)
+                    {
+                        if(m_cursor == m_end)
+                        {
+                            break;
+                        }
+
+                        std::uint8_t byte = static_cast<std::uint8_t>(*m_cursor++);
+                        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+
+                        if((byte & 0x80) == 0)
+                        {
+                            return value;
+                        }
+                    }
+
+                    m_failed = true;
+                    return 0;
+                }
+
+                std::int64_t get_delta()
+                {
+                    std::uint64_t value = this->get_varint();
+                    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+                }
+
+                lang::ast::Expression* get_literal()
+                {
+                    switch(this->get<lang::ast::LiteralExpression::Type>())
+                    {
+                        case lang::ast::LiteralExpression::Type::NIL:
+                            return m_arena.make<lang::ast::LiteralExpression>();
+
+                        case lang::ast::LiteralExpression::Type::BOOLEAN:
+                            return m_arena.make<lang::ast::LiteralExpression>(this->get<std::uint8_t>() != 0);
+
+                        case lang::ast::LiteralExpression::Type::NUMBER:
+                            return m_arena.make<lang::ast::LiteralExpression>(this->get<double>());
+
+                        case lang::ast::LiteralExpression::Type::STRING:
+                        {
+                            std::uint64_t offset = this->get_varint();
+                            std::uint64_t length = this->get_varint();
+
+                            if(offset <= m_source.size() && length <= m_source.size() - offset)
+                            {
+                                return m_arena.make<lang::ast::LiteralExpression>(m_source.substr(offset, length));
+                            }
+                            break;
+                        }
+                    }
+
+                    m_failed = true;
+                    return nullptr;
+                }
+
+                lang::Token get_token()
+                {
+                    lang::TokenType type = this->get<lang::TokenType>();
+                    std::int64_t offset = m_previous_offset + this->get_delta();
+                    std::uint64_t length = this->get_varint();
+                    std::int64_t line = m_previous_line + this->get_delta();
+                    std::uint64_t symbol_index = this->get_varint();
+
+                    bool valid = type <= lang::TokenType::MYEOF
+                        && offset >= 0 && static_cast<std::uint64_t>(offset) <= m_source.size() && length <= m_source.size() - offset
+                        && line >= INT32_MIN && line <= INT32_MAX
+                        && symbol_index <= m_symbols.size();
+
+                    if(m_failed || !valid)
+                    {
+                        m_failed = true;
+                        return lang::Token{lang::TokenType::MYEOF, std::string_view{}, lang::NO_LITERAL, 0};
+                    }
+
+                    m_previous_offset = offset;
+                    m_previous_line = line;
+
+                    lang::Symbol symbol = symbol_index == 0 ? lang::NO_SYMBOL : m_symbols[symbol_index - 1];
+
+                    return lang::Token{type, m_source.substr(offset, length), lang::NO_LITERAL, static_cast<int>(line), symbol};
+                }
+
+                void push(lang::ast::Statement* statement)
+                {
+                    m_statements.push_back(statement);
+                }
+
+                void push(lang::ast::Expression* expression)
+                {
+                    m_expressions.push_back(expression);
+                }
+
+                lang::ast::Statement* pop_statement()
+                {
+                    return this->pop(m_statements);
+                }
+
+                lang::ast::Expression* pop_expression()
+                {
+                    return this->pop(m_expressions);
+                }
+
+                template<typename T>
+                T* pop(std::vector<T*>& stack)
+                {
+                    if(stack.empty())
+                    {
+                        m_failed = true;
+                        return nullptr;
+                    }
+
+                    T* node = stack.back();
+                    stack.pop_back();
+
+                    return node;
+                }
+
+                /* The last 'count' entries of 'stack' become the list, in the order they were written */
+                template<typename T>
+                lang::ast::List<T*> pop_list(std::vector<T*>& stack, std::uint64_t count)
+                {
+                    if(m_failed || count > stack.size())
+                    {
+                        m_failed = true;
+                        return lang::ast::List<T*>{};
+                    }
+
+                    std::size_t begin = stack.size() - count;
+                    lang::ast::List<T*> list = m_arena.make_list(stack.data() + begin, count);
+                    stack.erase(stack.begin() + begin, stack.end());
+
+                    return list;
+                }
+
+            private:
+                std::string_view m_source;
+                const char* m_cursor;
+                const char* m_end;
+                lang::ast::Arena& m_arena;
+
+                bool m_failed{false};
+
+                std::int64_t m_previous_offset{0};
+                std::int64_t m_previous_line{0};
+
+                std::vector<lang::Symbol> m_symbols;
+
+                std::vector<lang::ast::Statement*> m_statements;
+                std::vector<lang::ast::Expression*> m_expressions;
+                std::vector<lang::Token> m_parameters;
+        };
+    }
+
+    AstCache::AstCache(std::string directory, std::size_t max_nesting_depth)
+        : m_directory(std::move(directory)), m_max_nesting_depth(max_nesting_depth)
+    {}
+
+    std::uint64_t AstCache::hash_source(std::string_view source)
+    {
+        /* Seeded with the build of the compiler, a parser, folder or encoding of another build never sees the entry */
+        static const std::uint64_t seed = hash_bytes(lang::BUILD_ID);
+
+        return hash_bytes(source, seed);
+    }
+
+    bool AstCache::load(std::string_view source, std::uint64_t source_hash, lang::ast::Program& program)
+    {
+        /* The entry is decoded straight from the mapping, only the nodes are copied into the program's arena */
+        lang::SourceFile entry_file;
+        if(!entry_file.open(this->entry_path(source_hash).c_str()))
+        {
+            m_statistics.misses++;
+            return false;
+        }
+
+        std::string_view entry = entry_file.view();
+
+        Header header;
+        bool valid = entry.size() >= sizeof(Header);
+
+        if(valid)
+        {
+            std::memcpy(&header, entry.data(), sizeof(Header));
+
+            valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                && header.source_hash == source_hash
+                && header.source_size == source.size()
+                && header.max_nesting_depth == m_max_nesting_depth
+                && header.symbol_table_size <= entry.size() - sizeof(Header)
+                && header.source_digest == digest_source(source);
+        }
+
+        if(valid)
+        {
+            std::string_view symbol_table = entry.substr(sizeof(Header), header.symbol_table_size);
+            std::string_view records = entry.substr(sizeof(Header) + header.symbol_table_size);
+
+            valid = hash_bytes(records, hash_bytes(symbol_table)) == header.payload_hash;
+
+            if(valid)
+            {
+                Decoder decoder(source, entry.substr(sizeof(Header)), program.arena);
+
+                valid = decoder.decode_symbols(header.symbol_count) && decoder.decode_records(header.statement_count, program.statements);
+            }
+        }
+
+        if(!valid)
+        {
+            m_statistics.misses++;
+            return false;
+        }
+
+        m_statistics.hits++;
+        m_statistics.bytes_read += entry.size();
+
+        return true;
+    }
+
+    bool AstCache::store(std::string_view source, std::uint64_t source_hash, const lang::ast::Program& program)
+    {
+        Encoder encoder(source);
+        if(!encoder.encode(program.statements))
+        {
+            return false;
+        }
+
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.reserved = 0;
+        header.source_hash = source_hash;
+        header.source_size = source.size();
+        header.source_digest = digest_source(source);
+        header.max_nesting_depth = m_max_nesting_depth;
+        header.symbol_count = static_cast<std::uint32_t>(encoder.symbols().size());
+        header.statement_count = static_cast<std::uint32_t>(program.statements.size());
+
+        /* Each name is its length followed by its characters */
+        std::string symbol_table;
+        const lang::Interner& interner = lang::Interner::global();
+        for(lang::Symbol symbol: encoder.symbols())
+        {
+            std::string_view name = interner.name(symbol);
+            std::uint32_t length = static_cast<std::uint32_t>(name.size());
+
+            symbol_table.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            symbol_table.append(name);
+        }
+
+        std::string_view records{encoder.records().data(), encoder.records().size()};
+
+        header.symbol_table_size = symbol_table.size();
+        header.payload_hash = hash_bytes(records, hash_bytes(symbol_table));
+
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+        if(error)
+        {
+            return false;
+        }
+
+        /* Written next to the entry and renamed over it, so a concurrent load never maps a half written file */
+        std::string path = this->entry_path(source_hash);
+        std::string temporary_path = path + "." + std::to_string(::getpid()) + ".tmp";
+
+        {
+            std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            out.write(symbol_table.data(), symbol_table.size());
+            out.write(records.data(), records.size());
+
+            if(!out.flush())
+            {
+                std::filesystem::remove(temporary_path, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary_path, path, error);
+        if(error)
+        {
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+
+        m_statistics.stores++;
+        m_statistics.bytes_written += sizeof(Header) + symbol_table.size() + records.size();
+
+        return true;
+    }
+
+    const AstCache::Statistics& AstCache::statistics() const
+    {
+        return m_statistics;
+    }
+
+    std::string AstCache::entry_path(std::uint64_t source_hash) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.ast", static_cast<unsigned long long>(source_hash));
+
+        return (std::filesystem::path(m_directory) / name).string();
+    }
+}
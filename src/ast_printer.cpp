@@ -0,0 +1,250 @@
+#include <ast/printer.hpp>
+
+#include <cstdio>
+
+namespace lang
+{
+    namespace ast
+    {
+        Printer::Printer(std::ostream& out)
+            : m_out(out)
+        {}
+
+        void Printer::print(const std::vector<Statement*>& statements)
+        {
+            for(Statement* statement: statements)
+            {
+                this->push(statement);
+
+                while(!m_work.empty())
+                {
+                    Work work = m_work.back();
+                    m_work.pop_back();
+
+                    if(work.statement != nullptr)
+                    {
+                        this->visit_statement(work.statement);
+                    }
+                    else if(work.expression != nullptr)
+                    {
+                        this->visit_expression(work.expression);
+                    }
+                    else
+                    {
+                        m_out << work.text;
+                    }
+                }
+
+                m_out << '\n';
+            }
+        }
+
+        /*********************************************** STATEMENTS ***********************************************/
+
+        void Printer::visit(ExpressionStatement* statement)
+        {
+            m_out << "(expression ";
+            this->push(")");
+            this->push(statement->expr);
+        }
+
+        void Printer::visit(PrintStatement* statement)
+        {
+            m_out << "(print ";
+            this->push(")");
+            this->push(statement->expr);
+        }
+
+        void Printer::visit(VarStatement* statement)
+        {
+            m_out << "(var " << statement->name.m_lexeme;
+            this->push(")");
+
+            if(statement->initializer != nullptr)
+            {
+                this->push(statement->initializer);
+                this->push(" ");
+            }
+        }
+
+        void Printer::visit(BlockStatement* statement)
+        {
+            m_out << "(block";
+            this->push(")");
+            this->push_list(statement->statements);
+        }
+
+        void Printer::visit(IfStatement* statement)
+        {
+            m_out << "(if ";
+            this->push(")");
+
+            if(statement->elseBranch != nullptr)
+            {
+                this->push(statement->elseBranch);
+                this->push(" else ");
+            }
+
+            this->push(statement->thenBranch);
+            this->push(" ");
+            this->push(statement->condition);
+        }
+
+        void Printer::visit(WhileStatement* statement)
+        {
+            m_out << "(while ";
+            this->push(")");
+            this->push(statement->body_stmt);
+            this->push(" ");
+            this->push(statement->condition_expr);
+        }
+
+        void Printer::visit(FunctionStatement* statement)
+        {
+            m_out << "(fun " << statement->name.m_lexeme << " (";
+
+            for(std::size_t i = 0; i < statement->params.size(); i++)
+            {
+                m_out << (i > 0 ? " " : "") << statement->params[i].m_lexeme;
+            }
+            m_out << ")";
+
+            /* A body skipped in lazy mode has no nodes yet */
+            if(!statement->is_body_parsed)
+            {
+                m_out << " unparsed)";
+                return;
+            }
+
+            this->push(")");
+            this->push_list(statement->body_stmts);
+        }
+
+        void Printer::visit(ReturnStatement* statement)
+        {
+            m_out << "(return";
+            this->push(")");
+
+            if(statement->expr != nullptr)
+            {
+                this->push(statement->expr);
+                this->push(" ");
+            }
+        }
+
+        /*********************************************** EXPRESSIONS ***********************************************/
+
+        void Printer::visit(BinaryExpression* expression)
+        {
+            m_out << "(" << expression->op.m_lexeme << " ";
+            this->push(")");
+            this->push(expression->right);
+            this->push(" ");
+            this->push(expression->left);
+        }
+
+        void Printer::visit(GroupingExpression* expression)
+        {
+            m_out << "(group ";
+            this->push(")");
+            this->push(expression->expr);
+        }
+
+        void Printer::visit(LiteralExpression* expression)
+        {
+            switch(expression->type)
+            {
+                case LiteralExpression::Type::NIL:
+                    m_out << "nil";
+                    break;
+
+                case LiteralExpression::Type::BOOLEAN:
+                    m_out << (expression->boolean ? "true" : "false");
+                    break;
+
+                case LiteralExpression::Type::NUMBER:
+                {
+                    char digits[32];
+                    std::snprintf(digits, sizeof(digits), "%.17g", expression->number);
+                    m_out << digits;
+                    break;
+                }
+
+                case LiteralExpression::Type::STRING:
+                    m_out << '"' << expression->string << '"';
+                    break;
+            }
+        }
+
+        void Printer::visit(UnaryExpression* expression)
+        {
+            m_out << "(" << expression->op.m_lexeme << " ";
+            this->push(")");
+            this->push(expression->expr);
+        }
+
+        void Printer::visit(VariableExpression* expression)
+        {
+            m_out << expression->name.m_lexeme;
+        }
+
+        void Printer::visit(AssignmentExpression* expression)
+        {
+            m_out << "(= " << expression->name.m_lexeme << " ";
+            this->push(")");
+            this->push(expression->expr);
+        }
+
+        void Printer::visit(LogicalExpression* expression)
+        {
+            m_out << "(" << expression->op.m_lexeme << " ";
+            this->push(")");
+            this->push(expression->right);
+            this->push(" ");
+            this->push(expression->left);
+        }
+
+        void Printer::visit(CallExpression* expression)
+        {
+            m_out << "(call ";
+            this->push(")");
+            this->push_list(expression->arguments);
+            this->push(expression->callee);
+        }
+
+        /**********************************************************************************************************/
+
+        void Printer::push(Statement* statement)
+        {
+            m_work.push_back(statement != nullptr ? Work{statement, nullptr, nullptr} : Work{nullptr, nullptr, "null"});
+        }
+
+        void Printer::push(Expression* expression)
+        {
+            m_work.push_back(expression != nullptr ? Work{nullptr, expression, nullptr} : Work{nullptr, nullptr, "null"});
+        }
+
+        void Printer::push(const char* text)
+        {
+            m_work.push_back(Work{nullptr, nullptr, text});
+        }
+
+        void Printer::push_list(List<Statement*> statements)
+        {
+            for(std::size_t i = statements.size(); i > 0; i--)
+            {
+                this->push(statements[i - 1]);
+                this->push(" ");
+            }
+        }
+
+        void Printer::push_list(List<Expression*> expressions)
+        {
+            for(std::size_t i = expressions.size(); i > 0; i--)
+            {
+                this->push(expressions[i - 1]);
+                this->push(" ");
+            }
+        }
+    }
+}
@@ -0,0 +1,909 @@
+#include <vm/bytecode_compiler.hpp>
+#include <runtime/operations.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace lang
+{
+    namespace
+    {
+        using lang::vm::OpCode;
+
+        /* Whether an assignment is nested anywhere in 'root', one at the root itself runs after its operands */
+        bool assigns_inside(lang::ast::Expression* root)
+        {
+            std::vector<lang::ast::Expression*> nodes{root};
+
+            while(!nodes.empty())
+            {
+                lang::ast::Expression* expression = nodes.back();
+                nodes.pop_back();
+
+                switch(expression->kind)
+                {
+                    case lang::ast::ExpressionKind::LITERAL:
+                    case lang::ast::ExpressionKind::VARIABLE:
+                        break;
+
+                    case lang::ast::ExpressionKind::ASSIGNMENT:
+                        if(expression != root)
+                        {
+                            return true;
+                        }
+                        nodes.push_back(static_cast<lang::ast::AssignmentExpression*>(expression)->expr);
+                        break;
+
+                    case lang::ast::ExpressionKind::GROUPING: nodes.push_back(static_cast<lang::ast::GroupingExpression*>(expression)->expr); break;
+                    case lang::ast::ExpressionKind::UNARY: nodes.push_back(static_cast<lang::ast::UnaryExpression*>(expression)->expr); break;
+
+                    case lang::ast::ExpressionKind::BINARY:
+                        nodes.push_back(static_cast<lang::ast::BinaryExpression*>(expression)->left);
+                        nodes.push_back(static_cast<lang::ast::BinaryExpression*>(expression)->right);
+                        break;
+
+                    case lang::ast::ExpressionKind::LOGICAL:
+                        nodes.push_back(static_cast<lang::ast::LogicalExpression*>(expression)->left);
+                        nodes.push_back(static_cast<lang::ast::LogicalExpression*>(expression)->right);
+                        break;
+
+                    case lang::ast::ExpressionKind::CALL:
+                    {
+                        lang::ast::CallExpression* call = static_cast<lang::ast::CallExpression*>(expression);
+                        nodes.push_back(call->callee);
+                        nodes.insert(nodes.end(), call->arguments.begin(), call->arguments.end());
+                        break;
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        /* The compare-and-branch instruction of a comparison, OPCODE_COUNT for the other operators */
+        OpCode jump_unless(lang::TokenType op)
+        {
+            switch(op)
+            {
+                case lang::TokenType::EQUAL_EQUAL: return OpCode::JUMP_UNLESS_EQUAL;
+                case lang::TokenType::BANG_EQUAL: return OpCode::JUMP_UNLESS_NOT_EQUAL;
+                case lang::TokenType::LESS: return OpCode::JUMP_UNLESS_LESS;
+                case lang::TokenType::LESS_EQUAL: return OpCode::JUMP_UNLESS_LESS_EQUAL;
+                case lang::TokenType::GREATER: return OpCode::JUMP_UNLESS_GREATER;
+                case lang::TokenType::GREATER_EQUAL: return OpCode::JUMP_UNLESS_GREATER_EQUAL;
+                default: return OpCode::OPCODE_COUNT;
+            }
+        }
+
+        OpCode binary_opcode(lang::TokenType op)
+        {
+            switch(op)
+            {
+                case lang::TokenType::PLUS: return OpCode::ADD;
+                case lang::TokenType::MINUS: return OpCode::SUBTRACT;
+                case lang::TokenType::STAR: return OpCode::MULTIPLY;
+                case lang::TokenType::SLASH: return OpCode::DIVIDE;
+                case lang::TokenType::EQUAL_EQUAL: return OpCode::EQUAL;
+                case lang::TokenType::BANG_EQUAL: return OpCode::NOT_EQUAL;
+                case lang::TokenType::LESS: return OpCode::LESS;
+                case lang::TokenType::LESS_EQUAL: return OpCode::LESS_EQUAL;
+                case lang::TokenType::GREATER: return OpCode::GREATER;
+                default: return OpCode::GREATER_EQUAL;
+            }
+        }
+
+        /* Indexed by the argument count */
+        constexpr OpCode CALL_OPCODES[] = {OpCode::CALL_0, OpCode::CALL_1, OpCode::CALL_2, OpCode::CALL_3};
+    }
+
+    void BytecodeCompiler::set_function_body_loader(FunctionBodyLoader loader)
+    {
+        m_function_body_loader = std::move(loader);
+    }
+
+    std::vector<std::string> BytecodeCompiler::compile(const std::vector<lang::ast::Statement*>& statements, std::uint32_t global_count, std::uint32_t top_level_frame_size)
+    {
+        m_module = lang::vm::Module();
+        m_module.global_count = global_count;
+        m_string_values.clear();
+        m_errors.clear();
+
+        m_module.prototypes.push_back(std::make_unique<lang::vm::Prototype>());
+        lang::vm::Prototype* main = m_module.prototypes.back().get();
+        main->name = "script";
+        main->arity = 0;
+        main->register_count = top_level_frame_size;
+
+        m_functions.push_back(FunctionContext{main, 0, std::vector<bool>(top_level_frame_size, false), top_level_frame_size, {}});
+
+        for(std::size_t i = statements.size(); i > 0; i--)
+        {
+            this->push(statements[i - 1]);
+        }
+        this->run();
+
+        this->emit(OpCode::RETURN_NIL);
+        m_functions.clear();
+
+        return std::move(m_errors);
+    }
+
+    lang::vm::Module BytecodeCompiler::take_module()
+    {
+        return std::move(m_module);
+    }
+
+    bool BytecodeCompiler::load_function_body(lang::ast::FunctionStatement* function)
+    {
+        if(function->is_body_parsed)
+        {
+            return true;
+        }
+
+        if(!m_function_body_loader)
+        {
+            m_errors.push_back("[line " + std::to_string(function->name.m_line) + "] Error at '" + std::string{function->name.m_lexeme} + "': Function body was not parsed\n");
+            return false;
+        }
+
+        std::vector<std::string> body_errors = m_function_body_loader(function);
+        m_errors.insert(m_errors.end(), std::make_move_iterator(body_errors.begin()), std::make_move_iterator(body_errors.end()));
+
+        return body_errors.empty();
+    }
+
+    /**********************************************************************************************************************8*/
+    void BytecodeCompiler::run()
+    {
+        while(!m_work.empty())
+        {
+            Work work = m_work.back();
+            m_work.pop_back();
+
+            switch(work.kind)
+            {
+                case Work::Kind::STATEMENT:
+                    this->compile_statement(work.statement);
+                    break;
+
+                case Work::Kind::EXPRESSION:
+                    this->compile_expression(work.expression);
+                    break;
+
+                case Work::Kind::DISCARD:
+                    this->release(this->pop_value());
+                    break;
+
+                case Work::Kind::PRINT:
+                {
+                    Operand value = this->pop_value();
+                    this->emit(OpCode::PRINT, value.reg);
+                    this->release(value);
+                    break;
+                }
+
+                case Work::Kind::DEFINE_VAR:
+                {
+                    lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(work.statement);
+
+                    /* Without an initializer the variable is nil */
+                    if(var->initializer == nullptr)
+                    {
+                        std::uint32_t nil = this->allocate_register();
+                        this->emit_result(OpCode::LOAD_CONSTANT, nil, this->constant_index(lang::runtime::NIL_DOUBLE));
+                        m_values.push_back(Operand{nil, true});
+                    }
+
+                    Operand value = this->pop_value();
+
+                    if(var->binding.is_global())
+                    {
+                        this->emit(OpCode::SET_GLOBAL, value.reg, var->binding.slot);
+                    }
+                    else if(var->captured)
+                    {
+                        this->declare_local(var->binding.slot, true);
+                        this->emit(OpCode::NEW_BOX, var->binding.slot, value.reg);
+                    }
+                    else
+                    {
+                        this->declare_local(var->binding.slot, false);
+                        this->store_to(var->binding.slot, value);
+                    }
+
+                    this->release(value);
+                    break;
+                }
+
+                case Work::Kind::IF_BRANCH:
+                {
+                    lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(work.statement);
+                    std::size_t jump = this->emit_condition_jump(static_cast<lang::ast::BinaryExpression*>(work.expression));
+
+                    this->push(Work::Kind::IF_ELSE, if_statement, nullptr, jump);
+                    this->push(if_statement->thenBranch);
+                    break;
+                }
+
+                case Work::Kind::IF_ELSE:
+                {
+                    lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(work.statement);
+
+                    if(if_statement->elseBranch == nullptr)
+                    {
+                        this->patch_jump(work.first);
+                        break;
+                    }
+
+                    std::size_t end_jump = this->emit(OpCode::JUMP);
+                    this->patch_jump(work.first);
+
+                    this->push(Work::Kind::IF_END, nullptr, nullptr, end_jump);
+                    this->push(if_statement->elseBranch);
+                    break;
+                }
+
+                case Work::Kind::IF_END:
+                    this->patch_jump(work.first);
+                    break;
+
+                case Work::Kind::WHILE_BODY:
+                {
+                    lang::ast::WhileStatement* while_statement = static_cast<lang::ast::WhileStatement*>(work.statement);
+                    std::size_t exit_jump = this->emit_condition_jump(static_cast<lang::ast::BinaryExpression*>(work.expression));
+
+                    this->push(Work::Kind::WHILE_END, while_statement, nullptr, work.first, exit_jump);
+                    this->push(while_statement->body_stmt);
+                    break;
+                }
+
+                case Work::Kind::WHILE_END:
+                    this->emit_jump_back(work.first);
+                    this->patch_jump(work.second);
+                    break;
+
+                case Work::Kind::FUNCTION_END:
+                    this->end_function(static_cast<lang::ast::FunctionStatement*>(work.statement), static_cast<std::uint32_t>(work.first));
+                    break;
+
+                case Work::Kind::RETURN:
+                {
+                    Operand value = this->pop_value();
+                    this->emit(OpCode::RETURN, value.reg);
+                    this->release(value);
+                    break;
+                }
+
+                case Work::Kind::UNARY:
+                {
+                    lang::ast::UnaryExpression* unary = static_cast<lang::ast::UnaryExpression*>(work.expression);
+                    Operand operand = this->pop_value();
+                    this->release(operand);
+
+                    std::uint32_t result = this->allocate_register();
+                    OpCode op = unary->op.m_type == lang::TokenType::MINUS ? OpCode::NEGATE : OpCode::NOT;
+
+                    this->emit_result(op, result, operand.reg, 0, unary->op.m_line);
+                    m_values.push_back(Operand{result, true});
+                    break;
+                }
+
+                case Work::Kind::BINARY:
+                    this->compile_binary(static_cast<lang::ast::BinaryExpression*>(work.expression));
+                    break;
+
+                case Work::Kind::ASSIGN:
+                    this->compile_assignment(static_cast<lang::ast::AssignmentExpression*>(work.expression));
+                    break;
+
+                case Work::Kind::LOGICAL_RIGHT:
+                {
+                    lang::ast::LogicalExpression* logical = static_cast<lang::ast::LogicalExpression*>(work.expression);
+                    Operand left = this->pop_value();
+
+                    /* Both sides end up in the same register, the left one's if it is a temporary already */
+                    std::uint32_t result = left.reg;
+
+                    if(!left.temporary)
+                    {
+                        result = this->allocate_register();
+                        this->emit_result(OpCode::MOVE, result, left.reg);
+                    }
+
+                    /* 'or' keeps a truthy left side, 'and' a falsy one */
+                    OpCode op = logical->op.m_type == lang::TokenType::OR ? OpCode::JUMP_IF_TRUE : OpCode::JUMP_IF_FALSE;
+                    std::size_t jump = this->emit(op, result);
+
+                    this->push(Work::Kind::LOGICAL_END, nullptr, logical, result, jump);
+                    this->push(logical->right);
+                    break;
+                }
+
+                case Work::Kind::LOGICAL_END:
+                {
+                    std::uint32_t result = static_cast<std::uint32_t>(work.first);
+                    Operand right = this->pop_value();
+
+                    this->store_to(result, right);
+                    this->release(right);
+                    this->patch_jump(work.second);
+
+                    m_values.push_back(Operand{result, true});
+                    break;
+                }
+
+                case Work::Kind::CALL_ARGUMENT:
+                {
+                    /* The callee and the arguments take consecutive temporaries */
+                    Operand value = this->pop_value();
+
+                    if(!value.temporary)
+                    {
+                        std::uint32_t copy = this->allocate_register();
+                        this->emit_result(OpCode::MOVE, copy, value.reg);
+                        value = Operand{copy, true};
+                    }
+
+                    m_values.push_back(value);
+                    break;
+                }
+
+                case Work::Kind::CALL:
+                    this->compile_call(static_cast<lang::ast::CallExpression*>(work.expression));
+                    break;
+            }
+        }
+    }
+
+    void BytecodeCompiler::compile_statement(lang::ast::Statement* statement)
+    {
+        switch(statement->kind)
+        {
+            case lang::ast::StatementKind::EXPRESSION:
+                this->push(Work::Kind::DISCARD, statement, nullptr);
+                this->push_root(static_cast<lang::ast::ExpressionStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::PRINT:
+                this->push(Work::Kind::PRINT, statement, nullptr);
+                this->push_root(static_cast<lang::ast::PrintStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::VAR:
+            {
+                lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(statement);
+                this->push(Work::Kind::DEFINE_VAR, var, nullptr);
+
+                if(var->initializer != nullptr)
+                {
+                    this->push_root(var->initializer);
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::BLOCK:
+            {
+                lang::ast::BlockStatement* block = static_cast<lang::ast::BlockStatement*>(statement);
+
+                for(std::size_t i = block->statements.size(); i > 0; i--)
+                {
+                    this->push(block->statements[i - 1]);
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::IF:
+            {
+                lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(statement);
+
+                /* The branch is pushed before the condition it waits for, and told afterwards whether it is a comparison */
+                std::size_t branch = m_work.size();
+                this->push(Work::Kind::IF_BRANCH, if_statement, nullptr);
+                m_work[branch].expression = this->push_condition(if_statement->condition);
+                break;
+            }
+
+            case lang::ast::StatementKind::WHILE:
+            {
+                lang::ast::WhileStatement* while_statement = static_cast<lang::ast::WhileStatement*>(statement);
+
+                /* The condition is the start of the loop, something jumps to it */
+                m_last_result = NO_INSTRUCTION;
+
+                std::size_t body = m_work.size();
+                this->push(Work::Kind::WHILE_BODY, while_statement, nullptr, m_functions.back().prototype->code.size());
+                m_work[body].expression = this->push_condition(while_statement->condition_expr);
+                break;
+            }
+
+            case lang::ast::StatementKind::FUNCTION:
+                this->begin_function(static_cast<lang::ast::FunctionStatement*>(statement));
+                break;
+
+            case lang::ast::StatementKind::RETURN:
+            {
+                lang::ast::ReturnStatement* return_statement = static_cast<lang::ast::ReturnStatement*>(statement);
+
+                if(return_statement->expr == nullptr)
+                {
+                    this->emit(OpCode::RETURN_NIL);
+                    break;
+                }
+
+                this->push(Work::Kind::RETURN, return_statement, nullptr);
+                this->push_root(return_statement->expr);
+                break;
+            }
+        }
+    }
+
+    void BytecodeCompiler::compile_expression(lang::ast::Expression* expression)
+    {
+        switch(expression->kind)
+        {
+            case lang::ast::ExpressionKind::LITERAL:
+            {
+                lang::ast::LiteralExpression* literal = static_cast<lang::ast::LiteralExpression*>(expression);
+                double value = lang::runtime::NIL_DOUBLE;
+
+                switch(literal->type)
+                {
+                    case lang::ast::LiteralExpression::Type::NIL: break;
+                    case lang::ast::LiteralExpression::Type::BOOLEAN: value = lang::runtime::boolean_value(literal->boolean); break;
+                    case lang::ast::LiteralExpression::Type::NUMBER: value = literal->number; break;
+                    case lang::ast::LiteralExpression::Type::STRING: value = this->make_string(literal->string); break;
+                }
+
+                std::uint32_t result = this->allocate_register();
+                this->emit_result(OpCode::LOAD_CONSTANT, result, this->constant_index(value));
+                m_values.push_back(Operand{result, true});
+                break;
+            }
+
+            case lang::ast::ExpressionKind::VARIABLE:
+                m_values.push_back(this->read_variable(static_cast<lang::ast::VariableExpression*>(expression)->binding));
+                break;
+
+            case lang::ast::ExpressionKind::ASSIGNMENT:
+                this->push(Work::Kind::ASSIGN, nullptr, expression);
+                this->push(static_cast<lang::ast::AssignmentExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::GROUPING:
+                this->push(static_cast<lang::ast::GroupingExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::UNARY:
+                this->push(Work::Kind::UNARY, nullptr, expression);
+                this->push(static_cast<lang::ast::UnaryExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::BINARY:
+            {
+                lang::ast::BinaryExpression* binary = static_cast<lang::ast::BinaryExpression*>(expression);
+                this->push(Work::Kind::BINARY, nullptr, binary);
+                this->push(binary->right);
+                this->push(binary->left);
+                break;
+            }
+
+            case lang::ast::ExpressionKind::LOGICAL:
+            {
+                lang::ast::LogicalExpression* logical = static_cast<lang::ast::LogicalExpression*>(expression);
+                this->push(Work::Kind::LOGICAL_RIGHT, nullptr, logical);
+                this->push(logical->left);
+                break;
+            }
+
+            case lang::ast::ExpressionKind::CALL:
+            {
+                lang::ast::CallExpression* call = static_cast<lang::ast::CallExpression*>(expression);
+                this->push(Work::Kind::CALL, nullptr, call);
+
+                for(std::size_t i = call->arguments.size(); i > 0; i--)
+                {
+                    this->push(Work::Kind::CALL_ARGUMENT, nullptr, nullptr);
+                    this->push(call->arguments[i - 1]);
+                }
+
+                this->push(Work::Kind::CALL_ARGUMENT, nullptr, nullptr);
+                this->push(call->callee);
+                break;
+            }
+        }
+    }
+
+    void BytecodeCompiler::push(lang::ast::Statement* statement)
+    {
+        this->push(Work::Kind::STATEMENT, statement, nullptr);
+    }
+
+    void BytecodeCompiler::push(lang::ast::Expression* expression)
+    {
+        this->push(Work::Kind::EXPRESSION, nullptr, expression);
+    }
+
+    void BytecodeCompiler::push(Work::Kind kind, lang::ast::Statement* statement, lang::ast::Expression* expression, std::size_t first, std::size_t second)
+    {
+        m_work.push_back(Work{kind, statement, expression, first, second});
+    }
+
+    void BytecodeCompiler::push_root(lang::ast::Expression* expression)
+    {
+        m_copy_locals = assigns_inside(expression);
+        this->push(expression);
+    }
+
+    lang::ast::BinaryExpression* BytecodeCompiler::push_condition(lang::ast::Expression* condition)
+    {
+        lang::ast::Expression* unwrapped = condition;
+
+        while(lang::ast::GroupingExpression* grouping = lang::ast::as<lang::ast::GroupingExpression>(unwrapped))
+        {
+            unwrapped = grouping->expr;
+        }
+
+        lang::ast::BinaryExpression* comparison = lang::ast::as<lang::ast::BinaryExpression>(unwrapped);
+
+        if(comparison == nullptr || jump_unless(comparison->op.m_type) == OpCode::OPCODE_COUNT)
+        {
+            this->push_root(condition);
+            return nullptr;
+        }
+
+        /* Both operands are left for the branch, the comparison itself is never computed */
+        m_copy_locals = assigns_inside(comparison);
+        this->push(comparison->right);
+        this->push(comparison->left);
+
+        return comparison;
+    }
+
+    std::size_t BytecodeCompiler::emit_condition_jump(lang::ast::BinaryExpression* comparison)
+    {
+        if(comparison == nullptr)
+        {
+            Operand condition = this->pop_value();
+            this->release(condition);
+
+            return this->emit(OpCode::JUMP_IF_FALSE, condition.reg);
+        }
+
+        Operand right = this->pop_value();
+        Operand left = this->pop_value();
+        this->release(right);
+        this->release(left);
+
+        return this->emit(jump_unless(comparison->op.m_type), left.reg, right.reg, 0, comparison->op.m_line);
+    }
+
+    BytecodeCompiler::Operand BytecodeCompiler::pop_value()
+    {
+        Operand value = m_values.back();
+        m_values.pop_back();
+
+        return value;
+    }
+
+    /**********************************************************************************************************************8*/
+    void BytecodeCompiler::begin_function(lang::ast::FunctionStatement* function)
+    {
+        /* The name is in scope in the body, a nested function calling itself captures its own variable */
+        if(!function->binding.is_global())
+        {
+            this->declare_local(function->binding.slot, function->captured);
+
+            if(function->captured)
+            {
+                std::uint32_t nil = this->allocate_register();
+                this->emit(OpCode::LOAD_CONSTANT, nil, this->constant_index(lang::runtime::NIL_DOUBLE));
+                this->emit(OpCode::NEW_BOX, function->binding.slot, nil);
+                this->release(Operand{nil, true});
+            }
+        }
+
+        if(!this->load_function_body(function))
+        {
+            return;
+        }
+
+        std::uint32_t prototype_index = static_cast<std::uint32_t>(m_module.prototypes.size());
+        m_module.prototypes.push_back(std::make_unique<lang::vm::Prototype>());
+
+        lang::vm::Prototype* prototype = m_module.prototypes.back().get();
+        prototype->name = std::string{function->name.m_lexeme};
+        prototype->arity = static_cast<std::uint32_t>(function->params.size());
+        prototype->register_count = function->frame_size;
+
+        m_functions.push_back(FunctionContext{prototype, prototype_index, std::vector<bool>(function->frame_size, false), function->frame_size, {}});
+        m_last_result = NO_INSTRUCTION;
+
+        /* Parameters take the first slots, a captured one moves into a box of its own */
+        for(std::size_t i = 0; i < function->params.size(); i++)
+        {
+            bool captured = i < function->captured_params.size() && function->captured_params[i];
+            std::uint32_t slot = static_cast<std::uint32_t>(i);
+
+            this->declare_local(slot, captured);
+
+            if(captured)
+            {
+                this->emit(OpCode::NEW_BOX, slot, slot);
+            }
+        }
+
+        this->push(Work::Kind::FUNCTION_END, function, nullptr, prototype_index);
+        for(std::size_t i = function->body_stmts.size(); i > 0; i--)
+        {
+            this->push(function->body_stmts[i - 1]);
+        }
+    }
+
+    void BytecodeCompiler::end_function(lang::ast::FunctionStatement* function, std::uint32_t prototype_index)
+    {
+        /* Falling off the end returns nil */
+        this->emit(OpCode::RETURN_NIL);
+
+        m_functions.pop_back();
+        m_last_result = NO_INSTRUCTION;
+
+        if(!function->binding.is_global() && !function->captured)
+        {
+            this->emit(OpCode::CLOSURE, function->binding.slot, prototype_index);
+            return;
+        }
+
+        std::uint32_t closure = this->allocate_register();
+        this->emit(OpCode::CLOSURE, closure, prototype_index);
+
+        if(function->binding.is_global())
+        {
+            this->emit(OpCode::SET_GLOBAL, closure, function->binding.slot);
+        }
+        else
+        {
+            this->emit(OpCode::SET_BOX, function->binding.slot, closure);
+        }
+
+        this->release(Operand{closure, true});
+    }
+
+    void BytecodeCompiler::compile_binary(lang::ast::BinaryExpression* expression)
+    {
+        Operand right = this->pop_value();
+        Operand left = this->pop_value();
+        this->release(right);
+        this->release(left);
+
+        /* The result may reuse an operand's register, the VM reads both operands first */
+        std::uint32_t result = this->allocate_register();
+        this->emit_result(binary_opcode(expression->op.m_type), result, left.reg, static_cast<std::int32_t>(right.reg), expression->op.m_line);
+
+        m_values.push_back(Operand{result, true});
+    }
+
+    void BytecodeCompiler::compile_call(lang::ast::CallExpression* expression)
+    {
+        std::size_t argument_count = expression->arguments.size();
+
+        /* The callee and its arguments, in consecutive temporaries */
+        Operand callee = m_values[m_values.size() - argument_count - 1];
+        m_values.resize(m_values.size() - argument_count - 1);
+        m_functions.back().next_register = callee.reg;
+
+        int line = expression->closing_paren.m_line;
+
+        if(argument_count < std::size(CALL_OPCODES))
+        {
+            this->emit(CALL_OPCODES[argument_count], callee.reg, 0, 0, line);
+        }
+        else
+        {
+            this->emit(OpCode::CALL, callee.reg, static_cast<std::uint32_t>(argument_count), 0, line);
+        }
+
+        /* The result replaces the callee */
+        m_values.push_back(Operand{this->allocate_register(), true});
+    }
+
+    void BytecodeCompiler::compile_assignment(lang::ast::AssignmentExpression* expression)
+    {
+        const lang::ast::Binding& binding = expression->binding;
+        Operand value = this->pop_value();
+
+        if(binding.is_global())
+        {
+            this->emit(OpCode::SET_GLOBAL, value.reg, binding.slot);
+        }
+        else if(binding.depth != 0)
+        {
+            this->emit(OpCode::SET_UPVALUE, value.reg, this->upvalue_index(m_functions.size() - 1, m_functions.size() - 1 - binding.depth, binding.slot));
+        }
+        else if(m_functions.back().boxed_slots[binding.slot])
+        {
+            this->emit(OpCode::SET_BOX, binding.slot, value.reg);
+        }
+        else
+        {
+            this->store_to(binding.slot, value);
+            this->release(value);
+
+            m_values.push_back(this->local_result(binding.slot));
+            return;
+        }
+
+        /* The value assigned is the value of the assignment */
+        m_values.push_back(value);
+    }
+
+    BytecodeCompiler::Operand BytecodeCompiler::read_variable(const lang::ast::Binding& binding)
+    {
+        if(!binding.is_global() && binding.depth == 0 && !m_functions.back().boxed_slots[binding.slot])
+        {
+            return this->local_result(binding.slot);
+        }
+
+        std::uint32_t result = this->allocate_register();
+
+        if(binding.is_global())
+        {
+            this->emit_result(OpCode::GET_GLOBAL, result, binding.slot);
+        }
+        else if(binding.depth == 0)
+        {
+            this->emit_result(OpCode::GET_BOX, result, binding.slot);
+        }
+        else
+        {
+            this->emit_result(OpCode::GET_UPVALUE, result, this->upvalue_index(m_functions.size() - 1, m_functions.size() - 1 - binding.depth, binding.slot));
+        }
+
+        return Operand{result, true};
+    }
+
+    BytecodeCompiler::Operand BytecodeCompiler::local_result(std::uint32_t slot)
+    {
+        if(!m_copy_locals)
+        {
+            return Operand{slot, false};
+        }
+
+        std::uint32_t copy = this->allocate_register();
+        this->emit_result(OpCode::MOVE, copy, slot);
+
+        return Operand{copy, true};
+    }
+
+    std::uint32_t BytecodeCompiler::upvalue_index(std::size_t level, std::size_t target_level, std::uint32_t slot)
+    {
+        /* Every function between the declaration and the use passes the box on, each through an upvalue of its own */
+        std::uint32_t index = 0;
+
+        for(std::size_t current = target_level + 1; current <= level; current++)
+        {
+            lang::vm::UpvalueSource source = current == target_level + 1 ? lang::vm::UpvalueSource{true, slot} : lang::vm::UpvalueSource{false, index};
+            std::vector<lang::vm::UpvalueSource>& upvalues = m_functions[current].prototype->upvalues;
+
+            auto position = std::find_if(upvalues.begin(), upvalues.end(), [&source](const lang::vm::UpvalueSource& existing)
+            {
+                return existing.is_local == source.is_local && existing.index == source.index;
+            });
+
+            if(position == upvalues.end())
+            {
+                position = upvalues.insert(upvalues.end(), source);
+            }
+
+            index = static_cast<std::uint32_t>(position - upvalues.begin());
+        }
+
+        return index;
+    }
+
+    void BytecodeCompiler::declare_local(std::uint32_t slot, bool captured)
+    {
+        m_functions.back().boxed_slots[slot] = captured;
+    }
+
+    /**********************************************************************************************************************8*/
+    std::uint32_t BytecodeCompiler::allocate_register()
+    {
+        FunctionContext& context = m_functions.back();
+        std::uint32_t reg = context.next_register++;
+
+        context.prototype->register_count = std::max(context.prototype->register_count, context.next_register);
+
+        return reg;
+    }
+
+    void BytecodeCompiler::release(Operand operand)
+    {
+        /* Temporaries are released in the reverse order of their allocation */
+        if(operand.temporary)
+        {
+            m_functions.back().next_register = operand.reg;
+        }
+    }
+
+    void BytecodeCompiler::store_to(std::uint32_t target, Operand value)
+    {
+        if(value.reg == target)
+        {
+            return;
+        }
+
+        std::vector<lang::vm::Instruction>& code = m_functions.back().prototype->code;
+
+        if(value.temporary && m_last_result == code.size() - 1 && code.back().a == value.reg)
+        {
+            code.back().a = target;
+            m_last_result = NO_INSTRUCTION;
+            return;
+        }
+
+        this->emit(OpCode::MOVE, target, value.reg);
+    }
+
+    std::uint32_t BytecodeCompiler::constant_index(double value)
+    {
+        FunctionContext& context = m_functions.back();
+        auto [position, inserted] = context.constant_indices.try_emplace(lang::runtime::bits_of(value), static_cast<std::uint32_t>(context.prototype->constants.size()));
+
+        if(inserted)
+        {
+            context.prototype->constants.push_back(value);
+        }
+
+        return position->second;
+    }
+
+    double BytecodeCompiler::make_string(std::string_view string)
+    {
+        auto position = m_string_values.find(string);
+
+        if(position != m_string_values.end())
+        {
+            return position->second;
+        }
+
+        const std::string& characters = m_module.characters.emplace_back(string);
+        m_module.strings.push_back(lang::runtime::String{lang::runtime::STRING_OBJECT, static_cast<std::int64_t>(characters.size()), characters.c_str()});
+
+        double value = lang::runtime::box_object(&m_module.strings.back());
+        m_string_values.emplace(std::string_view{characters}, value);
+
+        return value;
+    }
+
+    std::size_t BytecodeCompiler::emit(OpCode op, std::uint32_t a, std::uint32_t b, std::int32_t c, int line)
+    {
+        lang::vm::Prototype* prototype = m_functions.back().prototype;
+
+        prototype->code.push_back(lang::vm::Instruction{nullptr, op, a, b, c});
+        prototype->lines.push_back(line);
+        m_last_result = NO_INSTRUCTION;
+
+        return prototype->code.size() - 1;
+    }
+
+    std::size_t BytecodeCompiler::emit_result(OpCode op, std::uint32_t a, std::uint32_t b, std::int32_t c, int line)
+    {
+        m_last_result = this->emit(op, a, b, c, line);
+        return m_last_result;
+    }
+
+    void BytecodeCompiler::patch_jump(std::size_t index)
+    {
+        std::vector<lang::vm::Instruction>& code = m_functions.back().prototype->code;
+        code[index].c = static_cast<std::int32_t>(code.size() - (index + 1));
+
+        /* The next instruction is a jump target, what comes before it may not be retargeted */
+        m_last_result = NO_INSTRUCTION;
+    }
+
+    void BytecodeCompiler::emit_jump_back(std::size_t target)
+    {
+        std::size_t index = m_functions.back().prototype->code.size();
+        this->emit(OpCode::JUMP, 0, 0, static_cast<std::int32_t>(target) - static_cast<std::int32_t>(index + 1));
+    }
+}
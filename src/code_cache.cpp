@@ -0,0 +1,185 @@
+#include <cache/code_cache.hpp>
+#include <cache/ast_cache.hpp>
+#include <lang/build_id.hpp>
+
+#include "llvm/Support/Host.h"
+#include "llvm/Support/SHA256.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+namespace lang
+{
+    namespace
+    {
+        constexpr char MAGIC[4] = {'L', 'C', 'O', 'D'};
+
+        /*
+            The key only selects the file, the source is identified by its SHA-256 as well, so sources whose keys collide,
+            by chance or on purpose, never run each other's code
+        */
+        struct Header
+        {
+            char magic[4];
+            std::uint32_t reserved;
+            std::uint64_t key;
+            std::uint64_t source_size;
+            CodeCache::SourceDigest source_digest;
+            std::uint64_t code_size;
+            std::uint64_t code_hash; /* A damaged entry is a miss */
+        };
+    }
+
+    CodeCache::CodeCache(std::string directory)
+        : m_directory(std::move(directory))
+    {}
+
+    std::uint64_t CodeCache::hash_key(std::string_view source, std::string_view configuration)
+    {
+        /* The compiler itself is part of the configuration, a rebuilt one never runs the code of the previous build */
+        std::string full_configuration = std::string{configuration} + " " + std::string{lang::BUILD_ID};
+
+        /* Two independent hashes combined, hashing the concatenation would copy the source */
+        std::uint64_t configuration_hash = lang::AstCache::hash_source(full_configuration);
+
+        return (lang::AstCache::hash_source(source) ^ configuration_hash) * 0x9E3779B97F4A7C15ull + configuration_hash;
+    }
+
+    std::string CodeCache::host_configuration()
+    {
+        return llvm::sys::getProcessTriple() + " " + llvm::sys::getHostCPUName().str();
+    }
+
+    CodeCache::SourceDigest CodeCache::digest_source(std::string_view source)
+    {
+        return llvm::SHA256::hash(llvm::ArrayRef<std::uint8_t>(reinterpret_cast<const std::uint8_t*>(source.data()), source.size()));
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> CodeCache::load(std::uint64_t key, std::string_view source, Kind kind)
+    {
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> entry = llvm::MemoryBuffer::getFile(this->entry_path(key, kind), /* is_text */ false, /* null_terminated */ false);
+
+        if(!entry)
+        {
+            m_statistics.misses++;
+            return nullptr;
+        }
+
+        llvm::StringRef bytes = (*entry)->getBuffer();
+
+        Header header;
+        bool valid = bytes.size() >= sizeof(Header);
+
+        if(valid)
+        {
+            std::memcpy(&header, bytes.data(), sizeof(Header));
+
+            valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                && header.key == key
+                && header.source_size == source.size()
+                && header.code_size == bytes.size() - sizeof(Header)
+                && header.source_digest == digest_source(source);
+        }
+
+        llvm::StringRef code = valid ? bytes.substr(sizeof(Header)) : llvm::StringRef{};
+
+        if(!valid || lang::AstCache::hash_source({code.data(), code.size()}) != header.code_hash)
+        {
+            m_statistics.misses++;
+            return nullptr;
+        }
+
+        m_statistics.hits++;
+        m_statistics.bytes_read += bytes.size();
+
+        /* A copy, the code has to be aligned for the bitcode reader and the object file loader */
+        return llvm::MemoryBuffer::getMemBufferCopy(code, (*entry)->getBufferIdentifier());
+    }
+
+    bool CodeCache::store(std::uint64_t key, std::string_view source, Kind kind, llvm::StringRef code)
+    {
+        return this->store(key, source.size(), digest_source(source), kind, code);
+    }
+
+    bool CodeCache::store(std::uint64_t key, std::size_t source_size, const SourceDigest& source_digest, Kind kind, llvm::StringRef code)
+    {
+        Header header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.reserved = 0;
+        header.key = key;
+        header.source_size = source_size;
+        header.source_digest = source_digest;
+        header.code_size = code.size();
+        header.code_hash = lang::AstCache::hash_source({code.data(), code.size()});
+
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+        if(error)
+        {
+            return false;
+        }
+
+        /* Written next to the entry and renamed over it, so a concurrent load never reads a half written file */
+        std::string path = this->entry_path(key, kind);
+        std::string temporary_path = path + "." + std::to_string(::getpid()) + ".tmp";
+
+        {
+            std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            out.write(code.data(), code.size());
+
+            if(!out.flush())
+            {
+                std::filesystem::remove(temporary_path, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary_path, path, error);
+        if(error)
+        {
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+
+        m_statistics.stores++;
+        m_statistics.bytes_written += sizeof(Header) + code.size();
+
+        return true;
+    }
+
+    void CodeCache::select_object_entry(std::uint64_t key, std::string_view source)
+    {
+        m_object_key = key;
+        m_object_source_size = source.size();
+        m_object_source_digest = digest_source(source);
+    }
+
+    void CodeCache::notifyObjectCompiled(const llvm::Module* /* module */, llvm::MemoryBufferRef object)
+    {
+        this->store(m_object_key, m_object_source_size, m_object_source_digest, Kind::OBJECT, object.getBuffer());
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> CodeCache::getObject(const llvm::Module* /* module */)
+    {
+        return nullptr;
+    }
+
+    const CodeCache::Statistics& CodeCache::statistics() const
+    {
+        return m_statistics;
+    }
+
+    std::string CodeCache::entry_path(std::uint64_t key, Kind kind) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.%s", static_cast<unsigned long long>(key), kind == Kind::BITCODE ? "bc" : "o");
+
+        return (std::filesystem::path(m_directory) / name).string();
+    }
+}
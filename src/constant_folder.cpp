@@ -0,0 +1,456 @@
+#include <optimizer/constant_folder.hpp>
+
+namespace lang
+{
+    void ConstantFolder::fold(std::vector<lang::ast::Statement*>& statements, lang::ast::Arena& arena)
+    {
+        m_arena = &arena;
+
+        for(lang::ast::Statement*& statement: statements)
+        {
+            this->schedule(&statement, true);
+        }
+
+        this->run();
+
+        /* A return at the top level is an error of the Resolver, so nothing after it is dropped here */
+        statements.resize(this->compact(statements.data(), statements.size(), false));
+    }
+
+    lang::ast::Statement* ConstantFolder::fold_declaration(lang::ast::Statement* statement, lang::ast::Arena& arena)
+    {
+        m_arena = &arena;
+
+        this->schedule(&statement, true);
+        this->run();
+
+        return statement;
+    }
+
+    void ConstantFolder::fold_function_body(lang::ast::FunctionStatement* function, lang::ast::Arena& arena)
+    {
+        m_arena = &arena;
+
+        this->schedule_children(function);
+        this->run();
+
+        function->body_stmts.m_size = static_cast<std::uint32_t>(this->compact(function->body_stmts.begin(), function->body_stmts.size(), true));
+    }
+
+    const ConstantFolder::Statistics& ConstantFolder::statistics() const
+    {
+        return m_statistics;
+    }
+
+    void ConstantFolder::run()
+    {
+        while(!m_work.empty())
+        {
+            Work work = m_work.back();
+            m_work.pop_back();
+
+            /* The node goes back below its children and is folded once they are */
+            if(!work.children_folded)
+            {
+                work.children_folded = true;
+                m_work.push_back(work);
+
+                if(work.statement != nullptr)
+                {
+                    this->schedule_children(*work.statement);
+                }
+                else
+                {
+                    this->schedule_children(*work.expression);
+                }
+
+                continue;
+            }
+
+            if(work.expression != nullptr)
+            {
+                *work.expression = this->visit_expression(*work.expression);
+                continue;
+            }
+
+            lang::ast::Statement* folded = this->visit_statement(*work.statement);
+
+            if(folded == nullptr && !work.in_list)
+            {
+                folded = m_arena->make<lang::ast::BlockStatement>(lang::ast::List<lang::ast::Statement*>{});
+            }
+
+            *work.statement = folded;
+        }
+    }
+
+    void ConstantFolder::schedule(lang::ast::Statement** statement, bool in_list)
+    {
+        if(*statement != nullptr)
+        {
+            m_work.push_back(Work{statement, nullptr, in_list, false});
+        }
+    }
+
+    void ConstantFolder::schedule(lang::ast::Expression** expression)
+    {
+        if(*expression != nullptr)
+        {
+            m_work.push_back(Work{nullptr, expression, false, false});
+        }
+    }
+
+    void ConstantFolder::schedule_children(lang::ast::Statement* statement)
+    {
+        switch(statement->kind)
+        {
+            case lang::ast::StatementKind::EXPRESSION:
+                this->schedule(&static_cast<lang::ast::ExpressionStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::PRINT:
+                this->schedule(&static_cast<lang::ast::PrintStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::VAR:
+                this->schedule(&static_cast<lang::ast::VarStatement*>(statement)->initializer);
+                break;
+
+            case lang::ast::StatementKind::BLOCK:
+                for(lang::ast::Statement*& child: static_cast<lang::ast::BlockStatement*>(statement)->statements)
+                {
+                    this->schedule(&child, true);
+                }
+                break;
+
+            case lang::ast::StatementKind::IF:
+            {
+                lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(statement);
+
+                this->schedule(&if_statement->condition);
+                this->schedule(&if_statement->thenBranch, false);
+                this->schedule(&if_statement->elseBranch, false);
+                break;
+            }
+
+            case lang::ast::StatementKind::WHILE:
+            {
+                lang::ast::WhileStatement* while_statement = static_cast<lang::ast::WhileStatement*>(statement);
+
+                this->schedule(&while_statement->condition_expr);
+                this->schedule(&while_statement->body_stmt, false);
+                break;
+            }
+
+            case lang::ast::StatementKind::FUNCTION:
+            {
+                lang::ast::FunctionStatement* function = static_cast<lang::ast::FunctionStatement*>(statement);
+
+                /* A skipped body is folded by fold_function_body() once it is parsed */
+                if(function->is_body_parsed)
+                {
+                    for(lang::ast::Statement*& child: function->body_stmts)
+                    {
+                        this->schedule(&child, true);
+                    }
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::RETURN:
+                this->schedule(&static_cast<lang::ast::ReturnStatement*>(statement)->expr);
+                break;
+        }
+    }
+
+    void ConstantFolder::schedule_children(lang::ast::Expression* expression)
+    {
+        switch(expression->kind)
+        {
+            case lang::ast::ExpressionKind::BINARY:
+                this->schedule(&static_cast<lang::ast::BinaryExpression*>(expression)->left);
+                this->schedule(&static_cast<lang::ast::BinaryExpression*>(expression)->right);
+                break;
+
+            case lang::ast::ExpressionKind::LOGICAL:
+                this->schedule(&static_cast<lang::ast::LogicalExpression*>(expression)->left);
+                this->schedule(&static_cast<lang::ast::LogicalExpression*>(expression)->right);
+                break;
+
+            case lang::ast::ExpressionKind::GROUPING:
+                this->schedule(&static_cast<lang::ast::GroupingExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::UNARY:
+                this->schedule(&static_cast<lang::ast::UnaryExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::ASSIGNMENT:
+                this->schedule(&static_cast<lang::ast::AssignmentExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::CALL:
+            {
+                lang::ast::CallExpression* call = static_cast<lang::ast::CallExpression*>(expression);
+
+                this->schedule(&call->callee);
+                for(lang::ast::Expression*& argument: call->arguments)
+                {
+                    this->schedule(&argument);
+                }
+                break;
+            }
+
+            case lang::ast::ExpressionKind::LITERAL:
+            case lang::ast::ExpressionKind::VARIABLE:
+                break;
+        }
+    }
+
+    std::size_t ConstantFolder::compact(lang::ast::Statement** statements, std::size_t count, bool stop_at_return)
+    {
+        std::size_t kept = 0;
+
+        for(std::size_t i = 0; i < count; i++)
+        {
+            if(statements[i] == nullptr)
+            {
+                continue;
+            }
+
+            statements[kept++] = statements[i];
+
+            if(stop_at_return && statements[i]->kind == lang::ast::StatementKind::RETURN)
+            {
+                /* Unreachable, the statements removed before it were counted when they folded away */
+                for(std::size_t j = i + 1; j < count; j++)
+                {
+                    m_statistics.removed_statements += statements[j] != nullptr ? 1 : 0;
+                }
+                break;
+            }
+        }
+
+        return kept;
+    }
+
+    /**********************************************************************************************************************8*/
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::ExpressionStatement* statement)
+    {
+        return statement;
+    }
+
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::PrintStatement* statement)
+    {
+        return statement;
+    }
+
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::VarStatement* statement)
+    {
+        return statement;
+    }
+
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::BlockStatement* statement)
+    {
+        statement->statements.m_size = static_cast<std::uint32_t>(this->compact(statement->statements.begin(), statement->statements.size(), true));
+        return statement;
+    }
+
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::IfStatement* statement)
+    {
+        lang::ast::LiteralExpression* condition = lang::ast::as<lang::ast::LiteralExpression>(statement->condition);
+
+        if(condition == nullptr)
+        {
+            return statement;
+        }
+
+        m_statistics.pruned_branches++;
+
+        /* Without an else and with a false condition nothing is left */
+        lang::ast::Statement* taken = is_truthy(condition) ? statement->thenBranch : statement->elseBranch;
+        if(taken == nullptr)
+        {
+            m_statistics.removed_statements++;
+        }
+
+        return taken;
+    }
+
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::WhileStatement* statement)
+    {
+        lang::ast::LiteralExpression* condition = lang::ast::as<lang::ast::LiteralExpression>(statement->condition_expr);
+
+        /* A loop that always runs is kept as it is, only one that never runs goes away */
+        if(condition == nullptr || is_truthy(condition))
+        {
+            return statement;
+        }
+
+        m_statistics.pruned_branches++;
+        m_statistics.removed_statements++;
+
+        return nullptr;
+    }
+
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::FunctionStatement* statement)
+    {
+        if(statement->is_body_parsed)
+        {
+            statement->body_stmts.m_size = static_cast<std::uint32_t>(this->compact(statement->body_stmts.begin(), statement->body_stmts.size(), true));
+        }
+
+        return statement;
+    }
+
+    lang::ast::Statement* ConstantFolder::visit(lang::ast::ReturnStatement* statement)
+    {
+        return statement;
+    }
+
+    /**********************************************************************************************************************8*/
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::BinaryExpression* expression)
+    {
+        using Type = lang::ast::LiteralExpression::Type;
+
+        lang::ast::LiteralExpression* left = lang::ast::as<lang::ast::LiteralExpression>(expression->left);
+        lang::ast::LiteralExpression* right = lang::ast::as<lang::ast::LiteralExpression>(expression->right);
+
+        if(left == nullptr || right == nullptr)
+        {
+            return expression;
+        }
+
+        lang::TokenType op = expression->op.m_type;
+
+        if(op == lang::TokenType::EQUAL_EQUAL || op == lang::TokenType::BANG_EQUAL)
+        {
+            /* How values of different types and strings compare is up to the generated code */
+            if(left->type != right->type || left->type == Type::STRING)
+            {
+                return expression;
+            }
+
+            bool equal = left->type == Type::NIL
+                || (left->type == Type::BOOLEAN && left->boolean == right->boolean)
+                || (left->type == Type::NUMBER && left->number == right->number);
+
+            return this->make_boolean(op == lang::TokenType::EQUAL_EQUAL ? equal : !equal);
+        }
+
+        if(left->type != Type::NUMBER || right->type != Type::NUMBER)
+        {
+            return expression;
+        }
+
+        double a = left->number;
+        double b = right->number;
+
+        switch(op)
+        {
+            case lang::TokenType::PLUS: return this->make_number(a + b);
+            case lang::TokenType::MINUS: return this->make_number(a - b);
+            case lang::TokenType::STAR: return this->make_number(a * b);
+            case lang::TokenType::SLASH: return this->make_number(a / b);
+
+            case lang::TokenType::GREATER: return this->make_boolean(a > b);
+            case lang::TokenType::GREATER_EQUAL: return this->make_boolean(a >= b);
+            case lang::TokenType::LESS: return this->make_boolean(a < b);
+            case lang::TokenType::LESS_EQUAL: return this->make_boolean(a <= b);
+
+            default:
+                return expression;
+        }
+    }
+
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::GroupingExpression* expression)
+    {
+        /* Parentheses only matter to the parser, the tree already has the grouping */
+        return expression->expr;
+    }
+
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::LiteralExpression* expression)
+    {
+        return expression;
+    }
+
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::UnaryExpression* expression)
+    {
+        lang::ast::LiteralExpression* operand = lang::ast::as<lang::ast::LiteralExpression>(expression->expr);
+
+        if(operand == nullptr)
+        {
+            return expression;
+        }
+
+        if(expression->op.m_type == lang::TokenType::BANG)
+        {
+            return this->make_boolean(!is_truthy(operand));
+        }
+
+        if(expression->op.m_type == lang::TokenType::MINUS && operand->type == lang::ast::LiteralExpression::Type::NUMBER)
+        {
+            return this->make_number(-operand->number);
+        }
+
+        return expression;
+    }
+
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::VariableExpression* expression)
+    {
+        return expression;
+    }
+
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::AssignmentExpression* expression)
+    {
+        return expression;
+    }
+
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::LogicalExpression* expression)
+    {
+        lang::ast::LiteralExpression* left = lang::ast::as<lang::ast::LiteralExpression>(expression->left);
+
+        if(left == nullptr)
+        {
+            return expression;
+        }
+
+        /* 'and' and 'or' yield one of their operands, a literal left one decides which, the right one may be anything */
+        m_statistics.folded_expressions++;
+
+        bool left_decides = expression->op.m_type == lang::TokenType::OR ? is_truthy(left) : !is_truthy(left);
+
+        return left_decides ? expression->left : expression->right;
+    }
+
+    lang::ast::Expression* ConstantFolder::visit(lang::ast::CallExpression* expression)
+    {
+        return expression;
+    }
+
+    /**********************************************************************************************************************8*/
+    lang::ast::Expression* ConstantFolder::make_number(double value)
+    {
+        m_statistics.folded_expressions++;
+        return m_arena->make<lang::ast::LiteralExpression>(value);
+    }
+
+    lang::ast::Expression* ConstantFolder::make_boolean(bool value)
+    {
+        m_statistics.folded_expressions++;
+        return m_arena->make<lang::ast::LiteralExpression>(value);
+    }
+
+    bool ConstantFolder::is_truthy(const lang::ast::LiteralExpression* literal)
+    {
+        switch(literal->type)
+        {
+            case lang::ast::LiteralExpression::Type::NIL: return false;
+            case lang::ast::LiteralExpression::Type::BOOLEAN: return literal->boolean;
+            case lang::ast::LiteralExpression::Type::NUMBER:
+            case lang::ast::LiteralExpression::Type::STRING: return true;
+        }
+
+        return true;
+    }
+}
@@ -1,9 +1,105 @@
 #include <generator/generator.hpp>
 
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+
+#include <algorithm>
+#include <thread>
 
 namespace lang
 {
+    namespace
+    {
+        /* Below this many top-level functions per worker the bitcode round trip and linking cost more than generating them here */
+        constexpr std::size_t MIN_FUNCTIONS_PER_WORKER = 256;
+
+        std::string top_level_function_symbol(std::size_t index, std::string_view name)
+        {
+            return "lang.function." + std::to_string(index) + "." + std::string{name};
+        }
+    }
+
+    void Generator::optimize(unsigned level, bool favor_compile_latency, llvm::TargetMachine* target_machine)
+    {
+        if(target_machine != nullptr)
+        {
+            m_module->setTargetTriple(target_machine->getTargetTriple().str());
+            m_module->setDataLayout(target_machine->createDataLayout());
+        }
+
+        if(level == 0)
+        {
+            return;
+        }
+
+        static const llvm::OptimizationLevel levels[] = {llvm::OptimizationLevel::O1, llvm::OptimizationLevel::O2, llvm::OptimizationLevel::O3};
+        llvm::OptimizationLevel optimization_level = levels[std::min(level, 3u) - 1];
+
+        /* The analysis managers refer to each other, they must outlive the pipeline run */
+        llvm::LoopAnalysisManager loop_analysis_manager;
+        llvm::FunctionAnalysisManager function_analysis_manager;
+        llvm::CGSCCAnalysisManager cgscc_analysis_manager;
+        llvm::ModuleAnalysisManager module_analysis_manager;
+
+        llvm::PassBuilder pass_builder(target_machine);
+        pass_builder.registerModuleAnalyses(module_analysis_manager);
+        pass_builder.registerCGSCCAnalyses(cgscc_analysis_manager);
+        pass_builder.registerFunctionAnalyses(function_analysis_manager);
+        pass_builder.registerLoopAnalyses(loop_analysis_manager);
+        pass_builder.crossRegisterProxies(loop_analysis_manager, function_analysis_manager, cgscc_analysis_manager, module_analysis_manager);
+
+        llvm::ModulePassManager module_pass_manager;
+
+        if(favor_compile_latency)
+        {
+            module_pass_manager.addPass(llvm::createModuleToFunctionPassAdaptor(
+                pass_builder.buildFunctionSimplificationPipeline(optimization_level, llvm::ThinOrFullLTOPhase::None)
+            ));
+        }
+        else
+        {
+            module_pass_manager = pass_builder.buildPerModuleDefaultPipeline(optimization_level);
+        }
+
+        module_pass_manager.run(*m_module, module_analysis_manager);
+    }
+
+    std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>> Generator::take_module()
+    {
+        /* The builder refers to the context, it cannot outlive it */
+        m_builder.reset();
+
+        return {std::move(m_ctx), std::move(m_module)};
+    }
+
+    std::vector<std::string> Generator::load_bitcode(llvm::MemoryBufferRef bitcode)
+    {
+        this->module_initialization();
+        m_errors = std::vector<std::string>();
+
+        llvm::Expected<std::unique_ptr<llvm::Module>> module = llvm::parseBitcodeFile(bitcode, *m_ctx);
+
+        if(!module)
+        {
+            this->generate_error(0, " the bitcode is invalid: " + llvm::toString(module.takeError()));
+        }
+        else
+        {
+            m_module = std::move(*module);
+        }
+
+        return std::move(m_errors);
+    }
+
+    void Generator::write_bitcode(llvm::SmallVectorImpl<char>& bitcode)
+    {
+        llvm::raw_svector_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(*m_module, out);
+    }
+
     void Generator::save_module_to_file(const std::string& file_name)
     {
         std::error_code ec;
@@ -16,33 +112,1093 @@ namespace lang
         m_module->print(llvm::outs(), nullptr);
     }
 
-    std::vector<std::string> Generator::generate(std::vector<std::unique_ptr<lang::ast::Statement>>&& statements)
+    std::vector<std::string> Generator::generate(const std::vector<lang::ast::Statement*>& statements)
+    {
+        this->begin_generation();
+
+        for(lang::ast::Statement* statement: statements)
+        {
+            this->generate_declaration(statement);
+        }
+
+        return this->end_generation();
+    }
+
+    std::vector<std::string> Generator::generate_parallel(const std::vector<lang::ast::Statement*>& statements, unsigned thread_count)
+    {
+        std::vector<lang::ast::FunctionStatement*> functions;
+        for(lang::ast::Statement* statement: statements)
+        {
+            if(statement->kind == lang::ast::StatementKind::FUNCTION && static_cast<lang::ast::FunctionStatement*>(statement)->binding.is_global())
+            {
+                functions.push_back(static_cast<lang::ast::FunctionStatement*>(statement));
+            }
+        }
+
+        std::size_t worker_count = std::min<std::size_t>(thread_count, functions.size() / MIN_FUNCTIONS_PER_WORKER);
+
+        if(worker_count <= 1)
+        {
+            return this->generate(statements);
+        }
+
+        m_shares_symbols = true;
+        this->begin_generation();
+
+        /* A function whose body has errors is left out, its errors are reported */
+        std::vector<bool> loaded(functions.size());
+        for(std::size_t i = 0; i < functions.size(); i++)
+        {
+            loaded[i] = this->load_function_body(functions[i]);
+        }
+
+        struct WorkerResult
+        {
+            llvm::SmallVector<char, 0> bitcode;
+            std::vector<std::string> errors;
+        };
+
+        std::vector<WorkerResult> results(worker_count);
+        std::vector<std::thread> workers;
+
+        for(std::size_t w = 0; w < worker_count; w++)
+        {
+            workers.emplace_back([&functions, &loaded, &results, w, worker_count]()
+            {
+                std::size_t begin = functions.size() * w / worker_count;
+                std::size_t end = functions.size() * (w + 1) / worker_count;
+
+                lang::Generator worker;
+                worker.begin_worker_generation();
+
+                for(std::size_t i = begin; i < end; i++)
+                {
+                    if(loaded[i])
+                    {
+                        worker.generate_function_definition(functions[i], top_level_function_symbol(i, functions[i]->name.m_lexeme));
+                    }
+                }
+
+                results[w].errors = worker.end_worker_generation(results[w].bitcode);
+            });
+        }
+
+        /* Meanwhile the top-level code, where a top-level function is only the store of its closure */
+        std::size_t function_index = 0;
+        for(lang::ast::Statement* statement: statements)
+        {
+            if(function_index < functions.size() && statement == functions[function_index])
+            {
+                if(loaded[function_index])
+                {
+                    this->declare_top_level_function(functions[function_index], top_level_function_symbol(function_index, functions[function_index]->name.m_lexeme));
+                }
+
+                function_index++;
+                continue;
+            }
+
+            this->generate_declaration(statement);
+        }
+
+        for(auto& worker: workers)
+        {
+            worker.join();
+        }
+
+        /* In source order, so the errors come out as generate() reports them */
+        for(WorkerResult& result: results)
+        {
+            m_errors.insert(m_errors.end(), std::make_move_iterator(result.errors.begin()), std::make_move_iterator(result.errors.end()));
+            this->link_bitcode(result.bitcode);
+        }
+
+        this->internalize_shared_symbols();
+        m_shares_symbols = false;
+
+        return this->end_generation();
+    }
+
+    std::vector<std::string> Generator::generate_runtime()
+    {
+        m_shares_symbols = true;
+        this->begin_generation();
+        m_shares_symbols = false;
+
+        return this->end_generation();
+    }
+
+    std::vector<std::string> Generator::generate_function(lang::ast::FunctionStatement* function, const std::string& symbol)
+    {
+        this->begin_worker_generation();
+        this->generate_function_definition(function, symbol);
+
+        m_functions.clear();
+        m_is_worker = false;
+        m_shares_symbols = false;
+
+        this->verify_module();
+
+        return std::move(m_errors);
+    }
+
+    std::vector<std::string> Generator::generate_loop(lang::ast::WhileStatement* loop, const std::vector<bool>& boxed_slots, const std::string& symbol)
+    {
+        this->begin_worker_generation();
+        m_functions.clear();
+
+        llvm::Type* double_type = m_builder->getDoubleTy();
+        llvm::PointerType* box_type = double_type->getPointerTo();
+
+        llvm::Function* fn = this->create_function_proto(symbol, llvm::FunctionType::get(double_type, {m_builder->getInt8PtrTy(), box_type, box_type->getPointerTo()}, false));
+        fn->getArg(0)->setName("closure");
+        fn->getArg(1)->setName("locals");
+        fn->getArg(2)->setName("boxes");
+
+        this->create_function_block(fn);
+        m_functions.push_back(FunctionContext{nullptr, fn, fn->getArg(0), nullptr, {}, {}});
+
+        /* The slots of the frame are allocas like the ones of a function, promoted by mem2reg */
+        std::vector<Storage>& slots = m_functions.back().slots;
+        slots.resize(boxed_slots.size());
+
+        for(std::size_t slot = 0; slot < boxed_slots.size(); slot++)
+        {
+            llvm::Type* type = boxed_slots[slot] ? static_cast<llvm::Type*>(box_type) : double_type;
+            llvm::Value* source = boxed_slots[slot] ? m_builder->CreateGEP(box_type, fn->getArg(2), m_builder->getInt64(slot)) : m_builder->CreateGEP(double_type, fn->getArg(1), m_builder->getInt64(slot));
+
+            llvm::Value* address = m_builder->CreateAlloca(type, nullptr, boxed_slots[slot] ? "slot.box" : "slot");
+            m_builder->CreateStore(m_builder->CreateLoad(type, source), address);
+
+            slots[slot] = Storage{address, boxed_slots[slot]};
+        }
+
+        /* A declaration in the loop takes a new alloca, the ones of the variables declared before the loop stay as they are */
+        std::vector<Storage> frame_slots = slots;
+
+        this->push(loop);
+        this->run();
+
+        if(!this->is_block_terminated())
+        {
+            for(std::size_t slot = 0; slot < frame_slots.size(); slot++)
+            {
+                if(!frame_slots[slot].boxed)
+                {
+                    llvm::Value* value = m_builder->CreateLoad(double_type, frame_slots[slot].address);
+                    m_builder->CreateStore(value, m_builder->CreateGEP(double_type, fn->getArg(1), m_builder->getInt64(slot)));
+                }
+            }
+
+            m_builder->CreateRet(this->constant_value(LOOP_EXIT_VALUE));
+        }
+
+        m_functions.clear();
+        m_is_worker = false;
+        m_shares_symbols = false;
+
+        this->verify_module();
+
+        return std::move(m_errors);
+    }
+
+    void Generator::begin_worker_generation()
+    {
+        m_is_worker = true;
+        m_shares_symbols = true;
+
+        this->module_initialization();
+        this->declare_runtime();
+
+        /* There is no 'main' in a worker, level 0 only keeps the levels of the functions the same as in the primary module */
+        m_functions.push_back(FunctionContext{nullptr, nullptr, nullptr, nullptr, {}, {}});
+    }
+
+    void Generator::generate_function_definition(lang::ast::FunctionStatement* function, const std::string& symbol)
+    {
+        /* Without a caller block end_function() leaves the closure to the primary module */
+        m_builder->ClearInsertionPoint();
+
+        std::size_t level_count = m_functions.size();
+        this->begin_function(function);
+
+        if(m_functions.size() == level_count)
+        {
+            return;
+        }
+
+        m_functions.back().function->setName(symbol);
+        m_functions.back().function->setLinkage(llvm::GlobalValue::ExternalLinkage);
+
+        this->run();
+    }
+
+    std::vector<std::string> Generator::end_worker_generation(llvm::SmallVectorImpl<char>& bitcode)
+    {
+        m_functions.clear();
+        this->write_bitcode(bitcode);
+
+        return std::move(m_errors);
+    }
+
+    void Generator::declare_top_level_function(lang::ast::FunctionStatement* function, const std::string& symbol)
+    {
+        llvm::Function* fn = this->create_function_proto(symbol, this->function_type(function->params.size()));
+
+        FunctionContext context{function, fn, nullptr, nullptr, {}, {}};
+        m_builder->CreateStore(this->make_closure(context), this->variable_address(function->binding, function->name));
+    }
+
+    void Generator::link_bitcode(const llvm::SmallVectorImpl<char>& bitcode)
+    {
+        llvm::MemoryBufferRef buffer{llvm::StringRef{bitcode.data(), bitcode.size()}, "worker"};
+        llvm::Expected<std::unique_ptr<llvm::Module>> module = llvm::parseBitcodeFile(buffer, *m_ctx);
+
+        if(!module)
+        {
+            this->generate_error(0, " the bitcode of a worker is invalid: " + llvm::toString(module.takeError()));
+            return;
+        }
+
+        if(llvm::Linker::linkModules(*m_module, std::move(*module)))
+        {
+            this->generate_error(0, " the module of a worker could not be linked");
+        }
+    }
+
+    void Generator::internalize_shared_symbols()
+    {
+        for(llvm::Function& function: *m_module)
+        {
+            if(!function.isDeclaration() && function.getName() != "main")
+            {
+                function.setLinkage(llvm::GlobalValue::InternalLinkage);
+            }
+        }
+
+        for(llvm::GlobalVariable& global: m_module->globals())
+        {
+            if(!global.isDeclaration() && global.hasExternalLinkage())
+            {
+                global.setLinkage(llvm::GlobalValue::InternalLinkage);
+            }
+        }
+    }
+
+    void Generator::begin_generation()
     {
+        this->module_initialization();
 
         m_errors = std::vector<std::string>();
+        m_work.clear();
+        m_values.clear();
+        m_functions.clear();
+        m_globals.clear();
+        m_strings.clear();
+        m_c_strings.clear();
+
+        this->declare_runtime();
 
         auto fn = this->create_function("main", llvm::FunctionType::get(
                 /* return type*/ m_builder->getInt32Ty(),
                 /* vararg */ false
             ));
 
+        m_functions.push_back(FunctionContext{nullptr, fn, nullptr, nullptr, {}, {}});
+    }
+
+    void Generator::generate_declaration(lang::ast::Statement* statement)
+    {
         /* generate IR for main body aka compile main body */
-        auto result = this->gen(std::move(statements));
+        this->push(statement);
+        this->run();
+    }
 
-        /* Cast to i32 to return from main: */
-        auto i32Result = m_builder->CreateIntCast(result, m_builder->getInt32Ty(), true);
+    std::vector<std::string> Generator::end_generation()
+    {
+        if(!this->is_block_terminated())
+        {
+            m_builder->CreateRet(m_builder->getInt32(0));
+        }
 
-        m_builder->CreateRet(i32Result);
+        m_functions.clear();
 
+        this->verify_module();
 
         return std::move(m_errors);
     }
 
-    llvm::Value* Generator::gen(std::vector<std::unique_ptr<lang::ast::Statement>>&& statements)
+    void Generator::verify_module()
+    {
+        std::string verifier_message;
+        llvm::raw_string_ostream verifier_stream(verifier_message);
+
+        if(llvm::verifyModule(*m_module, &verifier_stream))
+        {
+            this->generate_error(0, " the generated module is invalid: " + verifier_stream.str());
+        }
+    }
+
+    void Generator::set_function_body_loader(FunctionBodyLoader loader)
+    {
+        m_function_body_loader = std::move(loader);
+    }
+
+    bool Generator::load_function_body(lang::ast::FunctionStatement* function)
     {
-        return m_builder->getInt32(42);
+        if(function->is_body_parsed)
+        {
+            return true;
+        }
+
+        if(!m_function_body_loader)
+        {
+            this->error(function->name, "Function body was not parsed");
+            return false;
+        }
+
+        std::vector<std::string> body_errors = m_function_body_loader(function);
+        m_errors.insert(m_errors.end(), std::make_move_iterator(body_errors.begin()), std::make_move_iterator(body_errors.end()));
+
+        return body_errors.empty();
     }
 
+    /**********************************************************************************************************************8*/
+    void Generator::run()
+    {
+        while(!m_work.empty())
+        {
+            Work work = m_work.back();
+            m_work.pop_back();
+
+            switch(work.kind)
+            {
+                case Work::Kind::STATEMENT:
+                    this->generate_statement(work.statement);
+                    break;
+
+                case Work::Kind::EXPRESSION:
+                    this->generate_expression(work.expression);
+                    break;
+
+                case Work::Kind::DISCARD:
+                    (void)this->pop_value();
+                    break;
+
+                case Work::Kind::PRINT:
+                    m_builder->CreateCall(m_print, {this->pop_value()});
+                    break;
+
+                case Work::Kind::DEFINE_VAR:
+                {
+                    lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(work.statement);
+                    llvm::Value* value = this->pop_value();
+
+                    llvm::Value* address = var->binding.is_global()
+                        ? this->global_address(var->binding.slot, var->name.m_lexeme)
+                        : this->declare_local(var->binding.slot, var->captured, var->name.m_lexeme);
+
+                    m_builder->CreateStore(value, address);
+                    break;
+                }
+
+                case Work::Kind::IF_BRANCH:
+                {
+                    lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(work.statement);
+                    llvm::Value* condition = this->is_truthy(this->pop_value());
+
+                    llvm::BasicBlock* then_block = this->create_BB("if.then");
+                    llvm::BasicBlock* else_block = if_statement->elseBranch != nullptr ? this->create_BB("if.else") : nullptr;
+                    llvm::BasicBlock* end_block = this->create_BB("if.end");
+
+                    m_builder->CreateCondBr(condition, then_block, else_block != nullptr ? else_block : end_block);
+                    this->start_block(then_block);
+
+                    this->push(Work::Kind::IF_ELSE, if_statement, nullptr, else_block, end_block);
+                    this->push(if_statement->thenBranch);
+                    break;
+                }
+
+                case Work::Kind::IF_ELSE:
+                {
+                    if(!this->is_block_terminated())
+                    {
+                        m_builder->CreateBr(work.second_block);
+                    }
+
+                    if(work.first_block == nullptr)
+                    {
+                        this->start_block(work.second_block);
+                        break;
+                    }
+
+                    this->start_block(work.first_block);
+
+                    this->push(Work::Kind::IF_END, nullptr, nullptr, nullptr, work.second_block);
+                    this->push(static_cast<lang::ast::IfStatement*>(work.statement)->elseBranch);
+                    break;
+                }
+
+                case Work::Kind::IF_END:
+                {
+                    if(!this->is_block_terminated())
+                    {
+                        m_builder->CreateBr(work.second_block);
+                    }
+
+                    this->start_block(work.second_block);
+                    break;
+                }
+
+                case Work::Kind::WHILE_BODY:
+                {
+                    lang::ast::WhileStatement* while_statement = static_cast<lang::ast::WhileStatement*>(work.statement);
+                    llvm::Value* condition = this->is_truthy(this->pop_value());
+
+                    llvm::BasicBlock* body_block = this->create_BB("while.body");
+                    llvm::BasicBlock* end_block = this->create_BB("while.end");
+
+                    m_builder->CreateCondBr(condition, body_block, end_block);
+                    this->start_block(body_block);
+
+                    /* 'first_block' is the block of the condition, the body loops back to it */
+                    this->push(Work::Kind::WHILE_END, nullptr, nullptr, work.first_block, end_block);
+                    this->push(while_statement->body_stmt);
+                    break;
+                }
+
+                case Work::Kind::WHILE_END:
+                {
+                    if(!this->is_block_terminated())
+                    {
+                        m_builder->CreateBr(work.first_block);
+                    }
+
+                    this->start_block(work.second_block);
+                    break;
+                }
+
+                case Work::Kind::FUNCTION_END:
+                    this->end_function(static_cast<lang::ast::FunctionStatement*>(work.statement));
+                    break;
+
+                case Work::Kind::RETURN:
+                {
+                    m_builder->CreateRet(this->pop_value());
+
+                    /* Whatever follows in the same block is unreachable, it still needs a block to go to */
+                    this->start_block(this->create_BB("after.return"));
+                    break;
+                }
+
+                case Work::Kind::UNARY:
+                {
+                    lang::ast::UnaryExpression* unary = static_cast<lang::ast::UnaryExpression*>(work.expression);
+                    llvm::Value* operand = this->pop_value();
+
+                    if(unary->op.m_type == lang::TokenType::BANG)
+                    {
+                        m_values.push_back(this->boolean_value(m_builder->CreateNot(this->is_truthy(operand))));
+                        break;
+                    }
+
+                    this->check(this->is_number(operand), "Operand must be a number.", unary->op.m_line);
+                    m_values.push_back(m_builder->CreateFNeg(operand));
+                    break;
+                }
+
+                case Work::Kind::BINARY:
+                {
+                    llvm::Value* right = this->pop_value();
+                    llvm::Value* left = this->pop_value();
+
+                    this->generate_binary(static_cast<lang::ast::BinaryExpression*>(work.expression), left, right);
+                    break;
+                }
+
+                case Work::Kind::ASSIGN:
+                {
+                    lang::ast::AssignmentExpression* assignment = static_cast<lang::ast::AssignmentExpression*>(work.expression);
+                    llvm::Value* value = m_values.back();
+
+                    /* The value stays on m_values, an assignment is an expression */
+                    m_builder->CreateStore(value, this->variable_address(assignment->binding, assignment->name));
+                    break;
+                }
+
+                case Work::Kind::LOGICAL_RIGHT:
+                {
+                    /* 'and' and 'or' yield one of their operands, the right one is only evaluated if the left one does not decide */
+                    lang::ast::LogicalExpression* logical = static_cast<lang::ast::LogicalExpression*>(work.expression);
+                    llvm::Value* left = this->pop_value();
+                    llvm::Value* left_is_truthy = this->is_truthy(left);
+                    llvm::BasicBlock* left_block = m_builder->GetInsertBlock();
+
+                    llvm::BasicBlock* right_block = this->create_BB(logical->op.m_type == lang::TokenType::OR ? "or.right" : "and.right");
+                    llvm::BasicBlock* end_block = this->create_BB(logical->op.m_type == lang::TokenType::OR ? "or.end" : "and.end");
+
+                    if(logical->op.m_type == lang::TokenType::OR)
+                    {
+                        m_builder->CreateCondBr(left_is_truthy, end_block, right_block);
+                    }
+                    else
+                    {
+                        m_builder->CreateCondBr(left_is_truthy, right_block, end_block);
+                    }
+
+                    this->start_block(right_block);
+
+                    this->push(Work::Kind::LOGICAL_END, nullptr, logical, left_block, end_block, left);
+                    this->push(logical->right);
+                    break;
+                }
+
+                case Work::Kind::LOGICAL_END:
+                {
+                    llvm::Value* right = this->pop_value();
+                    llvm::BasicBlock* right_block = m_builder->GetInsertBlock();
+
+                    m_builder->CreateBr(work.second_block);
+                    this->start_block(work.second_block);
+
+                    llvm::PHINode* result = m_builder->CreatePHI(m_builder->getDoubleTy(), 2);
+                    result->addIncoming(work.value, work.first_block);
+                    result->addIncoming(right, right_block);
+
+                    m_values.push_back(result);
+                    break;
+                }
+
+                case Work::Kind::CALL:
+                    this->generate_call(static_cast<lang::ast::CallExpression*>(work.expression));
+                    break;
+            }
+        }
+    }
+
+    /* Children are pushed last to first, so their code is emitted in source order */
+    void Generator::generate_statement(lang::ast::Statement* statement)
+    {
+        switch(statement->kind)
+        {
+            case lang::ast::StatementKind::EXPRESSION:
+                this->push(Work::Kind::DISCARD, statement, nullptr);
+                this->push(static_cast<lang::ast::ExpressionStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::PRINT:
+                this->push(Work::Kind::PRINT, statement, nullptr);
+                this->push(static_cast<lang::ast::PrintStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::VAR:
+            {
+                lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(statement);
+
+                this->push(Work::Kind::DEFINE_VAR, var, nullptr);
+
+                if(var->initializer != nullptr)
+                {
+                    this->push(var->initializer);
+                }
+                else
+                {
+                    m_values.push_back(this->nil_value());
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::BLOCK:
+            {
+                /* The Resolver already gave every declaration in it a slot of its own, a block needs no code */
+                lang::ast::BlockStatement* block = static_cast<lang::ast::BlockStatement*>(statement);
+
+                for(std::size_t i = block->statements.size(); i > 0; i--)
+                {
+                    this->push(block->statements[i - 1]);
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::IF:
+                this->push(Work::Kind::IF_BRANCH, statement, nullptr);
+                this->push(static_cast<lang::ast::IfStatement*>(statement)->condition);
+                break;
+
+            case lang::ast::StatementKind::WHILE:
+            {
+                llvm::BasicBlock* condition_block = this->create_BB("while.condition");
+
+                m_builder->CreateBr(condition_block);
+                this->start_block(condition_block);
+
+                this->push(Work::Kind::WHILE_BODY, statement, nullptr, condition_block);
+                this->push(static_cast<lang::ast::WhileStatement*>(statement)->condition_expr);
+                break;
+            }
+
+            case lang::ast::StatementKind::FUNCTION:
+                this->begin_function(static_cast<lang::ast::FunctionStatement*>(statement));
+                break;
+
+            case lang::ast::StatementKind::RETURN:
+            {
+                lang::ast::ReturnStatement* return_statement = static_cast<lang::ast::ReturnStatement*>(statement);
+
+                this->push(Work::Kind::RETURN, statement, nullptr);
+
+                if(return_statement->expr != nullptr)
+                {
+                    this->push(return_statement->expr);
+                }
+                else
+                {
+                    m_values.push_back(this->nil_value());
+                }
+                break;
+            }
+        }
+    }
+
+    void Generator::generate_expression(lang::ast::Expression* expression)
+    {
+        switch(expression->kind)
+        {
+            case lang::ast::ExpressionKind::LITERAL:
+            {
+                lang::ast::LiteralExpression* literal = static_cast<lang::ast::LiteralExpression*>(expression);
+
+                switch(literal->type)
+                {
+                    case lang::ast::LiteralExpression::Type::NIL:
+                        m_values.push_back(this->nil_value());
+                        break;
+
+                    case lang::ast::LiteralExpression::Type::BOOLEAN:
+                        m_values.push_back(this->constant_value(literal->boolean ? TRUE_VALUE : FALSE_VALUE));
+                        break;
+
+                    case lang::ast::LiteralExpression::Type::NUMBER:
+                        m_values.push_back(this->number_value(literal->number));
+                        break;
+
+                    case lang::ast::LiteralExpression::Type::STRING:
+                        m_values.push_back(this->make_string(literal->string));
+                        break;
+                }
+                break;
+            }
+
+            case lang::ast::ExpressionKind::VARIABLE:
+            {
+                lang::ast::VariableExpression* variable = static_cast<lang::ast::VariableExpression*>(expression);
+
+                llvm::Value* address = this->variable_address(variable->binding, variable->name);
+                m_values.push_back(m_builder->CreateLoad(m_builder->getDoubleTy(), address, std::string{variable->name.m_lexeme}));
+                break;
+            }
+
+            case lang::ast::ExpressionKind::GROUPING:
+                this->push(static_cast<lang::ast::GroupingExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::UNARY:
+                this->push(Work::Kind::UNARY, nullptr, expression);
+                this->push(static_cast<lang::ast::UnaryExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::BINARY:
+                this->push(Work::Kind::BINARY, nullptr, expression);
+                this->push(static_cast<lang::ast::BinaryExpression*>(expression)->right);
+                this->push(static_cast<lang::ast::BinaryExpression*>(expression)->left);
+                break;
+
+            case lang::ast::ExpressionKind::LOGICAL:
+                this->push(Work::Kind::LOGICAL_RIGHT, nullptr, expression);
+                this->push(static_cast<lang::ast::LogicalExpression*>(expression)->left);
+                break;
+
+            case lang::ast::ExpressionKind::ASSIGNMENT:
+                this->push(Work::Kind::ASSIGN, nullptr, expression);
+                this->push(static_cast<lang::ast::AssignmentExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::CALL:
+            {
+                lang::ast::CallExpression* call = static_cast<lang::ast::CallExpression*>(expression);
+
+                this->push(Work::Kind::CALL, nullptr, call);
+                for(std::size_t i = call->arguments.size(); i > 0; i--)
+                {
+                    this->push(call->arguments[i - 1]);
+                }
+                this->push(call->callee);
+                break;
+            }
+        }
+    }
+
+    void Generator::push(lang::ast::Statement* statement)
+    {
+        if(statement != nullptr)
+        {
+            this->push(Work::Kind::STATEMENT, statement, nullptr);
+        }
+    }
+
+    void Generator::push(lang::ast::Expression* expression)
+    {
+        this->push(Work::Kind::EXPRESSION, nullptr, expression);
+    }
+
+    void Generator::push(Work::Kind kind, lang::ast::Statement* statement, lang::ast::Expression* expression, llvm::BasicBlock* first_block, llvm::BasicBlock* second_block, llvm::Value* value)
+    {
+        m_work.push_back(Work{kind, statement, expression, first_block, second_block, value});
+    }
+
+    llvm::Value* Generator::pop_value()
+    {
+        llvm::Value* value = m_values.back();
+        m_values.pop_back();
+
+        return value;
+    }
+
+    /**********************************************************************************************************************8*/
+    void Generator::begin_function(lang::ast::FunctionStatement* function)
+    {
+        /* The name is in scope in the body, a nested function calling itself captures its own variable */
+        if(!function->binding.is_global())
+        {
+            (void)this->declare_local(function->binding.slot, function->captured, function->name.m_lexeme);
+        }
+
+        if(!this->load_function_body(function))
+        {
+            return;
+        }
+
+        llvm::Function* fn = this->create_function_proto(std::string{function->name.m_lexeme}, this->function_type(function->params.size()));
+        fn->setLinkage(llvm::GlobalValue::InternalLinkage);
+        fn->getArg(0)->setName("closure");
+
+        m_functions.push_back(FunctionContext{function, fn, fn->getArg(0), m_builder->GetInsertBlock(), {}, {}});
+        m_functions.back().slots.resize(function->frame_size);
+
+        this->create_function_block(fn);
+
+        /* Parameters take the first slots */
+        for(std::size_t i = 0; i < function->params.size(); i++)
+        {
+            bool captured = i < function->captured_params.size() && function->captured_params[i];
+            std::string_view name = function->params[i].m_lexeme;
+
+            llvm::Argument* argument = fn->getArg(static_cast<unsigned>(i + 1));
+            argument->setName(llvm::StringRef{name.data(), name.size()});
+
+            m_builder->CreateStore(argument, this->declare_local(static_cast<std::uint32_t>(i), captured, name));
+        }
+
+        this->push(Work::Kind::FUNCTION_END, function, nullptr);
+        for(std::size_t i = function->body_stmts.size(); i > 0; i--)
+        {
+            this->push(function->body_stmts[i - 1]);
+        }
+    }
+
+    void Generator::end_function(lang::ast::FunctionStatement* function)
+    {
+        /* Falling off the end returns nil */
+        if(!this->is_block_terminated())
+        {
+            m_builder->CreateRet(this->nil_value());
+        }
+
+        FunctionContext context = std::move(m_functions.back());
+        m_functions.pop_back();
+
+        /* A top-level function of a worker, the primary module stores its closure */
+        if(context.caller_block == nullptr)
+        {
+            return;
+        }
+
+        m_builder->SetInsertPoint(context.caller_block);
+
+        llvm::Value* closure = this->make_closure(context);
+        m_builder->CreateStore(closure, this->variable_address(function->binding, function->name));
+    }
+
+    void Generator::generate_binary(lang::ast::BinaryExpression* expression, llvm::Value* left, llvm::Value* right)
+    {
+        int line = expression->op.m_line;
+        lang::TokenType op = expression->op.m_type;
+
+        llvm::Value* both_numbers = m_builder->CreateAnd(this->is_number(left), this->is_number(right), "numbers");
+
+        /* '+' also concatenates strings and '==' compares any values, both leave anything but two numbers to the runtime */
+        if(op == lang::TokenType::PLUS || op == lang::TokenType::EQUAL_EQUAL || op == lang::TokenType::BANG_EQUAL)
+        {
+            bool is_addition = op == lang::TokenType::PLUS;
+
+            llvm::BasicBlock* numbers_block = this->create_BB(is_addition ? "add.numbers" : "equal.numbers");
+            llvm::BasicBlock* other_block = this->create_BB(is_addition ? "add.other" : "equal.other");
+            llvm::BasicBlock* end_block = this->create_BB(is_addition ? "add.end" : "equal.end");
+
+            m_builder->CreateCondBr(both_numbers, numbers_block, other_block);
+
+            this->start_block(numbers_block);
+            llvm::Value* numbers_result = is_addition ? m_builder->CreateFAdd(left, right) : m_builder->CreateFCmpOEQ(left, right);
+            m_builder->CreateBr(end_block);
+
+            this->start_block(other_block);
+            llvm::Value* other_result = is_addition
+                ? m_builder->CreateCall(m_add, {left, right, m_builder->getInt32(line)})
+                : m_builder->CreateCall(m_equal, {left, right});
+            m_builder->CreateBr(end_block);
+
+            this->start_block(end_block);
+            llvm::PHINode* result = m_builder->CreatePHI(numbers_result->getType(), 2);
+            result->addIncoming(numbers_result, numbers_block);
+            result->addIncoming(other_result, other_block);
+
+            if(is_addition)
+            {
+                m_values.push_back(result);
+            }
+            else
+            {
+                m_values.push_back(this->boolean_value(op == lang::TokenType::EQUAL_EQUAL ? static_cast<llvm::Value*>(result) : m_builder->CreateNot(result)));
+            }
+            return;
+        }
+
+        this->check(both_numbers, "Operands must be numbers.", line);
+
+        switch(op)
+        {
+            case lang::TokenType::MINUS: m_values.push_back(m_builder->CreateFSub(left, right)); break;
+            case lang::TokenType::STAR: m_values.push_back(m_builder->CreateFMul(left, right)); break;
+            case lang::TokenType::SLASH: m_values.push_back(m_builder->CreateFDiv(left, right)); break;
+
+            case lang::TokenType::GREATER: m_values.push_back(this->boolean_value(m_builder->CreateFCmpOGT(left, right))); break;
+            case lang::TokenType::GREATER_EQUAL: m_values.push_back(this->boolean_value(m_builder->CreateFCmpOGE(left, right))); break;
+            case lang::TokenType::LESS: m_values.push_back(this->boolean_value(m_builder->CreateFCmpOLT(left, right))); break;
+            case lang::TokenType::LESS_EQUAL: m_values.push_back(this->boolean_value(m_builder->CreateFCmpOLE(left, right))); break;
+
+            default:
+                this->error(expression->op, "Unknown binary operator");
+                m_values.push_back(this->nil_value());
+                break;
+        }
+    }
+
+    void Generator::generate_call(lang::ast::CallExpression* expression)
+    {
+        std::size_t argument_count = expression->arguments.size();
+
+        /* The callee was pushed before the arguments */
+        std::vector<llvm::Value*> arguments(argument_count + 1);
+        for(std::size_t i = argument_count; i > 0; i--)
+        {
+            arguments[i] = this->pop_value();
+        }
+        llvm::Value* callee = this->pop_value();
+
+        llvm::Value* closure = m_builder->CreateCall(m_callee, {callee, m_builder->getInt32(static_cast<std::uint32_t>(argument_count)), m_builder->getInt32(expression->closing_paren.m_line)}, "callee");
+        arguments[0] = closure;
+
+        llvm::FunctionType* type = this->function_type(argument_count);
+
+        llvm::Value* function_field = m_builder->CreateStructGEP(m_closure_type, m_builder->CreateBitCast(closure, m_closure_type->getPointerTo()), 1);
+        llvm::Value* function = m_builder->CreateBitCast(m_builder->CreateLoad(m_builder->getInt8PtrTy(), function_field), type->getPointerTo());
+
+        m_values.push_back(m_builder->CreateCall(type, function, arguments, "call"));
+    }
+
+    /**********************************************************************************************************************8*/
+    llvm::Value* Generator::variable_address(const lang::ast::Binding& binding, const lang::Token& name)
+    {
+        if(binding.is_global())
+        {
+            return this->global_address(binding.slot, name.m_lexeme);
+        }
+
+        std::size_t level = m_functions.size() - 1;
+
+        if(binding.depth == 0)
+        {
+            const Storage& storage = m_functions[level].slots[binding.slot];
+
+            return storage.boxed ? m_builder->CreateLoad(m_builder->getDoubleTy()->getPointerTo(), storage.address) : storage.address;
+        }
+
+        std::uint32_t index = this->upvalue_index(level, level - binding.depth, binding.slot);
+        return this->upvalue_address(m_functions[level].closure, index);
+    }
+
+    llvm::Value* Generator::global_address(std::uint32_t slot, std::string_view name)
+    {
+        if(slot >= m_globals.size())
+        {
+            m_globals.resize(slot + 1, nullptr);
+        }
+
+        /* Globals exist from the start and hold nil until their declaration runs */
+        if(m_globals[slot] == nullptr)
+        {
+            llvm::StringRef global_name{name.data(), name.size()};
+
+            if(!m_shares_symbols)
+            {
+                m_globals[slot] = new llvm::GlobalVariable(*m_module, m_builder->getDoubleTy(), false, llvm::GlobalValue::InternalLinkage, this->nil_value(), global_name);
+            }
+            else
+            {
+                /* Named apart from the functions, the modules are linked by name */
+                m_globals[slot] = new llvm::GlobalVariable(*m_module, m_builder->getDoubleTy(), false, llvm::GlobalValue::ExternalLinkage, m_is_worker ? nullptr : this->nil_value(), "lang.global." + global_name);
+            }
+        }
+
+        return m_globals[slot];
+    }
+
+    llvm::Value* Generator::upvalue_address(llvm::Value* closure, std::uint32_t index)
+    {
+        llvm::Value* closure_object = m_builder->CreateBitCast(closure, m_closure_type->getPointerTo());
+        llvm::Value* upvalue = m_builder->CreateGEP(m_closure_type, closure_object, {m_builder->getInt32(0), m_builder->getInt32(UPVALUES_FIELD), m_builder->getInt32(index)});
+
+        return m_builder->CreateLoad(m_builder->getDoubleTy()->getPointerTo(), upvalue, "box");
+    }
+
+    std::uint32_t Generator::upvalue_index(std::size_t level, std::size_t target_level, std::uint32_t slot)
+    {
+        /* Every function between the declaration and the use passes the box on, each through an upvalue of its own */
+        std::uint32_t index = 0;
+
+        for(std::size_t current = target_level + 1; current <= level; current++)
+        {
+            Upvalue upvalue = current == target_level + 1 ? Upvalue{m_functions[target_level].slots[slot].address, 0} : Upvalue{nullptr, index};
+            std::vector<Upvalue>& upvalues = m_functions[current].upvalues;
+
+            auto position = std::find_if(upvalues.begin(), upvalues.end(), [&upvalue](const Upvalue& existing)
+            {
+                return existing.parent_local == upvalue.parent_local && existing.parent_index == upvalue.parent_index;
+            });
+
+            if(position == upvalues.end())
+            {
+                position = upvalues.insert(upvalues.end(), upvalue);
+            }
+
+            index = static_cast<std::uint32_t>(position - upvalues.begin());
+        }
+
+        return index;
+    }
+
+    llvm::Value* Generator::declare_local(std::uint32_t slot, bool captured, std::string_view name)
+    {
+        FunctionContext& context = m_functions.back();
+
+        /* Allocas go to the start of the entry block, where mem2reg promotes them */
+        llvm::BasicBlock& entry = context.function->getEntryBlock();
+        llvm::IRBuilder<> entry_builder(&entry, entry.begin());
+
+        llvm::Type* double_type = m_builder->getDoubleTy();
+        llvm::StringRef local_name{name.data(), name.size()};
+
+        if(slot >= context.slots.size())
+        {
+            context.slots.resize(slot + 1);
+        }
+
+        if(!captured)
+        {
+            llvm::Value* address = entry_builder.CreateAlloca(double_type, nullptr, local_name);
+            context.slots[slot] = Storage{address, false};
+
+            return address;
+        }
+
+        llvm::Value* box_address = entry_builder.CreateAlloca(double_type->getPointerTo(), nullptr, local_name + ".box");
+        context.slots[slot] = Storage{box_address, true};
+
+        llvm::Value* box = m_builder->CreateBitCast(m_builder->CreateCall(m_malloc, {m_builder->getInt64(sizeof(double))}), double_type->getPointerTo(), local_name + ".box");
+        m_builder->CreateStore(box, box_address);
+
+        return box;
+    }
+
+    llvm::Value* Generator::make_closure(const FunctionContext& context)
+    {
+        lang::ast::FunctionStatement* function = context.statement;
+
+        llvm::Constant* kind = m_builder->getInt8(CLOSURE_OBJECT);
+        llvm::Constant* code = llvm::ConstantExpr::getBitCast(context.function, m_builder->getInt8PtrTy());
+        llvm::Constant* name = llvm::cast<llvm::Constant>(this->c_string(function->name.m_lexeme, "lang.function_name"));
+        llvm::Constant* arity = m_builder->getInt32(static_cast<std::uint32_t>(function->params.size()));
+        llvm::Constant* upvalue_count = m_builder->getInt32(static_cast<std::uint32_t>(context.upvalues.size()));
+        llvm::Constant* interpreted = llvm::ConstantPointerNull::get(m_builder->getInt8PtrTy());
+
+        /* A function using no local of another one is a constant */
+        if(context.upvalues.empty())
+        {
+            llvm::ArrayType* no_upvalues_type = llvm::ArrayType::get(m_builder->getDoubleTy()->getPointerTo(), 0);
+            llvm::Constant* closure = llvm::ConstantStruct::get(m_closure_type, {kind, code, name, arity, upvalue_count, interpreted, llvm::ConstantArray::get(no_upvalues_type, {})});
+
+            llvm::GlobalVariable* object = new llvm::GlobalVariable(*m_module, m_closure_type, true, llvm::GlobalValue::PrivateLinkage, closure, context.function->getName() + ".closure");
+
+            return this->box_object(object);
+        }
+
+        /* Size of the closure with its upvalues, the address of upvalues[count] from a null closure */
+        llvm::Value* end_of_upvalues = m_builder->CreateGEP(m_closure_type, llvm::ConstantPointerNull::get(m_closure_type->getPointerTo()), {m_builder->getInt32(0), m_builder->getInt32(UPVALUES_FIELD), upvalue_count});
+        llvm::Value* size = m_builder->CreatePtrToInt(end_of_upvalues, m_builder->getInt64Ty());
+
+        llvm::Value* object = m_builder->CreateCall(m_malloc, {size});
+        llvm::Value* closure = m_builder->CreateBitCast(object, m_closure_type->getPointerTo(), "closure");
+
+        m_builder->CreateStore(kind, m_builder->CreateStructGEP(m_closure_type, closure, 0));
+        m_builder->CreateStore(code, m_builder->CreateStructGEP(m_closure_type, closure, 1));
+        m_builder->CreateStore(name, m_builder->CreateStructGEP(m_closure_type, closure, 2));
+        m_builder->CreateStore(arity, m_builder->CreateStructGEP(m_closure_type, closure, 3));
+        m_builder->CreateStore(upvalue_count, m_builder->CreateStructGEP(m_closure_type, closure, 4));
+        m_builder->CreateStore(interpreted, m_builder->CreateStructGEP(m_closure_type, closure, 5));
+
+        /* The boxes are copied now, from the function creating the closure, which is the current one again */
+        for(std::size_t i = 0; i < context.upvalues.size(); i++)
+        {
+            const Upvalue& upvalue = context.upvalues[i];
+
+            llvm::Value* box = upvalue.parent_local != nullptr
+                ? m_builder->CreateLoad(m_builder->getDoubleTy()->getPointerTo(), upvalue.parent_local, "box")
+                : this->upvalue_address(m_functions.back().closure, upvalue.parent_index);
+
+            llvm::Value* field = m_builder->CreateGEP(m_closure_type, closure, {m_builder->getInt32(0), m_builder->getInt32(UPVALUES_FIELD), m_builder->getInt32(static_cast<std::uint32_t>(i))});
+            m_builder->CreateStore(box, field);
+        }
+
+        return this->box_object(object);
+    }
+
+    llvm::Value* Generator::make_string(std::string_view string)
+    {
+        auto [position, inserted] = m_strings.try_emplace(string, nullptr);
+
+        if(inserted)
+        {
+            llvm::Constant* characters = llvm::cast<llvm::Constant>(this->c_string(string, "lang.characters"));
+            llvm::Constant* contents = llvm::ConstantStruct::get(m_string_type, {m_builder->getInt8(STRING_OBJECT), m_builder->getInt64(string.size()), characters});
+
+            llvm::GlobalVariable* object = new llvm::GlobalVariable(*m_module, m_string_type, true, llvm::GlobalValue::PrivateLinkage, contents, "lang.string");
+            position->second = llvm::cast<llvm::Constant>(this->box_object(object));
+        }
+
+        return position->second;
+    }
+
+    /**********************************************************************************************************************8*/
     llvm::Function* Generator::create_function(const std::string& fnName, llvm::FunctionType* fnType)
     {
         /* Function prototype might already be defined */
@@ -62,7 +1218,7 @@ namespace lang
     llvm::Function* Generator::create_function_proto(const std::string& fnName, llvm::FunctionType* fnType)
     {
         auto fn = llvm::Function::Create(fnType, llvm::Function::ExternalLinkage, fnName, *m_module);
-        
+
         llvm::verifyFunction(*fn);
 
         return fn;
@@ -79,6 +1235,21 @@ namespace lang
         return llvm::BasicBlock::Create(*m_ctx, name, fn);
     }
 
+    void Generator::start_block(llvm::BasicBlock* block)
+    {
+        if(block->getParent() == nullptr)
+        {
+            block->insertInto(m_builder->GetInsertBlock()->getParent());
+        }
+
+        m_builder->SetInsertPoint(block);
+    }
+
+    bool Generator::is_block_terminated()
+    {
+        return m_builder->GetInsertBlock()->getTerminator() != nullptr;
+    }
+
     llvm::Value* Generator::error(const Token& token, const std::string& message)
     {
         if(token.m_type == lang::TokenType::MYEOF)
@@ -87,12 +1258,12 @@ namespace lang
         }
         else
         {
-            this->generate_error(token.m_line, " at '" + token.m_lexeme + "' " + message);
+            this->generate_error(token.m_line, " at '" + std::string{token.m_lexeme} + "' " + message);
         }
 
         return nullptr;
     }
-    
+
     void Generator::generate_error(int line, const std::string& message)
     {
         std::stringstream buffer;
@@ -104,6 +1275,10 @@ namespace lang
 
     void Generator::module_initialization()
     {
+        /* The builder and the module refer to the context, they go first */
+        m_builder.reset();
+        m_module.reset();
+
         m_ctx = std::make_unique<llvm::LLVMContext>();
         m_module = std::make_unique<llvm::Module>("crap_lang", *m_ctx);
 
@@ -114,6 +1289,6 @@ namespace lang
     {
         this->module_initialization();
     }
-    
+
     Generator::~Generator(){}
-}
\ No newline at end of file
+}
@@ -0,0 +1,352 @@
+#include <generator/generator.hpp>
+
+/*
+    Representation of values in the generated code and the runtime functions generated into the module,
+    the code generation of the tree itself is in generator.cpp
+*/
+namespace lang
+{
+    void Generator::declare_runtime()
+    {
+        llvm::Type* i8_type = m_builder->getInt8Ty();
+        llvm::Type* i32_type = m_builder->getInt32Ty();
+        llvm::Type* i64_type = m_builder->getInt64Ty();
+        llvm::Type* double_type = m_builder->getDoubleTy();
+        llvm::Type* void_type = m_builder->getVoidTy();
+        llvm::PointerType* i8_pointer_type = m_builder->getInt8PtrTy();
+
+        m_string_type = llvm::StructType::create(*m_ctx, {i8_type, i64_type, i8_pointer_type}, "lang.string");
+        m_closure_type = llvm::StructType::create(*m_ctx, {i8_type, i8_pointer_type, i8_pointer_type, i32_type, i32_type, i8_pointer_type, llvm::ArrayType::get(double_type->getPointerTo(), 0)}, "lang.closure");
+
+        /* C library */
+        llvm::FunctionCallee printf_function = m_module->getOrInsertFunction("printf", llvm::FunctionType::get(i32_type, {i8_pointer_type}, true));
+        llvm::FunctionCallee fprintf_function = m_module->getOrInsertFunction("fprintf", llvm::FunctionType::get(i32_type, {i8_pointer_type, i8_pointer_type}, true));
+        llvm::FunctionCallee exit_function = m_module->getOrInsertFunction("exit", llvm::FunctionType::get(void_type, {i32_type}, false));
+        llvm::FunctionCallee memcpy_function = m_module->getOrInsertFunction("memcpy", llvm::FunctionType::get(i8_pointer_type, {i8_pointer_type, i8_pointer_type, i64_type}, false));
+        llvm::FunctionCallee memcmp_function = m_module->getOrInsertFunction("memcmp", llvm::FunctionType::get(i32_type, {i8_pointer_type, i8_pointer_type, i64_type}, false));
+        m_malloc = llvm::cast<llvm::Function>(m_module->getOrInsertFunction("malloc", llvm::FunctionType::get(i8_pointer_type, {i64_type}, false)).getCallee());
+
+        llvm::GlobalVariable* stderr_variable = new llvm::GlobalVariable(*m_module, i8_pointer_type, false, llvm::GlobalValue::ExternalLinkage, nullptr, "stderr");
+
+        /********************************************************************************************************/
+        /* void lang.runtime_error(i8* format, i32 line, i32 first_argument, i32 second_argument), it does not return */
+        m_runtime_error = this->runtime_function("lang.runtime_error", llvm::FunctionType::get(void_type, {i8_pointer_type, i32_type, i32_type, i32_type}, false));
+        m_runtime_error->addFnAttr(llvm::Attribute::NoReturn);
+        m_runtime_error->addFnAttr(llvm::Attribute::Cold);
+        m_runtime_error->addFnAttr(llvm::Attribute::NoInline);
+        if(!m_is_worker)
+        {
+            llvm::Value* error_stream = m_builder->CreateLoad(i8_pointer_type, stderr_variable);
+            m_builder->CreateCall(fprintf_function, {error_stream, m_runtime_error->getArg(0), m_runtime_error->getArg(2), m_runtime_error->getArg(3)});
+            m_builder->CreateCall(fprintf_function, {error_stream, this->c_string("\n[line %d] in script\n", "lang.error_line"), m_runtime_error->getArg(1)});
+            m_builder->CreateCall(exit_function, {m_builder->getInt32(RUNTIME_ERROR_STATUS)});
+            m_builder->CreateUnreachable();
+        }
+
+        /********************************************************************************************************/
+        /* void lang.print(double value) */
+        m_print = this->runtime_function("lang.print", llvm::FunctionType::get(void_type, {double_type}, false));
+        if(!m_is_worker)
+        {
+            llvm::Value* value = m_print->getArg(0);
+
+            llvm::BasicBlock* number_block = this->create_BB("number", m_print);
+            llvm::BasicBlock* other_block = this->create_BB("other", m_print);
+            llvm::BasicBlock* true_block = this->create_BB("true", m_print);
+            llvm::BasicBlock* false_block = this->create_BB("false", m_print);
+            llvm::BasicBlock* nil_block = this->create_BB("nil", m_print);
+            llvm::BasicBlock* object_block = this->create_BB("object", m_print);
+            llvm::BasicBlock* string_block = this->create_BB("string", m_print);
+            llvm::BasicBlock* closure_block = this->create_BB("closure", m_print);
+
+            m_builder->CreateCondBr(this->is_number(value), number_block, other_block);
+
+            m_builder->SetInsertPoint(number_block);
+            m_builder->CreateCall(printf_function, {this->c_string("%g\n", "lang.number_format"), value});
+            m_builder->CreateRetVoid();
+
+            m_builder->SetInsertPoint(other_block);
+            llvm::SwitchInst* switch_instruction = m_builder->CreateSwitch(this->value_bits(value), object_block, 3);
+            switch_instruction->addCase(m_builder->getInt64(TRUE_VALUE), true_block);
+            switch_instruction->addCase(m_builder->getInt64(FALSE_VALUE), false_block);
+            switch_instruction->addCase(m_builder->getInt64(NIL_VALUE), nil_block);
+
+            std::pair<llvm::BasicBlock*, const char*> constants[] = {{true_block, "true\n"}, {false_block, "false\n"}, {nil_block, "nil\n"}};
+            for(auto [block, text]: constants)
+            {
+                m_builder->SetInsertPoint(block);
+                m_builder->CreateCall(printf_function, {this->c_string(text, "lang.constant_text")});
+                m_builder->CreateRetVoid();
+            }
+
+            m_builder->SetInsertPoint(object_block);
+            llvm::Value* object = this->unbox_object(value);
+            llvm::Value* kind = m_builder->CreateLoad(i8_type, object, "kind");
+            m_builder->CreateCondBr(m_builder->CreateICmpEQ(kind, m_builder->getInt8(STRING_OBJECT)), string_block, closure_block);
+
+            m_builder->SetInsertPoint(string_block);
+            llvm::Value* string = m_builder->CreateBitCast(object, m_string_type->getPointerTo());
+            llvm::Value* length = m_builder->CreateLoad(i64_type, m_builder->CreateStructGEP(m_string_type, string, 1), "length");
+            llvm::Value* characters = m_builder->CreateLoad(i8_pointer_type, m_builder->CreateStructGEP(m_string_type, string, 2), "characters");
+            m_builder->CreateCall(printf_function, {this->c_string("%.*s\n", "lang.string_format"), m_builder->CreateTrunc(length, i32_type), characters});
+            m_builder->CreateRetVoid();
+
+            m_builder->SetInsertPoint(closure_block);
+            llvm::Value* closure = m_builder->CreateBitCast(object, m_closure_type->getPointerTo());
+            llvm::Value* name = m_builder->CreateLoad(i8_pointer_type, m_builder->CreateStructGEP(m_closure_type, closure, 2), "name");
+            m_builder->CreateCall(printf_function, {this->c_string("<fn %s>\n", "lang.function_format"), name});
+            m_builder->CreateRetVoid();
+        }
+
+        /********************************************************************************************************/
+        /* double lang.add(double left, double right, i32 line), '+' of operands which are not both numbers */
+        m_add = this->runtime_function("lang.add", llvm::FunctionType::get(double_type, {double_type, double_type, i32_type}, false));
+        if(!m_is_worker)
+        {
+            llvm::Value* left = m_add->getArg(0);
+            llvm::Value* right = m_add->getArg(1);
+
+            llvm::BasicBlock* objects_block = this->create_BB("objects", m_add);
+            llvm::BasicBlock* concatenate_block = this->create_BB("concatenate", m_add);
+            llvm::BasicBlock* error_block = this->create_BB("error", m_add);
+
+            llvm::Value* objects = m_builder->CreateAnd(this->is_object(left), this->is_object(right));
+            m_builder->CreateCondBr(objects, objects_block, error_block);
+
+            m_builder->SetInsertPoint(objects_block);
+            llvm::Value* left_object = this->unbox_object(left);
+            llvm::Value* right_object = this->unbox_object(right);
+            llvm::Value* left_is_string = m_builder->CreateICmpEQ(m_builder->CreateLoad(i8_type, left_object), m_builder->getInt8(STRING_OBJECT));
+            llvm::Value* right_is_string = m_builder->CreateICmpEQ(m_builder->CreateLoad(i8_type, right_object), m_builder->getInt8(STRING_OBJECT));
+            m_builder->CreateCondBr(m_builder->CreateAnd(left_is_string, right_is_string), concatenate_block, error_block);
+
+            m_builder->SetInsertPoint(concatenate_block);
+            llvm::Value* left_string = m_builder->CreateBitCast(left_object, m_string_type->getPointerTo());
+            llvm::Value* right_string = m_builder->CreateBitCast(right_object, m_string_type->getPointerTo());
+            llvm::Value* left_length = m_builder->CreateLoad(i64_type, m_builder->CreateStructGEP(m_string_type, left_string, 1));
+            llvm::Value* right_length = m_builder->CreateLoad(i64_type, m_builder->CreateStructGEP(m_string_type, right_string, 1));
+            llvm::Value* left_characters = m_builder->CreateLoad(i8_pointer_type, m_builder->CreateStructGEP(m_string_type, left_string, 2));
+            llvm::Value* right_characters = m_builder->CreateLoad(i8_pointer_type, m_builder->CreateStructGEP(m_string_type, right_string, 2));
+
+            llvm::Value* length = m_builder->CreateAdd(left_length, right_length, "length");
+            llvm::Value* characters = m_builder->CreateCall(m_malloc, {m_builder->CreateAdd(length, m_builder->getInt64(1))}, "characters");
+            m_builder->CreateCall(memcpy_function, {characters, left_characters, left_length});
+            m_builder->CreateCall(memcpy_function, {m_builder->CreateGEP(i8_type, characters, left_length), right_characters, right_length});
+            m_builder->CreateStore(m_builder->getInt8(0), m_builder->CreateGEP(i8_type, characters, length));
+
+            llvm::Value* result = m_builder->CreateBitCast(m_builder->CreateCall(m_malloc, {llvm::ConstantExpr::getSizeOf(m_string_type)}), m_string_type->getPointerTo(), "result");
+            m_builder->CreateStore(m_builder->getInt8(STRING_OBJECT), m_builder->CreateStructGEP(m_string_type, result, 0));
+            m_builder->CreateStore(length, m_builder->CreateStructGEP(m_string_type, result, 1));
+            m_builder->CreateStore(characters, m_builder->CreateStructGEP(m_string_type, result, 2));
+            m_builder->CreateRet(this->box_object(result));
+
+            m_builder->SetInsertPoint(error_block);
+            this->call_runtime_error(this->c_string("Operands must be two numbers or two strings.", "lang.message"), m_add->getArg(2));
+        }
+
+        /********************************************************************************************************/
+        /* i1 lang.equal(double left, double right), '==' of operands which are not both numbers. Strings are equal by contents */
+        m_equal = this->runtime_function("lang.equal", llvm::FunctionType::get(m_builder->getInt1Ty(), {double_type, double_type}, false));
+        if(!m_is_worker)
+        {
+            llvm::Value* left = m_equal->getArg(0);
+            llvm::Value* right = m_equal->getArg(1);
+
+            llvm::BasicBlock* different_block = this->create_BB("different", m_equal);
+            llvm::BasicBlock* objects_block = this->create_BB("objects", m_equal);
+            llvm::BasicBlock* strings_block = this->create_BB("strings", m_equal);
+            llvm::BasicBlock* compare_block = this->create_BB("compare", m_equal);
+            llvm::BasicBlock* equal_block = this->create_BB("equal", m_equal);
+            llvm::BasicBlock* not_equal_block = this->create_BB("not_equal", m_equal);
+
+            /* The same bits are the same value, nil, a boolean or the same object */
+            m_builder->CreateCondBr(m_builder->CreateICmpEQ(this->value_bits(left), this->value_bits(right)), equal_block, different_block);
+
+            m_builder->SetInsertPoint(different_block);
+            m_builder->CreateCondBr(m_builder->CreateAnd(this->is_object(left), this->is_object(right)), objects_block, not_equal_block);
+
+            m_builder->SetInsertPoint(objects_block);
+            llvm::Value* left_object = this->unbox_object(left);
+            llvm::Value* right_object = this->unbox_object(right);
+            llvm::Value* left_is_string = m_builder->CreateICmpEQ(m_builder->CreateLoad(i8_type, left_object), m_builder->getInt8(STRING_OBJECT));
+            llvm::Value* right_is_string = m_builder->CreateICmpEQ(m_builder->CreateLoad(i8_type, right_object), m_builder->getInt8(STRING_OBJECT));
+            m_builder->CreateCondBr(m_builder->CreateAnd(left_is_string, right_is_string), strings_block, not_equal_block);
+
+            m_builder->SetInsertPoint(strings_block);
+            llvm::Value* left_string = m_builder->CreateBitCast(left_object, m_string_type->getPointerTo());
+            llvm::Value* right_string = m_builder->CreateBitCast(right_object, m_string_type->getPointerTo());
+            llvm::Value* left_length = m_builder->CreateLoad(i64_type, m_builder->CreateStructGEP(m_string_type, left_string, 1));
+            llvm::Value* right_length = m_builder->CreateLoad(i64_type, m_builder->CreateStructGEP(m_string_type, right_string, 1));
+            m_builder->CreateCondBr(m_builder->CreateICmpEQ(left_length, right_length), compare_block, not_equal_block);
+
+            m_builder->SetInsertPoint(compare_block);
+            llvm::Value* left_characters = m_builder->CreateLoad(i8_pointer_type, m_builder->CreateStructGEP(m_string_type, left_string, 2));
+            llvm::Value* right_characters = m_builder->CreateLoad(i8_pointer_type, m_builder->CreateStructGEP(m_string_type, right_string, 2));
+            llvm::Value* difference = m_builder->CreateCall(memcmp_function, {left_characters, right_characters, left_length});
+            m_builder->CreateRet(m_builder->CreateICmpEQ(difference, m_builder->getInt32(0)));
+
+            m_builder->SetInsertPoint(equal_block);
+            m_builder->CreateRet(m_builder->getTrue());
+
+            m_builder->SetInsertPoint(not_equal_block);
+            m_builder->CreateRet(m_builder->getFalse());
+        }
+
+        /********************************************************************************************************/
+        /* i8* lang.callee(double callee, i32 argument_count, i32 line), the closure to call, after checking it is one taking that many arguments */
+        m_callee = this->runtime_function("lang.callee", llvm::FunctionType::get(i8_pointer_type, {double_type, i32_type, i32_type}, false));
+        if(!m_is_worker)
+        {
+            llvm::Value* callee = m_callee->getArg(0);
+            llvm::Value* argument_count = m_callee->getArg(1);
+            llvm::Value* line = m_callee->getArg(2);
+
+            llvm::BasicBlock* object_block = this->create_BB("object", m_callee);
+            llvm::BasicBlock* closure_block = this->create_BB("closure", m_callee);
+            llvm::BasicBlock* valid_block = this->create_BB("valid", m_callee);
+            llvm::BasicBlock* not_callable_block = this->create_BB("not_callable", m_callee);
+            llvm::BasicBlock* arity_block = this->create_BB("arity_mismatch", m_callee);
+
+            m_builder->CreateCondBr(this->is_object(callee), object_block, not_callable_block);
+
+            m_builder->SetInsertPoint(object_block);
+            llvm::Value* object = this->unbox_object(callee);
+            llvm::Value* kind = m_builder->CreateLoad(i8_type, object, "kind");
+            m_builder->CreateCondBr(m_builder->CreateICmpEQ(kind, m_builder->getInt8(CLOSURE_OBJECT)), closure_block, not_callable_block);
+
+            m_builder->SetInsertPoint(closure_block);
+            llvm::Value* closure = m_builder->CreateBitCast(object, m_closure_type->getPointerTo());
+            llvm::Value* arity = m_builder->CreateLoad(i32_type, m_builder->CreateStructGEP(m_closure_type, closure, 3), "arity");
+            m_builder->CreateCondBr(m_builder->CreateICmpEQ(arity, argument_count), valid_block, arity_block);
+
+            m_builder->SetInsertPoint(valid_block);
+            m_builder->CreateRet(object);
+
+            m_builder->SetInsertPoint(not_callable_block);
+            this->call_runtime_error(this->c_string("Can only call functions.", "lang.message"), line);
+
+            m_builder->SetInsertPoint(arity_block);
+            this->call_runtime_error(this->c_string("Expected %d arguments but got %d.", "lang.message"), line, arity, argument_count);
+        }
+    }
+
+    llvm::Function* Generator::runtime_function(const std::string& name, llvm::FunctionType* type)
+    {
+        /* A worker only declares it, the primary module of generate_parallel() defines it for every worker to link against */
+        llvm::Function* function = this->create_function_proto(name, type);
+
+        if(m_is_worker)
+        {
+            return function;
+        }
+
+        function->setLinkage(m_shares_symbols ? llvm::GlobalValue::ExternalLinkage : llvm::GlobalValue::InternalLinkage);
+        this->create_function_block(function);
+
+        return function;
+    }
+
+    /**********************************************************************************************************************8*/
+    llvm::Constant* Generator::constant_value(std::uint64_t bits)
+    {
+        return llvm::ConstantFP::get(*m_ctx, llvm::APFloat(llvm::APFloat::IEEEdouble(), llvm::APInt(64, bits)));
+    }
+
+    llvm::Constant* Generator::nil_value()
+    {
+        return this->constant_value(NIL_VALUE);
+    }
+
+    llvm::Value* Generator::number_value(double number)
+    {
+        return llvm::ConstantFP::get(m_builder->getDoubleTy(), number);
+    }
+
+    llvm::Value* Generator::boolean_value(llvm::Value* condition)
+    {
+        return m_builder->CreateSelect(condition, this->constant_value(TRUE_VALUE), this->constant_value(FALSE_VALUE));
+    }
+
+    llvm::Value* Generator::value_bits(llvm::Value* value)
+    {
+        return m_builder->CreateBitCast(value, m_builder->getInt64Ty());
+    }
+
+    llvm::Value* Generator::is_number(llvm::Value* value)
+    {
+        /* Every boxed value has all the bits of QUIET_NAN set, the NaN arithmetic produces does not */
+        llvm::Value* nan_bits = m_builder->CreateAnd(this->value_bits(value), m_builder->getInt64(QUIET_NAN));
+        return m_builder->CreateICmpNE(nan_bits, m_builder->getInt64(QUIET_NAN), "is_number");
+    }
+
+    llvm::Value* Generator::is_object(llvm::Value* value)
+    {
+        llvm::Value* tag_bits = m_builder->CreateAnd(this->value_bits(value), m_builder->getInt64(OBJECT_TAG));
+        return m_builder->CreateICmpEQ(tag_bits, m_builder->getInt64(OBJECT_TAG), "is_object");
+    }
+
+    llvm::Value* Generator::is_truthy(llvm::Value* value)
+    {
+        llvm::Value* bits = this->value_bits(value);
+        llvm::Value* not_false = m_builder->CreateICmpNE(bits, m_builder->getInt64(FALSE_VALUE));
+        llvm::Value* not_nil = m_builder->CreateICmpNE(bits, m_builder->getInt64(NIL_VALUE));
+
+        return m_builder->CreateAnd(not_false, not_nil, "is_truthy");
+    }
+
+    llvm::Value* Generator::box_object(llvm::Value* pointer)
+    {
+        llvm::Value* address = m_builder->CreatePtrToInt(pointer, m_builder->getInt64Ty());
+        return m_builder->CreateBitCast(m_builder->CreateOr(address, m_builder->getInt64(OBJECT_TAG)), m_builder->getDoubleTy());
+    }
+
+    llvm::Value* Generator::unbox_object(llvm::Value* value)
+    {
+        llvm::Value* address = m_builder->CreateAnd(this->value_bits(value), m_builder->getInt64(ADDRESS_MASK));
+        return m_builder->CreateIntToPtr(address, m_builder->getInt8PtrTy(), "object");
+    }
+
+    void Generator::check(llvm::Value* condition, const char* message, int line)
+    {
+        llvm::Function* function = m_builder->GetInsertBlock()->getParent();
+
+        llvm::BasicBlock* valid_block = this->create_BB("valid");
+        llvm::BasicBlock* error_block = this->create_BB("error", function);
+
+        m_builder->CreateCondBr(condition, valid_block, error_block);
+
+        m_builder->SetInsertPoint(error_block);
+        this->call_runtime_error(this->c_string(message, "lang.message"), m_builder->getInt32(line));
+
+        this->start_block(valid_block);
+    }
+
+    void Generator::call_runtime_error(llvm::Value* message, llvm::Value* line, llvm::Value* first_argument, llvm::Value* second_argument)
+    {
+        first_argument = first_argument != nullptr ? first_argument : m_builder->getInt32(0);
+        second_argument = second_argument != nullptr ? second_argument : m_builder->getInt32(0);
+
+        m_builder->CreateCall(m_runtime_error, {message, line, first_argument, second_argument});
+        m_builder->CreateUnreachable();
+    }
+
+    llvm::FunctionType* Generator::function_type(std::size_t parameter_count)
+    {
+        std::vector<llvm::Type*> parameters(parameter_count + 1, m_builder->getDoubleTy());
+        parameters[0] = m_builder->getInt8PtrTy();
+
+        return llvm::FunctionType::get(m_builder->getDoubleTy(), parameters, false);
+    }
+
+    llvm::Value* Generator::c_string(std::string_view string, const char* name)
+    {
+        auto [position, inserted] = m_c_strings.try_emplace(string, nullptr);
+
+        if(inserted)
+        {
+            position->second = m_builder->CreateGlobalStringPtr(llvm::StringRef{string.data(), string.size()}, name, 0, m_module.get());
+        }
+
+        return position->second;
+    }
+}
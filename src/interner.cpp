@@ -0,0 +1,55 @@
+#include <symbol/interner.hpp>
+
+#include <mutex>
+
+namespace lang
+{
+    lang::Interner& Interner::global()
+    {
+        static lang::Interner interner;
+        return interner;
+    }
+
+    lang::Symbol Interner::intern(std::string_view name)
+    {
+        /* Nearly every lookup is for a name which is already known, so try under the shared lock first */
+        {
+            std::shared_lock lock(m_mutex);
+
+            auto it = m_symbols.find(name);
+            if(it != m_symbols.end())
+            {
+                return it->second;
+            }
+        }
+
+        std::unique_lock lock(m_mutex);
+
+        /* Another thread may have added it in the meantime */
+        auto it = m_symbols.find(name);
+        if(it != m_symbols.end())
+        {
+            return it->second;
+        }
+
+        std::string_view stored_name = m_storage.emplace_back(name);
+        lang::Symbol symbol = static_cast<lang::Symbol>(m_names.size());
+
+        m_names.push_back(stored_name);
+        m_symbols.emplace(stored_name, symbol);
+
+        return symbol;
+    }
+
+    std::string_view Interner::name(lang::Symbol symbol) const
+    {
+        std::shared_lock lock(m_mutex);
+        return m_names.at(symbol);
+    }
+
+    std::size_t Interner::size() const
+    {
+        std::shared_lock lock(m_mutex);
+        return m_names.size();
+    }
+}
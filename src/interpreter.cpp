@@ -0,0 +1,1099 @@
+#include <interpreter/interpreter.hpp>
+#include <jit/tier_compiler.hpp>
+#include <runtime/operations.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <utility>
+
+namespace lang
+{
+    namespace
+    {
+        using lang::runtime::Closure;
+
+        /* The interpreter the closures created by it come back to, there is one running at a time */
+        Interpreter* s_active_interpreter = nullptr;
+
+        using lang::runtime::bits_of;
+        using lang::runtime::boolean_value;
+        using lang::runtime::box_object;
+        using lang::runtime::exit_program;
+        using lang::runtime::is_number;
+        using lang::runtime::is_object;
+        using lang::runtime::is_string;
+        using lang::runtime::is_truthy;
+        using lang::runtime::runtime_error;
+        using lang::runtime::unbox_object;
+        using lang::runtime::NIL_DOUBLE;
+
+        /**********************************************************************************************************************8*/
+        /* Calls between the interpreter and compiled code, whose functions take the closure and every argument as a double */
+        template<std::size_t>
+        using DoubleArgument = double;
+
+        template<std::size_t... Index>
+        double call_code(void* code, Closure* closure, const double* arguments, std::index_sequence<Index...>)
+        {
+            return reinterpret_cast<double (*)(void*, DoubleArgument<Index>...)>(code)(closure, arguments[Index]...);
+        }
+
+        template<std::size_t ArgumentCount>
+        double call_code(void* code, Closure* closure, const double* arguments)
+        {
+            return call_code(code, closure, arguments, std::make_index_sequence<ArgumentCount>{});
+        }
+
+        template<std::size_t... Index>
+        double interpreted_entry(void* closure, DoubleArgument<Index>... arguments)
+        {
+            const double values[] = {arguments..., 0.0};
+            return s_active_interpreter->call_from_native(static_cast<Closure*>(closure), values);
+        }
+
+        template<std::size_t... Index>
+        void* interpreted_entry_address(std::index_sequence<Index...>)
+        {
+            return reinterpret_cast<void*>(&interpreted_entry<Index...>);
+        }
+
+        using CodeCall = double (*)(void*, Closure*, const double*);
+
+        template<std::size_t... ArgumentCount>
+        std::array<CodeCall, sizeof...(ArgumentCount)> code_calls(std::index_sequence<ArgumentCount...>)
+        {
+            return {&call_code<ArgumentCount>...};
+        }
+
+        template<std::size_t... ArgumentCount>
+        std::array<void*, sizeof...(ArgumentCount)> interpreted_entries(std::index_sequence<ArgumentCount...>)
+        {
+            return {interpreted_entry_address(std::make_index_sequence<ArgumentCount>{})...};
+        }
+
+        /* Indexed by the argument count */
+        const std::array<CodeCall, Interpreter::MAX_NATIVE_ARITY + 1> CODE_CALLS = code_calls(std::make_index_sequence<Interpreter::MAX_NATIVE_ARITY + 1>{});
+        const std::array<void*, Interpreter::MAX_NATIVE_ARITY + 1> INTERPRETED_ENTRIES = interpreted_entries(std::make_index_sequence<Interpreter::MAX_NATIVE_ARITY + 1>{});
+
+        /**********************************************************************************************************************8*/
+        struct FunctionScan
+        {
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> upvalues; /* (depth, slot) */
+            bool fits_native_calls{true};
+        };
+
+        /*
+            The variables of enclosing functions the statements of a function body refer to, themselves or through the functions
+            nested in them, and whether every call and every function in them stays within Interpreter::MAX_NATIVE_ARITY arguments
+        */
+        FunctionScan scan_statements(const std::vector<lang::ast::Statement*>& statements)
+        {
+            FunctionScan scan;
+
+            /* 'level' counts the functions between the node and the body the statements are in */
+            struct Node
+            {
+                lang::ast::Statement* statement;
+                lang::ast::Expression* expression;
+                std::uint32_t level;
+            };
+
+            std::vector<Node> nodes;
+            for(lang::ast::Statement* statement: statements)
+            {
+                nodes.push_back(Node{statement, nullptr, 0});
+            }
+
+            auto reference = [&scan](const lang::ast::Binding& binding, std::uint32_t level)
+            {
+                if(binding.is_global() || binding.depth <= level)
+                {
+                    return;
+                }
+
+                std::pair<std::uint32_t, std::uint32_t> upvalue{binding.depth - level, binding.slot};
+                if(std::find(scan.upvalues.begin(), scan.upvalues.end(), upvalue) == scan.upvalues.end())
+                {
+                    scan.upvalues.push_back(upvalue);
+                }
+            };
+
+            while(!nodes.empty())
+            {
+                Node node = nodes.back();
+                nodes.pop_back();
+
+                auto push_statement = [&nodes, &node](lang::ast::Statement* statement)
+                {
+                    if(statement != nullptr)
+                    {
+                        nodes.push_back(Node{statement, nullptr, node.level});
+                    }
+                };
+                auto push_expression = [&nodes, &node](lang::ast::Expression* expression)
+                {
+                    if(expression != nullptr)
+                    {
+                        nodes.push_back(Node{nullptr, expression, node.level});
+                    }
+                };
+
+                if(node.statement != nullptr)
+                {
+                    switch(node.statement->kind)
+                    {
+                        case lang::ast::StatementKind::EXPRESSION: push_expression(static_cast<lang::ast::ExpressionStatement*>(node.statement)->expr); break;
+                        case lang::ast::StatementKind::PRINT: push_expression(static_cast<lang::ast::PrintStatement*>(node.statement)->expr); break;
+                        case lang::ast::StatementKind::VAR: push_expression(static_cast<lang::ast::VarStatement*>(node.statement)->initializer); break;
+                        case lang::ast::StatementKind::RETURN: push_expression(static_cast<lang::ast::ReturnStatement*>(node.statement)->expr); break;
+
+                        case lang::ast::StatementKind::BLOCK:
+                            for(lang::ast::Statement* statement: static_cast<lang::ast::BlockStatement*>(node.statement)->statements)
+                            {
+                                push_statement(statement);
+                            }
+                            break;
+
+                        case lang::ast::StatementKind::IF:
+                        {
+                            lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(node.statement);
+                            push_expression(if_statement->condition);
+                            push_statement(if_statement->thenBranch);
+                            push_statement(if_statement->elseBranch);
+                            break;
+                        }
+
+                        case lang::ast::StatementKind::WHILE:
+                        {
+                            lang::ast::WhileStatement* while_statement = static_cast<lang::ast::WhileStatement*>(node.statement);
+                            push_expression(while_statement->condition_expr);
+                            push_statement(while_statement->body_stmt);
+                            break;
+                        }
+
+                        case lang::ast::StatementKind::FUNCTION:
+                        {
+                            lang::ast::FunctionStatement* nested = static_cast<lang::ast::FunctionStatement*>(node.statement);
+                            scan.fits_native_calls = scan.fits_native_calls && nested->params.size() <= Interpreter::MAX_NATIVE_ARITY;
+
+                            for(lang::ast::Statement* statement: nested->body_stmts)
+                            {
+                                nodes.push_back(Node{statement, nullptr, node.level + 1});
+                            }
+                            break;
+                        }
+                    }
+                    continue;
+                }
+
+                switch(node.expression->kind)
+                {
+                    case lang::ast::ExpressionKind::LITERAL:
+                        break;
+
+                    case lang::ast::ExpressionKind::VARIABLE:
+                        reference(static_cast<lang::ast::VariableExpression*>(node.expression)->binding, node.level);
+                        break;
+
+                    case lang::ast::ExpressionKind::ASSIGNMENT:
+                    {
+                        lang::ast::AssignmentExpression* assignment = static_cast<lang::ast::AssignmentExpression*>(node.expression);
+                        reference(assignment->binding, node.level);
+                        push_expression(assignment->expr);
+                        break;
+                    }
+
+                    case lang::ast::ExpressionKind::GROUPING: push_expression(static_cast<lang::ast::GroupingExpression*>(node.expression)->expr); break;
+                    case lang::ast::ExpressionKind::UNARY: push_expression(static_cast<lang::ast::UnaryExpression*>(node.expression)->expr); break;
+
+                    case lang::ast::ExpressionKind::BINARY:
+                        push_expression(static_cast<lang::ast::BinaryExpression*>(node.expression)->left);
+                        push_expression(static_cast<lang::ast::BinaryExpression*>(node.expression)->right);
+                        break;
+
+                    case lang::ast::ExpressionKind::LOGICAL:
+                        push_expression(static_cast<lang::ast::LogicalExpression*>(node.expression)->left);
+                        push_expression(static_cast<lang::ast::LogicalExpression*>(node.expression)->right);
+                        break;
+
+                    case lang::ast::ExpressionKind::CALL:
+                    {
+                        lang::ast::CallExpression* call = static_cast<lang::ast::CallExpression*>(node.expression);
+                        scan.fits_native_calls = scan.fits_native_calls && call->arguments.size() <= Interpreter::MAX_NATIVE_ARITY;
+
+                        push_expression(call->callee);
+                        for(lang::ast::Expression* argument: call->arguments)
+                        {
+                            push_expression(argument);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            return scan;
+        }
+
+        FunctionScan scan_function(lang::ast::FunctionStatement* function)
+        {
+            FunctionScan scan = scan_statements({function->body_stmts.begin(), function->body_stmts.end()});
+            scan.fits_native_calls = scan.fits_native_calls && function->params.size() <= Interpreter::MAX_NATIVE_ARITY;
+
+            return scan;
+        }
+    }
+
+    Interpreter::Interpreter(std::uint32_t tier_up_threshold, unsigned optimization_level)
+        : m_tier_up_threshold(tier_up_threshold), m_optimization_level(optimization_level)
+    {}
+
+    Interpreter::~Interpreter()
+    {
+        /* The compiled code goes away with the compiler */
+        m_tier_compiler.reset();
+    }
+
+    void Interpreter::set_function_body_loader(FunctionBodyLoader loader)
+    {
+        m_function_body_loader = std::move(loader);
+    }
+
+    std::vector<std::string> Interpreter::interpret(const std::vector<lang::ast::Statement*>& statements, std::uint32_t global_count)
+    {
+        s_active_interpreter = this;
+
+        m_errors = std::vector<std::string>();
+        m_stopped = false;
+        m_globals.assign(global_count, NIL_DOUBLE);
+        m_native_symbols = this->native_symbols(statements);
+
+        m_frames.push_back(Frame{nullptr, nullptr, 0, 0, 0});
+
+        for(std::size_t i = statements.size(); i > 0; i--)
+        {
+            this->push(statements[i - 1]);
+        }
+        this->run(0);
+
+        m_frames.clear();
+        m_locals.clear();
+        m_boxes.clear();
+
+        return std::move(m_errors);
+    }
+
+    double Interpreter::call_from_native(lang::runtime::Closure* closure, const double* arguments)
+    {
+        FunctionInfo* function = static_cast<FunctionInfo*>(closure->interpreted);
+
+        if(void* code = function->native_code.load(std::memory_order_acquire))
+        {
+            closure->function = code;
+            m_native_calls++;
+
+            return CODE_CALLS[closure->arity](code, closure, arguments);
+        }
+
+        if(m_stopped || !this->load_function(function))
+        {
+            return NIL_DOUBLE;
+        }
+
+        std::size_t work_floor = m_work.size();
+
+        this->enter_function(closure, function, arguments, m_values.size());
+        this->run(work_floor);
+
+        return m_stopped ? NIL_DOUBLE : this->pop_value();
+    }
+
+    Interpreter::Statistics Interpreter::statistics() const
+    {
+        Statistics statistics;
+        statistics.hot_functions = m_hot_functions;
+        statistics.hot_loops = m_hot_loops;
+        statistics.compiled = m_tier_compiler != nullptr ? m_tier_compiler->compiled_count() : 0;
+        statistics.native_calls = m_native_calls;
+        statistics.native_loops = m_native_loops;
+
+        return statistics;
+    }
+
+    /**********************************************************************************************************************8*/
+    void Interpreter::run(std::size_t work_floor)
+    {
+        while(m_work.size() > work_floor && !m_stopped)
+        {
+            Work work = m_work.back();
+            m_work.pop_back();
+
+            switch(work.kind)
+            {
+                case Work::Kind::STATEMENT:
+                    this->execute_statement(work.statement);
+                    break;
+
+                case Work::Kind::EXPRESSION:
+                    this->evaluate_expression(work.expression);
+                    break;
+
+                case Work::Kind::DISCARD:
+                    m_values.pop_back();
+                    break;
+
+                case Work::Kind::PRINT:
+                    lang::runtime::print(this->pop_value());
+                    break;
+
+                case Work::Kind::DEFINE_VAR:
+                {
+                    lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(work.statement);
+                    double value = this->pop_value();
+
+                    double* address = var->binding.is_global() ? &m_globals[var->binding.slot] : this->declare_local(var->binding.slot, var->captured);
+                    *address = value;
+                    break;
+                }
+
+                case Work::Kind::IF_BRANCH:
+                {
+                    lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(work.statement);
+                    this->push(is_truthy(this->pop_value()) ? if_statement->thenBranch : if_statement->elseBranch);
+                    break;
+                }
+
+                case Work::Kind::WHILE_CONDITION:
+                {
+                    if(work.loop != nullptr)
+                    {
+                        if(void* code = work.loop->native_code.load(std::memory_order_acquire))
+                        {
+                            this->run_compiled_loop(work.loop, code);
+                            break;
+                        }
+
+                        this->count_hotness(work.loop);
+                    }
+
+                    this->push(Work::Kind::WHILE_BODY, work.statement, nullptr, work.loop);
+                    this->push(static_cast<lang::ast::WhileStatement*>(work.statement)->condition_expr);
+                    break;
+                }
+
+                case Work::Kind::WHILE_BODY:
+                {
+                    if(!is_truthy(this->pop_value()))
+                    {
+                        break;
+                    }
+
+                    /* The body loops back to the condition */
+                    this->count_hotness(m_frames.back().function);
+
+                    this->push(Work::Kind::WHILE_CONDITION, work.statement, nullptr, work.loop);
+                    this->push(static_cast<lang::ast::WhileStatement*>(work.statement)->body_stmt);
+                    break;
+                }
+
+                case Work::Kind::FUNCTION_END:
+                    /* Falling off the end returns nil */
+                    this->leave_function(NIL_DOUBLE);
+                    break;
+
+                case Work::Kind::RETURN:
+                    this->leave_function(this->pop_value());
+                    break;
+
+                case Work::Kind::UNARY:
+                {
+                    lang::ast::UnaryExpression* unary = static_cast<lang::ast::UnaryExpression*>(work.expression);
+                    double operand = this->pop_value();
+
+                    if(unary->op.m_type == lang::TokenType::BANG)
+                    {
+                        m_values.push_back(boolean_value(!is_truthy(operand)));
+                        break;
+                    }
+
+                    if(!is_number(operand))
+                    {
+                        runtime_error(unary->op.m_line, "Operand must be a number.");
+                    }
+                    m_values.push_back(-operand);
+                    break;
+                }
+
+                case Work::Kind::BINARY:
+                {
+                    double right = this->pop_value();
+                    double left = this->pop_value();
+
+                    m_values.push_back(this->binary(static_cast<lang::ast::BinaryExpression*>(work.expression), left, right));
+                    break;
+                }
+
+                case Work::Kind::ASSIGN:
+                {
+                    lang::ast::AssignmentExpression* assignment = static_cast<lang::ast::AssignmentExpression*>(work.expression);
+
+                    /* The value stays on m_values, an assignment is an expression */
+                    *this->variable_address(assignment->binding) = m_values.back();
+                    break;
+                }
+
+                case Work::Kind::LOGICAL_RIGHT:
+                {
+                    /* 'and' and 'or' yield one of their operands, the right one is only evaluated if the left one does not decide */
+                    lang::ast::LogicalExpression* logical = static_cast<lang::ast::LogicalExpression*>(work.expression);
+                    bool left_is_truthy = is_truthy(m_values.back());
+
+                    if(left_is_truthy == (logical->op.m_type == lang::TokenType::AND))
+                    {
+                        m_values.pop_back();
+                        this->push(logical->right);
+                    }
+                    break;
+                }
+
+                case Work::Kind::CALL:
+                    this->call(static_cast<lang::ast::CallExpression*>(work.expression));
+                    break;
+            }
+        }
+    }
+
+    /* Children are pushed last to first, so they run in source order */
+    void Interpreter::execute_statement(lang::ast::Statement* statement)
+    {
+        switch(statement->kind)
+        {
+            case lang::ast::StatementKind::EXPRESSION:
+                this->push(Work::Kind::DISCARD, statement, nullptr);
+                this->push(static_cast<lang::ast::ExpressionStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::PRINT:
+                this->push(Work::Kind::PRINT, statement, nullptr);
+                this->push(static_cast<lang::ast::PrintStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::VAR:
+            {
+                lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(statement);
+
+                this->push(Work::Kind::DEFINE_VAR, var, nullptr);
+
+                if(var->initializer != nullptr)
+                {
+                    this->push(var->initializer);
+                }
+                else
+                {
+                    m_values.push_back(NIL_DOUBLE);
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::BLOCK:
+            {
+                lang::ast::BlockStatement* block = static_cast<lang::ast::BlockStatement*>(statement);
+
+                for(std::size_t i = block->statements.size(); i > 0; i--)
+                {
+                    this->push(block->statements[i - 1]);
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::IF:
+                this->push(Work::Kind::IF_BRANCH, statement, nullptr);
+                this->push(static_cast<lang::ast::IfStatement*>(statement)->condition);
+                break;
+
+            case lang::ast::StatementKind::WHILE:
+            {
+                /* Looked up once per execution of the loop, not per iteration */
+                LoopInfo* loop = nullptr;
+
+                if(m_tier_up_threshold != 0)
+                {
+                    std::unique_ptr<LoopInfo>& info = m_loops[static_cast<lang::ast::WhileStatement*>(statement)];
+
+                    if(info == nullptr)
+                    {
+                        info = std::make_unique<LoopInfo>();
+                        info->statement = static_cast<lang::ast::WhileStatement*>(statement);
+                        info->is_requested = false;
+                        info->hotness = 0;
+                        info->frame_size = 0;
+                        info->native_code.store(nullptr, std::memory_order_relaxed);
+                    }
+                    loop = info.get();
+                }
+
+                this->push(Work::Kind::WHILE_CONDITION, statement, nullptr, loop);
+                break;
+            }
+
+            case lang::ast::StatementKind::FUNCTION:
+            {
+                lang::ast::FunctionStatement* function = static_cast<lang::ast::FunctionStatement*>(statement);
+
+                /* The name is in scope in the body, a nested function calling itself captures its own variable */
+                double* address = function->binding.is_global() ? &m_globals[function->binding.slot] : this->declare_local(function->binding.slot, function->captured);
+                *address = this->make_closure(function);
+                break;
+            }
+
+            case lang::ast::StatementKind::RETURN:
+            {
+                lang::ast::ReturnStatement* return_statement = static_cast<lang::ast::ReturnStatement*>(statement);
+
+                this->push(Work::Kind::RETURN, statement, nullptr);
+
+                if(return_statement->expr != nullptr)
+                {
+                    this->push(return_statement->expr);
+                }
+                else
+                {
+                    m_values.push_back(NIL_DOUBLE);
+                }
+                break;
+            }
+        }
+    }
+
+    void Interpreter::evaluate_expression(lang::ast::Expression* expression)
+    {
+        switch(expression->kind)
+        {
+            case lang::ast::ExpressionKind::LITERAL:
+            {
+                lang::ast::LiteralExpression* literal = static_cast<lang::ast::LiteralExpression*>(expression);
+
+                switch(literal->type)
+                {
+                    case lang::ast::LiteralExpression::Type::NIL: m_values.push_back(NIL_DOUBLE); break;
+                    case lang::ast::LiteralExpression::Type::BOOLEAN: m_values.push_back(boolean_value(literal->boolean)); break;
+                    case lang::ast::LiteralExpression::Type::NUMBER: m_values.push_back(literal->number); break;
+                    case lang::ast::LiteralExpression::Type::STRING: m_values.push_back(this->make_string(literal->string)); break;
+                }
+                break;
+            }
+
+            case lang::ast::ExpressionKind::VARIABLE:
+                m_values.push_back(*this->variable_address(static_cast<lang::ast::VariableExpression*>(expression)->binding));
+                break;
+
+            case lang::ast::ExpressionKind::GROUPING:
+                this->push(static_cast<lang::ast::GroupingExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::UNARY:
+                this->push(Work::Kind::UNARY, nullptr, expression);
+                this->push(static_cast<lang::ast::UnaryExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::BINARY:
+                this->push(Work::Kind::BINARY, nullptr, expression);
+                this->push(static_cast<lang::ast::BinaryExpression*>(expression)->right);
+                this->push(static_cast<lang::ast::BinaryExpression*>(expression)->left);
+                break;
+
+            case lang::ast::ExpressionKind::LOGICAL:
+                this->push(Work::Kind::LOGICAL_RIGHT, nullptr, expression);
+                this->push(static_cast<lang::ast::LogicalExpression*>(expression)->left);
+                break;
+
+            case lang::ast::ExpressionKind::ASSIGNMENT:
+                this->push(Work::Kind::ASSIGN, nullptr, expression);
+                this->push(static_cast<lang::ast::AssignmentExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::CALL:
+            {
+                lang::ast::CallExpression* call = static_cast<lang::ast::CallExpression*>(expression);
+
+                this->push(Work::Kind::CALL, nullptr, call);
+                for(std::size_t i = call->arguments.size(); i > 0; i--)
+                {
+                    this->push(call->arguments[i - 1]);
+                }
+                this->push(call->callee);
+                break;
+            }
+        }
+    }
+
+    void Interpreter::push(Work::Kind kind, lang::ast::Statement* statement, lang::ast::Expression* expression, LoopInfo* loop)
+    {
+        m_work.push_back(Work{kind, statement, expression, loop});
+    }
+
+    void Interpreter::push(lang::ast::Statement* statement)
+    {
+        if(statement != nullptr)
+        {
+            this->push(Work::Kind::STATEMENT, statement, nullptr);
+        }
+    }
+
+    void Interpreter::push(lang::ast::Expression* expression)
+    {
+        this->push(Work::Kind::EXPRESSION, nullptr, expression);
+    }
+
+    double Interpreter::pop_value()
+    {
+        double value = m_values.back();
+        m_values.pop_back();
+
+        return value;
+    }
+
+    /**********************************************************************************************************************8*/
+    void Interpreter::call(lang::ast::CallExpression* expression)
+    {
+        int line = expression->closing_paren.m_line;
+        std::size_t argument_count = expression->arguments.size();
+        std::size_t callee_index = m_values.size() - argument_count - 1;
+
+        double callee = m_values[callee_index];
+
+        if(!is_object(callee) || *unbox_object(callee) != lang::runtime::CLOSURE_OBJECT)
+        {
+            runtime_error(line, "Can only call functions.");
+        }
+
+        Closure* closure = reinterpret_cast<Closure*>(unbox_object(callee));
+
+        if(static_cast<std::size_t>(closure->arity) != argument_count)
+        {
+            runtime_error(line, "Expected %d arguments but got %d.", closure->arity, static_cast<int>(argument_count));
+        }
+
+        const double* arguments = m_values.data() + callee_index + 1;
+        FunctionInfo* function = static_cast<FunctionInfo*>(closure->interpreted);
+
+        if(function != nullptr)
+        {
+            if(void* code = function->native_code.load(std::memory_order_acquire))
+            {
+                /* Swapped in, compiled code calling the closure goes there directly from now on */
+                closure->function = code;
+            }
+            else
+            {
+                if(!this->load_function(function))
+                {
+                    return;
+                }
+
+                this->count_hotness(function);
+
+                /* The callee and the arguments are not part of the frame, the value stack is cut back to below them */
+                this->enter_function(closure, function, arguments, callee_index);
+                return;
+            }
+        }
+
+        /* A closure created by compiled code, or one whose function was compiled since */
+        m_native_calls++;
+        double result = CODE_CALLS[argument_count](closure->function, closure, arguments);
+
+        m_values.resize(callee_index);
+        m_values.push_back(result);
+    }
+
+    void Interpreter::enter_function(lang::runtime::Closure* closure, FunctionInfo* function, const double* arguments, std::size_t values_begin)
+    {
+        lang::ast::FunctionStatement* statement = function->statement;
+        std::size_t parameter_count = statement->params.size();
+
+        std::size_t slots_begin = m_locals.size();
+        std::size_t frame_size = std::max<std::size_t>(statement->frame_size, parameter_count);
+        m_locals.resize(slots_begin + frame_size, NIL_DOUBLE);
+        m_boxes.resize(slots_begin + frame_size, nullptr);
+
+        /* Parameters take the first slots */
+        for(std::size_t i = 0; i < parameter_count; i++)
+        {
+            if(i < statement->captured_params.size() && statement->captured_params[i])
+            {
+                m_boxes[slots_begin + i] = static_cast<double*>(std::malloc(sizeof(double)));
+                *m_boxes[slots_begin + i] = arguments[i];
+            }
+            else
+            {
+                m_locals[slots_begin + i] = arguments[i];
+            }
+        }
+
+        /* 'arguments' may point into the value stack, it is only cut back once they are copied */
+        m_values.resize(values_begin);
+
+        m_frames.push_back(Frame{function, closure, slots_begin, m_work.size(), values_begin});
+
+        this->push(Work::Kind::FUNCTION_END, statement, nullptr);
+        for(std::size_t i = statement->body_stmts.size(); i > 0; i--)
+        {
+            this->push(statement->body_stmts[i - 1]);
+        }
+    }
+
+    void Interpreter::leave_function(double result)
+    {
+        Frame frame = m_frames.back();
+        m_frames.pop_back();
+
+        /* A return skips whatever is left of the body */
+        m_work.resize(frame.work_begin);
+        m_values.resize(frame.values_begin);
+        m_locals.resize(frame.slots_begin);
+        m_boxes.resize(frame.slots_begin);
+
+        m_values.push_back(result);
+    }
+
+    bool Interpreter::load_function(FunctionInfo* function)
+    {
+        if(function->is_loaded)
+        {
+            return true;
+        }
+
+        lang::ast::FunctionStatement* statement = function->statement;
+
+        if(!statement->is_body_parsed)
+        {
+            std::vector<std::string> body_errors = m_function_body_loader
+                ? m_function_body_loader(statement)
+                : std::vector<std::string>{"[line " + std::to_string(statement->name.m_line) + "] Error at '" + std::string{statement->name.m_lexeme} + "': Function body was not parsed\n"};
+
+            if(!body_errors.empty())
+            {
+                m_errors.insert(m_errors.end(), std::make_move_iterator(body_errors.begin()), std::make_move_iterator(body_errors.end()));
+                m_stopped = true;
+
+                return false;
+            }
+        }
+
+        /* Only top-level functions are compiled, a function nested in one is compiled with it */
+        if(statement->binding.is_global() && m_tier_up_threshold != 0 && scan_function(statement).fits_native_calls)
+        {
+            function->tier_root = function;
+        }
+
+        function->is_loaded = true;
+        return true;
+    }
+
+    void Interpreter::count_hotness(FunctionInfo* function)
+    {
+        if(function == nullptr || function->tier_root == nullptr || ++function->hotness != m_tier_up_threshold)
+        {
+            return;
+        }
+
+        FunctionInfo* root = function->tier_root;
+
+        if(root->is_requested)
+        {
+            return;
+        }
+        root->is_requested = true;
+        m_hot_functions++;
+
+        if(m_tier_compiler == nullptr)
+        {
+            m_tier_compiler = std::make_unique<lang::TierCompiler>(m_optimization_level, m_native_symbols);
+        }
+
+        /* Symbols of the JIT are never replaced, a function declared again gets a new one */
+        std::string symbol = "lang.tier." + std::to_string(m_hot_functions) + "." + root->name;
+        m_tier_compiler->request_function(root->statement, std::move(symbol), &root->native_code);
+    }
+
+    void Interpreter::count_hotness(LoopInfo* loop)
+    {
+        if(++loop->hotness != m_tier_up_threshold || loop->is_requested)
+        {
+            return;
+        }
+        loop->is_requested = true;
+
+        /* The compiled loop has the frame's slots only, a closure would need the boxes of the enclosing functions */
+        FunctionScan scan = scan_statements({loop->statement});
+        if(!scan.upvalues.empty() || !scan.fits_native_calls)
+        {
+            return;
+        }
+        m_hot_loops++;
+
+        /* Whether a slot is boxed is decided by the declaration in scope, which is the same one every time the loop runs */
+        const Frame& frame = m_frames.back();
+        loop->frame_size = m_locals.size() - frame.slots_begin;
+
+        std::vector<bool> boxed_slots(loop->frame_size);
+        for(std::size_t slot = 0; slot < loop->frame_size; slot++)
+        {
+            boxed_slots[slot] = m_boxes[frame.slots_begin + slot] != nullptr;
+        }
+
+        if(m_tier_compiler == nullptr)
+        {
+            m_tier_compiler = std::make_unique<lang::TierCompiler>(m_optimization_level, m_native_symbols);
+        }
+
+        std::string symbol = "lang.tier.loop." + std::to_string(m_hot_loops);
+        m_tier_compiler->request_loop(loop->statement, std::move(boxed_slots), std::move(symbol), &loop->native_code);
+    }
+
+    void Interpreter::run_compiled_loop(LoopInfo* loop, void* code)
+    {
+        lang::runtime::Closure* closure = m_frames.back().closure;
+        std::size_t slots_begin = m_frames.back().slots_begin;
+
+        /* The top-level frame may have fewer slots when the loop runs again, its blocks grow it */
+        if(m_locals.size() < slots_begin + loop->frame_size)
+        {
+            m_locals.resize(slots_begin + loop->frame_size, NIL_DOUBLE);
+            m_boxes.resize(slots_begin + loop->frame_size, nullptr);
+        }
+
+        /* Copies, calls in the loop may come back into the interpreter and grow the slot vectors */
+        std::vector<double> locals(m_locals.begin() + slots_begin, m_locals.begin() + slots_begin + loop->frame_size);
+        std::vector<double*> boxes(m_boxes.begin() + slots_begin, m_boxes.begin() + slots_begin + loop->frame_size);
+
+        m_native_loops++;
+        double result = reinterpret_cast<double (*)(void*, double*, double**)>(code)(closure, locals.data(), boxes.data());
+
+        if(bits_of(result) != lang::runtime::LOOP_EXIT_VALUE)
+        {
+            this->leave_function(result);
+            return;
+        }
+
+        std::copy(locals.begin(), locals.end(), m_locals.begin() + slots_begin);
+    }
+
+    Interpreter::FunctionInfo* Interpreter::function_info(lang::ast::FunctionStatement* function)
+    {
+        std::unique_ptr<FunctionInfo>& info = m_functions[function];
+
+        if(info != nullptr)
+        {
+            return info.get();
+        }
+
+        info = std::make_unique<FunctionInfo>();
+        info->statement = function;
+        info->tier_root = nullptr;
+        info->name = std::string{function->name.m_lexeme};
+        info->is_loaded = false;
+        info->is_requested = false;
+        info->hotness = 0;
+        info->native_code.store(nullptr, std::memory_order_relaxed);
+
+        /* A top-level function uses no local of another one, its body may not even be parsed yet */
+        if(!function->binding.is_global())
+        {
+            for(auto [depth, slot]: scan_function(function).upvalues)
+            {
+                info->upvalues.push_back(UpvalueReference{depth, slot});
+            }
+
+            /* Its body is part of the one of the function around it */
+            FunctionInfo* enclosing = m_frames.back().function;
+            info->tier_root = enclosing != nullptr ? enclosing->tier_root : nullptr;
+            info->is_loaded = true;
+        }
+
+        return info.get();
+    }
+
+    double Interpreter::make_closure(lang::ast::FunctionStatement* function)
+    {
+        FunctionInfo* info = this->function_info(function);
+        std::size_t upvalue_count = info->upvalues.size();
+
+        Closure* closure = static_cast<Closure*>(std::malloc(sizeof(Closure) + upvalue_count * sizeof(double*)));
+        closure->kind = lang::runtime::CLOSURE_OBJECT;
+        closure->name = info->name.c_str();
+        closure->arity = static_cast<std::int32_t>(function->params.size());
+        closure->upvalue_count = static_cast<std::int32_t>(upvalue_count);
+        closure->interpreted = info;
+
+        void* code = info->native_code.load(std::memory_order_acquire);
+        closure->function = code != nullptr ? code : function->params.size() <= MAX_NATIVE_ARITY ? INTERPRETED_ENTRIES[function->params.size()] : nullptr;
+
+        /* The boxes are copied now, from the frame of the function creating the closure, which is the current one */
+        const Frame& frame = m_frames.back();
+
+        for(std::size_t i = 0; i < upvalue_count; i++)
+        {
+            const UpvalueReference& upvalue = info->upvalues[i];
+
+            closure->upvalues()[i] = upvalue.depth == 1
+                ? m_boxes[frame.slots_begin + upvalue.slot]
+                : frame.closure->upvalues()[this->upvalue_index(*frame.function, upvalue.depth - 1, upvalue.slot)];
+        }
+
+        return box_object(closure);
+    }
+
+    /**********************************************************************************************************************8*/
+    double* Interpreter::variable_address(const lang::ast::Binding& binding)
+    {
+        if(binding.is_global())
+        {
+            return &m_globals[binding.slot];
+        }
+
+        const Frame& frame = m_frames.back();
+
+        if(binding.depth == 0)
+        {
+            std::size_t index = frame.slots_begin + binding.slot;
+            return m_boxes[index] != nullptr ? m_boxes[index] : &m_locals[index];
+        }
+
+        return frame.closure->upvalues()[this->upvalue_index(*frame.function, binding.depth, binding.slot)];
+    }
+
+    double* Interpreter::declare_local(std::uint32_t slot, bool captured)
+    {
+        /* The top-level code has no size of its frame up front, its blocks grow it */
+        std::size_t index = m_frames.back().slots_begin + slot;
+
+        if(index >= m_locals.size())
+        {
+            m_locals.resize(index + 1, NIL_DOUBLE);
+            m_boxes.resize(index + 1, nullptr);
+        }
+
+        /* Each execution of the declaration gets a variable of its own, the closures created before keep the old one */
+        m_boxes[index] = captured ? static_cast<double*>(std::malloc(sizeof(double))) : nullptr;
+
+        return captured ? m_boxes[index] : &m_locals[index];
+    }
+
+    std::uint32_t Interpreter::upvalue_index(const FunctionInfo& function, std::uint32_t depth, std::uint32_t slot) const
+    {
+        std::uint32_t index = 0;
+
+        while(function.upvalues[index].depth != depth || function.upvalues[index].slot != slot)
+        {
+            index++;
+        }
+
+        return index;
+    }
+
+    /**********************************************************************************************************************8*/
+    double Interpreter::binary(lang::ast::BinaryExpression* expression, double left, double right)
+    {
+        int line = expression->op.m_line;
+        bool both_numbers = is_number(left) && is_number(right);
+
+        switch(expression->op.m_type)
+        {
+            case lang::TokenType::PLUS:
+                return both_numbers ? left + right : this->concatenate(left, right, line);
+
+            case lang::TokenType::EQUAL_EQUAL:
+            case lang::TokenType::BANG_EQUAL:
+            {
+                bool equal = lang::runtime::values_equal(left, right);
+                return boolean_value(equal == (expression->op.m_type == lang::TokenType::EQUAL_EQUAL));
+            }
+
+            default:
+                break;
+        }
+
+        if(!both_numbers)
+        {
+            runtime_error(line, "Operands must be numbers.");
+        }
+
+        switch(expression->op.m_type)
+        {
+            case lang::TokenType::MINUS: return left - right;
+            case lang::TokenType::STAR: return left * right;
+            case lang::TokenType::SLASH: return left / right;
+
+            case lang::TokenType::GREATER: return boolean_value(left > right);
+            case lang::TokenType::GREATER_EQUAL: return boolean_value(left >= right);
+            case lang::TokenType::LESS: return boolean_value(left < right);
+            case lang::TokenType::LESS_EQUAL: return boolean_value(left <= right);
+
+            default:
+                return NIL_DOUBLE;
+        }
+    }
+
+    double Interpreter::make_string(std::string_view string)
+    {
+        auto [position, inserted] = m_string_values.try_emplace(string, NIL_DOUBLE);
+
+        if(inserted)
+        {
+            m_strings.push_back(lang::runtime::String{lang::runtime::STRING_OBJECT, static_cast<std::int64_t>(string.size()), string.data()});
+            position->second = box_object(&m_strings.back());
+        }
+
+        return position->second;
+    }
+
+    double Interpreter::concatenate(double left, double right, int line)
+    {
+        if(!is_string(left) || !is_string(right))
+        {
+            runtime_error(line, "Operands must be two numbers or two strings.");
+        }
+
+        return lang::runtime::concatenate(left, right);
+    }
+
+    std::vector<std::pair<std::string, void*>> Interpreter::native_symbols(const std::vector<lang::ast::Statement*>& statements)
+    {
+        std::vector<std::pair<std::string, void*>> symbols;
+
+        /* The runtime exits through it, so the process does not run destructors under the compiler's thread either */
+        symbols.emplace_back("exit", reinterpret_cast<void*>(&exit_program));
+
+        /* Every global is declared by a top-level statement, the same one may be declared more than once */
+        std::vector<bool> is_defined(m_globals.size(), false);
+
+        for(lang::ast::Statement* statement: statements)
+        {
+            const lang::Token* name = nullptr;
+            const lang::ast::Binding* binding = nullptr;
+
+            if(lang::ast::VarStatement* var = lang::ast::as<lang::ast::VarStatement>(statement))
+            {
+                name = &var->name;
+                binding = &var->binding;
+            }
+            else if(lang::ast::FunctionStatement* function = lang::ast::as<lang::ast::FunctionStatement>(statement))
+            {
+                name = &function->name;
+                binding = &function->binding;
+            }
+
+            if(binding == nullptr || !binding->is_global() || binding->slot >= m_globals.size() || is_defined[binding->slot])
+            {
+                continue;
+            }
+            is_defined[binding->slot] = true;
+
+            symbols.emplace_back("lang.global." + std::string{name->m_lexeme}, &m_globals[binding->slot]);
+        }
+
+        return symbols;
+    }
+}
@@ -0,0 +1,115 @@
+#include <jit/jit.hpp>
+#include <native/native_emitter.hpp>
+
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+
+namespace lang
+{
+    namespace
+    {
+        std::string error_message(llvm::Error error)
+        {
+            return "[line 0] Error : " + llvm::toString(std::move(error)) + "\n";
+        }
+    }
+
+    Jit::Jit(llvm::ObjectCache* object_cache)
+        : m_object_cache(object_cache)
+    {
+        lang::NativeEmitter::initialize_native_target();
+    }
+
+    Jit::~Jit()
+    {}
+
+    std::vector<std::string> Jit::run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module)
+    {
+        llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = this->create_jit();
+
+        if(!jit)
+        {
+            return {error_message(jit.takeError())};
+        }
+
+        if(llvm::Error error = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))))
+        {
+            return {error_message(std::move(error))};
+        }
+
+        return this->call_main(**jit);
+    }
+
+    std::vector<std::string> Jit::run_object(std::unique_ptr<llvm::MemoryBuffer> object)
+    {
+        llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = this->create_jit();
+
+        if(!jit)
+        {
+            return {error_message(jit.takeError())};
+        }
+
+        if(llvm::Error error = (*jit)->addObjectFile(std::move(object)))
+        {
+            return {error_message(std::move(error))};
+        }
+
+        return this->call_main(**jit);
+    }
+
+    llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> Jit::create_jit()
+    {
+        llvm::orc::LLJITBuilder builder;
+
+        if(m_object_cache != nullptr)
+        {
+            llvm::ObjectCache* object_cache = m_object_cache;
+
+            builder.setCompileFunctionCreator([object_cache](llvm::orc::JITTargetMachineBuilder target_machine_builder)
+                -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>>
+            {
+                llvm::Expected<std::unique_ptr<llvm::TargetMachine>> target_machine = target_machine_builder.createTargetMachine();
+
+                if(!target_machine)
+                {
+                    return target_machine.takeError();
+                }
+
+                return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*target_machine), object_cache);
+            });
+        }
+
+        llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = builder.create();
+
+        if(!jit)
+        {
+            return jit;
+        }
+
+        char global_prefix = (*jit)->getDataLayout().getGlobalPrefix();
+        llvm::Expected<std::unique_ptr<llvm::orc::DynamicLibrarySearchGenerator>> process_symbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(global_prefix);
+
+        if(!process_symbols)
+        {
+            return process_symbols.takeError();
+        }
+        (*jit)->getMainJITDylib().addGenerator(std::move(*process_symbols));
+
+        return jit;
+    }
+
+    std::vector<std::string> Jit::call_main(llvm::orc::LLJIT& jit)
+    {
+        llvm::Expected<llvm::JITEvaluatedSymbol> main_symbol = jit.lookup("main");
+
+        if(!main_symbol)
+        {
+            return {error_message(main_symbol.takeError())};
+        }
+
+        auto main_function = reinterpret_cast<int (*)()>(main_symbol->getAddress());
+        main_function();
+
+        return {};
+    }
+}
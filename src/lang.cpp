@@ -3,16 +3,127 @@
 #include <parser/parser.hpp>
 #include <generator/generator.hpp>
 #include <ast/ast.hpp> /* For "statements" variable */
+#include <ast/printer.hpp>
+#include <source/source_file.hpp>
+#include <cache/ast_cache.hpp>
+#include <resolver/resolver.hpp>
+#include <optimizer/constant_folder.hpp>
+#include <jit/jit.hpp>
+#include <native/native_emitter.hpp>
+#include <cache/code_cache.hpp>
+#include <interpreter/interpreter.hpp>
+#include <vm/bytecode_compiler.hpp>
+#include <vm/virtual_machine.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <thread>
 
 namespace lang
 {
-    Lang::Lang()
+    namespace
+    {
+        /* Below this size thread start-up costs more than tokenizing the source on one thread */
+        constexpr std::size_t PARALLEL_LEXING_THRESHOLD = 4 * 1024 * 1024;
+
+        unsigned lexer_thread_count(const lang::Options& options, std::size_t source_size)
+        {
+            if(source_size < PARALLEL_LEXING_THRESHOLD && !options.force_parallel)
+            {
+                return 1;
+            }
+
+            return options.lexer_threads != 0 ? options.lexer_threads : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        /* Below this many tokens the brace matching pre-pass and the threads cost more than they save */
+        constexpr std::size_t PARALLEL_PARSING_THRESHOLD = 1024 * 1024;
+
+        unsigned parser_thread_count(const lang::Options& options, std::size_t token_count)
+        {
+            if(token_count < PARALLEL_PARSING_THRESHOLD && !options.force_parallel)
+            {
+                return 1;
+            }
+
+            return options.parser_threads != 0 ? options.parser_threads : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        /* Code compiled in the background is run for long, -O0 leaves it at level 2 */
+        constexpr unsigned DEFAULT_TIER_OPTIMIZATION_LEVEL = 2;
+
+        unsigned generator_thread_count(const lang::Options& options)
+        {
+            /* The generator itself keeps small programs on one thread */
+            return options.generator_threads != 0 ? options.generator_threads : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        bool write_file(const char* file_name, std::string_view contents)
+        {
+            std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+            out.write(contents.data(), contents.size());
+
+            return static_cast<bool>(out.flush());
+        }
+    }
+
+    Lang::Lang(const lang::Options& options)
+        : m_options(options)
     {
         m_lexer = std::make_unique<lang::Lexer>();
         m_parser = std::make_unique<lang::Parser>();
-        m_generator = std::make_unique<lang::Generator>();
+
+        if(m_options.max_nesting_depth != 0)
+        {
+            m_parser->set_max_nesting_depth(m_options.max_nesting_depth);
+        }
+
+        m_resolver = std::make_unique<lang::Resolver>();
+
+        if(m_options.fold_constants)
+        {
+            m_constant_folder = std::make_unique<lang::ConstantFolder>();
+        }
+
+        /* The bytecode backend runs the program itself, there is no generator, JIT, emitter, interpreter or code cache */
+        if(m_options.backend == lang::Backend::VM)
+        {
+            m_bytecode_compiler = std::make_unique<lang::BytecodeCompiler>();
+            m_virtual_machine = std::make_unique<lang::VirtualMachine>();
+        }
+        else
+        {
+            m_generator = std::make_unique<lang::Generator>();
+
+            /* Tiered execution neither writes nor caches a module, the interpreter starts right away */
+            if(m_options.tiered)
+            {
+                unsigned optimization_level = m_options.optimization_level != 0 ? m_options.optimization_level : DEFAULT_TIER_OPTIMIZATION_LEVEL;
+                m_interpreter = std::make_unique<lang::Interpreter>(m_options.tier_up_threshold, optimization_level);
+            }
+            else
+            {
+                if(!m_options.code_cache_directory.empty())
+                {
+                    m_code_cache = std::make_unique<lang::CodeCache>(m_options.code_cache_directory);
+                }
+
+                if(m_options.run_in_process)
+                {
+                    m_jit = std::make_unique<lang::Jit>(m_code_cache.get());
+                }
+                else if(m_options.emit == lang::Emit::OBJECT || m_options.emit == lang::Emit::EXECUTABLE)
+                {
+                    m_native_emitter = std::make_unique<lang::NativeEmitter>(m_options.target_cpu);
+                }
+            }
+        }
+
+        if(!m_options.ast_cache_directory.empty())
+        {
+            std::size_t max_nesting_depth = m_options.max_nesting_depth != 0 ? m_options.max_nesting_depth : lang::Parser::DEFAULT_MAX_NESTING_DEPTH;
+            m_ast_cache = std::make_unique<lang::AstCache>(m_options.ast_cache_directory, max_nesting_depth);
+        }
     }
 
     Lang::~Lang()
@@ -20,79 +131,534 @@ namespace lang
 
     int Lang::run_source_code(const char* absolute_path_of_source_code)
     {
-        std::ifstream file(absolute_path_of_source_code);
+        m_source_file = std::make_unique<lang::SourceFile>();
 
-        if(!file.is_open())
+        if(!m_source_file->open(absolute_path_of_source_code))
         {
             std::cout << "Error opening the file\n";
             return -1;
         }
+        
+        if(m_options.dump_tokens)
+        {
+            this->dump_tokens(m_source_file->view());
+            return 0;
+        }
 
-        file.seekg(0, std::ios::end); /* Seek to end of file */
-        auto file_size = file.tellg();
+        if(m_options.dump_ast)
+        {
+            this->dump_ast(m_source_file->view());
+            return 0;
+        }
 
-        std::string file_content;
-        file_content.resize(file_size);
+        if(m_code_cache != nullptr)
+        {
+            m_code_cache_key = lang::CodeCache::hash_key(m_source_file->view(), this->code_cache_configuration());
 
-        file.seekg(0, std::ios::beg);
-        file.read(file_content.data(), file_size);
+            if(this->emit_cached_code())
+            {
+                return 0;
+            }
+        }
 
-        file.close();
-        
-        /* run the file contents */
-        this->run(std::move(file_content));
+        /* run the file contents, the interpreter and the bytecode compiler need the whole tree */
+        if(m_options.streaming && m_interpreter == nullptr && m_virtual_machine == nullptr)
+        {
+            this->run_streaming(m_source_file->view());
+        }
+        else
+        {
+            this->run(m_source_file->view());
+        }
 
         return 0;
     }
 
-    void Lang::run(std::string&& source)
+    void Lang::run(std::string_view source)
     {
+        /* The program owns the arena of every node, the whole tree is released at once when it goes out of scope */
+        lang::ast::Program program;
+
+        if(!this->load_program(source, program))
+        {
+            return;
+        }
+
+        /* The cache keeps the tree as parsed, so it is resolved and folded after loading it as well */
+        auto resolution_errors = m_resolver->resolve(program.statements, program.arena);
+
+        if(resolution_errors.size() > 0)
+        {
+            this->report_errors("RESOLUTION", resolution_errors);
+            return;
+        }
+        std::cout << "Successfully resolved\n";
+
+        if(m_constant_folder != nullptr)
+        {
+            m_constant_folder->fold(program.statements, program.arena);
+        }
+
         /********************************************************************************************************/
-        auto [tokens, tokenization_errors] = m_lexer->tokenize(std::move(source));
-        
-        if(tokenization_errors.size() > 0)
+
+        /* Skipped function bodies are parsed on demand into the program's arena, the parser still holds their tokens */
+        lang::ast::Arena& program_arena = program.arena;
+        auto load_function_body = [this, &program_arena](lang::ast::FunctionStatement* function)
         {
-            std::cout << "\nERROR FOUND DURING TOKENIZATION:\n";
-            for(const auto& error: tokenization_errors)
+            std::vector<std::string> body_errors = m_parser->parse_function_body(function, program_arena);
+
+            if(body_errors.empty())
             {
-                std::cout << error << "\n";
+                body_errors = m_resolver->resolve_function_body(function, program_arena);
             }
-            
+
+            if(body_errors.empty() && m_constant_folder != nullptr)
+            {
+                m_constant_folder->fold_function_body(function, program_arena);
+            }
+
+            return body_errors;
+        };
+
+        if(m_virtual_machine != nullptr)
+        {
+            m_bytecode_compiler->set_function_body_loader(load_function_body);
+            this->run_bytecode(program.statements);
+            return;
+        }
+
+        if(m_interpreter != nullptr)
+        {
+            m_interpreter->set_function_body_loader(load_function_body);
+            this->run_tiered(program.statements);
+            return;
+        }
+
+        m_generator->set_function_body_loader(load_function_body);
+
+        auto evaluation_errors = m_generator->generate_parallel(program.statements, generator_thread_count(m_options));
+
+        if(evaluation_errors.size() > 0)
+        {
+            this->report_errors("EVALUATION", evaluation_errors);
+            return;
+        }
+
+        this->emit_module();
+        // m_generator->print_module(); /* Print in the console */
+    }
+
+    void Lang::run_tiered(const std::vector<lang::ast::Statement*>& statements)
+    {
+        auto execution_errors = m_interpreter->interpret(statements, m_resolver->global_count());
+
+        if(execution_errors.size() > 0)
+        {
+            this->report_errors("EXECUTION", execution_errors);
+        }
+
+        this->report_tiering_statistics();
+    }
+
+    void Lang::run_bytecode(const std::vector<lang::ast::Statement*>& statements)
+    {
+        auto compilation_errors = m_bytecode_compiler->compile(statements, m_resolver->global_count(), m_resolver->top_level_frame_size());
+
+        if(compilation_errors.size() > 0)
+        {
+            this->report_errors("EVALUATION", compilation_errors);
             return;
         }
+
+        lang::vm::Module module = m_bytecode_compiler->take_module();
+        m_virtual_machine->run(module);
+    }
+
+    bool Lang::load_program(std::string_view source, lang::ast::Program& program)
+    {
+        std::uint64_t source_hash = 0;
+
+        if(m_ast_cache != nullptr)
+        {
+            source_hash = lang::AstCache::hash_source(source);
+
+            /* Only error free programs are stored, a hit skips tokenizing and parsing altogether */
+            if(m_ast_cache->load(source, source_hash, program))
+            {
+                this->report_cache_statistics();
+                return true;
+            }
+        }
+
+        /********************************************************************************************************/
+        auto [tokens, tokenization_errors] = m_lexer->tokenize_parallel(source, lexer_thread_count(m_options, source.size()));
+        
+        if(tokenization_errors.size() > 0)
+        {
+            this->report_errors("TOKENIZATION", tokenization_errors);
+            return false;
+        }
         std::cout << "Successfully tokenize\n";
 
         /********************************************************************************************************/
-        auto [statements, parsing_errors] = m_parser->parse(std::move(tokens));
+        /* A cached entry needs every function body, parsing them eagerly is cheaper than skipping them and coming back */
+        std::size_t token_count = tokens.size();
+        m_parser->set_lazy_function_bodies(m_options.lazy_function_bodies && m_ast_cache == nullptr);
+
+        auto [parsed_program, parsing_errors] = m_parser->parse_parallel(std::move(tokens), parser_thread_count(m_options, token_count));
+
+        if(parsed_program.statements.size() == 0 || parsing_errors.size() > 0)
+        {
+            this->report_errors("PARSING", parsing_errors);
+            return false;
+        }
+        std::cout << "Successfully parsed\n";
+
+        program = std::move(parsed_program);
+
+        if(m_ast_cache != nullptr)
+        {
+            m_ast_cache->store(source, source_hash, program);
+            this->report_cache_statistics();
+        }
 
-        if(statements.size() == 0 || parsing_errors.size() > 0)
+        return true;
+    }
+
+    void Lang::dump_tokens(std::string_view source)
+    {
+        auto [tokens, tokenization_errors] = m_lexer->tokenize_parallel(source, lexer_thread_count(m_options, source.size()));
+
+        for(std::size_t i = 0; i < tokens.size(); i++)
+        {
+            std::cout << tokens.line(i) << " " << tokens.at(i);
+        }
+
+        if(tokenization_errors.size() > 0)
         {
-            std::cout << "\nERROR FOUND DURING PARSING:\n";
-            for(const auto& error: parsing_errors)
+            this->report_errors("TOKENIZATION", tokenization_errors);
+        }
+    }
+
+    void Lang::dump_ast(std::string_view source)
+    {
+        lang::ast::Program program;
+
+        if(this->load_program(source, program))
+        {
+            lang::ast::Printer printer(std::cout);
+            printer.print(program.statements);
+        }
+    }
+
+    void Lang::run_streaming(std::string_view source)
+    {
+        lang::ast::Arena arena;
+
+        m_lexer->begin(source);
+        m_parser->begin(*m_lexer, arena);
+        m_resolver->begin_resolution();
+        m_generator->begin_generation();
+
+        std::size_t statement_count = 0;
+
+        /* Only one declaration, its tokens and its AST are alive at any time */
+        while(m_parser->has_more_declarations())
+        {
+            lang::ast::Statement* statement = m_parser->parse_next_declaration();
+            statement_count++;
+
+            /* After the first error we keep going only to report the remaining errors */
+            if(!m_lexer->has_errors() && !m_parser->has_errors())
+            {
+                m_resolver->resolve_declaration(statement, arena);
+            }
+
+            if(!m_lexer->has_errors() && !m_parser->has_errors() && !m_resolver->has_errors())
             {
-                std::cout << error << "\n";
+                if(m_constant_folder != nullptr)
+                {
+                    statement = m_constant_folder->fold_declaration(statement, arena);
+                }
+
+                if(statement != nullptr)
+                {
+                    m_generator->generate_declaration(statement);
+                }
             }
-            
+
+            /* The declaration is done with, its nodes are dropped and the arena's block is reused for the next one */
+            arena.reset();
+        }
+
+        /********************************************************************************************************/
+        auto tokenization_errors = m_lexer->take_errors();
+
+        if(tokenization_errors.size() > 0)
+        {
+            this->report_errors("TOKENIZATION", tokenization_errors);
+            return;
+        }
+        std::cout << "Successfully tokenize\n";
+
+        /********************************************************************************************************/
+        auto parsing_errors = m_parser->take_errors();
+
+        if(statement_count == 0 || parsing_errors.size() > 0)
+        {
+            this->report_errors("PARSING", parsing_errors);
             return;
         }
         std::cout << "Successfully parsed\n";
-        
+
         /********************************************************************************************************/
+        /* Globals are resolved across declarations, one used but never declared is only known to be an error now */
+        auto resolution_errors = m_resolver->end_resolution();
 
-        auto evaluation_errors = m_generator->generate(std::move(statements));
+        if(resolution_errors.size() > 0)
+        {
+            this->report_errors("RESOLUTION", resolution_errors);
+            return;
+        }
+        std::cout << "Successfully resolved\n";
+
+        /********************************************************************************************************/
+        auto evaluation_errors = m_generator->end_generation();
 
         if(evaluation_errors.size() > 0)
         {
-            std::cout << "\nERROR FOUND DURING EVALUATION:\n";
-            for(const auto& error: evaluation_errors)
+            this->report_errors("EVALUATION", evaluation_errors);
+            return;
+        }
+
+        this->emit_module();
+    }
+
+    void Lang::emit_module()
+    {
+        if(m_jit != nullptr)
+        {
+            this->run_module();
+        }
+        else if(m_native_emitter == nullptr)
+        {
+            this->write_module();
+        }
+        else
+        {
+            this->compile_module();
+        }
+
+        /* Once the code is stored, the JIT stores it while it runs */
+        if(m_code_cache != nullptr)
+        {
+            this->report_code_cache_statistics();
+        }
+    }
+
+    void Lang::run_module()
+    {
+        m_generator->optimize(m_options.optimization_level, m_options.favor_compile_latency);
+
+        /* The JIT hands the object file it compiles to the cache */
+        if(m_code_cache != nullptr)
+        {
+            m_code_cache->select_object_entry(m_code_cache_key, m_source_file->view());
+        }
+
+        auto [context, module] = m_generator->take_module();
+        auto execution_errors = m_jit->run(std::move(context), std::move(module));
+
+        if(execution_errors.size() > 0)
+        {
+            this->report_errors("EXECUTION", execution_errors);
+        }
+    }
+
+    void Lang::write_module()
+    {
+        m_generator->optimize(m_options.optimization_level, m_options.favor_compile_latency);
+
+        llvm::SmallVector<char, 0> bitcode;
+        if(m_options.emit == lang::Emit::BITCODE || m_code_cache != nullptr)
+        {
+            m_generator->write_bitcode(bitcode);
+        }
+
+        if(m_options.emit == lang::Emit::BITCODE)
+        {
+            if(!write_file("out.bc", {bitcode.data(), bitcode.size()}))
             {
-                std::cout << error << "\n";
+                this->report_errors("OUTPUT", {"[line 0] Error : could not write out.bc\n"});
             }
-            
+        }
+        else
+        {
+            m_generator->save_module_to_file("out.ll");
+        }
+
+        if(m_code_cache != nullptr)
+        {
+            m_code_cache->store(m_code_cache_key, m_source_file->view(), lang::CodeCache::Kind::BITCODE, {bitcode.data(), bitcode.size()});
+        }
+    }
+
+    void Lang::compile_module()
+    {
+        if(m_native_emitter->target_machine() == nullptr)
+        {
+            this->report_errors("CODE GENERATION", m_native_emitter->errors());
             return;
         }
 
-        m_generator->save_module_to_file("out.ll");
-        // m_generator->print_module(); /* Print in the console */
+        m_generator->optimize(m_options.optimization_level, m_options.favor_compile_latency, m_native_emitter->target_machine());
+
+        auto [context, module] = m_generator->take_module();
+
+        llvm::SmallVector<char, 0> object;
+        auto object_errors = m_native_emitter->compile_object(*module, object);
+
+        if(object_errors.size() > 0)
+        {
+            this->report_errors("CODE GENERATION", object_errors);
+            return;
+        }
+
+        if(m_code_cache != nullptr)
+        {
+            m_code_cache->store(m_code_cache_key, m_source_file->view(), lang::CodeCache::Kind::OBJECT, {object.data(), object.size()});
+        }
+
+        this->emit_object({object.data(), object.size()});
+    }
+
+    void Lang::emit_object(std::string_view object)
+    {
+        if(!write_file("out.o", object))
+        {
+            this->report_errors("OUTPUT", {"[line 0] Error : could not write out.o\n"});
+            return;
+        }
+
+        if(m_options.emit == lang::Emit::EXECUTABLE)
+        {
+            auto linking_errors = m_native_emitter->link_executable("out.o", "out");
+
+            if(linking_errors.size() > 0)
+            {
+                this->report_errors("LINKING", linking_errors);
+            }
+        }
+    }
+
+    bool Lang::emit_cached_code()
+    {
+        bool is_object = m_jit != nullptr || m_native_emitter != nullptr;
+        lang::CodeCache::Kind kind = is_object ? lang::CodeCache::Kind::OBJECT : lang::CodeCache::Kind::BITCODE;
+
+        std::unique_ptr<llvm::MemoryBuffer> code = m_code_cache->load(m_code_cache_key, m_source_file->view(), kind);
+
+        /* On a miss emit_module() reports, once the code is stored */
+        if(code == nullptr)
+        {
+            return false;
+        }
+
+        this->report_code_cache_statistics();
+
+        if(m_jit != nullptr)
+        {
+            auto execution_errors = m_jit->run_object(std::move(code));
+
+            if(execution_errors.size() > 0)
+            {
+                this->report_errors("EXECUTION", execution_errors);
+            }
+        }
+        else if(m_native_emitter != nullptr)
+        {
+            this->emit_object({code->getBufferStart(), code->getBufferSize()});
+        }
+        else if(m_options.emit == lang::Emit::BITCODE)
+        {
+            if(!write_file("out.bc", {code->getBufferStart(), code->getBufferSize()}))
+            {
+                this->report_errors("OUTPUT", {"[line 0] Error : could not write out.bc\n"});
+            }
+        }
+        else
+        {
+            auto bitcode_errors = m_generator->load_bitcode(code->getMemBufferRef());
+
+            if(bitcode_errors.size() > 0)
+            {
+                this->report_errors("CODE CACHE", bitcode_errors);
+                return true;
+            }
+
+            m_generator->save_module_to_file("out.ll");
+        }
+
+        return true;
+    }
+
+    std::string Lang::code_cache_configuration() const
+    {
+        static const char* outputs[] = {"ll", "bc", "obj", "exe"};
+
+        /* The executable is linked from the cached object file, an object compiled by the JIT is only run by the JIT */
+        std::string configuration = m_jit != nullptr ? "jit" : outputs[static_cast<int>(m_options.emit)];
+        if(configuration == "exe")
+        {
+            configuration = "obj";
+        }
+
+        configuration += " -O" + std::to_string(m_options.optimization_level);
+        configuration += m_options.favor_compile_latency ? " latency" : " throughput";
+        configuration += m_options.fold_constants ? " fold" : " no-fold";
+
+        if(m_jit != nullptr)
+        {
+            configuration += " " + lang::CodeCache::host_configuration();
+        }
+        else if(m_native_emitter != nullptr)
+        {
+            configuration += " " + m_native_emitter->configuration();
+        }
+
+        return configuration;
+    }
+
+    void Lang::report_cache_statistics()
+    {
+        const lang::AstCache::Statistics& statistics = m_ast_cache->statistics();
+
+        std::cout << "AST cache: " << statistics.hits << " hits, " << statistics.misses << " misses, " << statistics.stores << " stores ("
+                  << statistics.bytes_read << " bytes read, " << statistics.bytes_written << " bytes written)\n";
+    }
+
+    void Lang::report_code_cache_statistics()
+    {
+        const lang::CodeCache::Statistics& statistics = m_code_cache->statistics();
+
+        std::cout << "Code cache: " << statistics.hits << " hits, " << statistics.misses << " misses, " << statistics.stores << " stores ("
+                  << statistics.bytes_read << " bytes read, " << statistics.bytes_written << " bytes written)\n";
+    }
+
+    void Lang::report_tiering_statistics()
+    {
+        lang::Interpreter::Statistics statistics = m_interpreter->statistics();
+
+        std::cout << "Tiered execution: " << statistics.hot_functions << " hot functions, " << statistics.hot_loops << " hot loops, " << statistics.compiled << " compiled ("
+                  << statistics.native_calls << " calls and " << statistics.native_loops << " loops run as compiled code)\n";
+    }
+
+    void Lang::report_errors(const char* stage, const std::vector<std::string>& errors)
+    {
+        std::cout << "\nERROR FOUND DURING " << stage << ":\n";
+        for(const auto& error: errors)
+        {
+            std::cout << error << "\n";
+        }
     }
 }
\ No newline at end of file
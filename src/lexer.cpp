@@ -1,24 +1,20 @@
 #include <lexer/lexer.hpp>
 #include <token/token.hpp>
+#include <lexer/scan.hpp>
+#include <lexer/keywords.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <thread>
 
 namespace lang
 {
     Lexer::Lexer(){}
     Lexer::~Lexer(){}
 
-    std::pair<std::vector<lang::Token>, std::vector<std::string>> Lexer::tokenize(std::string&& source)
+    std::pair<lang::TokenStream, std::vector<std::string>> Lexer::tokenize(std::string_view source)
     {   
-        /* Initialize */
-        m_source = std::move(source);
-        m_source_size = m_source.size();
-
-        m_current = 0;
-        m_start = 0;
-        m_line = 1;
-        
-        /* It is important because we are moving from this class to outside at the end of tokenize function */
-        m_tokens = std::vector<lang::Token>();
-        m_errors = std::vector<std::string>();
+        this->begin(source);
         
         while(!this->is_at_end())
         {
@@ -34,7 +30,7 @@ namespace lang
             this->scan_token();
         }
 
-        m_tokens.emplace_back(lang::Token{lang::TokenType::MYEOF, "", lang::util::null, m_line});
+        m_tokens.push_back(lang::TokenType::MYEOF, m_source_size, 0, lang::NO_LITERAL, m_line);
 
         return std::make_pair(
             std::move(m_tokens),
@@ -42,6 +38,192 @@ namespace lang
         );
     }
 
+    std::pair<lang::TokenStream, std::vector<std::string>> Lexer::tokenize_parallel(std::string_view source, unsigned thread_count)
+    {
+        if(thread_count <= 1)
+        {
+            return this->tokenize(source);
+        }
+
+        /* 
+            Split right after a '\n'. Outside of string literals no token spans a newline
+            (a comment stops before it), so every chunk starts in a clean lexer state unless
+            it starts inside a string literal, which is fixed up while stitching below
+        */
+        std::vector<Chunk> chunks;
+        std::size_t chunk_begin = 0;
+
+        for(unsigned k = 1; k <= thread_count && chunk_begin < source.size(); k++)
+        {
+            std::size_t chunk_end = source.size();
+
+            if(k < thread_count)
+            {
+                std::size_t newline = source.find('\n', std::max(chunk_begin, source.size() / thread_count * k));
+                chunk_end = (newline == std::string_view::npos) ? source.size() : newline + 1;
+            }
+
+            chunks.emplace_back(Chunk{chunk_begin, chunk_end, 0, 0, {}, {}, std::string_view::npos, 0});
+            chunk_begin = chunk_end;
+        }
+
+        auto run_on_every_chunk = [&chunks](auto&& work)
+        {
+            std::vector<std::thread> workers;
+            for(std::size_t i = 0; i < chunks.size(); i++)
+            {
+                workers.emplace_back(work, i);
+            }
+
+            for(auto& worker: workers)
+            {
+                worker.join();
+            }
+        };
+
+        /* Pass 1: count the newlines of each chunk to know the line every chunk starts on */
+        run_on_every_chunk([&chunks, source](std::size_t i)
+        {
+            auto first = source.begin() + chunks[i].begin;
+            auto last = source.begin() + chunks[i].end;
+            chunks[i].newline_count = static_cast<int>(std::count(first, last, '\n'));
+        });
+
+        int line = 1;
+        for(auto& chunk: chunks)
+        {
+            chunk.first_line = line;
+            line += chunk.newline_count;
+        }
+
+        /* Pass 2: tokenize every chunk speculatively, assuming it does not start inside a string literal */
+        run_on_every_chunk([&chunks, source](std::size_t i)
+        {
+            lang::Lexer chunk_lexer;
+            chunk_lexer.tokenize_chunk(source, chunks[i], i + 1 == chunks.size());
+        });
+
+        /* Stitch the chunks together in source order */
+        std::size_t token_count = 1;
+        for(const auto& chunk: chunks)
+        {
+            token_count += chunk.tokens.size();
+        }
+
+        lang::TokenStream stream(source);
+        std::vector<std::string> errors;
+        stream.reserve(token_count);
+
+        for(std::size_t i = 0; i < chunks.size(); i++)
+        {
+            Chunk& chunk = chunks[i];
+
+            /* Every chunk has its own literal pool, append() moves the values into the pool of the whole stream */
+            stream.append(chunk.tokens);
+            chunk.tokens = lang::TokenStream();
+
+            std::move(chunk.errors.begin(), chunk.errors.end(), std::back_inserter(errors));
+
+            if(chunk.spill_offset != std::string_view::npos)
+            {
+                /* 
+                    A string literal runs into the next chunk, so its speculative result is wrong.
+                    Tokenize it again starting from the opening quote, it may spill further itself
+                */
+                Chunk& next_chunk = chunks[i + 1];
+                next_chunk.begin = chunk.spill_offset;
+                next_chunk.first_line = chunk.spill_line;
+
+                this->tokenize_chunk(source, next_chunk, i + 2 == chunks.size());
+            }
+        }
+
+        stream.push_back(lang::TokenType::MYEOF, source.size(), 0, lang::NO_LITERAL, line);
+
+        return std::make_pair(std::move(stream), std::move(errors));
+    }
+
+    void Lexer::tokenize_chunk(std::string_view source, Chunk& chunk, bool is_last_chunk)
+    {
+        /* The view keeps the base of the whole source, so lexemes point into the caller's buffer */
+        this->begin(source.substr(0, chunk.end));
+
+        m_current = chunk.begin;
+        m_line = chunk.first_line;
+        m_spill_allowed = !is_last_chunk;
+
+        while(!this->is_at_end())
+        {
+            m_start = m_current;
+            this->scan_token();
+        }
+
+        chunk.tokens = std::move(m_tokens);
+        chunk.errors = std::move(m_errors);
+        chunk.spill_offset = m_spill_offset;
+        chunk.spill_line = m_spill_line;
+    }
+
+    void Lexer::begin(std::string_view source)
+    {
+        /* Initialize */
+        m_source = source;
+        m_source_size = m_source.size();
+
+        m_current = 0;
+        m_start = 0;
+        m_line = 1;
+
+        m_spill_allowed = false;
+        m_spill_offset = std::string_view::npos;
+        m_spill_line = 0;
+        
+        /* It is important because we are moving from this class to outside at the end of tokenize function */
+        m_tokens = lang::TokenStream(source);
+        m_errors = std::vector<std::string>();
+    }
+
+    void Lexer::next_token(lang::TokenStream& out)
+    {
+        /* In streaming mode m_tokens only ever holds the token being handed out, its literals are kept */
+        m_tokens.clear_tokens();
+
+        /* Whitespace and comments do not add a token, so keep scanning until one is added */
+        while(m_tokens.size() == 0 && !this->is_at_end())
+        {
+            m_start = m_current;
+            this->scan_token();
+        }
+
+        if(m_tokens.size() == 0)
+        {
+            out.push_back(lang::TokenType::MYEOF, m_source_size, 0, lang::NO_LITERAL, m_line);
+            return;
+        }
+
+        out.push_back(m_tokens, 0);
+    }
+
+    std::string_view Lexer::source() const
+    {
+        return m_source;
+    }
+
+    const lang::LiteralPool& Lexer::literals() const
+    {
+        return m_tokens.literals();
+    }
+
+    bool Lexer::has_errors() const
+    {
+        return !m_errors.empty();
+    }
+
+    std::vector<std::string> Lexer::take_errors()
+    {
+        return std::exchange(m_errors, std::vector<std::string>());
+    }
+
     void Lexer::scan_token()
     {   
         /* advance() is for input and add_token() is for output */
@@ -75,27 +257,25 @@ namespace lang
                 if(this->match('/'))
                 {
                     /* A comment goes until the end of the line */
-                    while(this->peek() != '\n' && !this->is_at_end())
-                    {
-                        this->advance();
-                    }
+                    m_current = lang::scan::skip_comment(m_source.data(), m_current, m_source_size);
                 }
                 else
                 {
                     this->add_token(TokenType::SLASH);
                 }
                 break;
+            case '\n':
+                m_line++;
+                [[fallthrough]];
             case ' ':
             case '\r':
             case '\t':
                 /* 
                     Ignore whitespace
-                    When encountering whitespace, we simply go back to the beginning of the scan loop
+                    When encountering whitespace, we skip the whole run at once and go back to the beginning of the scan loop
                     We dumped the returned consumed character by advance()
                 */
-                break;
-            case '\n':
-                m_line++;
+                m_current = lang::scan::skip_whitespace(m_source.data(), m_current, m_source_size, m_line);
                 break;
             case '"': this->read_string_literal(); break;
             default:
@@ -137,23 +317,16 @@ namespace lang
 
     void Lexer::read_identifier()
     {
-        while(this->is_aplha_numeric(this->peek()))
-        {
-            this->advance();
-        }
+        m_current = lang::scan::skip_identifier_body(m_source.data(), m_current, m_source_size);
 
-        int length = m_current - m_start;
-        std::string text = m_source.substr(m_start, length);
-        TokenType type{};
+        std::size_t length = m_current - m_start;
+        std::string_view text = m_source.substr(m_start, length);
+        TokenType type = lang::keywords::classify(text);
 
-        auto it = m_keywords.find(text);
-        if(it != m_keywords.end())
-        {
-            type = it->second;
-        }
-        else
+        if(type == TokenType::IDENTIFIER)
         {
-            type = TokenType::IDENTIFIER;
+            this->add_identifier_token(lang::Interner::global().intern(text));
+            return;
         }
         
         this->add_token(type);
@@ -166,20 +339,16 @@ namespace lang
     */
     void Lexer::read_number_literal()
     {
-        while(this->is_digit(this->peek()))
-        {
-            /* m_current is changed to point to next character but the m_start is at the start of the number lexeme */
-            this->advance();
-        }
+        /* m_current is changed to point to next character but the m_start is at the start of the number lexeme */
+        m_current = lang::scan::skip_digits(m_source.data(), m_current, m_source_size);
 
         /* Look for a fractional part */
         if(this->peek() == '.' && this->is_digit(this->peekNext()))
         {
             /* Consume the "." */
-            while(this->is_digit(this->peek()))
-            {
-                this->advance();
-            }
+            this->advance();
+
+            m_current = lang::scan::skip_digits(m_source.data(), m_current, m_source_size);
         }
 
         /*
@@ -193,8 +362,11 @@ namespace lang
         */
 
 
-        int length = m_current - m_start;
-        this->add_token(TokenType::NUMBER, std::stod(m_source.substr(m_start, length)));
+        /* The lexeme is known to be digits with an optional fraction, so from_chars() can not fail here */
+        double value = 0.0;
+        std::from_chars(m_source.data() + m_start, m_source.data() + m_current, value);
+
+        this->add_token(TokenType::NUMBER, m_tokens.literals().add_number(value));
     }
 
     void Lexer::read_string_literal()
@@ -204,19 +376,21 @@ namespace lang
             the string. We also handle running out of input before the string literal
             is closed and report an error for that.
         */
-        while(this->peek() != '"' && !this->is_at_end())
-        {   
-            /* We support multi-line string literals */
-            if(this->peek() == '\n')
-            {
-                m_line++;
-            }
+        int opening_line = m_line;
 
-            this->advance();
-        }
+        /* We support multi-line string literals, every skipped '\n' is counted in m_line */
+        m_current = lang::scan::skip_string_body(m_source.data(), m_current, m_source_size, m_line);
 
         if(this->is_at_end())
         {
+            if(m_spill_allowed)
+            {
+                /* The end of a chunk is not the end of the source, tokenize_parallel() picks it up from here */
+                m_spill_offset = m_start;
+                m_spill_line = opening_line;
+                return;
+            }
+
             this->generate_error(m_line, "Unterminated string");
             return;
         }
@@ -225,15 +399,14 @@ namespace lang
         this->advance();
 
         /* Trim the starting quote and ending quote */
-        int length = (m_current - 1) - (m_start + 1);
-        std::string value = m_source.substr(m_start + 1, length);
-        this->add_token(TokenType::STRING, value);
+        std::size_t length = (m_current - 1) - (m_start + 1);
+        this->add_token(TokenType::STRING, m_tokens.literals().add_string(m_source.substr(m_start + 1, length)));
     }
 
     /* It consumes the next character in the source file and returns it */
     char Lexer::advance()
     {
-        return m_source.at(m_current++);
+        return m_source[m_current++];
     }
 
     /* It is like conditional advance(). It only consumes the current character if it's what we're looking for. */
@@ -244,7 +417,7 @@ namespace lang
             return false;
         }
 
-        if(m_source.at(m_current) != expected)
+        if(m_source[m_current] != expected)
         {
             return false;
         }
@@ -266,7 +439,7 @@ namespace lang
             return '\0';
         }
 
-        return m_source.at(m_current);
+        return m_source[m_current];
     }
 
     char Lexer::peekNext()
@@ -276,20 +449,26 @@ namespace lang
             return '\0';
         }
 
-        return m_source.at(m_current + 1);
+        return m_source[m_current + 1];
     }
 
     void Lexer::add_token(TokenType type)
     {
-        this->add_token(type, lang::util::null);
+        this->add_token(type, lang::NO_LITERAL);
+    }
+
+    void Lexer::add_token(TokenType type, lang::LiteralId literal)
+    {
+        std::size_t length = m_current - m_start;
+
+        m_tokens.push_back(type, m_start, length, literal, m_line);
     }
 
-    void Lexer::add_token(TokenType type, lang::util::object_t literal)
+    void Lexer::add_identifier_token(lang::Symbol symbol)
     {
-        int length = m_current - m_start;
-        std::string extracted_lexeme = m_source.substr(m_start, length);
+        std::size_t length = m_current - m_start;
 
-        m_tokens.emplace_back(Token{type, extracted_lexeme, literal, m_line});
+        m_tokens.push_back(TokenType::IDENTIFIER, m_start, length, symbol, m_line);
     }
 
     /* It returns true if current reaches end of file */
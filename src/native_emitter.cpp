@@ -0,0 +1,147 @@
+#include <native/native_emitter.hpp>
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <mutex>
+
+namespace lang
+{
+    NativeEmitter::NativeEmitter(const std::string& cpu)
+    {
+        NativeEmitter::initialize_native_target();
+
+        std::string triple = llvm::sys::getProcessTriple();
+        std::string lookup_error;
+
+        const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, lookup_error);
+
+        if(target == nullptr)
+        {
+            this->generate_error("no target for " + triple + ": " + lookup_error);
+            return;
+        }
+
+        /* A named CPU brings its own features, only the host's are probed */
+        std::string cpu_name = cpu == "native" ? llvm::sys::getHostCPUName().str() : cpu;
+        std::string features;
+
+        std::unique_ptr<llvm::MCSubtargetInfo> subtarget(target->createMCSubtargetInfo(triple, "", ""));
+        if(subtarget == nullptr || !subtarget->isCPUStringValid(cpu_name))
+        {
+            this->generate_error("'" + cpu_name + "' is not a CPU of " + triple);
+            return;
+        }
+
+        llvm::StringMap<bool> host_features;
+        if(cpu == "native" && llvm::sys::getHostCPUFeatures(host_features))
+        {
+            llvm::SubtargetFeatures subtarget_features;
+            for(const llvm::StringMapEntry<bool>& feature: host_features)
+            {
+                subtarget_features.AddFeature(feature.getKey(), feature.getValue());
+            }
+            features = subtarget_features.getString();
+        }
+
+        /* Position independent, the C compiler driver links position independent executables by default */
+        m_target_machine.reset(target->createTargetMachine(
+            triple, cpu_name, features, llvm::TargetOptions{}, llvm::Reloc::PIC_
+        ));
+
+        if(m_target_machine == nullptr)
+        {
+            this->generate_error("could not create a target machine for " + triple);
+        }
+    }
+
+    NativeEmitter::~NativeEmitter()
+    {}
+
+    void NativeEmitter::initialize_native_target()
+    {
+        static std::once_flag target_initialized;
+        std::call_once(target_initialized, []
+        {
+            llvm::InitializeNativeTarget();
+            llvm::InitializeNativeTargetAsmPrinter();
+        });
+    }
+
+    llvm::TargetMachine* NativeEmitter::target_machine()
+    {
+        return m_target_machine.get();
+    }
+
+    std::string NativeEmitter::configuration() const
+    {
+        if(m_target_machine == nullptr)
+        {
+            return "";
+        }
+
+        return m_target_machine->getTargetTriple().str() + " " + m_target_machine->getTargetCPU().str() + " " + m_target_machine->getTargetFeatureString().str();
+    }
+
+    const std::vector<std::string>& NativeEmitter::errors() const
+    {
+        return m_errors;
+    }
+
+    std::vector<std::string> NativeEmitter::compile_object(llvm::Module& module, llvm::SmallVectorImpl<char>& object)
+    {
+        if(m_target_machine == nullptr)
+        {
+            return m_errors;
+        }
+
+        llvm::raw_svector_ostream out(object);
+
+        /* Machine code generation still runs on the legacy pass manager */
+        llvm::legacy::PassManager pass_manager;
+
+        if(m_target_machine->addPassesToEmitFile(pass_manager, out, nullptr, llvm::CGFT_ObjectFile))
+        {
+            this->generate_error("the target machine cannot emit object files");
+            return std::move(m_errors);
+        }
+
+        pass_manager.run(module);
+
+        return std::move(m_errors);
+    }
+
+    std::vector<std::string> NativeEmitter::link_executable(const std::string& object_file, const std::string& executable_file)
+    {
+        llvm::ErrorOr<std::string> linker = llvm::sys::findProgramByName("cc");
+
+        if(!linker)
+        {
+            this->generate_error("no C compiler driver ('cc') to link " + executable_file + " with");
+            return std::move(m_errors);
+        }
+
+        llvm::StringRef arguments[] = {*linker, object_file, "-o", executable_file};
+        std::string execution_error;
+
+        int status = llvm::sys::ExecuteAndWait(*linker, arguments, /* environment */ llvm::None, /* redirects */ {}, 0, 0, &execution_error);
+
+        if(status != 0)
+        {
+            this->generate_error("linking " + executable_file + " failed" + (execution_error.empty() ? "" : ": " + execution_error));
+        }
+
+        return std::move(m_errors);
+    }
+
+    void NativeEmitter::generate_error(const std::string& message)
+    {
+        m_errors.emplace_back("[line 0] Error : " + message + "\n");
+    }
+}
@@ -1,505 +1,1006 @@
 #include <parser/parser.hpp>
 #include <ast/ast.hpp>
+#include <lexer/lexer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <thread>
 
 namespace lang
 {
-    Parser::Parser()
-    {}
-
-    Parser::~Parser()
-    {}
-    
-    std::pair<std::vector<std::unique_ptr<lang::ast::Statement>>, std::vector<std::string>> Parser::parse(std::vector<lang::Token>&& tokens)
+    namespace
     {
-        m_tokens = std::move(tokens);
+        /* Binding powers of the infix operators, from the loosest to the tightest */
+        enum Precedence: std::uint8_t
+        {
+            NONE,
+            ASSIGNMENT,     /* = */
+            OR,             /* or */
+            AND,            /* and */
+            EQUALITY,       /* == != */
+            COMPARISON,     /* < > <= >= */
+            TERM,           /* + - */
+            FACTOR,         /* * / */
+            UNARY,          /* ! - */
+            CALL            /* () */
+        };
+
+        enum class InfixKind: std::uint8_t
+        {
+            NONE, ASSIGNMENT, LOGICAL, BINARY, CALL
+        };
 
-        m_current = 0;
-        /* It is important because we are moving from this class to outside at the end of tokenize function */
-        m_errors = std::vector<std::string>();
-        // m_temp_exprs.clear();
-        m_statements = std::vector<std::unique_ptr<lang::ast::Statement>>();
+        struct InfixRule
+        {
+            Precedence precedence;
+            InfixKind kind;
+        };
 
-        while(!this->is_at_end())
+        constexpr std::size_t TOKEN_TYPE_COUNT = static_cast<std::size_t>(lang::TokenType::MYEOF) + 1;
+
+        constexpr std::array<InfixRule, TOKEN_TYPE_COUNT> make_infix_rules()
         {
-            std::unique_ptr<lang::ast::Statement> parsed_statment = this->parse_declaration();
+            std::array<InfixRule, TOKEN_TYPE_COUNT> rules{};
 
-            if(parsed_statment == nullptr)
+            auto set = [&rules](lang::TokenType type, Precedence precedence, InfixKind kind)
             {
-                /* There is an error during parsing a statement, so skip it*/
-                this->synchronize_after_an_error();
-            }
+                rules[static_cast<std::size_t>(type)] = InfixRule{precedence, kind};
+            };
 
-            m_statements.emplace_back(std::move(parsed_statment));
-        }
+            set(lang::TokenType::EQUAL, Precedence::ASSIGNMENT, InfixKind::ASSIGNMENT);
 
-        return std::make_pair(std::move(m_statements), std::move(m_errors));;
-    }
+            set(lang::TokenType::OR, Precedence::OR, InfixKind::LOGICAL);
+            set(lang::TokenType::AND, Precedence::AND, InfixKind::LOGICAL);
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_declaration()
-    {
-       if(this->match({lang::TokenType::FUN}))
-        {
-            return this->parse_function_statement();
-        }
-        
-        if(this->match({lang::TokenType::VAR}))
-        {
-            return this->parse_var_declaration();
-        }
+            set(lang::TokenType::BANG_EQUAL, Precedence::EQUALITY, InfixKind::BINARY);
+            set(lang::TokenType::EQUAL_EQUAL, Precedence::EQUALITY, InfixKind::BINARY);
 
-        return this->parse_statement();
-    }
+            set(lang::TokenType::GREATER, Precedence::COMPARISON, InfixKind::BINARY);
+            set(lang::TokenType::GREATER_EQUAL, Precedence::COMPARISON, InfixKind::BINARY);
+            set(lang::TokenType::LESS, Precedence::COMPARISON, InfixKind::BINARY);
+            set(lang::TokenType::LESS_EQUAL, Precedence::COMPARISON, InfixKind::BINARY);
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_function_statement()
-    {
-        /* name will store the 'fun' */
-        lang::Token name = this->consume(lang::TokenType::IDENTIFIER,"Expect 'function' name");
-        (void)this->consume(lang::TokenType::LEFT_PAREN, "Expect '(' after function name");
-        
-        std::vector<lang::Token> parameters;
-        if(!this->check(lang::TokenType::RIGHT_PAREN))
-        {
-            do
-            {
-                if(parameters.size() >= 255)
-                {
-                    this->generate_error(this->peek().m_line, "Can't have more than 255 parameters");
-                }
+            set(lang::TokenType::MINUS, Precedence::TERM, InfixKind::BINARY);
+            set(lang::TokenType::PLUS, Precedence::TERM, InfixKind::BINARY);
 
-                parameters.emplace_back(this->consume(lang::TokenType::IDENTIFIER, "Expect parameter name."));
+            set(lang::TokenType::SLASH, Precedence::FACTOR, InfixKind::BINARY);
+            set(lang::TokenType::STAR, Precedence::FACTOR, InfixKind::BINARY);
 
-            } while(this->match({lang::TokenType::COMMA}));
+            set(lang::TokenType::LEFT_PAREN, Precedence::CALL, InfixKind::CALL);
+
+            return rules;
         }
 
-        this->consume(lang::TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
+        /* Indexed by TokenType, tokens that are not infix operators keep {Precedence::NONE, InfixKind::NONE} */
+        constexpr std::array<InfixRule, TOKEN_TYPE_COUNT> INFIX_RULES = make_infix_rules();
 
-        this->consume(lang::TokenType::LEFT_BRACE, "Expect '{' before function body.");
-        std::vector<std::unique_ptr<lang::ast::Statement>> body_stmts = this->parse_block();
+        static_assert(INFIX_RULES[static_cast<std::size_t>(lang::TokenType::MYEOF)].precedence == Precedence::NONE);
+    }
 
-        auto function_statement = std::make_unique<lang::ast::FunctionStatement>(name, std::move(parameters), std::move(body_stmts));
+    Parser::Parser()
+    {}
 
-        return std::move(function_statement);
+    Parser::~Parser()
+    {}
+    
+    std::pair<lang::ast::Program, std::vector<std::string>> Parser::parse(lang::TokenStream&& tokens)
+    {
+        m_tokens = std::move(tokens);
+        m_stream = &m_tokens;
+        m_literals = &m_tokens.literals();
+        m_token_source = nullptr;
 
-    }
+        m_current = 0;
+        /* It is important because we are moving from this class to outside at the end of tokenize function */
+        m_errors = std::vector<std::string>();
+        m_nesting_too_deep = false;
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_var_declaration()
-    {
-        lang::Token name = this->consume(lang::TokenType::IDENTIFIER, "Expect variable name.");
-        std::unique_ptr<lang::ast::Expression> initializer = nullptr;
+        lang::ast::Program program;
+        m_arena = &program.arena;
 
-        if(this->match({lang::TokenType::EQUAL}))
+        while(!this->is_at_end())
         {
-            initializer = this->parse_expression();
+            program.statements.emplace_back(this->parse_next_declaration());
         }
 
-        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after variable declaration");
+        m_arena = nullptr;
 
-        auto var_statement = std::make_unique<lang::ast::VarStatement>(name, std::move(initializer));
-        return std::move(var_statement);
+        return std::make_pair(std::move(program), std::move(m_errors));
     }
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_statement()
+    std::pair<lang::ast::Program, std::vector<std::string>> Parser::parse_parallel(lang::TokenStream&& tokens, unsigned thread_count)
     {
-        if(this->match({lang::TokenType::IF}))
+        std::vector<Range> ranges = Parser::split_into_ranges(tokens, thread_count);
+
+        if(ranges.size() <= 1)
         {
-            return this->parse_if_statement();
+            return this->parse(std::move(tokens));
         }
 
-        if(this->match({lang::TokenType::PRINT}))
+        std::vector<std::thread> workers;
+        for(auto& range: ranges)
         {
-            return this->parse_print_statement();
+            workers.emplace_back([&tokens, &range, lazy_function_bodies = m_lazy_function_bodies, max_nesting_depth = m_max_nesting_depth]()
+            {
+                lang::Parser range_parser;
+                range_parser.set_lazy_function_bodies(lazy_function_bodies);
+                range_parser.set_max_nesting_depth(max_nesting_depth);
+                range_parser.parse_range(tokens, range);
+            });
         }
 
-        if(this->match({lang::TokenType::RETURN}))
+        for(auto& worker: workers)
         {
-            return this->parse_return_statement();
+            worker.join();
         }
 
-        if(this->match({lang::TokenType::WHILE}))
+        /*
+            Between two top-level declarations the parser carries no state but its position, so a range that stopped
+            exactly at its end parsed the same declarations parse() would have. Otherwise the boundary was not
+            a declaration boundary for parse() and the ranges cannot be trusted
+        */
+        bool every_range_stopped_at_its_end = std::all_of(ranges.begin(), ranges.end(), [](const Range& range)
+        {
+            return range.stopped_at == range.end;
+        });
+
+        if(!every_range_stopped_at_its_end)
         {
-            return this->parse_while_statement();
+            return this->parse(std::move(tokens));
         }
 
-        if(this->match({lang::TokenType::LEFT_BRACE}))
+        /* Merge in source order, the nodes stay where they are and only the arena blocks change owner */
+        lang::ast::Program program;
+        std::vector<std::string> errors;
+
+        std::size_t statement_count = 0;
+        for(const auto& range: ranges)
         {
-            std::vector<std::unique_ptr<lang::ast::Statement>> stmts = this->parse_block();
-            auto block_statement = std::make_unique<lang::ast::BlockStatement>(std::move(stmts));
+            statement_count += range.statements.size();
+        }
+        program.statements.reserve(statement_count);
 
-            return std::move(block_statement);
+        for(auto& range: ranges)
+        {
+            program.arena.adopt(std::move(range.arena));
+            program.statements.insert(program.statements.end(), range.statements.begin(), range.statements.end());
+            errors.insert(errors.end(), std::make_move_iterator(range.errors.begin()), std::make_move_iterator(range.errors.end()));
         }
 
-        return this->parse_expression_statement();
+        /* Like parse(), the parser keeps the stream alive until the next parse */
+        m_tokens = std::move(tokens);
+        m_stream = &m_tokens;
+        m_literals = &m_tokens.literals();
+        m_token_source = nullptr;
+        m_errors = std::vector<std::string>();
+
+        return std::make_pair(std::move(program), std::move(errors));
     }
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_return_statement()
+    std::vector<Parser::Range> Parser::split_into_ranges(const lang::TokenStream& tokens, unsigned range_count)
     {
-        Token keyword = this->previous(); /* Stores the 'return' keyword Token */
-        std::unique_ptr<lang::ast::Expression> value = nullptr;
+        std::vector<Range> ranges;
 
-        if(!this->check({lang::TokenType::SEMICOLON}))
+        /* The last token is MYEOF */
+        int eof_index = static_cast<int>(tokens.size()) - 1;
+        int range_begin = 0;
+        int depth = 0;
+
+        auto split_target = [eof_index, range_count](std::size_t split)
         {
-            value = this->parse_expression();
-        }
+            return static_cast<int>(static_cast<long long>(eof_index) * static_cast<long long>(split) / range_count);
+        };
 
-        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after return value");
+        int next_split = split_target(1);
 
-        auto return_statement = std::make_unique<lang::ast::ReturnStatement>(keyword, std::move(value));
+        for(int i = 0; i < eof_index && ranges.size() + 1 < range_count; i++)
+        {
+            switch(tokens.type(i))
+            {
+                case lang::TokenType::LEFT_BRACE:
+                case lang::TokenType::LEFT_PAREN:
+                    depth++;
+                    break;
 
-        return std::move(return_statement);
-    }
+                case lang::TokenType::RIGHT_BRACE:
+                case lang::TokenType::RIGHT_PAREN:
+                    depth--;
+                    break;
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_while_statement()
-    {
-        (void)this->consume(lang::TokenType::LEFT_PAREN, "Expect '(' after 'while'.");
+                case lang::TokenType::FUN:
+                case lang::TokenType::VAR:
+                    /* Outside of every brace and parenthesis these start a top-level declaration */
+                    if(depth == 0 && i >= next_split && i > range_begin)
+                    {
+                        ranges.emplace_back(Range{range_begin, i, range_begin, {}, {}, {}});
+                        range_begin = i;
+                        next_split = split_target(ranges.size() + 1);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        ranges.emplace_back(Range{range_begin, eof_index, range_begin, {}, {}, {}});
 
-        std::unique_ptr<lang::ast::Expression> condition = this->parse_expression();
+        return ranges;
+    }
 
-        (void)this->consume(lang::TokenType::RIGHT_PAREN, "Expect ')' after condition.");
+    void Parser::parse_range(const lang::TokenStream& tokens, Range& range)
+    {
+        m_stream = &tokens;
+        m_literals = &tokens.literals();
+        m_token_source = nullptr;
+        m_arena = &range.arena;
 
-        std::unique_ptr<lang::ast::Statement> body = this->parse_statement();
+        m_current = range.begin;
+        m_errors = std::vector<std::string>();
+        m_nesting_too_deep = false;
 
-        auto while_statement = std::make_unique<lang::ast::WhileStatement>(std::move(condition), std::move(body));
+        while(m_current < range.end && !this->is_at_end())
+        {
+            range.statements.emplace_back(this->parse_next_declaration());
+        }
 
-        return std::move(while_statement);
+        range.stopped_at = m_current;
+        range.errors = std::move(m_errors);
     }
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_if_statement()
+    void Parser::begin(lang::Lexer& token_source, lang::ast::Arena& arena)
     {
-        (void)this->consume(lang::TokenType::LEFT_PAREN, "Expect '(' after 'if'.");
+        m_token_source = &token_source;
+        m_tokens = lang::TokenStream(token_source.source());
+        m_stream = &m_tokens;
+        m_literals = &token_source.literals();
+        m_arena = &arena;
 
-        std::unique_ptr<lang::ast::Expression> condition = this->parse_expression();
+        m_current = 0;
+        m_errors = std::vector<std::string>();
+        m_nesting_too_deep = false;
+    }
 
-        (void)this->consume(lang::TokenType::RIGHT_PAREN, "Expect ')' after 'if'.");
+    void Parser::set_lazy_function_bodies(bool lazy)
+    {
+        m_lazy_function_bodies = lazy;
+    }
 
-        std::unique_ptr<lang::ast::Statement> thenBranch = this->parse_statement();
-        std::unique_ptr<lang::ast::Statement> elseBranch = nullptr;
+    void Parser::set_max_nesting_depth(std::size_t max_nesting_depth)
+    {
+        m_max_nesting_depth = max_nesting_depth;
+    }
 
-        if(this->match({lang::TokenType::ELSE}))
+    std::vector<std::string> Parser::parse_function_body(lang::ast::FunctionStatement* function, lang::ast::Arena& arena)
+    {
+        if(function->is_body_parsed)
         {
-            elseBranch = this->parse_statement();
+            return std::vector<std::string>();
         }
 
-        auto if_statement = std::make_unique<lang::ast::IfStatement>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+        m_arena = &arena;
+        m_current = function->body_begin;
+        m_errors = std::vector<std::string>();
+        m_nesting_too_deep = false;
+
+        /* The range was brace matched by skip_function_body(), so the body ends at the '}' closing it */
+        function->is_body_parsed = true;
+        (void)this->parse_statement_tree(function);
+
+        return std::move(m_errors);
+    }
 
-        return std::move(if_statement);
+    bool Parser::has_more_declarations()
+    {
+        return !this->is_at_end();
     }
 
-    std::vector<std::unique_ptr<lang::ast::Statement>> Parser::parse_block()
+    lang::ast::Statement* Parser::parse_next_declaration()
     {
-        std::vector<std::unique_ptr<lang::ast::Statement>> statements;
+        int statement_begin = m_current;
+        lang::ast::Statement* parsed_statment = this->parse_declaration();
 
-        while(!this->check(lang::TokenType::RIGHT_BRACE) && !this->is_at_end())
+        if(parsed_statment == nullptr || m_current == statement_begin)
         {
-            statements.emplace_back(this->parse_declaration());
+            /* 
+                There is an error during parsing a statement, so skip it
+                A statement that consumed nothing started with a token no rule accepts, without skipping it we would parse it forever
+            */
+            this->synchronize_after_an_error();
         }
 
-        (void)this->consume(lang::TokenType::RIGHT_BRACE, "Expect '}' after block");
+        this->release_consumed_tokens();
 
-        return std::move(statements);
+        return parsed_statment;
     }
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_print_statement()
+    bool Parser::has_errors() const
     {
-        std::unique_ptr<lang::ast::Expression> expr = this->parse_expression();
-
-        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after value");
+        return !m_errors.empty();
+    }
 
-        auto print_statement = std::make_unique<lang::ast::PrintStatement>(std::move(expr));
+    std::vector<std::string> Parser::take_errors()
+    {
+        return std::exchange(m_errors, std::vector<std::string>());
+    }
 
-        return std::move(print_statement);
+    void Parser::fill_tokens_up_to(std::size_t index)
+    {
+        while(m_tokens.size() <= index)
+        {
+            /* The lexer keeps handing out MYEOF once the source is exhausted */
+            m_token_source->next_token(m_tokens);
+        }
     }
 
-    std::unique_ptr<lang::ast::Statement> Parser::parse_expression_statement()
+    void Parser::release_consumed_tokens()
     {
-        std::unique_ptr<lang::ast::Expression> expr = this->parse_expression();
-        
-        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after expression");
-        auto expression_statement = std::make_unique<lang::ast::ExpressionStatement>(std::move(expr));
+        if(m_token_source == nullptr || m_current <= 1)
+        {
+            return;
+        }
 
-        return std::move(expression_statement);
+        /* Keep previous() alive, everything before it belongs to declarations that were already handed out */
+        m_tokens.erase_front(m_current - 1);
+        m_current = 1;
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_expression()
+    lang::ast::Statement* Parser::parse_declaration()
     {
-        return this->parse_assignment();
+        return this->parse_statement_tree(nullptr);
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_assignment()
+    lang::ast::Statement* Parser::parse_statement_tree(lang::ast::FunctionStatement* function_body)
     {
-        std::unique_ptr<lang::ast::Expression> left_expr = this->parse_logical_or_expression();
+        const std::size_t frames_base = m_statement_frames.size();
+        const std::size_t statements_base = m_statement_scratch.size();
 
-        if(this->match({lang::TokenType::EQUAL}))
+        /* DECLARATION and STATEMENT parse the start of one, BLOCK_ITEM continues the innermost block, FINISH hands a parsed statement to its frame */
+        enum class Step { DECLARATION, STATEMENT, BLOCK_ITEM, FINISH };
+
+        Step step = Step::DECLARATION;
+        lang::ast::Statement* statement = nullptr;
+
+        if(function_body != nullptr)
         {
-            lang::Token equals = this->previous();
+            m_statement_frames.emplace_back(StatementFrame{StatementFrame::Kind::FUNCTION_BODY, m_current, statements_base, nullptr, nullptr, function_body});
+            step = Step::BLOCK_ITEM;
+        }
 
-            if(lang::ast::VariableExpression* var_expr = dynamic_cast<lang::ast::VariableExpression*>(left_expr.get()))
+        while(true)
+        {
+            if(m_nesting_too_deep)
             {
-                lang::Token name = var_expr->name;
-                std::unique_ptr<lang::ast::Expression> assignment_expr = this->parse_assignment();
-                
-                auto assignment_expression = std::make_unique<lang::ast::AssignmentExpression>(name, std::move(assignment_expr));
-                return std::move(assignment_expression);
+                /* The rest of the source was skipped, every unfinished statement is dropped */
+                m_statement_frames.erase(m_statement_frames.begin() + frames_base, m_statement_frames.end());
+                m_statement_scratch.erase(m_statement_scratch.begin() + statements_base, m_statement_scratch.end());
+
+                return nullptr;
             }
 
-            this->error(equals, "Invalid assignment target");
-        }
+            switch(step)
+            {
+                case Step::DECLARATION:
+                {
+                    if(this->match({lang::TokenType::FUN}))
+                    {
+                        lang::ast::FunctionStatement* function = this->parse_function_header();
+                        statement = function;
+                        step = Step::FINISH;
+
+                        if(function->is_body_parsed && !this->exceeds_nesting_limit())
+                        {
+                            m_statement_frames.emplace_back(StatementFrame{StatementFrame::Kind::FUNCTION_BODY, m_current, m_statement_scratch.size(), nullptr, nullptr, function});
+                            step = Step::BLOCK_ITEM;
+                        }
+                        break;
+                    }
+
+                    if(this->match({lang::TokenType::VAR}))
+                    {
+                        statement = this->parse_var_declaration();
+                        step = Step::FINISH;
+                        break;
+                    }
+
+                    step = Step::STATEMENT;
+                    break;
+                }
 
-        return left_expr;
-    }
+                case Step::STATEMENT:
+                {
+                    switch(this->peek_type())
+                    {
+                        case lang::TokenType::IF:
+                        {
+                            this->advance();
+                            (void)this->consume(lang::TokenType::LEFT_PAREN, "Expect '(' after 'if'.");
+
+                            lang::ast::Expression* condition = this->parse_expression();
+
+                            (void)this->consume(lang::TokenType::RIGHT_PAREN, "Expect ')' after 'if'.");
+
+                            if(!this->exceeds_nesting_limit())
+                            {
+                                m_statement_frames.emplace_back(StatementFrame{StatementFrame::Kind::IF_THEN, m_current, 0, condition, nullptr, nullptr});
+                            }
+                            break;
+                        }
+
+                        case lang::TokenType::WHILE:
+                        {
+                            this->advance();
+                            (void)this->consume(lang::TokenType::LEFT_PAREN, "Expect '(' after 'while'.");
+
+                            lang::ast::Expression* condition = this->parse_expression();
+
+                            (void)this->consume(lang::TokenType::RIGHT_PAREN, "Expect ')' after condition.");
+
+                            if(!this->exceeds_nesting_limit())
+                            {
+                                m_statement_frames.emplace_back(StatementFrame{StatementFrame::Kind::WHILE_BODY, m_current, 0, condition, nullptr, nullptr});
+                            }
+                            break;
+                        }
+
+                        case lang::TokenType::LEFT_BRACE:
+                        {
+                            this->advance();
+
+                            if(!this->exceeds_nesting_limit())
+                            {
+                                m_statement_frames.emplace_back(StatementFrame{StatementFrame::Kind::BLOCK, m_current, m_statement_scratch.size(), nullptr, nullptr, nullptr});
+                                step = Step::BLOCK_ITEM;
+                            }
+                            break;
+                        }
+
+                        case lang::TokenType::PRINT:
+                        {
+                            this->advance();
+                            statement = this->parse_print_statement();
+                            step = Step::FINISH;
+                            break;
+                        }
+
+                        case lang::TokenType::RETURN:
+                        {
+                            this->advance();
+                            statement = this->parse_return_statement();
+                            step = Step::FINISH;
+                            break;
+                        }
+
+                        default:
+                        {
+                            statement = this->parse_expression_statement();
+                            step = Step::FINISH;
+                            break;
+                        }
+                    }
+                    break;
+                }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_logical_or_expression()
-    {
-        std::unique_ptr<lang::ast::Expression> left_expr = this->parse_logical_and_expression();
-        
-        while(this->match({lang::TokenType::OR}))
-        {
-            lang::Token op = this->previous();
-            std::unique_ptr<lang::ast::Expression> right_expr = this->parse_logical_and_expression();
-            
-            auto logical_expression = std::make_unique<lang::ast::LogicalExpression>(std::move(left_expr), op, std::move(right_expr));
-            left_expr = std::move(logical_expression);
-        }
+                case Step::BLOCK_ITEM:
+                {
+                    if(!this->check(lang::TokenType::RIGHT_BRACE) && !this->is_at_end())
+                    {
+                        m_statement_frames.back().statement_begin = m_current;
+                        step = Step::DECLARATION;
+                        break;
+                    }
+
+                    StatementFrame frame = m_statement_frames.back();
+                    m_statement_frames.pop_back();
+
+                    lang::ast::List<lang::ast::Statement*> statements = m_arena->make_list(m_statement_scratch.data() + frame.statements_begin, m_statement_scratch.size() - frame.statements_begin);
+                    m_statement_scratch.erase(m_statement_scratch.begin() + frame.statements_begin, m_statement_scratch.end());
+
+                    (void)this->consume(lang::TokenType::RIGHT_BRACE, "Expect '}' after block");
+
+                    if(frame.kind == StatementFrame::Kind::FUNCTION_BODY)
+                    {
+                        frame.function->body_stmts = statements;
+                        statement = frame.function;
+                    }
+                    else
+                    {
+                        statement = m_arena->make<lang::ast::BlockStatement>(statements);
+                    }
+
+                    step = Step::FINISH;
+                    break;
+                }
 
-        return left_expr;
+                case Step::FINISH:
+                {
+                    if(m_statement_frames.size() == frames_base)
+                    {
+                        return statement;
+                    }
+
+                    StatementFrame& frame = m_statement_frames.back();
+
+                    switch(frame.kind)
+                    {
+                        case StatementFrame::Kind::BLOCK:
+                        case StatementFrame::Kind::FUNCTION_BODY:
+                        {
+                            m_statement_scratch.emplace_back(statement);
+
+                            if(m_current == frame.statement_begin)
+                            {
+                                /* Same recovery as parse_next_declaration(), a statement that consumed nothing is skipped */
+                                this->synchronize_after_an_error();
+                            }
+
+                            step = Step::BLOCK_ITEM;
+                            break;
+                        }
+
+                        case StatementFrame::Kind::IF_THEN:
+                        {
+                            if(this->match({lang::TokenType::ELSE}))
+                            {
+                                /* An 'else if' chain reuses this frame for its else branch, so it only grows the frame stack by one per link */
+                                frame.kind = StatementFrame::Kind::IF_ELSE;
+                                frame.then_branch = statement;
+                                step = Step::STATEMENT;
+                                break;
+                            }
+
+                            statement = m_arena->make<lang::ast::IfStatement>(frame.condition, statement, nullptr);
+                            m_statement_frames.pop_back();
+                            break;
+                        }
+
+                        case StatementFrame::Kind::IF_ELSE:
+                        {
+                            statement = m_arena->make<lang::ast::IfStatement>(frame.condition, frame.then_branch, statement);
+                            m_statement_frames.pop_back();
+                            break;
+                        }
+
+                        case StatementFrame::Kind::WHILE_BODY:
+                        {
+                            statement = m_arena->make<lang::ast::WhileStatement>(frame.condition, statement);
+                            m_statement_frames.pop_back();
+                            break;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_logical_and_expression()
+    lang::ast::FunctionStatement* Parser::parse_function_header()
     {
-        std::unique_ptr<lang::ast::Expression> left_expr = this->parse_equality();
+        /* name will store the 'fun' */
+        lang::Token name = this->consume(lang::TokenType::IDENTIFIER,"Expect 'function' name");
+        (void)this->consume(lang::TokenType::LEFT_PAREN, "Expect '(' after function name");
         
-        while(this->match({lang::TokenType::AND}))
+        std::size_t parameters_begin = m_parameter_scratch.size();
+        if(!this->check(lang::TokenType::RIGHT_PAREN))
         {
-            lang::Token op = this->previous();
-            std::unique_ptr<lang::ast::Expression> right_expr = this->parse_equality();
-            
-            auto logical_expression = std::make_unique<lang::ast::LogicalExpression>(std::move(left_expr), op, std::move(right_expr));
-            left_expr = std::move(logical_expression);
-        }
+            do
+            {
+                if(m_parameter_scratch.size() - parameters_begin >= 255)
+                {
+                    this->generate_error(this->peek().m_line, "Can't have more than 255 parameters");
+                }
 
-        return left_expr;
-    }
+                m_parameter_scratch.emplace_back(this->consume(lang::TokenType::IDENTIFIER, "Expect parameter name."));
 
+            } while(this->match({lang::TokenType::COMMA}));
+        }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_equality()
-    {
-        std::unique_ptr<lang::ast::Expression> left_expr = this->parse_comparison();
+        lang::ast::List<lang::Token> parameters = m_arena->make_list(m_parameter_scratch.data() + parameters_begin, m_parameter_scratch.size() - parameters_begin);
+        m_parameter_scratch.erase(m_parameter_scratch.begin() + parameters_begin, m_parameter_scratch.end());
+
+        this->consume(lang::TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
 
-        while(this->match({lang::TokenType::BANG_EQUAL, lang::TokenType::EQUAL_EQUAL}))
+        /* Only top-level bodies are skipped, a nested function is resolved in the scopes of the one around it, so it is parsed with it */
+        if(m_lazy_function_bodies && m_token_source == nullptr && m_statement_frames.empty() && this->check(lang::TokenType::LEFT_BRACE))
         {
-            lang::Token op = this->previous();
-            std::unique_ptr<lang::ast::Expression> right_expr = this->parse_comparison();
+            this->advance();
 
-            auto binary_expression = std::make_unique<lang::ast::BinaryExpression>(std::move(left_expr), op, std::move(right_expr));
-            left_expr = std::move(binary_expression);
+            int body_begin = m_current;
+            this->skip_function_body();
+
+            return m_arena->make<lang::ast::FunctionStatement>(name, parameters, body_begin);
         }
 
-        return left_expr;
+        this->consume(lang::TokenType::LEFT_BRACE, "Expect '{' before function body.");
+
+        /* The body is filled in by parse_statement_tree() once its block is parsed */
+        return m_arena->make<lang::ast::FunctionStatement>(name, parameters, lang::ast::List<lang::ast::Statement*>{});
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_comparison()
+    void Parser::skip_function_body()
     {
-        std::unique_ptr<lang::ast::Expression> left_expr = this->parse_term();
+        int depth = 1;
 
-        while(this->match({lang::TokenType::GREATER, lang::TokenType::GREATER_EQUAL, lang::TokenType::LESS, lang::TokenType::LESS_EQUAL}))
+        while(!this->is_at_end())
         {
-            lang::Token op = this->previous();
-            std::unique_ptr<lang::ast::Expression> right_expr = this->parse_term();
+            lang::TokenType type = this->peek_type();
+
+            if(type == lang::TokenType::LEFT_BRACE)
+            {
+                depth++;
+            }
+            else if(type == lang::TokenType::RIGHT_BRACE && --depth == 0)
+            {
+                break;
+            }
 
-            auto binary_expression = std::make_unique<lang::ast::BinaryExpression>(std::move(left_expr), op, std::move(right_expr));
-            left_expr = std::move(binary_expression);
+            this->advance();
         }
 
-        return left_expr;
+        (void)this->consume(lang::TokenType::RIGHT_BRACE, "Expect '}' after block");
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_term()
+    lang::ast::Statement* Parser::parse_var_declaration()
     {
-        std::unique_ptr<lang::ast::Expression> left_expr = this->parse_factor();
+        lang::Token name = this->consume(lang::TokenType::IDENTIFIER, "Expect variable name.");
+        lang::ast::Expression* initializer = nullptr;
 
-        while(this->match({lang::TokenType::MINUS, lang::TokenType::PLUS}))
+        if(this->match({lang::TokenType::EQUAL}))
         {
-            lang::Token op = this->previous();
-            std::unique_ptr<lang::ast::Expression> right_expr = this->parse_factor();
-
-            auto binary_expression = std::make_unique<lang::ast::BinaryExpression>(std::move(left_expr), op, std::move(right_expr));
-            left_expr = std::move(binary_expression);
+            initializer = this->parse_expression();
         }
 
-        return left_expr;
+        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after variable declaration");
+
+        auto var_statement = m_arena->make<lang::ast::VarStatement>(name, initializer);
+        return var_statement;
     }
-    
-    std::unique_ptr<lang::ast::Expression> Parser::parse_factor()
+
+    lang::ast::Statement* Parser::parse_return_statement()
     {
-        std::unique_ptr<lang::ast::Expression> left_expr = this->parse_unary();
+        Token keyword = this->previous(); /* Stores the 'return' keyword Token */
+        lang::ast::Expression* value = nullptr;
 
-        while(this->match({lang::TokenType::SLASH, lang::TokenType::STAR}))
+        if(!this->check({lang::TokenType::SEMICOLON}))
         {
-            lang::Token op = this->previous();
-            std::unique_ptr<lang::ast::Expression> right_expr = this->parse_unary();
-
-            auto binary_expression = std::make_unique<lang::ast::BinaryExpression>(std::move(left_expr), op, std::move(right_expr));
-            left_expr = std::move(binary_expression);
+            value = this->parse_expression();
         }
 
-        return left_expr;
+        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after return value");
+
+        auto return_statement = m_arena->make<lang::ast::ReturnStatement>(keyword, value);
+
+        return return_statement;
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_unary()
+    lang::ast::Statement* Parser::parse_print_statement()
     {
-        if(this->match({lang::TokenType::BANG, lang::TokenType::MINUS}))
-        {
-            lang::Token op = this->previous();
-            std::unique_ptr<lang::ast::Expression> right_expr = this->parse_unary();
+        lang::ast::Expression* expr = this->parse_expression();
 
-            auto unary_expression = std::make_unique<lang::ast::UnaryExpression>(op, std::move(right_expr));
+        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after value");
 
-            return std::move(unary_expression);
-        }
+        auto print_statement = m_arena->make<lang::ast::PrintStatement>(expr);
 
-        return this->parse_call_expression();
+        return print_statement;
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_call_expression()
+    lang::ast::Statement* Parser::parse_expression_statement()
     {
-        std::unique_ptr<lang::ast::Expression> expr = this->parse_primary();
+        lang::ast::Expression* expr = this->parse_expression();
+        
+        (void)this->consume(lang::TokenType::SEMICOLON, "Expect ';' after expression");
+        auto expression_statement = m_arena->make<lang::ast::ExpressionStatement>(expr);
 
-        while(this->match({lang::TokenType::LEFT_PAREN}))
-        {
-            auto single_call_expression = this->parse_single_call_expression_helper_function(std::move(expr));
-            expr = std::move(single_call_expression);
-        }
+        return expression_statement;
+    }
 
-        return expr;
+    lang::ast::Expression* Parser::parse_expression()
+    {
+        return this->parse_precedence(Precedence::ASSIGNMENT);
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_single_call_expression_helper_function(std::unique_ptr<lang::ast::Expression> callee)
+    lang::ast::Expression* Parser::parse_precedence(std::uint8_t min_precedence)
     {
-        std::vector<std::unique_ptr<lang::ast::Expression>> arguments;
+        const std::size_t frames_base = m_expression_frames.size();
+        const std::size_t arguments_base = m_expression_scratch.size();
+
+        /* OPERAND parses a prefix expression, INFIX folds in the operators binding at least as tightly as 'min_precedence', FINISH hands it to its frame */
+        enum class Step { OPERAND, INFIX, FINISH };
+
+        Step step = Step::OPERAND;
+        lang::ast::Expression* expr = nullptr;
 
-        if(!this->check({lang::TokenType::RIGHT_PAREN}))
+        while(true)
         {
-            /* We have arguments */
-            do
+            if(m_nesting_too_deep)
+            {
+                m_expression_frames.erase(m_expression_frames.begin() + frames_base, m_expression_frames.end());
+                m_expression_scratch.erase(m_expression_scratch.begin() + arguments_base, m_expression_scratch.end());
+
+                return nullptr;
+            }
+
+            switch(step)
             {
-                if(arguments.size() >= 255)
+                case Step::OPERAND:
                 {
-                    this->generate_error(this->peek().m_line, "Can't have more than 255 arguments");
+                    switch(this->peek_type())
+                    {
+                        case lang::TokenType::BANG:
+                        case lang::TokenType::MINUS:
+                        {
+                            if(this->exceeds_nesting_limit())
+                            {
+                                break;
+                            }
+
+                            this->advance();
+
+                            /* The operand binds tighter than any binary operator, calls still apply to it */
+                            m_expression_frames.emplace_back(ExpressionFrame{ExpressionFrame::Kind::UNARY, min_precedence, this->previous(), nullptr, 0});
+                            min_precedence = Precedence::UNARY;
+                            break;
+                        }
+
+                        case lang::TokenType::LEFT_PAREN:
+                        {
+                            if(this->exceeds_nesting_limit())
+                            {
+                                break;
+                            }
+
+                            this->advance();
+
+                            m_expression_frames.emplace_back(ExpressionFrame{ExpressionFrame::Kind::GROUPING, min_precedence, this->previous(), nullptr, 0});
+                            min_precedence = Precedence::ASSIGNMENT;
+                            break;
+                        }
+
+                        default:
+                        {
+                            expr = this->parse_primary();
+                            step = Step::INFIX;
+                            break;
+                        }
+                    }
+                    break;
                 }
-                arguments.emplace_back(this->parse_expression());
 
-            } while(this->match({lang::TokenType::COMMA}));
+                case Step::INFIX:
+                {
+                    /* MYEOF and every token that is not an infix operator have Precedence::NONE, which ends the loop */
+                    const InfixRule& rule = INFIX_RULES[static_cast<std::size_t>(this->peek_type())];
+
+                    if(rule.precedence < min_precedence)
+                    {
+                        step = Step::FINISH;
+                        break;
+                    }
+
+                    if(this->exceeds_nesting_limit())
+                    {
+                        break;
+                    }
+
+                    this->advance();
+
+                    switch(rule.kind)
+                    {
+                        case InfixKind::ASSIGNMENT:
+                        {
+                            lang::Token equals = this->previous();
+
+                            if(lang::ast::VariableExpression* var_expr = lang::ast::as<lang::ast::VariableExpression>(expr))
+                            {
+                                /* Right associative, so the value is parsed at the same precedence */
+                                m_expression_frames.emplace_back(ExpressionFrame{ExpressionFrame::Kind::ASSIGNMENT, min_precedence, var_expr->name, nullptr, 0});
+                                min_precedence = Precedence::ASSIGNMENT;
+                                step = Step::OPERAND;
+                                break;
+                            }
+
+                            this->error(equals, "Invalid assignment target");
+
+                            step = Step::FINISH;
+                            break;
+                        }
+
+                        case InfixKind::LOGICAL:
+                        case InfixKind::BINARY:
+                        {
+                            /* Left associative, so the right operand only takes operators binding tighter than this one */
+                            ExpressionFrame::Kind kind = rule.kind == InfixKind::LOGICAL ? ExpressionFrame::Kind::LOGICAL : ExpressionFrame::Kind::BINARY;
+
+                            m_expression_frames.emplace_back(ExpressionFrame{kind, min_precedence, this->previous(), expr, 0});
+                            min_precedence = rule.precedence + 1;
+                            step = Step::OPERAND;
+                            break;
+                        }
+
+                        case InfixKind::CALL:
+                        {
+                            if(this->check(lang::TokenType::RIGHT_PAREN))
+                            {
+                                expr = this->finish_call_expression(expr, m_expression_scratch.size());
+                                break;
+                            }
+
+                            /* We have arguments, each one is parsed as a whole expression */
+                            m_expression_frames.emplace_back(ExpressionFrame{ExpressionFrame::Kind::CALL_ARGUMENTS, min_precedence, this->previous(), expr, m_expression_scratch.size()});
+                            min_precedence = Precedence::ASSIGNMENT;
+                            step = Step::OPERAND;
+                            break;
+                        }
+
+                        case InfixKind::NONE:
+                            step = Step::FINISH;
+                            break;
+                    }
+                    break;
+                }
+
+                case Step::FINISH:
+                {
+                    if(m_expression_frames.size() == frames_base)
+                    {
+                        return expr;
+                    }
+
+                    ExpressionFrame& frame = m_expression_frames.back();
+                    min_precedence = frame.min_precedence;
+                    step = Step::INFIX;
+
+                    switch(frame.kind)
+                    {
+                        case ExpressionFrame::Kind::UNARY:
+                            expr = m_arena->make<lang::ast::UnaryExpression>(frame.op, expr);
+                            break;
+
+                        case ExpressionFrame::Kind::GROUPING:
+                            (void)this->consume(lang::TokenType::RIGHT_PAREN, "Expecting ')' after expression.");
+                            expr = m_arena->make<lang::ast::GroupingExpression>(expr);
+                            break;
+
+                        case ExpressionFrame::Kind::BINARY:
+                            expr = m_arena->make<lang::ast::BinaryExpression>(frame.left, frame.op, expr);
+                            break;
+
+                        case ExpressionFrame::Kind::LOGICAL:
+                            expr = m_arena->make<lang::ast::LogicalExpression>(frame.left, frame.op, expr);
+                            break;
+
+                        case ExpressionFrame::Kind::ASSIGNMENT:
+                            /* An assignment ends the level it appeared in */
+                            expr = m_arena->make<lang::ast::AssignmentExpression>(frame.op, expr);
+                            step = Step::FINISH;
+                            break;
+
+                        case ExpressionFrame::Kind::CALL_ARGUMENTS:
+                        {
+                            m_expression_scratch.emplace_back(expr);
+
+                            if(this->match({lang::TokenType::COMMA}))
+                            {
+                                if(m_expression_scratch.size() - frame.arguments_begin >= 255)
+                                {
+                                    this->generate_error(this->peek().m_line, "Can't have more than 255 arguments");
+                                }
+
+                                /* The frame stays for the next argument */
+                                min_precedence = Precedence::ASSIGNMENT;
+                                step = Step::OPERAND;
+                                continue;
+                            }
+
+                            expr = this->finish_call_expression(frame.left, frame.arguments_begin);
+                            break;
+                        }
+                    }
+
+                    m_expression_frames.pop_back();
+                    break;
+                }
+            }
         }
+    }
+
+    lang::ast::Expression* Parser::finish_call_expression(lang::ast::Expression* callee, std::size_t arguments_begin)
+    {
+        lang::ast::List<lang::ast::Expression*> arguments = m_arena->make_list(m_expression_scratch.data() + arguments_begin, m_expression_scratch.size() - arguments_begin);
+        m_expression_scratch.erase(m_expression_scratch.begin() + arguments_begin, m_expression_scratch.end());
 
-        /* We do not have any arguments */
         lang::Token paren = this->consume(lang::TokenType::RIGHT_PAREN, "Expect ')' after arguments");
 
-        auto call_expression = std::make_unique<lang::ast::CallExpression>(std::move(callee), paren, std::move(arguments));
-        
-        return std::move(call_expression);
+        return m_arena->make<lang::ast::CallExpression>(callee, paren, arguments);
     }
 
-    std::unique_ptr<lang::ast::Expression> Parser::parse_primary()
+    lang::ast::Expression* Parser::parse_primary()
     {
-        std::unique_ptr<lang::ast::Expression> expr;
-
-        if(this->match({lang::TokenType::FALSE}))
+        switch(this->peek_type())
         {
-            double value = 10.1;
-            auto literal_expression = std::make_unique<lang::ast::LiteralExpression>(value);
-            
-            expr = std::move(literal_expression);
-
-            return expr;
-        }
+            case lang::TokenType::FALSE:
+                this->advance();
+                return m_arena->make<lang::ast::LiteralExpression>(false);
 
-        if(this->match({lang::TokenType::TRUE}))
-        {
-            double value = 10.2;
-            auto literal_expression = std::make_unique<lang::ast::LiteralExpression>(value);
-            
-            expr = std::move(literal_expression);
+            case lang::TokenType::TRUE:
+                this->advance();
+                return m_arena->make<lang::ast::LiteralExpression>(true);
 
-            return expr;
-        }
+            case lang::TokenType::NIL:
+                this->advance();
+                return m_arena->make<lang::ast::LiteralExpression>();
 
-        if(this->match({lang::TokenType::NIL}))
-        {
-            double value = 10.3;
-            auto literal_expression = std::make_unique<lang::ast::LiteralExpression>(value);
-            
-            expr = std::move(literal_expression);
+            /* The lexer already converted the value, the token only carries its index in the literal pool */
+            case lang::TokenType::NUMBER:
+                this->advance();
+                return m_arena->make<lang::ast::LiteralExpression>(m_literals->number(m_stream->literal(m_current - 1)));
 
-            return expr;
-        }
+            case lang::TokenType::STRING:
+                this->advance();
+                return m_arena->make<lang::ast::LiteralExpression>(m_literals->string(m_stream->literal(m_current - 1)));
 
-        if(this->match({lang::TokenType::NUMBER}))
-        {
-            // double value = this->previous().m_literal;
-            double value = 10.4;
-            auto literal_expression = std::make_unique<lang::ast::LiteralExpression>(value);
-            
-            expr = std::move(literal_expression);
+            case lang::TokenType::IDENTIFIER:
+                this->advance();
+                return m_arena->make<lang::ast::VariableExpression>(this->previous());
 
-            return expr;
+            default:
+                break;
         }
 
-        if(this->match({lang::TokenType::STRING}))
-        {
-            double value = 10.5;
-            auto literal_expression = std::make_unique<lang::ast::LiteralExpression>(value);
-            
-            expr = std::move(literal_expression);
+        this->error(this->peek(), "Expect Expression.");
 
-            return expr;
-        }
+        return nullptr; // Unreachable
+    }
 
-        if(this->match({lang::TokenType::IDENTIFIER}))
+    bool Parser::exceeds_nesting_limit()
+    {
+        if(m_statement_frames.size() + m_expression_frames.size() < m_max_nesting_depth)
         {
-            auto variable_expression = std::make_unique<lang::ast::VariableExpression>(this->previous());
-            
-            expr = std::move(variable_expression);
-
-            return expr;
+            return false;
         }
 
-        if(this->match({lang::TokenType::LEFT_PAREN}))
-        {
-            expr = this->parse_expression();
-            (void)this->consume(lang::TokenType::RIGHT_PAREN, "Expecting ')' after expression.");
-
-            auto grouping_expression = std::make_unique<lang::ast::GroupingExpression>(std::move(expr));
-            
-            expr = std::move(grouping_expression);
+        this->error(this->peek(), "Nesting is deeper than the limit of " + std::to_string(m_max_nesting_depth) + " levels");
 
-            return expr;
+        /* Every enclosing construct is left unfinished, nothing after this point could be parsed meaningfully */
+        while(!this->is_at_end())
+        {
+            this->advance();
         }
 
-        this->error(this->peek(), "Expect Expression.");
+        m_nesting_too_deep = true;
 
-        return nullptr; // Unreachable
+        return true;
     }
 
     lang::Token Parser::consume(lang::TokenType type, std::string message)
     {
         if(this->check(type))
         {
-            return this->advance();
+            this->advance();
+            return this->previous();
         }
 
         this->error(this->peek(), message);
 
-        return lang::Token{lang::TokenType::MYEOF, "DEAD END", lang::util::null, 1}; // Unreachable
+        return lang::Token{lang::TokenType::MYEOF, "DEAD END", lang::NO_LITERAL, 1}; // Unreachable
     }
     
-    std::unique_ptr<lang::ast::Statement> Parser::error(const Token& token, const std::string& message)
+    lang::ast::Statement* Parser::error(const Token& token, const std::string& message)
     {
+        if(m_nesting_too_deep)
+        {
+            /* The rest of the source was skipped, anything reported now would only be an echo of that error */
+            return nullptr;
+        }
+
         if(token.m_type == lang::TokenType::MYEOF)
         {
             this->generate_error(token.m_line, " at end: " + message);
         }
         else
         {
-            this->generate_error(token.m_line, " at '" + token.m_lexeme + "' " + message);
+            this->generate_error(token.m_line, " at '" + std::string{token.m_lexeme} + "' " + message);
         }
 
         return nullptr;
@@ -534,7 +1035,7 @@ namespace lang
             return false;
         }
 
-        return this->peek().m_type == type;
+        return this->peek_type() == type;
     }
 
     void Parser::synchronize_after_an_error()
@@ -543,7 +1044,7 @@ namespace lang
 
         while(!this->is_at_end())
         {
-            if(this->previous().m_type == lang::TokenType::SEMICOLON)
+            if(m_stream->type(m_current - 1) == lang::TokenType::SEMICOLON)
             {
                 /* 
                     We have reached the end of the statement which caused an exception. 
@@ -552,7 +1053,7 @@ namespace lang
                 return;
             }
 
-            switch(this->peek().m_type)
+            switch(this->peek_type())
             {
                 case lang::TokenType::CLASS:
                 case lang::TokenType::FUN:
@@ -570,28 +1071,41 @@ namespace lang
         }
     }
 
-    lang::Token Parser::advance()
+    void Parser::advance()
     {
         if(!this->is_at_end())
         {
             m_current++;
         }
-
-        return this->previous();
     }
 
     bool Parser::is_at_end()
     {
-        return this->peek().m_type == lang::TokenType::MYEOF;
+        return this->peek_type() == lang::TokenType::MYEOF;
+    }
+
+    lang::TokenType Parser::peek_type()
+    {
+        if(m_token_source != nullptr)
+        {
+            this->fill_tokens_up_to(m_current);
+        }
+
+        return m_stream->type(m_current);
     }
 
     Token Parser::peek()
     {
-        return m_tokens.at(m_current);
+        if(m_token_source != nullptr)
+        {
+            this->fill_tokens_up_to(m_current);
+        }
+
+        return m_stream->at(m_current);
     }
 
     Token Parser::previous()
     {
-        return m_tokens.at(m_current - 1);
+        return m_stream->at(m_current - 1);
     }
 }
\ No newline at end of file
@@ -0,0 +1,479 @@
+#include <resolver/resolver.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+namespace lang
+{
+    namespace
+    {
+        /* No local of that name is in scope, or no global of that name got a slot yet */
+        constexpr std::uint32_t NONE = UINT32_MAX;
+    }
+
+    std::vector<std::string> Resolver::resolve(const std::vector<lang::ast::Statement*>& statements, lang::ast::Arena& arena)
+    {
+        this->begin_resolution();
+
+        for(lang::ast::Statement* statement: statements)
+        {
+            this->resolve_declaration(statement, arena);
+        }
+
+        return this->end_resolution();
+    }
+
+    void Resolver::begin_resolution()
+    {
+        m_errors = std::vector<std::string>();
+
+        m_work.clear();
+        m_locals.clear();
+        m_scopes.clear();
+        m_innermost_local.clear();
+        m_global_slots.clear();
+        m_globals.clear();
+        m_pending_globals.clear();
+
+        m_frames.assign(1, Frame{nullptr, 0, 0});
+    }
+
+    void Resolver::resolve_declaration(lang::ast::Statement* statement, lang::ast::Arena& arena)
+    {
+        m_arena = &arena;
+
+        this->push(statement);
+        this->run();
+    }
+
+    bool Resolver::has_errors() const
+    {
+        return !m_errors.empty();
+    }
+
+    std::vector<std::string> Resolver::end_resolution()
+    {
+        this->report_undefined_globals();
+
+        return std::move(m_errors);
+    }
+
+    std::vector<std::string> Resolver::resolve_function_body(lang::ast::FunctionStatement* function, lang::ast::Arena& arena)
+    {
+        m_arena = &arena;
+        m_errors = std::vector<std::string>();
+
+        /* Its name was declared with the rest of the program, only the body is left */
+        this->begin_function(function);
+        m_work.push_back(Work{Work::Kind::END_FUNCTION, nullptr, nullptr});
+
+        for(std::size_t i = function->body_stmts.size(); i > 0; i--)
+        {
+            this->push(function->body_stmts[i - 1]);
+        }
+
+        this->run();
+        this->report_undefined_globals();
+
+        return std::move(m_errors);
+    }
+
+    std::uint32_t Resolver::global_count() const
+    {
+        return static_cast<std::uint32_t>(m_globals.size());
+    }
+
+    std::uint32_t Resolver::top_level_frame_size() const
+    {
+        return m_frames.empty() ? 0 : m_frames.front().size;
+    }
+
+    void Resolver::run()
+    {
+        while(!m_work.empty())
+        {
+            Work work = m_work.back();
+            m_work.pop_back();
+
+            switch(work.kind)
+            {
+                case Work::Kind::STATEMENT:
+                    this->resolve_statement(work.statement);
+                    break;
+
+                case Work::Kind::EXPRESSION:
+                    this->resolve_expression(work.expression);
+                    break;
+
+                case Work::Kind::DEFINE:
+                {
+                    lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(work.statement);
+
+                    /* A global comes into existence only now, so 'var a = a;' at the top level refers to an earlier 'a' */
+                    if(m_scopes.empty())
+                    {
+                        var->binding = this->declare_global(var->name);
+                    }
+                    else
+                    {
+                        m_locals[m_innermost_local[var->name.m_symbol]].defined = true;
+                    }
+                    break;
+                }
+
+                case Work::Kind::END_SCOPE:
+                    this->end_scope();
+                    break;
+
+                case Work::Kind::END_FUNCTION:
+                    this->end_function();
+                    break;
+            }
+        }
+    }
+
+    /* Children are pushed last to first, so they are resolved in source order and a name is only seen by the code after its declaration */
+    void Resolver::resolve_statement(lang::ast::Statement* statement)
+    {
+        switch(statement->kind)
+        {
+            case lang::ast::StatementKind::EXPRESSION:
+                this->push(static_cast<lang::ast::ExpressionStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::PRINT:
+                this->push(static_cast<lang::ast::PrintStatement*>(statement)->expr);
+                break;
+
+            case lang::ast::StatementKind::VAR:
+            {
+                lang::ast::VarStatement* var = static_cast<lang::ast::VarStatement*>(statement);
+
+                /* A local is declared before its initializer, which must not read it, and defined after it */
+                if(!m_scopes.empty())
+                {
+                    var->binding = this->declare(var->name, &var->captured, false);
+                }
+
+                m_work.push_back(Work{Work::Kind::DEFINE, var, nullptr});
+                this->push(var->initializer);
+                break;
+            }
+
+            case lang::ast::StatementKind::BLOCK:
+            {
+                lang::ast::BlockStatement* block = static_cast<lang::ast::BlockStatement*>(statement);
+
+                this->begin_scope();
+                m_work.push_back(Work{Work::Kind::END_SCOPE, nullptr, nullptr});
+
+                for(std::size_t i = block->statements.size(); i > 0; i--)
+                {
+                    this->push(block->statements[i - 1]);
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::IF:
+            {
+                lang::ast::IfStatement* if_statement = static_cast<lang::ast::IfStatement*>(statement);
+
+                this->push(if_statement->elseBranch);
+                this->push(if_statement->thenBranch);
+                this->push(if_statement->condition);
+                break;
+            }
+
+            case lang::ast::StatementKind::WHILE:
+            {
+                lang::ast::WhileStatement* while_statement = static_cast<lang::ast::WhileStatement*>(statement);
+
+                this->push(while_statement->body_stmt);
+                this->push(while_statement->condition_expr);
+                break;
+            }
+
+            case lang::ast::StatementKind::FUNCTION:
+            {
+                lang::ast::FunctionStatement* function = static_cast<lang::ast::FunctionStatement*>(statement);
+
+                /* Defined right away, so the body can call the function itself */
+                function->binding = this->declare(function->name, &function->captured, true);
+
+                /* A skipped body is resolved by resolve_function_body() once it is parsed */
+                if(function->is_body_parsed)
+                {
+                    this->begin_function(function);
+                    m_work.push_back(Work{Work::Kind::END_FUNCTION, nullptr, nullptr});
+
+                    for(std::size_t i = function->body_stmts.size(); i > 0; i--)
+                    {
+                        this->push(function->body_stmts[i - 1]);
+                    }
+                }
+                break;
+            }
+
+            case lang::ast::StatementKind::RETURN:
+            {
+                lang::ast::ReturnStatement* return_statement = static_cast<lang::ast::ReturnStatement*>(statement);
+
+                if(m_frames.size() == 1)
+                {
+                    this->error(return_statement->keyword, "Can't return from top-level code.");
+                }
+
+                this->push(return_statement->expr);
+                break;
+            }
+        }
+    }
+
+    void Resolver::resolve_expression(lang::ast::Expression* expression)
+    {
+        switch(expression->kind)
+        {
+            case lang::ast::ExpressionKind::VARIABLE:
+            {
+                lang::ast::VariableExpression* variable = static_cast<lang::ast::VariableExpression*>(expression);
+                variable->binding = this->resolve_name(variable->name, true);
+                break;
+            }
+
+            case lang::ast::ExpressionKind::ASSIGNMENT:
+            {
+                lang::ast::AssignmentExpression* assignment = static_cast<lang::ast::AssignmentExpression*>(expression);
+                assignment->binding = this->resolve_name(assignment->name, false);
+
+                this->push(assignment->expr);
+                break;
+            }
+
+            case lang::ast::ExpressionKind::BINARY:
+                this->push(static_cast<lang::ast::BinaryExpression*>(expression)->right);
+                this->push(static_cast<lang::ast::BinaryExpression*>(expression)->left);
+                break;
+
+            case lang::ast::ExpressionKind::LOGICAL:
+                this->push(static_cast<lang::ast::LogicalExpression*>(expression)->right);
+                this->push(static_cast<lang::ast::LogicalExpression*>(expression)->left);
+                break;
+
+            case lang::ast::ExpressionKind::GROUPING:
+                this->push(static_cast<lang::ast::GroupingExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::UNARY:
+                this->push(static_cast<lang::ast::UnaryExpression*>(expression)->expr);
+                break;
+
+            case lang::ast::ExpressionKind::CALL:
+            {
+                lang::ast::CallExpression* call = static_cast<lang::ast::CallExpression*>(expression);
+
+                for(std::size_t i = call->arguments.size(); i > 0; i--)
+                {
+                    this->push(call->arguments[i - 1]);
+                }
+                this->push(call->callee);
+                break;
+            }
+
+            case lang::ast::ExpressionKind::LITERAL:
+                break;
+        }
+    }
+
+    void Resolver::push(lang::ast::Statement* statement)
+    {
+        if(statement != nullptr)
+        {
+            m_work.push_back(Work{Work::Kind::STATEMENT, statement, nullptr});
+        }
+    }
+
+    void Resolver::push(lang::ast::Expression* expression)
+    {
+        if(expression != nullptr)
+        {
+            m_work.push_back(Work{Work::Kind::EXPRESSION, nullptr, expression});
+        }
+    }
+
+    void Resolver::begin_scope()
+    {
+        m_scopes.push_back(Scope{m_locals.size(), m_frames.back().next_slot});
+    }
+
+    void Resolver::end_scope()
+    {
+        Scope scope = m_scopes.back();
+        m_scopes.pop_back();
+
+        while(m_locals.size() > scope.locals_begin)
+        {
+            m_innermost_local[m_locals.back().symbol] = m_locals.back().shadowed;
+            m_locals.pop_back();
+        }
+
+        m_frames.back().next_slot = scope.next_slot;
+    }
+
+    void Resolver::begin_function(lang::ast::FunctionStatement* function)
+    {
+        m_frames.push_back(Frame{function, 0, 0});
+        this->begin_scope();
+
+        std::size_t parameter_count = function->params.size();
+        bool* captured = static_cast<bool*>(m_arena->allocate(std::max<std::size_t>(parameter_count, 1), alignof(bool)));
+        std::fill(captured, captured + parameter_count, false);
+
+        function->captured_params = lang::ast::List<bool>{captured, static_cast<std::uint32_t>(parameter_count)};
+
+        for(std::size_t i = 0; i < parameter_count; i++)
+        {
+            (void)this->declare(function->params[i], &captured[i], true);
+        }
+    }
+
+    void Resolver::end_function()
+    {
+        this->end_scope();
+
+        m_frames.back().function->frame_size = m_frames.back().size;
+        m_frames.pop_back();
+    }
+
+    lang::ast::Binding Resolver::declare(const lang::Token& name, bool* captured, bool defined)
+    {
+        if(m_scopes.empty())
+        {
+            return this->declare_global(name);
+        }
+
+        lang::Symbol symbol = name.m_symbol;
+        if(symbol >= m_innermost_local.size())
+        {
+            m_innermost_local.resize(symbol + 1, NONE);
+        }
+
+        std::uint32_t shadowed = m_innermost_local[symbol];
+        if(shadowed != NONE && shadowed >= m_scopes.back().locals_begin)
+        {
+            this->error(name, "Already a variable with this name in this scope.");
+        }
+
+        Frame& frame = m_frames.back();
+        std::uint32_t slot = frame.next_slot++;
+        frame.size = std::max(frame.size, frame.next_slot);
+
+        m_innermost_local[symbol] = static_cast<std::uint32_t>(m_locals.size());
+        m_locals.push_back(Local{symbol, static_cast<std::uint32_t>(m_frames.size() - 1), slot, shadowed, defined, captured});
+
+        return lang::ast::Binding{0, slot};
+    }
+
+    lang::ast::Binding Resolver::declare_global(const lang::Token& name)
+    {
+        std::uint32_t slot = this->global_slot(name.m_symbol);
+        Global& global = m_globals[slot];
+
+        /* A function may use a global declared after it, as long as it is called later, top-level code runs in order */
+        if(!global.declared && global.first_top_level_use_line != 0)
+        {
+            this->generate_error(global.first_top_level_use_line, " at '" + std::string{name.m_lexeme} + "' Variable used before its declaration.");
+        }
+
+        /* Declaring a global again is allowed, it is the same variable */
+        global.declared = true;
+
+        return lang::ast::Binding{lang::ast::Binding::GLOBAL, slot};
+    }
+
+    lang::ast::Binding Resolver::resolve_name(const lang::Token& name, bool is_read)
+    {
+        lang::Symbol symbol = name.m_symbol;
+
+        std::uint32_t local_index = symbol < m_innermost_local.size() ? m_innermost_local[symbol] : NONE;
+        if(local_index != NONE)
+        {
+            Local& local = m_locals[local_index];
+
+            if(is_read && !local.defined)
+            {
+                this->error(name, "Can't read local variable in its own initializer.");
+            }
+
+            std::uint32_t depth = static_cast<std::uint32_t>(m_frames.size() - 1) - local.function;
+            if(depth > 0)
+            {
+                *local.captured = true;
+            }
+
+            return lang::ast::Binding{depth, local.slot};
+        }
+
+        std::uint32_t slot = this->global_slot(symbol);
+        Global& global = m_globals[slot];
+
+        if(!global.declared)
+        {
+            if(global.first_use_line == 0)
+            {
+                global.first_use_line = name.m_line;
+                m_pending_globals.push_back(slot);
+            }
+
+            if(m_frames.size() == 1 && global.first_top_level_use_line == 0)
+            {
+                global.first_top_level_use_line = name.m_line;
+            }
+        }
+
+        return lang::ast::Binding{lang::ast::Binding::GLOBAL, slot};
+    }
+
+    std::uint32_t Resolver::global_slot(lang::Symbol symbol)
+    {
+        if(symbol >= m_global_slots.size())
+        {
+            m_global_slots.resize(symbol + 1, NONE);
+        }
+
+        if(m_global_slots[symbol] == NONE)
+        {
+            m_global_slots[symbol] = static_cast<std::uint32_t>(m_globals.size());
+            m_globals.push_back(Global{symbol, false, 0, 0});
+        }
+
+        return m_global_slots[symbol];
+    }
+
+    void Resolver::report_undefined_globals()
+    {
+        for(std::uint32_t slot: m_pending_globals)
+        {
+            const Global& global = m_globals[slot];
+
+            if(!global.declared)
+            {
+                this->generate_error(global.first_use_line, " at '" + std::string{lang::Interner::global().name(global.symbol)} + "' Undefined variable.");
+            }
+        }
+
+        m_pending_globals.clear();
+    }
+
+    void Resolver::error(const lang::Token& token, const std::string& message)
+    {
+        this->generate_error(token.m_line, " at '" + std::string{token.m_lexeme} + "' " + message);
+    }
+
+    void Resolver::generate_error(int line, const std::string& message)
+    {
+        std::stringstream buffer;
+        buffer << "[line " << line << "] Error : " << message << "\n";
+
+        m_errors.emplace_back(buffer.str());
+    }
+}
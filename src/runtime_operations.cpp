@@ -0,0 +1,89 @@
+#include <runtime/operations.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace lang
+{
+    namespace runtime
+    {
+        bool values_equal(double left, double right)
+        {
+            if(is_number(left) && is_number(right))
+            {
+                return left == right;
+            }
+
+            if(bits_of(left) == bits_of(right))
+            {
+                return true;
+            }
+
+            if(!is_string(left) || !is_string(right))
+            {
+                return false;
+            }
+
+            const String* left_string = reinterpret_cast<const String*>(unbox_object(left));
+            const String* right_string = reinterpret_cast<const String*>(unbox_object(right));
+
+            return left_string->length == right_string->length && std::memcmp(left_string->characters, right_string->characters, left_string->length) == 0;
+        }
+
+        double concatenate(double left, double right)
+        {
+            const String* left_string = reinterpret_cast<const String*>(unbox_object(left));
+            const String* right_string = reinterpret_cast<const String*>(unbox_object(right));
+
+            std::int64_t length = left_string->length + right_string->length;
+            char* characters = static_cast<char*>(std::malloc(length + 1));
+            std::memcpy(characters, left_string->characters, left_string->length);
+            std::memcpy(characters + left_string->length, right_string->characters, right_string->length);
+            characters[length] = '\0';
+
+            String* result = static_cast<String*>(std::malloc(sizeof(String)));
+            *result = String{STRING_OBJECT, length, characters};
+
+            return box_object(result);
+        }
+
+        void print(double value)
+        {
+            if(is_number(value))
+            {
+                std::printf("%g\n", value);
+                return;
+            }
+
+            switch(bits_of(value))
+            {
+                case TRUE_VALUE: std::printf("true\n"); return;
+                case FALSE_VALUE: std::printf("false\n"); return;
+                case NIL_VALUE: std::printf("nil\n"); return;
+                default: break;
+            }
+
+            if(is_string(value))
+            {
+                const String* string = reinterpret_cast<const String*>(unbox_object(value));
+                std::printf("%.*s\n", static_cast<int>(string->length), string->characters);
+                return;
+            }
+
+            std::printf("<fn %s>\n", reinterpret_cast<const Closure*>(unbox_object(value))->name);
+        }
+
+        void exit_program(int status)
+        {
+            std::fflush(nullptr);
+            std::_Exit(status);
+        }
+
+        void runtime_error(int line, const char* message, int first_argument, int second_argument)
+        {
+            std::fprintf(stderr, message, first_argument, second_argument);
+            std::fprintf(stderr, "\n[line %d] in script\n", line);
+            exit_program(RUNTIME_ERROR_STATUS);
+        }
+    }
+}
@@ -0,0 +1,424 @@
+#include <lexer/scan.hpp>
+
+#include <cstring>
+#include <string_view>
+
+/* SSE2 is part of the x86-64 baseline, so only AVX2 needs a runtime check */
+#if defined(__SSE2__)
+    #define LANG_SCAN_X86 1
+    #include <immintrin.h>
+#endif
+
+namespace lang
+{
+    namespace scan
+    {
+        namespace
+        {
+            /**************************************************** SCALAR ****************************************************/
+
+            inline bool is_whitespace(char c)
+            {
+                return c == ' ' || c == '\r' || c == '\t' || c == '\n';
+            }
+
+            inline bool is_digit(char c)
+            {
+                return (c >= '0' && c <= '9');
+            }
+
+            inline bool is_identifier_char(char c)
+            {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || is_digit(c);
+            }
+
+            std::size_t skip_whitespace_scalar(const char* data, std::size_t i, std::size_t size, int& line)
+            {
+                while(i < size && is_whitespace(data[i]))
+                {
+                    if(data[i] == '\n')
+                    {
+                        line++;
+                    }
+                    i++;
+                }
+
+                return i;
+            }
+
+            std::size_t skip_identifier_body_scalar(const char* data, std::size_t i, std::size_t size)
+            {
+                while(i < size && is_identifier_char(data[i]))
+                {
+                    i++;
+                }
+
+                return i;
+            }
+
+            std::size_t skip_digits_scalar(const char* data, std::size_t i, std::size_t size)
+            {
+                while(i < size && is_digit(data[i]))
+                {
+                    i++;
+                }
+
+                return i;
+            }
+
+            std::size_t skip_string_body_scalar(const char* data, std::size_t i, std::size_t size, int& line)
+            {
+                while(i < size && data[i] != '"')
+                {
+                    if(data[i] == '\n')
+                    {
+                        line++;
+                    }
+                    i++;
+                }
+
+                return i;
+            }
+
+#if defined(LANG_SCAN_X86)
+            /**************************************************** SSE2 ****************************************************/
+
+            /*
+                The byte classes are built from signed compares: every byte >= 0x80 is negative,
+                so it falls outside of all the ASCII ranges below, exactly like in the scalar code.
+            */
+            inline __m128i in_range_sse2(__m128i v, char lo, char hi)
+            {
+                return _mm_and_si128(
+                    _mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                    _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(hi + 1)), v)
+                );
+            }
+
+            inline unsigned whitespace_mask_sse2(__m128i v)
+            {
+                __m128i ws = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')))
+                );
+
+                return static_cast<unsigned>(_mm_movemask_epi8(ws));
+            }
+
+            inline unsigned identifier_mask_sse2(__m128i v)
+            {
+                __m128i id = _mm_or_si128(
+                    _mm_or_si128(in_range_sse2(v, 'a', 'z'), in_range_sse2(v, 'A', 'Z')),
+                    _mm_or_si128(in_range_sse2(v, '0', '9'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')))
+                );
+
+                return static_cast<unsigned>(_mm_movemask_epi8(id));
+            }
+
+            inline unsigned byte_mask_sse2(__m128i v, char c)
+            {
+                return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))));
+            }
+
+            inline __m128i load_sse2(const char* p)
+            {
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            }
+
+            std::size_t skip_whitespace_sse2(const char* data, std::size_t i, std::size_t size, int& line)
+            {
+                while(i + 16 <= size)
+                {
+                    __m128i v = load_sse2(data + i);
+                    unsigned stop = ~whitespace_mask_sse2(v) & 0xFFFFu;
+                    unsigned newlines = byte_mask_sse2(v, '\n');
+
+                    if(stop != 0)
+                    {
+                        unsigned n = __builtin_ctz(stop);
+                        line += __builtin_popcount(newlines & ((1u << n) - 1));
+                        return i + n;
+                    }
+
+                    line += __builtin_popcount(newlines);
+                    i += 16;
+                }
+
+                return skip_whitespace_scalar(data, i, size, line);
+            }
+
+            std::size_t skip_identifier_body_sse2(const char* data, std::size_t i, std::size_t size)
+            {
+                while(i + 16 <= size)
+                {
+                    unsigned stop = ~identifier_mask_sse2(load_sse2(data + i)) & 0xFFFFu;
+
+                    if(stop != 0)
+                    {
+                        return i + __builtin_ctz(stop);
+                    }
+
+                    i += 16;
+                }
+
+                return skip_identifier_body_scalar(data, i, size);
+            }
+
+            std::size_t skip_digits_sse2(const char* data, std::size_t i, std::size_t size)
+            {
+                while(i + 16 <= size)
+                {
+                    __m128i digits = in_range_sse2(load_sse2(data + i), '0', '9');
+                    unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(digits)) & 0xFFFFu;
+
+                    if(stop != 0)
+                    {
+                        return i + __builtin_ctz(stop);
+                    }
+
+                    i += 16;
+                }
+
+                return skip_digits_scalar(data, i, size);
+            }
+
+            std::size_t skip_string_body_sse2(const char* data, std::size_t i, std::size_t size, int& line)
+            {
+                while(i + 16 <= size)
+                {
+                    __m128i v = load_sse2(data + i);
+                    unsigned stop = byte_mask_sse2(v, '"');
+                    unsigned newlines = byte_mask_sse2(v, '\n');
+
+                    if(stop != 0)
+                    {
+                        unsigned n = __builtin_ctz(stop);
+                        line += __builtin_popcount(newlines & ((1u << n) - 1));
+                        return i + n;
+                    }
+
+                    line += __builtin_popcount(newlines);
+                    i += 16;
+                }
+
+                return skip_string_body_scalar(data, i, size, line);
+            }
+
+            /**************************************************** AVX2 ****************************************************/
+
+            #define LANG_SCAN_AVX2 __attribute__((target("avx2")))
+
+            LANG_SCAN_AVX2 inline __m256i in_range_avx2(__m256i v, char lo, char hi)
+            {
+                return _mm256_and_si256(
+                    _mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                    _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), v)
+                );
+            }
+
+            LANG_SCAN_AVX2 inline unsigned whitespace_mask_avx2(__m256i v)
+            {
+                __m256i ws = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')))
+                );
+
+                return static_cast<unsigned>(_mm256_movemask_epi8(ws));
+            }
+
+            LANG_SCAN_AVX2 inline unsigned identifier_mask_avx2(__m256i v)
+            {
+                __m256i id = _mm256_or_si256(
+                    _mm256_or_si256(in_range_avx2(v, 'a', 'z'), in_range_avx2(v, 'A', 'Z')),
+                    _mm256_or_si256(in_range_avx2(v, '0', '9'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')))
+                );
+
+                return static_cast<unsigned>(_mm256_movemask_epi8(id));
+            }
+
+            LANG_SCAN_AVX2 inline unsigned byte_mask_avx2(__m256i v, char c)
+            {
+                return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+            }
+
+            LANG_SCAN_AVX2 inline __m256i load_avx2(const char* p)
+            {
+                return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            }
+
+            LANG_SCAN_AVX2 std::size_t skip_whitespace_avx2(const char* data, std::size_t i, std::size_t size, int& line)
+            {
+                while(i + 32 <= size)
+                {
+                    __m256i v = load_avx2(data + i);
+                    unsigned stop = ~whitespace_mask_avx2(v);
+                    unsigned newlines = byte_mask_avx2(v, '\n');
+
+                    if(stop != 0)
+                    {
+                        unsigned n = __builtin_ctz(stop);
+                        line += __builtin_popcount(newlines & ((1u << n) - 1));
+                        return i + n;
+                    }
+
+                    line += __builtin_popcount(newlines);
+                    i += 32;
+                }
+
+                return skip_whitespace_sse2(data, i, size, line);
+            }
+
+            LANG_SCAN_AVX2 std::size_t skip_identifier_body_avx2(const char* data, std::size_t i, std::size_t size)
+            {
+                while(i + 32 <= size)
+                {
+                    unsigned stop = ~identifier_mask_avx2(load_avx2(data + i));
+
+                    if(stop != 0)
+                    {
+                        return i + __builtin_ctz(stop);
+                    }
+
+                    i += 32;
+                }
+
+                return skip_identifier_body_sse2(data, i, size);
+            }
+
+            LANG_SCAN_AVX2 std::size_t skip_digits_avx2(const char* data, std::size_t i, std::size_t size)
+            {
+                while(i + 32 <= size)
+                {
+                    __m256i digits = in_range_avx2(load_avx2(data + i), '0', '9');
+                    unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(digits));
+
+                    if(stop != 0)
+                    {
+                        return i + __builtin_ctz(stop);
+                    }
+
+                    i += 32;
+                }
+
+                return skip_digits_sse2(data, i, size);
+            }
+
+            LANG_SCAN_AVX2 std::size_t skip_string_body_avx2(const char* data, std::size_t i, std::size_t size, int& line)
+            {
+                while(i + 32 <= size)
+                {
+                    __m256i v = load_avx2(data + i);
+                    unsigned stop = byte_mask_avx2(v, '"');
+                    unsigned newlines = byte_mask_avx2(v, '\n');
+
+                    if(stop != 0)
+                    {
+                        unsigned n = __builtin_ctz(stop);
+                        line += __builtin_popcount(newlines & ((1u << n) - 1));
+                        return i + n;
+                    }
+
+                    line += __builtin_popcount(newlines);
+                    i += 32;
+                }
+
+                return skip_string_body_sse2(data, i, size, line);
+            }
+
+            #undef LANG_SCAN_AVX2
+#endif
+
+            /**************************************************** DISPATCH ****************************************************/
+
+            struct Implementation
+            {
+                std::size_t (*skip_whitespace)(const char*, std::size_t, std::size_t, int&);
+                std::size_t (*skip_identifier_body)(const char*, std::size_t, std::size_t);
+                std::size_t (*skip_digits)(const char*, std::size_t, std::size_t);
+                std::size_t (*skip_string_body)(const char*, std::size_t, std::size_t, int&);
+            };
+
+            Implementation scalar_implementation()
+            {
+                return Implementation{skip_whitespace_scalar, skip_identifier_body_scalar, skip_digits_scalar, skip_string_body_scalar};
+            }
+
+            Implementation select_implementation()
+            {
+#if defined(LANG_SCAN_X86)
+                __builtin_cpu_init();
+
+                if(__builtin_cpu_supports("avx2"))
+                {
+                    return Implementation{skip_whitespace_avx2, skip_identifier_body_avx2, skip_digits_avx2, skip_string_body_avx2};
+                }
+
+                return Implementation{skip_whitespace_sse2, skip_identifier_body_sse2, skip_digits_sse2, skip_string_body_sse2};
+#else
+                return scalar_implementation();
+#endif
+            }
+
+            /* Selected once, before main() runs, force_implementation() may replace it before anything is lexed */
+            Implementation implementation = select_implementation();
+        }
+
+        bool force_implementation(std::string_view name)
+        {
+            if(name == "scalar")
+            {
+                implementation = scalar_implementation();
+                return true;
+            }
+
+#if defined(LANG_SCAN_X86)
+            if(name == "sse2")
+            {
+                implementation = Implementation{skip_whitespace_sse2, skip_identifier_body_sse2, skip_digits_sse2, skip_string_body_sse2};
+                return true;
+            }
+
+            if(name == "avx2" && __builtin_cpu_supports("avx2"))
+            {
+                implementation = Implementation{skip_whitespace_avx2, skip_identifier_body_avx2, skip_digits_avx2, skip_string_body_avx2};
+                return true;
+            }
+#endif
+
+            return false;
+        }
+
+        std::size_t skip_whitespace(const char* data, std::size_t from, std::size_t size, int& line)
+        {
+            return implementation.skip_whitespace(data, from, size, line);
+        }
+
+        std::size_t skip_comment(const char* data, std::size_t from, std::size_t size)
+        {
+            if(from >= size)
+            {
+                return size;
+            }
+
+            /* memchr() is already vectorized by the C library on every target we support */
+            const void* newline = std::memchr(data + from, '\n', size - from);
+
+            return newline == nullptr ? size : static_cast<std::size_t>(static_cast<const char*>(newline) - data);
+        }
+
+        std::size_t skip_identifier_body(const char* data, std::size_t from, std::size_t size)
+        {
+            return implementation.skip_identifier_body(data, from, size);
+        }
+
+        std::size_t skip_digits(const char* data, std::size_t from, std::size_t size)
+        {
+            return implementation.skip_digits(data, from, size);
+        }
+
+        std::size_t skip_string_body(const char* data, std::size_t from, std::size_t size, int& line)
+        {
+            return implementation.skip_string_body(data, from, size, line);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include <source/source_file.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace lang
+{
+    SourceFile::SourceFile()
+    {}
+
+    SourceFile::~SourceFile()
+    {
+        this->close();
+    }
+
+    bool SourceFile::open(const char* absolute_path_of_source_code)
+    {
+        this->close();
+
+        int fd = ::open(absolute_path_of_source_code, O_RDONLY);
+        if(fd == -1)
+        {
+            return false;
+        }
+
+        struct stat file_stat;
+        if(::fstat(fd, &file_stat) == -1)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        std::size_t file_size = static_cast<std::size_t>(file_stat.st_size);
+
+        /* mmap() refuses zero length mappings, an empty file is simply an empty view */
+        if(file_size == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        /* The mapping stays valid after the descriptor is closed */
+        ::close(fd);
+
+        if(mapping == MAP_FAILED)
+        {
+            return false;
+        }
+
+        /* The lexer walks the file front to back exactly once */
+        ::madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+        m_data = static_cast<const char*>(mapping);
+        m_size = file_size;
+
+        return true;
+    }
+
+    void SourceFile::close()
+    {
+        if(m_data != nullptr)
+        {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    std::string_view SourceFile::view() const
+    {
+        return std::string_view{m_data, m_size};
+    }
+}
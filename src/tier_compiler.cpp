@@ -0,0 +1,179 @@
+#include <jit/tier_compiler.hpp>
+#include <generator/generator.hpp>
+#include <native/native_emitter.hpp>
+
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+namespace lang
+{
+    TierCompiler::TierCompiler(unsigned optimization_level, std::vector<std::pair<std::string, void*>> symbols)
+        : m_optimization_level(optimization_level), m_symbols(std::move(symbols))
+    {
+        lang::NativeEmitter::initialize_native_target();
+    }
+
+    TierCompiler::~TierCompiler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_requested.notify_one();
+
+        if(m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    void TierCompiler::request_function(lang::ast::FunctionStatement* function, std::string symbol, std::atomic<void*>* code)
+    {
+        this->request(Request{function, nullptr, {}, std::move(symbol), code});
+    }
+
+    void TierCompiler::request_loop(lang::ast::WhileStatement* loop, std::vector<bool> boxed_slots, std::string symbol, std::atomic<void*>* code)
+    {
+        this->request(Request{nullptr, loop, std::move(boxed_slots), std::move(symbol), code});
+    }
+
+    void TierCompiler::request(Request request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back(std::move(request));
+        }
+        m_requested.notify_one();
+
+        if(!m_thread.joinable())
+        {
+            m_thread = std::thread([this]() { this->compile_requests(); });
+        }
+    }
+
+    std::size_t TierCompiler::compiled_count() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_compiled_count;
+    }
+
+    void TierCompiler::compile_requests()
+    {
+        bool has_jit = this->create_jit();
+
+        while(true)
+        {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_requested.wait(lock, [this]() { return m_stopping || !m_requests.empty(); });
+
+                if(m_stopping)
+                {
+                    return;
+                }
+
+                request = std::move(m_requests.front());
+                m_requests.pop_front();
+            }
+
+            /* A function which fails to compile stays in the interpreter */
+            void* code = has_jit ? this->compile(request) : nullptr;
+
+            if(code != nullptr)
+            {
+                request.code->store(code, std::memory_order_release);
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_compiled_count++;
+            }
+        }
+    }
+
+    bool TierCompiler::create_jit()
+    {
+        llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = llvm::orc::LLJITBuilder().create();
+
+        if(!jit)
+        {
+            llvm::consumeError(jit.takeError());
+            return false;
+        }
+        m_jit = std::move(*jit);
+
+        llvm::orc::JITDylib& main_library = m_jit->getMainJITDylib();
+
+        /* The C library of the runtime */
+        llvm::Expected<std::unique_ptr<llvm::orc::DynamicLibrarySearchGenerator>> process_symbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(m_jit->getDataLayout().getGlobalPrefix());
+
+        if(!process_symbols)
+        {
+            llvm::consumeError(process_symbols.takeError());
+            return false;
+        }
+        main_library.addGenerator(std::move(*process_symbols));
+
+        llvm::orc::SymbolMap symbol_map;
+        for(const auto& [name, address]: m_symbols)
+        {
+            symbol_map[m_jit->mangleAndIntern(name)] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(address), llvm::JITSymbolFlags::Exported);
+        }
+
+        if(llvm::Error error = main_library.define(llvm::orc::absoluteSymbols(std::move(symbol_map))))
+        {
+            llvm::consumeError(std::move(error));
+            return false;
+        }
+
+        lang::Generator generator;
+
+        if(!generator.generate_runtime().empty())
+        {
+            return false;
+        }
+        generator.optimize(m_optimization_level, false);
+
+        auto [context, module] = generator.take_module();
+
+        if(llvm::Error error = m_jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))))
+        {
+            llvm::consumeError(std::move(error));
+            return false;
+        }
+
+        return true;
+    }
+
+    void* TierCompiler::compile(const Request& request)
+    {
+        lang::Generator generator;
+
+        std::vector<std::string> errors = request.function != nullptr
+            ? generator.generate_function(request.function, request.symbol)
+            : generator.generate_loop(request.loop, request.boxed_slots, request.symbol);
+
+        if(!errors.empty())
+        {
+            return nullptr;
+        }
+        generator.optimize(m_optimization_level, false);
+
+        auto [context, module] = generator.take_module();
+
+        if(llvm::Error error = m_jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))))
+        {
+            llvm::consumeError(std::move(error));
+            return nullptr;
+        }
+
+        llvm::Expected<llvm::JITEvaluatedSymbol> symbol = m_jit->lookup(request.symbol);
+
+        if(!symbol)
+        {
+            llvm::consumeError(symbol.takeError());
+            return nullptr;
+        }
+
+        return llvm::jitTargetAddressToPointer<void*>(symbol->getAddress());
+    }
+}
@@ -0,0 +1,104 @@
+#include <token/token_stream.hpp>
+
+#include <algorithm>
+
+namespace lang
+{
+    void TokenStream::push_back(lang::TokenType type, std::size_t offset, std::size_t length, std::uint32_t payload, int line)
+    {
+        if(m_lines.empty() || m_lines.back().line != line)
+        {
+            m_lines.push_back(LineRun{static_cast<std::uint32_t>(m_types.size()), line});
+        }
+
+        m_types.push_back(type);
+        m_offsets.push_back(static_cast<std::uint32_t>(offset));
+        m_lengths.push_back(static_cast<std::uint32_t>(length));
+        m_payloads.push_back(payload);
+    }
+
+    void TokenStream::push_back(const lang::TokenStream& other, std::size_t index)
+    {
+        this->push_back(other.m_types[index], other.m_offsets[index], other.m_lengths[index], other.m_payloads[index], other.line(index));
+    }
+
+    void TokenStream::append(const lang::TokenStream& other)
+    {
+        this->reserve(this->size() + other.size());
+
+        for(std::size_t i = 0; i < other.size(); i++)
+        {
+            std::uint32_t payload = other.m_payloads[i];
+
+            if(has_literal(other.m_types[i]))
+            {
+                payload = m_literals.adopt(other.m_literals, payload);
+            }
+
+            this->push_back(other.m_types[i], other.m_offsets[i], other.m_lengths[i], payload, other.line(i));
+        }
+    }
+
+    void TokenStream::erase_front(std::size_t count)
+    {
+        if(count == 0)
+        {
+            return;
+        }
+
+        m_types.erase(m_types.begin(), m_types.begin() + count);
+        m_offsets.erase(m_offsets.begin(), m_offsets.begin() + count);
+        m_lengths.erase(m_lengths.begin(), m_lengths.begin() + count);
+        m_payloads.erase(m_payloads.begin(), m_payloads.begin() + count);
+
+        /* Keep the run holding the new first token, it now starts at token 0 */
+        auto first_kept = std::upper_bound(m_lines.begin(), m_lines.end(), count,
+            [](std::size_t index, const LineRun& run){ return index < run.first_token; }) - 1;
+
+        m_lines.erase(m_lines.begin(), first_kept);
+
+        for(auto& run: m_lines)
+        {
+            run.first_token = (run.first_token > count) ? static_cast<std::uint32_t>(run.first_token - count) : 0;
+        }
+
+        /* Every token of the first run may have been erased */
+        if(m_types.empty())
+        {
+            m_lines.clear();
+        }
+    }
+
+    void TokenStream::clear_tokens()
+    {
+        m_types.clear();
+        m_offsets.clear();
+        m_lengths.clear();
+        m_payloads.clear();
+        m_lines.clear();
+    }
+
+    void TokenStream::reserve(std::size_t token_count)
+    {
+        m_types.reserve(token_count);
+        m_offsets.reserve(token_count);
+        m_lengths.reserve(token_count);
+        m_payloads.reserve(token_count);
+    }
+
+    int TokenStream::line(std::size_t index) const
+    {
+        /* The last run whose first token is at or before 'index' */
+        auto run = std::upper_bound(m_lines.begin(), m_lines.end(), index,
+            [](std::size_t index, const LineRun& run){ return index < run.first_token; }) - 1;
+
+        return run->line;
+    }
+
+    std::size_t TokenStream::memory_usage() const
+    {
+        return m_types.capacity() * sizeof(lang::TokenType)
+            + (m_offsets.capacity() + m_lengths.capacity() + m_payloads.capacity()) * sizeof(std::uint32_t)
+            + m_lines.capacity() * sizeof(LineRun);
+    }
+}
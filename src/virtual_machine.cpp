@@ -0,0 +1,335 @@
+#include <vm/virtual_machine.hpp>
+#include <runtime/operations.hpp>
+
+#include <cstdlib>
+#include <iterator>
+
+namespace lang
+{
+    namespace
+    {
+        using lang::runtime::Closure;
+        using lang::runtime::bits_of;
+        using lang::runtime::boolean_value;
+        using lang::runtime::box_object;
+        using lang::runtime::is_closure;
+        using lang::runtime::is_number;
+        using lang::runtime::is_string;
+        using lang::runtime::is_truthy;
+        using lang::runtime::runtime_error;
+        using lang::runtime::unbox_object;
+        using lang::runtime::value_of;
+
+        /* A captured local's register holds the address of its box, it is never used as a value */
+        double box_register(double* box)
+        {
+            return value_of(reinterpret_cast<std::uint64_t>(box));
+        }
+
+        double* box_address(double value)
+        {
+            return reinterpret_cast<double*>(bits_of(value));
+        }
+
+        bool equal(double left, double right)
+        {
+            return is_number(left) && is_number(right) ? left == right : lang::runtime::values_equal(left, right);
+        }
+    }
+
+    VirtualMachine::VirtualMachine()
+        /* Left uninitialized, the pages of the stacks are only touched as deep as the program goes */
+        : m_registers(new double[REGISTER_STACK_SIZE]), m_frames(new CallFrame[MAX_FRAMES])
+    {}
+
+    void VirtualMachine::run(lang::vm::Module& module)
+    {
+        m_globals.assign(module.global_count, lang::runtime::NIL_DOUBLE);
+        this->execute(module);
+    }
+
+    void VirtualMachine::execute(lang::vm::Module& module)
+    {
+        /* In the order of vm::OpCode */
+        static const void* const HANDLERS[] = {
+            &&handle_MOVE, &&handle_LOAD_CONSTANT, &&handle_GET_GLOBAL, &&handle_SET_GLOBAL, &&handle_NEW_BOX, &&handle_GET_BOX,
+            &&handle_SET_BOX, &&handle_GET_UPVALUE, &&handle_SET_UPVALUE, &&handle_CLOSURE,
+            &&handle_ADD, &&handle_SUBTRACT, &&handle_MULTIPLY, &&handle_DIVIDE,
+            &&handle_EQUAL, &&handle_NOT_EQUAL, &&handle_LESS, &&handle_LESS_EQUAL, &&handle_GREATER, &&handle_GREATER_EQUAL,
+            &&handle_NEGATE, &&handle_NOT,
+            &&handle_JUMP, &&handle_JUMP_IF_FALSE, &&handle_JUMP_IF_TRUE,
+            &&handle_JUMP_UNLESS_EQUAL, &&handle_JUMP_UNLESS_NOT_EQUAL, &&handle_JUMP_UNLESS_LESS, &&handle_JUMP_UNLESS_LESS_EQUAL,
+            &&handle_JUMP_UNLESS_GREATER, &&handle_JUMP_UNLESS_GREATER_EQUAL,
+            &&handle_CALL, &&handle_CALL_0, &&handle_CALL_1, &&handle_CALL_2, &&handle_CALL_3,
+            &&handle_RETURN, &&handle_RETURN_NIL,
+            &&handle_PRINT
+        };
+
+        static_assert(std::size(HANDLERS) == static_cast<std::size_t>(lang::vm::OpCode::OPCODE_COUNT), "Every opcode has a handler");
+
+        if(!module.is_linked)
+        {
+            for(const std::unique_ptr<lang::vm::Prototype>& prototype: module.prototypes)
+            {
+                for(lang::vm::Instruction& instruction: prototype->code)
+                {
+                    instruction.handler = HANDLERS[static_cast<std::size_t>(instruction.op)];
+                }
+            }
+            module.is_linked = true;
+        }
+
+        /* The state of the running function, the registers of the C++ compiler if it can */
+        const lang::vm::Prototype* prototype = module.prototypes.front().get();
+        Closure* closure = nullptr;
+        const lang::vm::Instruction* ip = prototype->code.data();
+        const double* constants = prototype->constants.data();
+        double* base = m_registers.get();
+        double* globals = m_globals.data();
+
+        CallFrame* frame = m_frames.get();
+        CallFrame* const frames_end = m_frames.get() + MAX_FRAMES;
+        double* const registers_end = m_registers.get() + REGISTER_STACK_SIZE;
+
+        if(prototype->register_count > REGISTER_STACK_SIZE)
+        {
+            runtime_error(0, "Stack overflow.");
+        }
+
+#define LANG_VM_DISPATCH() goto *ip->handler
+#define LANG_VM_NEXT() do { ++ip; LANG_VM_DISPATCH(); } while(false)
+#define LANG_VM_LINE() (prototype->lines[ip - prototype->code.data()])
+
+#define LANG_VM_NUMBER_OPERATION(expression)                                                                            \
+        {                                                                                                               \
+            double left = base[ip->b];                                                                                  \
+            double right = base[ip->c];                                                                                 \
+            if(!is_number(left) || !is_number(right))                                                                   \
+            {                                                                                                           \
+                runtime_error(LANG_VM_LINE(), "Operands must be numbers.");                                            \
+            }                                                                                                           \
+            base[ip->a] = (expression);                                                                                 \
+            LANG_VM_NEXT();                                                                                             \
+        }
+
+#define LANG_VM_JUMP_UNLESS(condition)                                                                                  \
+        {                                                                                                               \
+            bool holds = (condition);                                                                                   \
+            ip += holds ? 1 : ip->c + 1;                                                                                \
+            LANG_VM_DISPATCH();                                                                                         \
+        }
+
+#define LANG_VM_NUMBER_JUMP_UNLESS(comparison)                                                                          \
+        {                                                                                                               \
+            double left = base[ip->a];                                                                                  \
+            double right = base[ip->b];                                                                                 \
+            if(!is_number(left) || !is_number(right))                                                                   \
+            {                                                                                                           \
+                runtime_error(LANG_VM_LINE(), "Operands must be numbers.");                                            \
+            }                                                                                                           \
+            LANG_VM_JUMP_UNLESS(comparison);                                                                            \
+        }
+
+/* The arguments are already in place, the callee's frame starts right after the callee */
+#define LANG_VM_CALL(argument_count)                                                                                    \
+        {                                                                                                               \
+            double callee = base[ip->a];                                                                                \
+            if(!is_closure(callee))                                                                                     \
+            {                                                                                                           \
+                runtime_error(LANG_VM_LINE(), "Can only call functions.");                                             \
+            }                                                                                                           \
+            Closure* target = reinterpret_cast<Closure*>(unbox_object(callee));                                         \
+            int count = static_cast<int>(argument_count);                                                               \
+            if(target->arity != count)                                                                                  \
+            {                                                                                                           \
+                runtime_error(LANG_VM_LINE(), "Expected %d arguments but got %d.", target->arity, count);              \
+            }                                                                                                           \
+            const lang::vm::Prototype* target_prototype = static_cast<const lang::vm::Prototype*>(target->interpreted); \
+            double* target_base = base + ip->a + 1;                                                                     \
+            if(frame == frames_end || target_base + target_prototype->register_count > registers_end)                   \
+            {                                                                                                           \
+                runtime_error(LANG_VM_LINE(), "Stack overflow.");                                                      \
+            }                                                                                                           \
+            *frame++ = CallFrame{prototype, closure, ip + 1, base};                                                     \
+            prototype = target_prototype;                                                                               \
+            closure = target;                                                                                           \
+            base = target_base;                                                                                         \
+            constants = prototype->constants.data();                                                                    \
+            ip = prototype->code.data();                                                                                \
+            LANG_VM_DISPATCH();                                                                                         \
+        }
+
+/* The result replaces the callee, in the register before the frame */
+#define LANG_VM_RETURN(result)                                                                                          \
+        {                                                                                                               \
+            double value = (result);                                                                                    \
+            if(frame == m_frames.get())                                                                                 \
+            {                                                                                                           \
+                return;                                                                                                 \
+            }                                                                                                           \
+            base[-1] = value;                                                                                           \
+            --frame;                                                                                                    \
+            prototype = frame->prototype;                                                                               \
+            closure = frame->closure;                                                                                   \
+            ip = frame->resume;                                                                                         \
+            base = frame->base;                                                                                         \
+            constants = prototype->constants.data();                                                                    \
+            LANG_VM_DISPATCH();                                                                                         \
+        }
+
+        LANG_VM_DISPATCH();
+
+    handle_MOVE:
+        base[ip->a] = base[ip->b];
+        LANG_VM_NEXT();
+
+    handle_LOAD_CONSTANT:
+        base[ip->a] = constants[ip->b];
+        LANG_VM_NEXT();
+
+    handle_GET_GLOBAL:
+        base[ip->a] = globals[ip->b];
+        LANG_VM_NEXT();
+
+    handle_SET_GLOBAL:
+        globals[ip->b] = base[ip->a];
+        LANG_VM_NEXT();
+
+    handle_NEW_BOX:
+    {
+        double* box = static_cast<double*>(std::malloc(sizeof(double)));
+        *box = base[ip->b];
+        base[ip->a] = box_register(box);
+        LANG_VM_NEXT();
+    }
+
+    handle_GET_BOX:
+        base[ip->a] = *box_address(base[ip->b]);
+        LANG_VM_NEXT();
+
+    handle_SET_BOX:
+        *box_address(base[ip->a]) = base[ip->b];
+        LANG_VM_NEXT();
+
+    handle_GET_UPVALUE:
+        base[ip->a] = *closure->upvalues()[ip->b];
+        LANG_VM_NEXT();
+
+    handle_SET_UPVALUE:
+        *closure->upvalues()[ip->b] = base[ip->a];
+        LANG_VM_NEXT();
+
+    handle_CLOSURE:
+    {
+        const lang::vm::Prototype* function = module.prototypes[ip->b].get();
+        std::size_t upvalue_count = function->upvalues.size();
+
+        Closure* created = static_cast<Closure*>(std::malloc(sizeof(Closure) + upvalue_count * sizeof(double*)));
+        created->kind = lang::runtime::CLOSURE_OBJECT;
+        created->function = nullptr;
+        created->name = function->name.c_str();
+        created->arity = static_cast<std::int32_t>(function->arity);
+        created->upvalue_count = static_cast<std::int32_t>(upvalue_count);
+        created->interpreted = const_cast<lang::vm::Prototype*>(function);
+
+        /* The boxes are copied now, from the frame creating the closure */
+        for(std::size_t i = 0; i < upvalue_count; i++)
+        {
+            const lang::vm::UpvalueSource& source = function->upvalues[i];
+            created->upvalues()[i] = source.is_local ? box_address(base[source.index]) : closure->upvalues()[source.index];
+        }
+
+        base[ip->a] = box_object(created);
+        LANG_VM_NEXT();
+    }
+
+    handle_ADD:
+    {
+        double left = base[ip->b];
+        double right = base[ip->c];
+
+        if(is_number(left) && is_number(right))
+        {
+            base[ip->a] = left + right;
+        }
+        else if(is_string(left) && is_string(right))
+        {
+            base[ip->a] = lang::runtime::concatenate(left, right);
+        }
+        else
+        {
+            runtime_error(LANG_VM_LINE(), "Operands must be two numbers or two strings.");
+        }
+        LANG_VM_NEXT();
+    }
+
+    handle_SUBTRACT: LANG_VM_NUMBER_OPERATION(left - right)
+    handle_MULTIPLY: LANG_VM_NUMBER_OPERATION(left * right)
+    handle_DIVIDE: LANG_VM_NUMBER_OPERATION(left / right)
+
+    handle_EQUAL:
+        base[ip->a] = boolean_value(equal(base[ip->b], base[ip->c]));
+        LANG_VM_NEXT();
+
+    handle_NOT_EQUAL:
+        base[ip->a] = boolean_value(!equal(base[ip->b], base[ip->c]));
+        LANG_VM_NEXT();
+
+    handle_LESS: LANG_VM_NUMBER_OPERATION(boolean_value(left < right))
+    handle_LESS_EQUAL: LANG_VM_NUMBER_OPERATION(boolean_value(left <= right))
+    handle_GREATER: LANG_VM_NUMBER_OPERATION(boolean_value(left > right))
+    handle_GREATER_EQUAL: LANG_VM_NUMBER_OPERATION(boolean_value(left >= right))
+
+    handle_NEGATE:
+    {
+        double operand = base[ip->b];
+
+        if(!is_number(operand))
+        {
+            runtime_error(LANG_VM_LINE(), "Operand must be a number.");
+        }
+        base[ip->a] = -operand;
+        LANG_VM_NEXT();
+    }
+
+    handle_NOT:
+        base[ip->a] = boolean_value(!is_truthy(base[ip->b]));
+        LANG_VM_NEXT();
+
+    handle_JUMP:
+        ip += ip->c + 1;
+        LANG_VM_DISPATCH();
+
+    handle_JUMP_IF_FALSE: LANG_VM_JUMP_UNLESS(is_truthy(base[ip->a]))
+    handle_JUMP_IF_TRUE: LANG_VM_JUMP_UNLESS(!is_truthy(base[ip->a]))
+
+    handle_JUMP_UNLESS_EQUAL: LANG_VM_JUMP_UNLESS(equal(base[ip->a], base[ip->b]))
+    handle_JUMP_UNLESS_NOT_EQUAL: LANG_VM_JUMP_UNLESS(!equal(base[ip->a], base[ip->b]))
+    handle_JUMP_UNLESS_LESS: LANG_VM_NUMBER_JUMP_UNLESS(left < right)
+    handle_JUMP_UNLESS_LESS_EQUAL: LANG_VM_NUMBER_JUMP_UNLESS(left <= right)
+    handle_JUMP_UNLESS_GREATER: LANG_VM_NUMBER_JUMP_UNLESS(left > right)
+    handle_JUMP_UNLESS_GREATER_EQUAL: LANG_VM_NUMBER_JUMP_UNLESS(left >= right)
+
+    handle_CALL: LANG_VM_CALL(ip->b)
+    handle_CALL_0: LANG_VM_CALL(0)
+    handle_CALL_1: LANG_VM_CALL(1)
+    handle_CALL_2: LANG_VM_CALL(2)
+    handle_CALL_3: LANG_VM_CALL(3)
+
+    handle_RETURN: LANG_VM_RETURN(base[ip->a])
+    handle_RETURN_NIL: LANG_VM_RETURN(lang::runtime::NIL_DOUBLE)
+
+    handle_PRINT:
+        lang::runtime::print(base[ip->a]);
+        LANG_VM_NEXT();
+
+#undef LANG_VM_DISPATCH
+#undef LANG_VM_NEXT
+#undef LANG_VM_LINE
+#undef LANG_VM_NUMBER_OPERATION
+#undef LANG_VM_JUMP_UNLESS
+#undef LANG_VM_NUMBER_JUMP_UNLESS
+#undef LANG_VM_CALL
+#undef LANG_VM_RETURN
+    }
+}